@@ -0,0 +1,301 @@
+/**
+\file spag_bench.cpp
+\brief Micro-benchmarks of the run-time hot paths of SpagFSM, build and run with "make bench"
+
+Measures, for several FSM sizes (number of states and of events):
+- processEvent() on allowed / ignored events, and processEvents() on a batch
+- callback dispatch, with a \c std::function and with a raw callback
+- processTimeOut(), and start()/stop() of a FSM with an already checked configuration
+- chains of pass-states (AAT) and inner events, see processInnerEvent()
+- processEvent() on each FSM of a set of instances, versus FsmPool::apply()
+- processEvent() on the run-time sized FSM (DynamicFSM), with the dense and the sparse transition table, for an increasing number of transitions per state
+
+The makefile builds this file several times, with different build options (logging enabled or not, packed table, ...),
+the name of the variant is given by symbol \c SPAG_BENCH_VARIANT.
+
+Output is csv-style, one line per measure, with the mean duration of an operation, in nanoseconds.
+
+This file is part of Spaghetti, a C++ library for implementing Finite State Machines
+
+Homepage: https://github.com/skramm/spaghetti
+*/
+
+#define SPAG_USE_SIGNALS
+#define SPAG_USE_FSM_POOL
+#include "spaghetti.hpp"
+
+#include <chrono>
+#include <random>
+
+#ifndef SPAG_BENCH_VARIANT
+	#define SPAG_BENCH_VARIANT default
+#endif
+
+/// Minimal duration of a measure, in ms
+#define SPAG_BENCH_DURATION 50
+
+/// Enums of a FSM having N states and N events
+template<size_t N>
+struct Enums
+{
+	enum States { NB_STATES = N };
+	enum Events { NB_EVENTS = N };
+};
+
+/// Event handler doing nothing, so that timeouts can be assigned and processed directly (see processTimeOut() )
+template<typename ST, typename EV, typename CBA>
+struct NullTimer
+{
+	void init( const spag::SpagFSM<ST,EV,NullTimer,CBA>* ) {}
+	void timerStart( const spag::SpagFSM<ST,EV,NullTimer,CBA>* ) {}
+	void timerCancel() {}
+	void kill() {}
+	void postDrain( const spag::SpagFSM<ST,EV,NullTimer,CBA>* ) {}
+};
+
+size_t g_count;
+
+void callback( int )
+{
+	g_count++;
+}
+void rawCallback( void*, int )
+{
+	g_count++;
+}
+
+//-----------------------------------------------------------------------------------
+/// Runs \c func (that does \c nbOps operations) until at least SPAG_BENCH_DURATION ms have elapsed, then prints the result
+template<typename F>
+void
+measure( const char* name, size_t nbStates, size_t nbEvents, size_t nbOps, F func )
+{
+	using Clock = std::chrono::steady_clock;
+	func();                                  // warm-up
+	size_t nbRuns = 0;
+	auto t0 = Clock::now();
+	auto t1 = t0;
+	do
+	{
+		func();
+		nbRuns++;
+		t1 = Clock::now();
+	}
+	while( t1 - t0 < std::chrono::milliseconds( SPAG_BENCH_DURATION ) );
+
+	auto total = nbRuns * nbOps;
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count();
+	std::cout << SPAG_STRINGIZE( SPAG_BENCH_VARIANT ) << ';' << name << ';' << nbStates << ';' << nbEvents
+		<< ';' << total << ';' << std::fixed << std::setprecision(2) << 1.0 * ns / total << '\n';
+}
+
+/// Same as above, for a FSM with as many events as states
+template<typename F>
+void
+measure( const char* name, size_t nbStates, size_t nbOps, F func )
+{
+	measure( name, nbStates, nbStates, nbOps, func );
+}
+
+//-----------------------------------------------------------------------------------
+template<typename FSM>
+void
+setLogFile( FSM& fsm, size_t n, const char* name )
+{
+#ifdef SPAG_ENABLE_LOGGING
+	fsm.setLogFileName( std::string("build/bench_") + name + '_' + std::to_string(n) + ".log" );
+#endif
+}
+
+//-----------------------------------------------------------------------------------
+/// Runs all the benchmarks on FSM of N states and N events
+template<size_t N>
+void
+runAll()
+{
+	using ST = typename Enums<N>::States;
+	using EV = typename Enums<N>::Events;
+	using fsm_t = spag::SpagFSM<ST,EV,NullTimer<ST,EV,int>,int>;
+	const size_t nbEv = 4096;                           // length of the event sequences
+
+	std::mt19937 rng( 1 );
+	std::vector<EV> v_allowed( nbEv ), v_ignored( nbEv );
+	for( size_t i=0; i<nbEv; i++ )
+	{
+		v_allowed[i] = static_cast<EV>( rng() % (N/2) );          // first half of the events are allowed on all the states
+		v_ignored[i] = static_cast<EV>( N/2 + rng() % (N/2) );    // second half are ignored
+	}
+
+// 1 - events
+	NullTimer<ST,EV,int> timer;
+	fsm_t fsm;
+	setLogFile( fsm, N, "events" );
+	fsm.assignEventHandler( &timer );
+	for( size_t s=0; s<N; s++ )
+		for( size_t e=0; e<N/2; e++ )
+			fsm.assignTransition( static_cast<ST>(s), static_cast<EV>(e), static_cast<ST>( (s+e+1)%N ) );
+	fsm.start();
+
+	measure( "event_allowed", N, nbEv, [&](){ for( auto ev: v_allowed ) fsm.processEvent( ev ); } );
+	measure( "event_ignored", N, nbEv, [&](){ for( auto ev: v_ignored ) fsm.processEvent( ev ); } );
+	measure( "event_batch",   N, nbEv, [&](){ fsm.processEvents( v_allowed ); } );
+
+	fsm.assignCallback( callback );
+	measure( "callback_function", N, nbEv, [&](){ for( auto ev: v_allowed ) fsm.processEvent( ev ); } );
+	fsm.assignCallback( &rawCallback, nullptr );
+	measure( "callback_raw",      N, nbEv, [&](){ for( auto ev: v_allowed ) fsm.processEvent( ev ); } );
+	fsm.stop();
+
+	fsm_t fsm_st;                                            // shares the configuration, already checked
+	fsm_st.assignConfig( fsm );
+	fsm_st.assignEventHandler( &timer );
+	measure( "start_stop", N, 64, [&](){ for( size_t i=0; i<64; i++ ) { fsm_st.start(); fsm_st.stop(); } } );
+
+// 2 - timeouts
+	fsm_t fsm_to;
+	setLogFile( fsm_to, N, "timeout" );
+	fsm_to.assignEventHandler( &timer );
+	for( size_t s=0; s<N; s++ )
+		fsm_to.assignTimeOut( static_cast<ST>(s), 1, static_cast<ST>( (s+1)%N ) );
+	fsm_to.start();
+	measure( "timeout", N, nbEv, [&](){ for( size_t i=0; i<nbEv; i++ ) fsm_to.processTimeOut(); } );
+	fsm_to.stop();
+
+// 3 - chain of pass-states: S0 => S1 => ... => S(N-1) => S0, measures the duration of a transition
+	fsm_t fsm_aat;
+	setLogFile( fsm_aat, N, "aat" );
+	fsm_aat.assignEventHandler( &timer );
+	fsm_aat.assignTransition( static_cast<ST>(0), static_cast<EV>(0), static_cast<ST>(1) );
+	for( size_t s=1; s<N; s++ )
+		fsm_aat.assignAAT( static_cast<ST>(s), static_cast<ST>( (s+1)%N ) );
+	fsm_aat.start();
+	measure( "aat_chain", N, 64*(N-1), [&](){ for( size_t i=0; i<64; i++ ) fsm_aat.processEvent( static_cast<EV>(0) ); } );
+	fsm_aat.stop();
+
+// 4 - inner events: S0 =>(ev0) S1 =>(inner event) S0, measures a cycle (activation and two transitions)
+	fsm_t fsm_ie;
+	setLogFile( fsm_ie, N, "inner" );
+	fsm_ie.assignEventHandler( &timer );
+	const auto iev = static_cast<EV>( N-1 );
+	fsm_ie.assignTransition( static_cast<ST>(0), static_cast<EV>(0), static_cast<ST>(1) );
+	fsm_ie.assignInnerTransition( static_cast<ST>(1), iev, static_cast<ST>(0) );
+	for( size_t s=2; s<N; s++ )                                 // so all states are reachable, and none is a dead-end
+		fsm_ie.assignTransition( static_cast<ST>(s-1), static_cast<EV>(1), static_cast<ST>(s) );
+	fsm_ie.assignTransition( static_cast<ST>(N-1), static_cast<EV>(1), static_cast<ST>(0) );
+	fsm_ie.start();
+	measure( "inner_event", N, nbEv,
+		[&]()
+		{
+			for( size_t i=0; i<nbEv; i++ )
+			{
+				fsm_ie.activateInnerEvent( iev );
+				fsm_ie.processEvent( static_cast<EV>(0) );
+			}
+		}
+	);
+	fsm_ie.stop();
+
+// 5 - run-time sized FSM, same configuration as 1
+	spag::DynamicFSM<uint16_t> fsm_dyn( N, N );
+	for( size_t s=0; s<N; s++ )
+		for( size_t e=0; e<N/2; e++ )
+			fsm_dyn.assignTransition( s, e, (s+e+1)%N );
+	fsm_dyn.start();
+	measure( "dynamic_event_allowed", N, nbEv, [&](){ for( auto ev: v_allowed ) fsm_dyn.processEvent( ev ); } );
+	measure( "dynamic_event_ignored", N, nbEv, [&](){ for( auto ev: v_ignored ) fsm_dyn.processEvent( ev ); } );
+	fsm_dyn.stop();
+}
+
+//-----------------------------------------------------------------------------------
+/// Runs \c nbEv random events on a DynamicFSM using table \c TABLE, having \c nbStates states, \c nbEvents events, and \c k transitions on each state
+template<typename TABLE>
+void
+runTable( const char* name, size_t nbStates, size_t nbEvents, size_t k )
+{
+	const size_t nbEv = 4096;
+	std::mt19937 rng( 1 );
+	spag::DynamicFSM<uint16_t,spag::StaticNoCallback<uint16_t,uint16_t>,TABLE> fsm( nbStates, nbEvents );
+	for( size_t s=0; s<nbStates; s++ )
+		for( size_t i=0; i<k; i++ )
+			fsm.assignTransition( s, (s+i*(nbEvents/k))%nbEvents, rng()%nbStates );
+	std::vector<uint16_t> v_ev( nbEv );
+	for( auto& ev: v_ev )
+		ev = rng() % nbEvents;
+	fsm.start();
+
+	std::string bname = std::string(name) + "_k" + std::to_string(k);
+	measure( bname.c_str(), nbStates, nbEvents, nbEv, [&](){ for( auto ev: v_ev ) fsm.processEvent( ev ); } );
+	std::cout << "# " << bname << ';' << nbStates << ';' << nbEvents << ";table size=" << fsm.table().memSize() << '\n';
+	fsm.stop();
+}
+
+/// Dense vs. sparse transition table of DynamicFSM, for an increasing number of transitions per state, to show the crossover point
+void
+runTables()
+{
+	for( size_t nbEvents: { 64, 1024 } )
+		for( size_t k=1; k<=nbEvents; k*=4 )
+		{
+			runTable<spag::DenseTable<uint16_t>>(  "table_dense",  16384, nbEvents, k );
+			runTable<spag::SparseTable<uint16_t>>( "table_sparse", 16384, nbEvents, k );
+		}
+}
+
+//-----------------------------------------------------------------------------------
+/// Processing of an event on many instances of a FSM: on each SpagFSM object, and with a FsmPool
+void
+runPool()
+{
+	const size_t N = 16;
+	const size_t nbInst = 100000;
+	using ST = Enums<N>::States;
+	using EV = Enums<N>::Events;
+	using fsm_t = spag::SpagFSM<ST,EV,NullTimer<ST,EV,int>,int>;
+
+	NullTimer<ST,EV,int> timer;
+	fsm_t model;
+	model.assignEventHandler( &timer );
+	for( size_t s=0; s<N; s++ )
+		model.assignTransition( static_cast<ST>(s), static_cast<EV>(s%2), static_cast<ST>( (s+1)%N ) );  // ev0 on even states, ev1 on odd states
+	model.assignCallback( callback );
+
+	std::vector<fsm_t> vfsm( nbInst );
+	for( auto& fsm: vfsm )
+	{
+		fsm.assignConfig( model );
+		fsm.assignEventHandler( &timer );
+		fsm.start();
+	}
+	spag::FsmPool<ST,EV,int> pool( model, nbInst );
+	pool.start();
+	for( size_t i=0; i<nbInst; i+=2 )          // half of the instances on an odd state, so each event is ignored by half of them
+	{
+		vfsm[i].processEvent( static_cast<EV>(0) );
+		pool.processEvent( i, static_cast<EV>(0) );
+	}
+	measure( "pool_loop",  N, 2*nbInst,
+		[&]()
+		{
+			for( auto& fsm: vfsm )
+				fsm.processEvent( static_cast<EV>(0) );
+			for( auto& fsm: vfsm )
+				fsm.processEvent( static_cast<EV>(1) );
+		}
+	);
+	measure( "pool_apply", N, 2*nbInst, [&](){ pool.apply( static_cast<EV>(0) ); pool.apply( static_cast<EV>(1) ); } );
+	for( auto& fsm: vfsm )
+		fsm.stop();
+}
+
+//-----------------------------------------------------------------------------------
+int main()
+{
+	std::cout << "# variant;bench;nb_states;nb_events;nb_ops;ns_per_op\n";
+	runAll<4>();
+	runAll<16>();
+	runAll<64>();
+	runAll<256>();
+	runAll<1024>();
+	runTables();
+	runPool();
+}
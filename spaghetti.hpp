@@ -40,23 +40,123 @@ DEALINGS IN THE SOFTWARE.
 #define SPAG_VERSION "0.9.6"
 
 #include <vector>
+#include <array>
+#include <bitset>
 #include <map>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <algorithm>
 #include <functional>
+#include <memory>
+#include <type_traits>
+#include <iterator>
 #include <cassert>
 #include <iomanip>
 #include <fstream>
 #include <iostream> // needed for expansion of SPAG_LOG
+#include <atomic>   // needed for priv::PrepareGuard
+#include <mutex>
 
 
-#if defined (SPAG_USE_SIGNALS)
-	#ifndef SPAG_SIGNAL
-		#define SPAG_SIGNAL SIGUSR1
+#if defined (SPAG_EMBED_ASIO_WRAPPER)
+	#define SPAG_USE_ASIO_WRAPPER
+#endif
+
+#if defined (SPAG_USE_FSM_ENGINE)
+	#ifndef SPAG_USE_TIMER_WHEEL
+		#define SPAG_USE_TIMER_WHEEL
 	#endif
+	#ifndef SPAG_EVENT_QUEUE_SIZE
+		#define SPAG_EVENT_QUEUE_SIZE 256  // max nb of pending posted events (per shard), must be a power of 2
+	#endif
+	#ifndef SPAG_ARENA_CHUNK_SIZE
+		#define SPAG_ARENA_CHUNK_SIZE 65536  // size of the memory chunks of the arenas of FsmEngine, in bytes
+	#endif
+	#include <atomic>
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
 #endif
 
-#if defined (SPAG_EMBED_ASIO_WRAPPER)
-	#define SPAG_USE_ASIO_WRAPPER
+#if defined (SPAG_USE_HOT_RECONFIG)
+	#include <atomic>
+#endif
+
+#if defined (SPAG_USE_ASYNC_CALLBACKS)
+	#ifndef SPAG_USE_EVENT_QUEUE
+		#define SPAG_USE_EVENT_QUEUE
+	#endif
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+#if defined (SPAG_USE_HIRES_TIMER)
+	#ifndef SPAG_HIRES_SPIN_US
+		#define SPAG_HIRES_SPIN_US 200   // default busy-wait duration before a deadline, in us
+	#endif
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+#if defined (SPAG_USE_COROUTINES)
+	#if !defined (__cpp_impl_coroutine)
+		#error "Symbol SPAG_USE_COROUTINES requires a C++20 compiler, with coroutines enabled"
+	#endif
+	#include <coroutine>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+#if defined (SPAG_USE_FSM_POOL) && defined (__AVX2__)
+	#include <immintrin.h>
+#endif
+
+#if defined (SPAG_ENUM_STRINGS)
+	#include <unordered_set>
+#endif
+
+#if defined (SPAG_USE_MMAP)
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#if defined (SPAG_ASYNC_LOGGING)
+	#ifndef SPAG_ENABLE_LOGGING
+		#define SPAG_ENABLE_LOGGING
+	#endif
+	#ifndef SPAG_ASYNC_LOG_SIZE
+		#define SPAG_ASYNC_LOG_SIZE 8192   // nb of records in ring buffer, must be a power of 2
+	#endif
+	#ifndef SPAG_ASYNC_LOG_PERIOD
+		#define SPAG_ASYNC_LOG_PERIOD 100  // writer thread wake-up period, in ms
+	#endif
+	#include <atomic>
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+#if defined (SPAG_USE_EVENT_QUEUE)
+	#ifndef SPAG_EVENT_QUEUE_SIZE
+		#define SPAG_EVENT_QUEUE_SIZE 256  // max nb of pending posted events, must be a power of 2
+	#endif
+	#ifndef SPAG_EVENT_QUEUE_HIGH_SIZE
+		#define SPAG_EVENT_QUEUE_HIGH_SIZE 32  // max nb of pending posted high priority events, must be a power of 2
+	#endif
+	#include <atomic>
+#endif
+
+#if defined (SPAG_ENABLE_LOGGING)
+	#include <atomic>
+#endif
+
+#if defined (SPAG_USE_TIMEOUT_POLICIES)
+	#include <atomic>
 #endif
 
 #if defined (SPAG_USE_ASIO_WRAPPER)
@@ -64,7 +164,19 @@ DEALINGS IN THE SOFTWARE.
 	#include <boost/asio.hpp>
 #endif
 
-#if defined (SPAG_USE_ASIO_WRAPPER) || defined (SPAG_ENABLE_LOGGING)
+#if defined (SPAG_ENABLE_TRACE)
+	#include <thread>
+#endif
+
+#if defined (SPAG_ENABLE_TRACEPOINTS)
+	#include <atomic>
+	#include <mutex>
+	#if defined (SPAG_USE_USDT)
+		#include <sys/sdt.h>
+	#endif
+#endif
+
+#if defined (SPAG_USE_ASIO_WRAPPER) || defined (SPAG_ENABLE_LOGGING) || defined (SPAG_USE_TIMER_WHEEL) || defined (SPAG_ENABLE_HISTOGRAMS) || defined (SPAG_ENABLE_TRACE) || defined (SPAG_USE_VIRTUAL_CLOCK) || defined (SPAG_USE_HIRES_TIMER)
 	#include <chrono>
 #endif
 
@@ -122,23 +234,13 @@ DEALINGS IN THE SOFTWARE.
 #else
 	#define SPAG_P_ASSERT( a, msg ) \
 		if(!(a) ) \
-		{ \
-			std::cerr << priv::getSpagName() << "assert failure in function " << __FUNCTION__ \
-				<< "(), line:" << __LINE__ \
-				<< ", condition \"" << #a << "\" is false, " << msg << '\n'; \
-				std::exit(1); \
-		}
+			spag::priv::assertFailure( __FUNCTION__, __LINE__, #a, msg );
 #endif
 
 #ifdef SPAG_FRIENDLY_CHECKING
 	#define SPAG_CHECK_LESS( a, b ) \
 		if( !( (a) < (b) ) )\
-		{ \
-			std::cerr << spag::priv::getSpagName() << "runtime error in func: " << __FUNCTION__ << "(), value is incorrect:\n" \
-				<< " - "   << #a << " value=" << a \
-				<< "\n - " << #b << " max value=" << b << '\n'; \
-			SPAG_P_THROW_ERROR_CFG( "incorrect values" ); \
-		}
+			spag::priv::checkLessFailure( __FUNCTION__, #a, static_cast<size_t>(a), #b, static_cast<size_t>(b) );
 #else
 	#define SPAG_CHECK_LESS( a, b ) assert( (a) < (b) )
 #endif
@@ -151,6 +253,22 @@ DEALINGS IN THE SOFTWARE.
 		static_assert( priv::AlwaysFalse<ST>::value, "This function is not available when symbol " #a " not defined" ); \
 	}
 
+/// Private macro, emits the tracepoint \c tp (a spag::Tracepoint value) of FSM \c fsm, see symbol \c SPAG_ENABLE_TRACEPOINTS
+#if defined (SPAG_ENABLE_TRACEPOINTS)
+	#if defined (SPAG_USE_USDT)
+		#define SPAG_P_TRACEPOINT( tp, fsm, a, b, c ) \
+			{ \
+				DTRACE_PROBE4( spaghetti, tp, fsm, a, b, c ); \
+				spag::priv::callTracepointHook( spag::Tracepoint::tp, fsm, a, b, c ); \
+			}
+	#else
+		#define SPAG_P_TRACEPOINT( tp, fsm, a, b, c ) \
+			spag::priv::callTracepointHook( spag::Tracepoint::tp, fsm, a, b, c )
+	#endif
+#else
+	#define SPAG_P_TRACEPOINT( tp, fsm, a, b, c ) {}
+#endif
+
 #ifdef SPAG_TRACK_RUNTIME
 int g_indent;
 #define SPAG_P_START \
@@ -177,6 +295,18 @@ int g_indent;
 	#define SPAG_P_END ;
 #endif // SPAG_TRACK_RUNTIME
 
+/// Private macro, size of a cache line, used to avoid false sharing
+#define SPAG_P_CACHE_LINE 64
+
+/// Private macro, marks a function as never inlined and rarely called: used for the error paths, so that the run-time functions stay small
+#if defined (__GNUC__)
+	#define SPAG_P_COLD __attribute__((noinline,cold))
+#elif defined (_MSC_VER)
+	#define SPAG_P_COLD __declspec(noinline)
+#else
+	#define SPAG_P_COLD
+#endif
+
 /// Private macro, used to convert a 'state' type into an integer
 #define SPAG_P_CAST2IDX( a ) static_cast<size_t>(a)
 
@@ -197,11 +327,47 @@ enum Item : uint8_t
 	,ItemIgnoredEvents = 0x04
 };
 
-/// Timer units
-enum class DurUnit : uint8_t { ms, sec, min };
+/// Timer units (sub-millisecond units are added at the end, so that values of the previous ones are unchanged)
+enum class DurUnit : uint8_t { ms, sec, min, us, ns };
+
+/// What is done with the running timer on a transition from a state having a timeout, see SpagFSM::setTimerReuse()
+enum class TimerReuse : uint8_t
+{
+	Off            ///< timer is canceled, then started again if the next state has a timeout (default)
+	,Rearm         ///< if the next state has a timeout, the timer is not canceled but directly re-armed
+	,KeepDeadline  ///< as \c Rearm, but if the next state has the same timeout (duration and destination), the timer keeps running with the same deadline
+};
+
+#ifdef SPAG_USE_EVENT_QUEUE
+/// Flags telling how the posted events are queued, see SpagFSM::assignQueueFlags(). Can be "OR-ed"
+enum QueueFlag : uint8_t
+{
+	QueueDefault        = 0x00   ///< event is always queued, in the normal lane
+	,QueueCoalesce      = 0x01   ///< event is coalesced: not queued if another one of the same type is still pending (the earliest one is kept)
+	,QueueDropIfIgnored = 0x02   ///< event is not queued if it is ignored on the current state
+	,QueueHighPriority  = 0x04   ///< event is queued in the high priority lane, processed before the normal one
+};
+#endif
 
 namespace priv {
 
+	/// Converts a duration into nanoseconds
+	inline
+	uint64_t
+	toNanoseconds( Duration dur, DurUnit unit )
+	{
+		switch( unit )
+		{
+			case DurUnit::ns:  return uint64_t(dur);
+			case DurUnit::us:  return uint64_t(dur) * 1000;
+			case DurUnit::ms:  return uint64_t(dur) * 1000000;
+			case DurUnit::sec: return uint64_t(dur) * 1000000000;
+			case DurUnit::min: return uint64_t(dur) * 60000000000;
+			default: assert(0);
+		}
+		return 0;
+	}
+
 	// forward declaration
 	template<typename T, typename U>
 	struct RunTimeData;
@@ -211,6 +377,19 @@ namespace priv {
 	struct AlwaysFalse {
 		enum { value = false };
 	};
+
+#ifdef SPAG_USE_SIGNALS
+	/// Sets a flag for the lifetime of the object, resets it on exit (even through an exception)
+	struct FlagGuard
+	{
+		explicit FlagGuard( bool& flag ) : _flag( flag ) { _flag = true; }
+		~FlagGuard() { _flag = false; }
+		FlagGuard( const FlagGuard& ) = delete;
+		FlagGuard& operator = ( const FlagGuard& ) = delete;
+		private:
+			bool& _flag;
+	};
+#endif
 };
 
 //-----------------------------------------------------------------------------------
@@ -288,6 +467,14 @@ inline
 std::pair<bool,DurUnit>
 timeUnitFromString( std::string str ) noexcept
 {
+	if( str == "ns" )
+		return std::make_pair( true, DurUnit::ns );
+	if( str == "nsec" )
+		return std::make_pair( true, DurUnit::ns );
+	if( str == "us" )
+		return std::make_pair( true, DurUnit::us );
+	if( str == "usec" )
+		return std::make_pair( true, DurUnit::us );
 	if( str == "ms" )
 		return std::make_pair( true, DurUnit::ms );
 	if( str == "msec" )
@@ -310,6 +497,8 @@ stringFromTimeUnit( DurUnit du )
 	std::string out;
 	switch( du )
 	{
+		case DurUnit::ns:  out = "ns";  break;
+		case DurUnit::us:  out = "us";  break;
 		case DurUnit::ms:  out = "ms";  break;
 		case DurUnit::sec: out = "sec"; break;
 		case DurUnit::min: out = "min"; break;
@@ -325,6 +514,68 @@ getSpagName()
 	static std::string str("Spaghetti: ");
 	return str;
 }
+
+//-----------------------------------------------------------------------------------
+/// Run-time error codes, see throwRuntimeError()
+enum EN_RuntimeError
+{
+	RE_InnerEvent            ///< request to process an event that has been declared as inner event
+	,RE_NotInnerEvent        ///< request to activate an inner event that has not been declared as such
+};
+
+//-----------------------------------------------------------------------------------
+/// Builds the error message associated to \c code and throws. Called by the run-time functions, that hold no string handling code
+/**
+\param func name of calling function
+\param idx index of the event
+\param name string of the event (can be null)
+*/
+[[noreturn]] inline SPAG_P_COLD
+void
+throwRuntimeError( EN_RuntimeError code, const char* func, size_t idx, const std::string* name )
+{
+	std::string strName = name ? " (" + *name + ")" : std::string();
+	switch( code )
+	{
+		case RE_NotInnerEvent:
+			throw std::runtime_error( "request to activate inner event " + std::to_string( idx ) + strName + ", but not found in list of Internal Events" );
+		default:
+		{
+			std::string msg = "request to process event idx=" + std::to_string( idx ) + strName + " but event has been declared as inner event.";
+#ifndef SPAG_NO_VERBOSE
+			std::cerr << getSpagName() << func << "(): error: " << msg << '\n';
+#endif
+			throw std::runtime_error( getSpagName() + "runtime error in " + func + "(): " + msg );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------
+/// Called when the condition of \c SPAG_P_ASSERT is false
+[[noreturn]] inline SPAG_P_COLD
+void
+assertFailure( const char* func, int line, const char* cond, const char* msg )
+{
+	std::cerr << getSpagName() << "assert failure in function " << func
+		<< "(), line:" << line
+		<< ", condition \"" << cond << "\" is false, " << msg << '\n';
+	std::exit(1);
+}
+
+//-----------------------------------------------------------------------------------
+/// Called when the condition of \c SPAG_CHECK_LESS is false (only used if \c SPAG_FRIENDLY_CHECKING is defined)
+[[noreturn]] inline SPAG_P_COLD
+void
+checkLessFailure( const char* func, const char* str_a, size_t a, const char* str_b, size_t b )
+{
+	std::cerr << getSpagName() << "runtime error in func: " << func << "(), value is incorrect:\n"
+		<< " - "   << str_a << " value=" << a
+		<< "\n - " << str_b << " max value=" << b << '\n';
+#ifndef SPAG_NO_VERBOSE
+	std::cerr << getSpagName() << func << "(): error: incorrect values\n";
+#endif
+	throw std::logic_error( getSpagName() + "configuration error in " + func + "(): incorrect values" );
+}
 //-----------------------------------------------------------------------------------
 /// Container holding information on timeout events. Each state will have one, event if it does not use it
 template<typename ST>
@@ -346,6 +597,87 @@ struct TimerEvent
 		_enabled = true;
 	}
 };
+
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+//-----------------------------------------------------------------------------------
+/// Timeout policy of a state, see SpagFSM::assignTimeOutPolicy()
+struct TimeOutPolicy
+{
+	uint16_t _nbRetries = 0;     ///< nb of times the timeout re-enters the state, before switching to the next state
+	uint16_t _backoff   = 100;   ///< duration multiplier applied at each retry, in percent
+	uint16_t _jitter    = 0;     ///< maximum random variation of each duration, in percent (+/-)
+
+	bool isActive() const
+	{
+		return _nbRetries != 0 || _backoff != 100 || _jitter != 0;
+	}
+};
+
+/// Returns a different (non null) seed for each FSM instance, for the jitter of the timeouts (see SpagFSM::seedJitter() )
+inline uint32_t jitterSeed()
+{
+	static std::atomic<uint32_t> counter{0};
+	uint32_t seed = 2463534242u + 0x9E3779B9u * counter.fetch_add( 1, std::memory_order_relaxed );   // Weyl sequence
+	return seed ? seed : 1;
+}
+#endif
+//-----------------------------------------------------------------------------------
+/// A set of events, one bit per event (used for inner events)
+template<typename EV>
+using EventSet = std::bitset<static_cast<size_t>(EV::NB_EVENTS)>;
+
+/// Raw callback function: a function pointer, called with a user-provided context pointer (see SpagFSM::assignCallback( ST, RawCallback_t, void*, CBA ) )
+template<typename CBA>
+using RawCallback = void(*)( void*, CBA );
+
+#ifdef SPAG_USE_TRANSITION_ACTIONS
+/// Transition action function: called with a user-provided context pointer, the source state and the event (see SpagFSM::assignTransitionAction() )
+template<typename ST, typename EV>
+using TransitionActionFunc = void(*)( void*, ST, EV );
+
+/// Private class, a transition action and its context pointer. The FSM holds one of these for every (event,state) pair
+template<typename ST, typename EV>
+struct TransitionAction
+{
+	TransitionActionFunc<ST,EV> _func    = nullptr;
+	void*                       _context = nullptr;
+};
+#endif
+
+//-----------------------------------------------------------------------------------
+/// Index sequence (C++11 equivalent of \c std::index_sequence), built with a logarithmic recursion depth
+template<size_t... I>
+struct IndexSeq
+{};
+
+template<typename A, typename B>
+struct ConcatSeq;
+
+template<size_t... I, size_t... J>
+struct ConcatSeq<IndexSeq<I...>,IndexSeq<J...>>
+{
+	using type = IndexSeq<I..., (sizeof...(I)+J)...>;
+};
+
+template<size_t N>
+struct MakeIndexSeq
+{
+	using type = typename ConcatSeq<
+		typename MakeIndexSeq<N/2>::type,
+		typename MakeIndexSeq<N-N/2>::type
+	>::type;
+};
+template<>
+struct MakeIndexSeq<0>
+{
+	using type = IndexSeq<>;
+};
+template<>
+struct MakeIndexSeq<1>
+{
+	using type = IndexSeq<0>;
+};
+
 //-----------------------------------------------------------------------------------
 #ifdef SPAG_USE_SIGNALS
 /// Holds information on inner events
@@ -384,16 +716,34 @@ struct StateInfo
 {
 	TimerEvent<ST>           _timerEvent;   ///< Holds the information on timeout
 	std::function<void(CBA)> _callback;     ///< callback function
+	RawCallback<CBA>         _rawCallback = nullptr; ///< callback function, raw version (used instead of \c _callback if not null)
+	void*                    _rawContext  = nullptr; ///< context pointer given to \c _rawCallback
 	CBA                      _callbackArg;  ///< value of argument of callback function
 
+#ifdef SPAG_USE_TRANSITION_ACTIONS
+	std::function<void(CBA)> _exitCallback;     ///< exit callback function, called when leaving the state
+	RawCallback<CBA>         _exitRawCallback = nullptr; ///< exit callback function, raw version (used instead of \c _exitCallback if not null)
+	void*                    _exitContext     = nullptr; ///< context pointer given to \c _exitRawCallback
+#endif
+
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+	TimeOutPolicy            _toPolicy;     ///< retries and backoff of the timeout
+#endif
+
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+	bool                     _isAsync        = false;  ///< if true, the callback is run by a CallbackPool, see SpagFSM::assignAsyncCallback()
+	size_t                   _asyncDoneEvent = static_cast<size_t>(EV::NB_EVENTS); ///< event posted once the asynchronous callback has returned (NB_EVENTS: none)
+#endif
+
 #ifdef SPAG_USE_SIGNALS
 	bool                     _isPassState = false; ///< if true, the next state is stored in transition table, at line nbEvents()+1
 	std::vector<InnerTransition<ST,EV>> _innerTransList;
+	EventSet<EV>             _innerEventMask;      ///< the inner events of \c _innerTransList, built at startup (see FsmConfig::build() )
 
 	friend std::ostream& operator << ( std::ostream& s, const StateInfo& si )
 	{
 		s << "StateInfo:"
-			<< "\n -has callback=" << (si._callback==0?"NO":"YES")
+			<< "\n -has callback=" << ( (si._callback==0 && si._rawCallback==nullptr)?"NO":"YES")
 			<< "\n -callbackArg=" << si._callbackArg
 			<< "\n -isPassState=" << si._isPassState
 			<< "\n -NbInnerTransition=" << si._innerTransList.size()
@@ -487,6 +837,163 @@ getMaxLength( const T& v_str )
 	return maxlength;
 }
 
+#if (defined SPAG_USE_EVENT_QUEUE) || (defined SPAG_USE_FSM_ENGINE)
+//-----------------------------------------------------------------------------------
+/// Bounded lock-free queue, multiple producers, single consumer. Used to hold the events posted with SpagFSM::postEvent() and FsmEngine::postEvent()
+/**
+Each cell holds a sequence number, that tells if the cell is ready to be written (by a producer) or read (by the consumer).
+Producers only compete on the write index, with a CAS, and never block: push() returns false if queue is full.
+
+Based on D. Vyukov's bounded queue, see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+*/
+template<typename T, size_t N>
+class MpscQueue
+{
+	static_assert( N > 1 && (N & (N-1)) == 0, "queue size must be a power of 2" );
+
+	struct Cell
+	{
+		std::atomic<size_t> _seq;
+		T                   _data;
+	};
+
+	public:
+		MpscQueue()
+		{
+			for( size_t i=0; i<N; i++ )
+				_cells[i]._seq.store( i, std::memory_order_relaxed );
+		}
+		MpscQueue( const MpscQueue& ) = delete;
+
+/// Adds element \c val, returns false if queue is full. Can be called concurrently by several threads
+		bool push( T val )
+		{
+			auto pos = _writeIdx.load( std::memory_order_relaxed );
+			for(;;)
+			{
+				auto& cell = _cells[ pos & (N-1) ];
+				auto seq  = cell._seq.load( std::memory_order_acquire );
+				auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+				if( diff == 0 )          // cell is free, try to reserve it
+				{
+					if( _writeIdx.compare_exchange_weak( pos, pos+1, std::memory_order_relaxed ) )
+					{
+						cell._data = val;
+						cell._seq.store( pos+1, std::memory_order_release );
+						return true;
+					}
+				}
+				else
+				{
+					if( diff < 0 )       // cell has not been read yet: queue is full
+						return false;
+					pos = _writeIdx.load( std::memory_order_relaxed );  // another producer got it
+				}
+			}
+		}
+
+/// Fetches next element into \c val, returns false if queue is empty. Must only be called by a single thread
+		bool pop( T& val )
+		{
+			auto& cell = _cells[ _readIdx & (N-1) ];
+			auto seq   = cell._seq.load( std::memory_order_acquire );
+			if( static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(_readIdx+1) < 0 )
+				return false;
+			val = cell._data;
+			cell._seq.store( _readIdx + N, std::memory_order_release );
+			_readIdx++;
+			return true;
+		}
+
+/// Returns true if there is no element to read. Must only be called by the consumer thread
+		bool empty() const
+		{
+			auto seq = _cells[ _readIdx & (N-1) ]._seq.load( std::memory_order_acquire );
+			return static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(_readIdx+1) < 0;
+		}
+
+	private:
+		std::array<Cell,N>  _cells;
+		std::atomic<size_t> _writeIdx{0};
+		char                _pad[64];     ///< so that producers and consumer don't share the same cache line
+		size_t              _readIdx = 0;
+};
+#endif // SPAG_USE_EVENT_QUEUE || SPAG_USE_FSM_ENGINE
+
+#ifdef SPAG_PACKED_TABLE
+//-----------------------------------------------------------------------------------
+/// Smallest unsigned integer type that can hold a state index of a FSM with \c N states, plus 2 flag bits
+template<size_t N>
+struct PackedCellType
+{
+	using type = typename std::conditional<
+		( N <= (1u<<6) ),
+		uint8_t,
+		typename std::conditional<
+			( N <= (1u<<14) ),
+			uint16_t,
+			uint32_t
+		>::type
+	>::type;
+};
+
+//-----------------------------------------------------------------------------------
+/// Packed transition table, used at run-time when symbol \c SPAG_PACKED_TABLE is defined
+/**
+Fuses the transition matrix and the allowed events matrix into a single cell for each (state,event) pair:
+the destination state is stored in the upper bits, the 2 lower bits hold the flag (0: ignored, 1: allowed, 2: inner event).
+
+Storage is state-major: all the cells of a given state are contiguous, so processing an event on the current state
+only touches a single cache line (as long as the FSM has less than 64 events, with less than 64 states).
+
+This does not replace the configuration matrices, it is built from them when the FSM is started,
+and built again on the next event if the configuration is changed while the FSM is running.
+*/
+template<typename ST, typename EV>
+class PackedTable
+{
+	static constexpr size_t NbStates = static_cast<size_t>(ST::NB_STATES);
+	static constexpr size_t NbEvents = static_cast<size_t>(EV::NB_EVENTS);
+
+	public:
+		using Cell = typename PackedCellType<NbStates>::type;
+
+/// Builds the table from the transition matrix \c tmat and the allowed events matrix \c amat (both are event-major)
+		template<typename TM, typename AM>
+		void build( const TM& tmat, const AM& amat )
+		{
+			for( size_t st=0; st<NbStates; st++ )
+				for( size_t ev=0; ev<NbEvents; ev++ )
+				{
+					Cell flag = 0;
+					if( amat[ev][st] == 1 )
+						flag = 1;
+					if( amat[ev][st] == -1 )
+						flag = 2;
+					_data[ st*NbEvents + ev ] = static_cast<Cell>( ( static_cast<size_t>(tmat[ev][st]) << 2 ) | flag );
+				}
+		}
+
+		Cell get( size_t st, size_t ev ) const
+		{
+			return _data[ st*NbEvents + ev ];
+		}
+
+		static bool isAllowed( Cell c )
+		{
+			return (c & 3) == 1;
+		}
+
+		static ST nextState( Cell c )
+		{
+			return static_cast<ST>( c >> 2 );
+		}
+
+	private:
+		std::array<Cell,NbStates*NbEvents> _data;
+};
+#endif // SPAG_PACKED_TABLE
+
 } // namespace priv
 
 //-----------------------------------------------------------------------------------
@@ -546,100 +1053,651 @@ Counters::print( std::ostream& out, uint8_t flags, char sep ) const
 		}
 	}
 }
-#endif // SPAG_ENABLE_LOGGING
 
-namespace priv {
-//------------------------------------------------------------------------------------
-/// Holds the FSM dynamic data: current state, and logged data (if enabled at build, see symbol \c SPAG_ENABLE_LOGGING)
-#ifdef SPAG_ENABLE_LOGGING
-template<typename ST,typename EV>
-struct RunTimeData
+//-----------------------------------------------------------------------------------
+/// Rates of a FSM over a time window, can be fetched with \c fsm.getRates()
+struct Rates
 {
-//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-/// A state-change event, used for logging
-	struct StateChangeEvent
-	{
-		size_t _state;
-		size_t _event;   ///< stored as size_t because it will hold values other than the ones in the enum
-		std::chrono::duration<double> _elapsed;
-	};
-//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-
-	public:
-#ifdef SPAG_ENUM_STRINGS
-	RunTimeData( const std::vector<std::string>& str_events, const std::vector<std::string>& str_states )
-		: _strEvents_R(str_events), _strStates_R( str_states )
-#else
-	RunTimeData()
-#endif
-	{
-		_startTime = std::chrono::high_resolution_clock::now();
-		clear();
-		_stateCounter[0] = 1; // because we start on state 0, so it starts at 1
-	}
+	size_t _window      = 0;    ///< duration of the window actually used, in seconds (can be smaller than requested if the FSM has not run long enough)
+	double _events      = 0.;   ///< events processed per second (ignored ones included)
+	double _transitions = 0.;   ///< transitions per second (on events, timeouts, AAT and inner events)
+	double _ignored     = 0.;   ///< ignored events per second
+	double _timeOuts    = 0.;   ///< timeouts per second
 
-	void clear()
-	{
-		_stateCounter.fill( 0 );
-		_eventCounter.fill( 0 );
-		_ignoredEventCounter.fill( 0 );
-	}
-/// Returns a copy of all the counters.
-	Counters buildCounters() const
+	void print( std::ostream& out=std::cout, char sep=';' ) const
 	{
-#ifdef SPAG_ENUM_STRINGS
-		Counters cnt( _strStates_R, _strEvents_R );
-#else
-		Counters cnt( _stateCounter.size(), _eventCounter.size() );
-#endif
-
-		std::copy( std::begin(_stateCounter),  std::end(_stateCounter),  std::begin(cnt._stateCounter) );
-		std::copy( std::begin(_eventCounter),  std::end(_eventCounter),  std::begin(cnt._eventCounter) );
-		std::copy( std::begin(_ignoredEventCounter), std::end(_ignoredEventCounter), std::begin(cnt._ignoredEventCounter) );
-
-		return cnt;
+		out << _window << sep << _events << sep << _transitions << sep << _ignored << sep << _timeOuts;
 	}
+};
 
-/// Logs a transition from current state to state \c st, that was produced by event \c ev
+//-----------------------------------------------------------------------------------
+/// Ring of per-second counters, giving the rates over the last seconds (see Rates)
 /**
-This will both:
-- increment the event and state counters
-- log the transition in the logfile
+Each bucket holds the counts of one second, and the index of that second: a bucket is reset when it gets reused, so recording is O(1)
+and the counters never need to be cleared.
 
-Events are passed as \c size_t because we may pass values other than the ones in the enum (timeout and Always Active transitions)
+Single writer (the thread running the FSM), but rates() can be called from any thread at any time, and does not allocate:
+a bucket being reset while read is skipped.
 */
-	void logTransition( ST st, size_t ev_idx )
-	{
-		assert( ev_idx < SPAG_P_CAST2IDX( EV::NB_EVENTS ) + 2 );
-		assert( st < ST::NB_STATES );
-		auto st_idx = SPAG_P_CAST2IDX(st);
-		_eventCounter[ ev_idx ]++;
-		_stateCounter[ st_idx ]++;
+class RateCounters
+{
+	public:
+		static constexpr size_t NbBuckets = 64;   ///< size of the ring, so the max window is NbBuckets-1 seconds
+		enum Kind { KindEvent, KindTransition, KindIgnored, KindTimeOut, NbKinds };
 
-		if( !_logfile.is_open() )
+		RateCounters()
 		{
-			_logfile.open( _logfileName );
-			if( !_logfile.is_open() )
-				SPAG_P_THROW_ERROR_RT( "unable to open file " + _logfileName );
-
-			_logfile << "# FSM runtime history\n# "
-				<< getSpagName() << SPAG_VERSION
-				<< "\n# index" << _sepChar << "time" << _sepChar << "event-Id" << _sepChar
-	#ifdef SPAG_ENUM_STRINGS
-				<< "event_string" << _sepChar << "state-Id" << _sepChar << "state_string\n";
+			clear();
+		}
+		void clear()
+		{
+			for( auto& b: _ring )
+			{
+				b._second.store( NoSecond, std::memory_order_relaxed );
+				for( auto& c: b._count )
+					c.store( 0, std::memory_order_relaxed );
+			}
+		}
+
+/// Counts one occurrence of \c kind, at second \c sec
+		void record( Kind kind, uint64_t sec )
+		{
+			auto& b = _ring[ sec % NbBuckets ];
+			if( b._second.load( std::memory_order_relaxed ) != sec )   // first record in this second: reuse the bucket
+			{
+				b._second.store( NoSecond, std::memory_order_relaxed );
+				for( auto& c: b._count )
+					c.store( 0, std::memory_order_relaxed );
+				b._second.store( sec, std::memory_order_release );
+			}
+			auto& c = b._count[kind];
+			c.store( c.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+		}
+
+/// Returns the rates over the \c window complete seconds before second \c now (the current one is not complete, so not used)
+/**
+\c window is bounded by NbBuckets-1 and by \c now (the number of complete seconds since start)
+*/
+		Rates rates( size_t window, uint64_t now ) const
+		{
+			Rates r;
+			window = static_cast<size_t>( std::min( std::min( window, NbBuckets-1 ), static_cast<size_t>( now ) ) );
+			r._window = window;
+			if( window == 0 )
+				return r;
+
+			uint64_t sum[NbKinds] = { 0, 0, 0, 0 };
+			for( uint64_t sec = now-window; sec < now; sec++ )
+			{
+				const auto& b = _ring[ sec % NbBuckets ];
+				if( b._second.load( std::memory_order_acquire ) != sec )   // nothing recorded in that second
+					continue;
+				uint64_t cnt[NbKinds];
+				for( size_t k=0; k<NbKinds; k++ )
+					cnt[k] = b._count[k].load( std::memory_order_relaxed );
+				if( b._second.load( std::memory_order_acquire ) != sec )   // reused in between
+					continue;
+				for( size_t k=0; k<NbKinds; k++ )
+					sum[k] += cnt[k];
+			}
+			r._events      = double( sum[KindEvent] )      / window;
+			r._transitions = double( sum[KindTransition] ) / window;
+			r._ignored     = double( sum[KindIgnored] )    / window;
+			r._timeOuts    = double( sum[KindTimeOut] )    / window;
+			return r;
+		}
+
+	private:
+		static constexpr uint64_t NoSecond = std::numeric_limits<uint64_t>::max();
+		struct Bucket
+		{
+			std::atomic<uint64_t> _second;          ///< second the counts belong to
+			std::atomic<uint64_t> _count[NbKinds];
+		};
+		std::array<Bucket,NbBuckets> _ring;
+};
+#endif // SPAG_ENABLE_LOGGING
+
+#ifdef SPAG_ENABLE_HISTOGRAMS
+//-----------------------------------------------------------------------------------
+/// Fixed-size latency histogram, with logarithmic buckets (HDR-style). Values are durations, in nanoseconds
+/**
+Values below 2^SubBits are stored exactly. Above, each power of 2 is divided into 2^SubBits buckets,
+so the relative error of a percentile is less than 1/2^SubBits (6%).
+Values above 2^MaxBits ns (about 2.4 hours) are stored in the last bucket.
+
+Recording a value is constant time, and never allocates.
+*/
+class Histogram
+{
+	static constexpr size_t SubBits   = 4;
+	static constexpr size_t MaxBits   = 43;
+	static constexpr size_t NbSub     = size_t(1) << SubBits;
+	public:
+		static constexpr size_t NbBuckets = (MaxBits - SubBits + 2) * NbSub;
+
+		Histogram()
+		{
+			clear();
+		}
+		void clear()
+		{
+			_buckets.fill( 0 );
+			_count = 0;
+			_sum   = 0;
+			_min   = std::numeric_limits<uint64_t>::max();
+			_max   = 0;
+		}
+/// Adds value \c v
+		void record( uint64_t v )
+		{
+			_buckets[ bucketIndex( v ) ]++;
+			_count++;
+			_sum += v;
+			_min = std::min( _min, v );
+			_max = std::max( _max, v );
+		}
+
+		uint64_t count() const { return _count; }
+		uint64_t min()   const { return _count ? _min : 0; }
+		uint64_t max()   const { return _max; }
+		uint64_t mean()  const { return _count ? _sum / _count : 0; }
+
+/// Returns the value below which a proportion \c p (in [0,1]) of the recorded values are (highest value of the bucket, bounded by max() )
+		uint64_t percentile( double p ) const
+		{
+			if( _count == 0 )
+				return 0;
+			auto target = static_cast<uint64_t>( p * _count + 0.5 );
+			target = std::max( target, uint64_t(1) );
+			uint64_t cumul = 0;
+			for( size_t i=0; i<NbBuckets; i++ )
+			{
+				cumul += _buckets[i];
+				if( cumul >= target )
+					return std::min( bucketUpperValue( i ), _max );
+			}
+			return _max;
+		}
+
+/// Prints a one line summary, values are in microseconds
+		void print( std::ostream& out=std::cout, char sep=';' ) const
+		{
+			out << _count << sep << min()/1000. << sep << percentile(.5)/1000. << sep
+				<< percentile(.9)/1000. << sep << percentile(.99)/1000. << sep << max()/1000.;
+		}
+
+/// Returns the index of the bucket that holds value \c v
+		static size_t bucketIndex( uint64_t v )
+		{
+			if( v < NbSub )
+				return static_cast<size_t>( v );
+			size_t msb = 0;                        // index of most significant bit
+			for( size_t sh=32; sh; sh /= 2 )
+				if( v >> (msb+sh) )
+					msb += sh;
+			if( msb > MaxBits )
+				return NbBuckets - 1;
+			return (msb - SubBits + 1) * NbSub + static_cast<size_t>( ( v >> (msb - SubBits) ) - NbSub );
+		}
+/// Returns the highest value that is stored in bucket \c idx
+		static uint64_t bucketUpperValue( size_t idx )
+		{
+			if( idx < NbSub )
+				return idx;
+			auto shift = idx / NbSub - 1;
+			auto sub   = idx % NbSub + NbSub;
+			return ( uint64_t(sub+1) << shift ) - 1;
+		}
+
+	private:
+		std::array<uint64_t,NbBuckets> _buckets;
+		uint64_t _count;
+		uint64_t _sum;
+		uint64_t _min;
+		uint64_t _max;
+};
+
+//-----------------------------------------------------------------------------------
+/// Snapshot of the latency histograms of a FSM, can be fetched with \c fsm.getHistograms()
+struct LatencyHistograms
+{
+	std::vector<Histogram> _callback;    ///< per state: duration of the callback
+	std::vector<Histogram> _dwell;       ///< per state: time spent in state (from entering it, to entering the next one)
+	Histogram              _timeOutLateness; ///< delay between the expected and actual time of the timeouts
+#ifdef SPAG_ENUM_STRINGS
+	std::vector<std::string> _strStates;
+#endif
+
+	void print( std::ostream& out=std::cout, char sep=';' ) const
+	{
+		out << "# Latency histograms (values in us): count, min, p50, p90, p99, max\n";
+		for( size_t i=0; i<_callback.size(); i++ )
+		{
+			out << i << sep;
+#ifdef SPAG_ENUM_STRINGS
+			out << _strStates[i] << sep;
+#endif
+			out << "callback" << sep;
+			_callback[i].print( out, sep );
+			out << '\n' << i << sep;
+#ifdef SPAG_ENUM_STRINGS
+			out << _strStates[i] << sep;
+#endif
+			out << "dwell" << sep;
+			_dwell[i].print( out, sep );
+			out << '\n';
+		}
+		out << "timeout lateness" << sep;
+		_timeOutLateness.print( out, sep );
+		out << '\n';
+	}
+};
+
+namespace priv {
+//-----------------------------------------------------------------------------------
+/// Runtime latency data of a FSM (see symbol \c SPAG_ENABLE_HISTOGRAMS)
+template<typename ST>
+struct LatencyData
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::array<Histogram,SPAG_P_CAST2IDX(ST::NB_STATES)> _callback;
+	std::array<Histogram,SPAG_P_CAST2IDX(ST::NB_STATES)> _dwell;
+	Histogram         _timeOutLateness;
+	Clock::time_point _stateEntry;      ///< time at which current state was entered
+	Clock::time_point _timerExpected;   ///< time at which the pending timer should expire
+	bool              _hasEntry = false;
+
+	void clear()
+	{
+		for( auto& h: _callback )
+			h.clear();
+		for( auto& h: _dwell )
+			h.clear();
+		_timeOutLateness.clear();
+	}
+	static uint64_t toNs( Clock::duration d )
+	{
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( d ).count();
+		return ns > 0 ? static_cast<uint64_t>( ns ) : 0;
+	}
+	static Clock::duration toDuration( Duration dur, DurUnit unit )
+	{
+		switch( unit )
+		{
+			case DurUnit::ns:  return std::chrono::duration_cast<Clock::duration>( std::chrono::nanoseconds( dur ) );
+			case DurUnit::us:  return std::chrono::microseconds( dur );
+			case DurUnit::sec: return std::chrono::seconds( dur );
+			case DurUnit::min: return std::chrono::minutes( dur );
+			default:           return std::chrono::milliseconds( dur );
+		}
+	}
+};
+} // namespace priv
+#endif // SPAG_ENABLE_HISTOGRAMS
+
+namespace priv {
+#ifdef SPAG_ENABLE_LOGGING
+//------------------------------------------------------------------------------------
+/// A state-change event, used for logging
+/**
+This is a fixed-size POD, so that it can be written "as is" in the binary log file (see symbol \c SPAG_ASYNC_LOGGING)
+*/
+struct StateChangeEvent
+{
+	uint64_t _index;    ///< record index
+	int64_t  _elapsed;  ///< elapsed time since FSM creation, in nanoseconds
+	uint32_t _state;
+	uint32_t _event;    ///< stored as integer because it will hold values other than the ones in the enum
+};
+
+//------------------------------------------------------------------------------------
+/// Header of the binary log file. Is followed by the event and state strings (if any), then by the records
+struct LogFileHeader
+{
+	char     _magic[8];    ///< holds "SPAGLOG"
+	uint32_t _version;     ///< binary format version
+	uint32_t _nbStates;
+	uint32_t _nbEvents;    ///< includes the two "timeout" and "AAT" pseudo-events
+	uint32_t _hasStrings;  ///< 1 if the event and state strings are stored after the header
+};
+
+/// Current binary log format version
+#define SPAG_P_LOGFILE_VERSION 1
+
+//------------------------------------------------------------------------------------
+/// Prints the header lines of the csv log file
+inline
+void
+printLogHeader( std::ostream& f, char sep, bool hasStrings )
+{
+	f << "# FSM runtime history\n# "
+		<< getSpagName() << SPAG_VERSION
+		<< "\n# index" << sep << "time" << sep << "event-Id" << sep;
+	if( hasStrings )
+		f << "event_string" << sep << "state-Id" << sep << "state_string\n";
+	else
+		f << "state-Id\n";
+}
+
+//------------------------------------------------------------------------------------
+/// Prints a single record as a line of the csv log file. The string pointers are null if strings are not available
+inline
+void
+printLogRecord(
+	std::ostream&                   f,
+	const StateChangeEvent&         sce,
+	char                            sep,
+	const std::vector<std::string>* strEvents,
+	const std::vector<std::string>* strStates
+)
+{
+	f << std::setw(6) << std::setfill('0') << sce._index
+		<< sep << std::chrono::duration<double>( std::chrono::nanoseconds( sce._elapsed ) ).count()
+		<< sep << sce._event << sep;
+	if( strEvents )
+		f << (*strEvents)[sce._event] << sep;
+	f << sce._state << sep;
+	if( strStates )
+		f << (*strStates)[sce._state];
+	f << '\n';
+}
+
+#ifdef SPAG_ASYNC_LOGGING
+//------------------------------------------------------------------------------------
+/// Binary log writer: records are stored into a preallocated ring buffer, and written to file by a background thread
+/**
+This is a single producer (the FSM) / single consumer (the writer thread) queue.
+The producer never blocks: if the ring buffer is full, the record is dropped and counted.
+
+The writer thread wakes up every \c SPAG_ASYNC_LOG_PERIOD milliseconds, or when the buffer gets half-full,
+and writes all the available records to file in one go.
+*/
+class AsyncLogWriter
+{
+	public:
+		AsyncLogWriter() = default;
+		AsyncLogWriter( const AsyncLogWriter& ) = delete;
+		~AsyncLogWriter()
+		{
+			close();
+		}
+
+		bool isOpen() const
+		{
+			return _thread.joinable();
+		}
+
+/// Opens the file, writes the header and the strings, then starts the writer thread
+		void open(
+			const std::string&              fname,
+			const LogFileHeader&            hdr,
+			const std::vector<std::string>* strEvents,
+			const std::vector<std::string>* strStates
+		)
+		{
+			_file.open( fname, std::ios::binary );
+			if( !_file.is_open() )
+				SPAG_P_THROW_ERROR_RT( "unable to open file " + fname );
+
+			_file.write( reinterpret_cast<const char*>( &hdr ), sizeof(hdr) );
+			if( strEvents )
+				writeStrings( *strEvents );
+			if( strStates )
+				writeStrings( *strStates );
+			_file.flush();
+
+			_stop = false;
+			_thread = std::thread( &AsyncLogWriter::run, this );
+		}
+
+/// Called by the FSM, adds a record in the ring buffer. Dropped if buffer is full.
+		void push( const StateChangeEvent& sce )
+		{
+			auto head = _head.load( std::memory_order_relaxed );
+			auto used = head - _tail.load( std::memory_order_acquire );
+			if( used == SPAG_ASYNC_LOG_SIZE )
+			{
+				_nbDropped++;
+				return;
+			}
+			_ring[ head & (SPAG_ASYNC_LOG_SIZE-1) ] = sce;
+			_head.store( head+1, std::memory_order_release );
+			if( used == SPAG_ASYNC_LOG_SIZE/2 ) // writer thread is late, wake it up
+				_cv.notify_one();
+		}
+
+/// Stops the writer thread, once all the pending records have been written
+		void close()
+		{
+			if( !_thread.joinable() )
+				return;
+			{
+				std::lock_guard<std::mutex> lock( _mutex );
+				_stop = true;
+			}
+			_cv.notify_one();
+			_thread.join();
+			_file.close();
+			if( _nbDropped )
+				SPAG_P_LOG_ERROR << "warning, " << _nbDropped << " log records were dropped, consider increasing SPAG_ASYNC_LOG_SIZE\n";
+		}
+
+	private:
+		void writeStrings( const std::vector<std::string>& v_str )
+		{
+			for( const auto& str: v_str )
+			{
+				uint32_t len = str.size();
+				_file.write( reinterpret_cast<const char*>( &len ), sizeof(len) );
+				_file.write( str.data(), len );
+			}
+		}
+
+/// Writer thread function
+		void run()
+		{
+			std::unique_lock<std::mutex> lock( _mutex );
+			while( !_stop )
+			{
+				_cv.wait_for( lock, std::chrono::milliseconds( SPAG_ASYNC_LOG_PERIOD ) );
+				lock.unlock();
+				drain();
+				lock.lock();
+			}
+			lock.unlock();
+			drain();
+		}
+
+/// Writes all the available records, with at most two calls to write() (ring buffer may wrap around)
+		void drain()
+		{
+			auto tail = _tail.load( std::memory_order_relaxed );
+			auto head = _head.load( std::memory_order_acquire );
+			if( tail == head )
+				return;
+			while( tail != head )
+			{
+				auto start = tail & (SPAG_ASYNC_LOG_SIZE-1);
+				auto count = std::min<size_t>( head - tail, SPAG_ASYNC_LOG_SIZE - start );
+				_file.write( reinterpret_cast<const char*>( &_ring[start] ), count * sizeof(StateChangeEvent) );
+				tail += count;
+				_tail.store( tail, std::memory_order_release );
+			}
+			_file.flush();
+		}
+
+		static_assert( (SPAG_ASYNC_LOG_SIZE & (SPAG_ASYNC_LOG_SIZE-1)) == 0, "SPAG_ASYNC_LOG_SIZE must be a power of 2" );
+
+		std::array<StateChangeEvent,SPAG_ASYNC_LOG_SIZE> _ring;
+		std::atomic<size_t> _head{0};      ///< written by producer only
+		char _pad[64];                     ///< avoids false sharing between head and tail
+		std::atomic<size_t> _tail{0};      ///< written by writer thread only
+		size_t              _nbDropped = 0;
+
+		std::ofstream           _file;
+		std::thread             _thread;
+		std::mutex              _mutex;
+		std::condition_variable _cv;
+		bool                    _stop = false;
+};
+#endif // SPAG_ASYNC_LOGGING
+#endif // SPAG_ENABLE_LOGGING
+
+//------------------------------------------------------------------------------------
+/// Holds the FSM dynamic data: current state, and logged data (if enabled at build, see symbol \c SPAG_ENABLE_LOGGING)
+#ifdef SPAG_ENABLE_LOGGING
+template<typename ST,typename EV>
+struct RunTimeData
+{
+	public:
+	RunTimeData()
+	{
+		_startTime = std::chrono::high_resolution_clock::now();
+		clear();
+		_stateCounter[0].store( 1, std::memory_order_relaxed ); // because we start on state 0, so it starts at 1
+	}
+
+#ifdef SPAG_ENUM_STRINGS
+/// Assigns the strings used in the log file (they are held by the FSM configuration)
+	void setStrings( const std::vector<std::string>* str_events, const std::vector<std::string>* str_states )
+	{
+		_strEvents_P = str_events;
+		_strStates_P = str_states;
+	}
+#endif
+
+	void clear()
+	{
+		for( auto& c: _stateCounter )
+			c.store( 0, std::memory_order_relaxed );
+		for( auto& c: _eventCounter )
+			c.store( 0, std::memory_order_relaxed );
+		for( auto& c: _ignoredEventCounter )
+			c.store( 0, std::memory_order_relaxed );
+	}
+
+/// Copies the counters of type \c what into \c dest (at most \c size values), returns the number of counters of that type
+/**
+Does not allocate, and can be called from any thread, concurrently with the thread running the FSM.
+The values are read one by one, so they may not be consistent between each other (but each of them is a value that was actually reached).
+*/
+	size_t readCounters( Item what, size_t* dest, size_t size ) const
+	{
+		switch( what )
+		{
+			case ItemStates:        return readArray( _stateCounter, dest, size );
+			case ItemEvents:        return readArray( _eventCounter, dest, size );
+			case ItemIgnoredEvents: return readArray( _ignoredEventCounter, dest, size );
+			default: assert(0);
+		}
+		return 0;
+	}
+/// Copies the counters into \c st (NB_STATES values), \c ev (NB_EVENTS+2 values) and \c ign (NB_EVENTS values), see SpagFSM::snapshot()
+	void saveCounters( uint64_t* st, uint64_t* ev, uint64_t* ign ) const
+	{
+		for( size_t i=0; i<_stateCounter.size(); i++ )
+			st[i] = _stateCounter[i].load( std::memory_order_relaxed );
+		for( size_t i=0; i<_eventCounter.size(); i++ )
+			ev[i] = _eventCounter[i].load( std::memory_order_relaxed );
+		for( size_t i=0; i<_ignoredEventCounter.size(); i++ )
+			ign[i] = _ignoredEventCounter[i].load( std::memory_order_relaxed );
+	}
+/// Sets the counters from the values saved by saveCounters()
+	void restoreCounters( const uint64_t* st, const uint64_t* ev, const uint64_t* ign )
+	{
+		for( size_t i=0; i<_stateCounter.size(); i++ )
+			_stateCounter[i].store( static_cast<size_t>( st[i] ), std::memory_order_relaxed );
+		for( size_t i=0; i<_eventCounter.size(); i++ )
+			_eventCounter[i].store( static_cast<size_t>( ev[i] ), std::memory_order_relaxed );
+		for( size_t i=0; i<_ignoredEventCounter.size(); i++ )
+			_ignoredEventCounter[i].store( static_cast<size_t>( ign[i] ), std::memory_order_relaxed );
+	}
+/// Returns a copy of all the counters.
+	Counters buildCounters() const
+	{
+#ifdef SPAG_ENUM_STRINGS
+		Counters cnt( *_strStates_P, *_strEvents_P );
+#else
+		Counters cnt( _stateCounter.size(), _eventCounter.size() );
+#endif
+
+		readArray( _stateCounter,        cnt._stateCounter.data(),        cnt._stateCounter.size() );
+		readArray( _eventCounter,        cnt._eventCounter.data(),        cnt._eventCounter.size() );
+		readArray( _ignoredEventCounter, cnt._ignoredEventCounter.data(), cnt._ignoredEventCounter.size() );
+
+		return cnt;
+	}
+
+/// Logs a transition from current state to state \c st, that was produced by event \c ev
+/**
+This will both:
+- increment the event and state counters
+- log the transition in the logfile (either directly, or through the ring buffer if symbol \c SPAG_ASYNC_LOGGING is defined)
+
+Events are passed as \c size_t because we may pass values other than the ones in the enum (timeout and Always Active transitions)
+*/
+	void logTransition( ST st, size_t ev_idx )
+	{
+		assert( ev_idx < SPAG_P_CAST2IDX( EV::NB_EVENTS ) + 2 );
+		assert( st < ST::NB_STATES );
+		auto st_idx = SPAG_P_CAST2IDX(st);
+		increment( _eventCounter[ ev_idx ] );
+		increment( _stateCounter[ st_idx ] );
+
+		StateChangeEvent sce{
+			_logIndex++,
+			elapsedNs(),
+			static_cast<uint32_t>( st_idx ),
+			static_cast<uint32_t>( ev_idx )
+		};
+		auto sec = static_cast<uint64_t>( sce._elapsed ) / 1000000000u;
+		_rates.record( RateCounters::KindTransition, sec );
+		if( ev_idx < SPAG_P_CAST2IDX( EV::NB_EVENTS ) )
+			_rates.record( RateCounters::KindEvent, sec );
+		else if( ev_idx == SPAG_P_CAST2IDX( EV::NB_EVENTS ) )
+			_rates.record( RateCounters::KindTimeOut, sec );
+
+#ifdef SPAG_ASYNC_LOGGING
+		if( !_logWriter.isOpen() )
+			openBinaryLogFile();
+		_logWriter.push( sce );
+#else
+		if( !_logfile.is_open() )
+		{
+			_logfile.open( _logfileName );
+			if( !_logfile.is_open() )
+				SPAG_P_THROW_ERROR_RT( "unable to open file " + _logfileName );
+	#ifdef SPAG_ENUM_STRINGS
+			printLogHeader( _logfile, _sepChar, true );
 	#else
-				<< "state-Id\n";
+			printLogHeader( _logfile, _sepChar, false );
 	#endif
 		}
 
-		print2LogFile( _logfile, StateChangeEvent{ st_idx, ev_idx, std::chrono::high_resolution_clock::now() - _startTime } );
+	#ifdef SPAG_ENUM_STRINGS
+		printLogRecord( _logfile, sce, _sepChar, _strEvents_P, _strStates_P );
+	#else
+		printLogRecord( _logfile, sce, _sepChar, nullptr, nullptr );
+	#endif
 		_logfile.flush();
+#endif // SPAG_ASYNC_LOGGING
 	}
 
 	void logIgnoredEvent( size_t ev_idx )
 	{
 		SPAG_CHECK_LESS( ev_idx, SPAG_P_CAST2IDX(EV::NB_EVENTS) );
-		_ignoredEventCounter[ ev_idx ]++;
+		increment( _ignoredEventCounter[ ev_idx ] );
+		auto sec = static_cast<uint64_t>( elapsedNs() ) / 1000000000u;
+		_rates.record( RateCounters::KindEvent,   sec );
+		_rates.record( RateCounters::KindIgnored, sec );
+	}
+
+/// Returns the rates over the last \c window complete seconds (can be called from any thread)
+	Rates rates( size_t window ) const
+	{
+		return _rates.rates( window, static_cast<uint64_t>( elapsedNs() ) / 1000000000u );
 	}
 
 //////////////////////////////////
@@ -647,42 +1705,75 @@ Events are passed as \c size_t because we may pass values other than the ones in
 //////////////////////////////////
 
 	private:
-	void print2LogFile( std::ofstream& f, const StateChangeEvent sce ) const
+/// Time elapsed since FSM creation, in nanoseconds
+	int64_t elapsedNs() const
 	{
-		f << std::setw(6) << std::setfill('0') << _logIndex++
-			<< _sepChar << sce._elapsed.count() << _sepChar << sce._event << _sepChar;
-//		std::cout << "c=" << c << '\n';
-	#ifdef SPAG_ENUM_STRINGS
-		f << _strEvents_R[sce._event] << _sepChar;
-	#endif
-		f << sce._state << _sepChar;
+		return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - _startTime ).count();
+	}
+/// Counters have a single writer (the thread running the FSM), so no need for an atomic read-modify-write operation
+	static void increment( std::atomic<size_t>& c )
+	{
+		c.store( c.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+	}
+	template<size_t N>
+	static size_t readArray( const std::array<std::atomic<size_t>,N>& arr, size_t* dest, size_t size )
+	{
+		for( size_t i=0; i<std::min( N, size ); i++ )
+			dest[i] = arr[i].load( std::memory_order_relaxed );
+		return N;
+	}
+
+#ifdef SPAG_ASYNC_LOGGING
+	void openBinaryLogFile()
+	{
+		LogFileHeader hdr{
+			{ 'S', 'P', 'A', 'G', 'L', 'O', 'G', 0 },
+			SPAG_P_LOGFILE_VERSION,
+			static_cast<uint32_t>( ST::NB_STATES ),
+			static_cast<uint32_t>( EV::NB_EVENTS ) + 2,
+			0
+		};
 	#ifdef SPAG_ENUM_STRINGS
-		f << _strStates_R[sce._state];
+		hdr._hasStrings = 1;
+		_logWriter.open( _logfileName, hdr, _strEvents_P, _strStates_P );
+	#else
+		_logWriter.open( _logfileName, hdr, nullptr, nullptr );
 	#endif
-		f << '\n';
 	}
+#endif // SPAG_ASYNC_LOGGING
 
 //////////////////////////////////
 // RunTimeData: private data section
 //////////////////////////////////
 
 	private:
-		mutable size_t _logIndex = 0;
-		std::array<size_t,static_cast<size_t>(ST::NB_STATES)>   _stateCounter;   ///< per state counter
-		std::array<size_t,static_cast<size_t>(EV::NB_EVENTS)+2> _eventCounter;   ///< per event counter
-		std::array<size_t,static_cast<size_t>(EV::NB_EVENTS)>   _ignoredEventCounter;  ///< ignored events counter. No need to do "+2" as here, time outs and AAT will never be counted as ignored
+		uint64_t _logIndex = 0;
+		char     _padBefore[SPAG_P_CACHE_LINE];   ///< keeps the counters (read by other threads) away from the FSM hot data
+		std::array<std::atomic<size_t>,static_cast<size_t>(ST::NB_STATES)>   _stateCounter;   ///< per state counter
+		std::array<std::atomic<size_t>,static_cast<size_t>(EV::NB_EVENTS)+2> _eventCounter;   ///< per event counter
+		std::array<std::atomic<size_t>,static_cast<size_t>(EV::NB_EVENTS)>   _ignoredEventCounter;  ///< ignored events counter. No need to do "+2" as here, time outs and AAT will never be counted as ignored
+		RateCounters _rates;                      ///< per second counters, not reset by clear()
+		char     _padAfter[SPAG_P_CACHE_LINE];
 
 		std::chrono::time_point<std::chrono::high_resolution_clock> _startTime;
+#ifdef SPAG_ASYNC_LOGGING
+		AsyncLogWriter _logWriter;
+#else
 		std::ofstream _logfile;
+#endif
 
 	#ifdef SPAG_ENUM_STRINGS
-		const std::vector<std::string>& _strEvents_R; ///< reference on vector of strings of events
-		const std::vector<std::string>& _strStates_R; ///< reference on vector of strings of states
+		const std::vector<std::string>* _strEvents_P = nullptr; ///< pointer on vector of strings of events
+		const std::vector<std::string>* _strStates_P = nullptr; ///< pointer on vector of strings of states
 	#endif
 
 		char _sepChar = ';';          ///< log file separator
 	public:
+#ifdef SPAG_ASYNC_LOGGING
+		std::string _logfileName = "spaghetti.bin";
+#else
 		std::string _logfileName = "spaghetti.csv";
+#endif
 };
 #endif // SPAG_ENABLE_LOGGING
 
@@ -702,1778 +1793,6731 @@ resizemat( std::vector<std::vector<T>>& mat, std::size_t nb_lines, std::size_t n
 	}
 }
 #endif
+#ifdef SPAG_ENUM_STRINGS
 //-----------------------------------------------------------------------------------
-/// Used for configuration errors (more to be added). Used through priv::getConfigErrorMessage()
-enum EN_ConfigError
+/// Index on a set of strings, to get the index of a string without comparing it to all of them
+/**
+Holds the hash values of the strings, sorted: a lookup is a binary search on integers,
+followed by (usually) a single string comparison. The strings themselves are not held, they are given to find().
+*/
+class StringIndex
 {
-	CE_TimeOutAndPassState   ///< state has both timeout and pass-state flags active
-	,CE_IllegalPassState     ///< pass-state is followed by another pass-state
-	,CE_SamePassState        ///< pass-state leads to same state
+	public:
+		void build( const std::vector<std::string>& v_str )
+		{
+			_entries.clear();
+			_entries.reserve( v_str.size() );
+			for( size_t i=0; i<v_str.size(); i++ )
+				_entries.push_back( std::make_pair( std::hash<std::string>()( v_str[i] ), i ) );
+			std::sort( _entries.begin(), _entries.end() );
+		}
+/// Returns the index of \c str in \c v_str (that must be the vector given to build() ). First value is false if not found
+		std::pair<bool,size_t> find( const std::string& str, const std::vector<std::string>& v_str ) const
+		{
+			auto h = std::hash<std::string>()( str );
+			auto it = std::lower_bound( _entries.begin(), _entries.end(), std::make_pair( h, size_t(0) ) );
+			for( ; it != _entries.end() && it->first == h; ++it )
+				if( v_str[it->second] == str )
+					return std::make_pair( true, it->second );
+			return std::make_pair( false, size_t(0) );
+		}
+
+	private:
+		std::vector<std::pair<size_t,size_t>> _entries;   ///< hash value, index
 };
 
+/// Linear search, used when the index is not built
+inline
+std::pair<bool,size_t>
+findString( const std::string& str, const std::vector<std::string>& v_str )
+{
+	auto it = std::find( v_str.begin(), v_str.end(), str );
+	if( it == v_str.end() )
+		return std::make_pair( false, size_t(0) );
+	return std::make_pair( true, static_cast<size_t>( it - v_str.begin() ) );
+}
+
+/// Returns false if one of the strings is present more than once (linear time, on average)
+inline
+bool
+checkUnicity( const std::vector<std::string>& v_str )
+{
+	std::unordered_set<std::string> set;
+	for( const auto& str: v_str )
+		if( !set.insert( str ).second )
+			return false;
+	return true;
+}
+#endif // SPAG_ENUM_STRINGS
+
 //-----------------------------------------------------------------------------------
-/// Dummy struct, useful in case there is no need for a timer
-template<typename ST, typename EV,typename CBA=int>
-struct NoTimer;
+#define SPAG_P_CONFIG_IMAGE_VERSION 1
 
-} // namespace priv
+/// Header of a binary configuration image, see SpagFSM::saveConfig()
+/**
+All the offsets are relative to the beginning of the image, and all the sections start on 8 bytes boundaries,
+so the image can be used from any address (memory-mapped file, ...). Values are in the byte order of the writer,
+this is checked with \c _byteOrder.
+*/
+struct ConfigImageHeader
+{
+	char     _magic[8];            ///< "SPAGCFG"
+	uint32_t _version;
+	uint32_t _byteOrder;           ///< 0x01020304
+	uint32_t _nbStates;
+	uint32_t _nbEvents;
+	uint32_t _flags;               ///< see ConfigImageFlag
+	uint32_t _nbInnerTrans;        ///< total number of inner transitions
+	uint32_t _offTransitions;      ///< (nbEvents+2) x nbStates \c uint32_t: transition table, including AAT line
+	uint32_t _offAllowed;          ///< nbEvents x nbStates \c int8_t: allowed events table
+	uint32_t _offStates;           ///< nbStates ConfigImageState
+	uint32_t _offInnerTrans;       ///< nbInnerTrans pairs of \c uint32_t: event, destination state
+	uint32_t _offInnerEvents;      ///< nbEvents \c uint8_t: 1 if inner event
+	uint32_t _offStrings;          ///< (nbStates + nbEvents+2 + 1) \c uint32_t offsets (relative to this section), then the characters
+	uint32_t _size;                ///< total size of the image
+	uint32_t _reserved;
+};
 
-#if defined (SPAG_USE_ASIO_WRAPPER)
-// Forward declaration
-	template<typename ST, typename EV, typename CBA>
-	struct AsioWrapper;
-#endif
+enum ConfigImageFlag : uint32_t
+{
+	CIF_Strings    = 0x01,  ///< image holds the strings of states and events
+	CIF_PassStates = 0x02   ///< image holds pass states or inner transitions (needs \c SPAG_USE_SIGNALS)
+};
 
-//-----------------------------------------------------------------------------------
-/// Options for printing the dotfile, see SpagFSM::writeDotFile()
-struct DotFileOptions
+/// Information on a state, in a configuration image
+struct ConfigImageState
 {
-	std::string nodeShape = "circle"; ///< Default shape for nodes. See https://www.graphviz.org/doc/info/shapes.html
-	bool showActiveState = false;
-	bool showTimeOuts    = true;
-	bool showInnerEvents = true;
-	bool showAAT         = true;
-	bool showStateIndex  = true;
-	bool showStateString = true;
-	bool showEventIndex  = true;
-	bool showEventString = true;
-	bool showUnreachableStates = true;
-	bool fixedNodeWidth  = false;
-	std::string nodeWidth = "1.5";  ///< used only if \c fixedNodeWidth is true
-	bool useColorsEventType = true;
+	uint64_t _duration;
+	uint32_t _nextState;
+	uint8_t  _timerEnabled;
+	uint8_t  _durUnit;
+	uint8_t  _isPassState;
+	uint8_t  _reserved;
+	uint32_t _innerFirst;      ///< index of first inner transition of that state
+	uint32_t _innerCount;
+};
+
+/// Helper for SpagFSM::saveConfig(), appends values to a buffer, with 8 bytes aligned sections
+class ConfigImageWriter
+{
+	public:
+		template<typename T>
+		void put( const T& val )
+		{
+			auto p = reinterpret_cast<const uint8_t*>( &val );
+			_data.insert( _data.end(), p, p + sizeof(T) );
+		}
+		void putBytes( const void* p, size_t n )
+		{
+			auto pb = static_cast<const uint8_t*>( p );
+			_data.insert( _data.end(), pb, pb + n );
+		}
+/// Pads to next 8 bytes boundary, and returns the offset
+		uint32_t startSection()
+		{
+			_data.resize( ( _data.size() + 7 ) / 8 * 8, 0 );
+			return static_cast<uint32_t>( _data.size() );
+		}
+		std::vector<uint8_t>& data() { return _data; }
 
+	private:
+		std::vector<uint8_t> _data;
 };
 
-//-----------------------------------------------------------------------------------
-/// Main class, holding data for a FSM, without the event loop
+/// Helper for SpagFSM::loadConfig(), gives access to the sections of an image, with bounds checking
 /**
-types:
- - ST: an enum defining the different states.
- - EV: an enum defining the different external events.
- - TIM: a type handling the events, must provide the following methods:
-   - init();
-   - timerStart( const SpagFSM* );
-   - timerCancel();
- - CBA: the callback function type (single) argument
-
-Requirements: the two enums \b MUST have the following requirements:
- - the last element \b must be NB_STATES and NB_EVENTS, respectively
- - the first state must have value 0
+The values are copied out with \c memcpy(), so the image needs not be aligned (it can be any buffer, not only a mapped file).
 */
-template<typename ST, typename EV,typename TIM,typename CBA=int>
-class SpagFSM
+class ConfigImageReader
 {
-	using Callback_t = std::function<void(CBA)>;
-
 	public:
-/// Constructor
-
-#if (defined SPAG_ENABLE_LOGGING) && (defined SPAG_ENUM_STRINGS)
-		SpagFSM() : _rtdata( _strEvents, _strStates )
-#else
-		SpagFSM()
-#endif
+		ConfigImageReader( const void* data, size_t size ) : _data( static_cast<const uint8_t*>( data ) ), _size( size )
+		{}
+/// Returns a pointer on \c n bytes at offset \c off, throws if outside of the image
+		const char* bytes( size_t off, size_t n ) const
 		{
-			static_assert( SPAG_P_CAST2IDX(ST::NB_STATES) > 1, "Error, you need to provide at least two states" );
+			if( off > _size || n > _size - off )
+				SPAG_P_THROW_ERROR_RT( "truncated or invalid configuration image" );
+			return reinterpret_cast<const char*>( _data + off );
+		}
+/// Reads a value at offset \c off (no alignment requirement)
+		template<typename T>
+		T read( size_t off ) const
+		{
+			T val;
+			std::memcpy( &val, bytes( off, sizeof(T) ), sizeof(T) );
+			return val;
+		}
+/// Reads element \c i of the array of type \c T starting at offset \c off
+		template<typename T>
+		T read( size_t off, size_t i ) const
+		{
+			return read<T>( off + i * sizeof(T) );
+		}
+
+	private:
+		const uint8_t* _data;
+		size_t         _size;
+};
+
+//-----------------------------------------------------------------------------------
+/// Used for configuration errors (more to be added). Used through priv::getConfigErrorMessage()
+enum EN_ConfigError
+{
+	CE_TimeOutAndPassState   ///< state has both timeout and pass-state flags active
+	,CE_IllegalPassState     ///< pass-state is followed by another pass-state
+	,CE_SamePassState        ///< pass-state leads to same state
+};
+
+//-----------------------------------------------------------------------------------
+/// Private class, makes the check and build of a configuration happen only once, even if FSMs sharing it are started by several threads (see SpagFSM::prepareCfg() )
+/**
+A copy is never prepared, whatever the source (it is done to be modified, see SpagFSM::wcfg() )
+*/
+struct PrepareGuard
+{
+	std::mutex        _mutex;
+	std::atomic<bool> _isDone{false};
+
+	PrepareGuard() = default;
+	PrepareGuard( const PrepareGuard& ) {}
+	PrepareGuard& operator = ( const PrepareGuard& )
+	{
+		_isDone = false;
+		return *this;
+	}
+};
 
+//-----------------------------------------------------------------------------------
+/// Private class, holds the whole configuration of a FSM
+/**
+Can be shared between several SpagFSM instances of the same type (see SpagFSM::assignConfig() ),
+in which case each of them only holds its run-time data. Copy on write: calling a configuration member function
+on a FSM that shares its configuration will first give it its own copy.
+*/
+template<typename ST, typename EV, typename CBA>
+struct FsmConfig
+{
+	FsmConfig()
+	{
 #ifdef SPAG_USE_ARRAY
-			for( auto& e: _allowedMat )      // all events will be ignored at init
-				std::fill( e.begin(), e.end(), 0 );
-			for( auto& e: _transitionMat )      // transition table filled with state 0
-				std::fill( e.begin(), e.end(), static_cast<ST>(0) );
+		for( auto& e: _allowedMat )      // all events will be ignored at init
+			std::fill( e.begin(), e.end(), 0 );
+		for( auto& e: _transitionMat )      // transition table filled with state 0
+			std::fill( e.begin(), e.end(), static_cast<ST>(0) );
 #else
-			priv::resizemat( _transitionMat, nbEvents(), nbStates() );
-			priv::resizemat( _allowedMat, nbEvents(), nbStates() );
-			_stateInfo.resize( nbStates() );    // states information
+		resizemat( _transitionMat, nbEvents(), nbStates() );
+		resizemat( _allowedMat, nbEvents(), nbStates() );
+		_stateInfo.resize( nbStates() );    // states information
 #endif
 
 #ifdef SPAG_ENUM_STRINGS
-			_strEvents.resize( nbEvents()+2 );
-			_strStates.resize( nbStates() );
-			std::generate(                          // assign default strings, so it doesn't stay empty
-				_strStates.begin(),
-				_strStates.end(),
-				[](){ static int idx; std::string s = "St-"; s += std::to_string(idx++); return s; } // lambda
-			);
-			std::generate(                          // assign default strings, so it doesn't stay empty
-				_strEvents.begin(),
-				_strEvents.end(),
-				[](){ static int idx; std::string s = "Ev-"; s += std::to_string(idx++); return s; } // lambda
-			);
-			_strEvents[ nbEvents()   ] = "*Timeout*";
-			_strEvents[ nbEvents()+1 ] = "*  AAT  *"; // Always Active Transition
-#endif
-
-#ifdef SPAG_EMBED_ASIO_WRAPPER
-			_eventHandler = &_asioWrapper;
+		_strEvents.resize( nbEvents()+2 );
+		_strStates.resize( nbStates() );
+		for( size_t i=0; i<nbStates(); i++ )     // assign default strings, so it doesn't stay empty
+			_strStates[i] = "St-" + std::to_string(i);
+		for( size_t i=0; i<nbEvents()+2; i++ )
+			_strEvents[i] = "Ev-" + std::to_string(i);
+		_strEvents[ nbEvents()   ] = "*Timeout*";
+		_strEvents[ nbEvents()+1 ] = "*  AAT  *"; // Always Active Transition
 #endif
-		}
+	}
 
-/** \name Configuration of FSM */
-///@{
+	static constexpr size_t nbStates() { return static_cast<size_t>(ST::NB_STATES); }
+	static constexpr size_t nbEvents() { return static_cast<size_t>(EV::NB_EVENTS); }
 
-/// Assigns allowed event matrix
+/// Computes for each state if it is the destination of a transition from another state (event, timeout, pass-state or inner event)
 /**
-Allowed types for \c T:
- - \c std::vector<std::vector<A>>
- - \c std::array<std::array<A,N1>,N2> (with N1 the number of states, N2 the number of events)
-
-Type \c A can be \c bool, \c char, \c uchar, ...
+Single pass over the configuration, the result is kept until next change (see SpagFSM::wcfg() )
 */
-		template<typename T>
-		void assignEventMat( const T& mat )
+	void updateReferences()
+	{
+		if( _hasReferences )
+			return;
+		_isReferenced.assign( nbStates(), 0 );
+		for( size_t i=0; i<nbStates(); i++ )
 		{
-			SPAG_CHECK_EQUAL( mat.size(),    nbEvents() );
-			SPAG_CHECK_EQUAL( mat[0].size(), nbStates() );
+			for( size_t k=0; k<nbEvents(); k++ )
+				if( _allowedMat[k][i] != 0 )
+					_isReferenced[ SPAG_P_CAST2IDX( _transitionMat[k][i] ) ] |= ( SPAG_P_CAST2IDX( _transitionMat[k][i] ) != i );
 
-			auto li_out = std::begin( _allowedMat );
-			for( auto li_in : mat )
-			{
-				std::copy( std::begin(li_in), std::end(li_in), std::begin(*li_out) );
-				li_out++;
-			}
+			const auto& stinf = _stateInfo[i];
+			if( stinf._timerEvent._enabled )
+				_isReferenced[ SPAG_P_CAST2IDX( stinf._timerEvent._nextState ) ] |= ( SPAG_P_CAST2IDX( stinf._timerEvent._nextState ) != i );
+#ifdef SPAG_USE_SIGNALS
+			if( stinf._isPassState )
+				_isReferenced[ SPAG_P_CAST2IDX( _transitionMat[ nbEvents()+1 ][i] ) ] |= ( SPAG_P_CAST2IDX( _transitionMat[ nbEvents()+1 ][i] ) != i );
+			for( const auto& itr: stinf._innerTransList )
+				_isReferenced[ SPAG_P_CAST2IDX( itr._destState ) ] |= ( SPAG_P_CAST2IDX( itr._destState ) != i );
+#endif
 		}
+		_hasReferences = true;
+	}
 
-/// Assigns transition matrix
-/**
-Copying of elements is done because the input matrix can be a \c std::vector, or an \c std::array
-
-Allowed types for \c T:
- - \c std::vector<std::vector<ST>>
- - \c std::array<std::array<ST,N1>,N2> (with N1 the number of states, N2 the number of events)
-*/
-		template<typename T>
-		void assignTransitionMat( const T& mat )
+/// Builds the data that is derived from the configuration, once it is complete (called when a FSM using it is started or shared)
+	void build()
+	{
+		if( _isBuilt )
+			return;
+#ifdef SPAG_USE_SIGNALS
+		for( auto& stinf: _stateInfo )   // build for each state the set of inner events it handles
 		{
-			SPAG_CHECK_EQUAL( mat.size(),    nbEvents() );
-			SPAG_CHECK_EQUAL( mat[0].size(), nbStates() );
-			auto li_out = std::begin( _transitionMat );
-			for( auto li_in : mat )
-			{
-				std::copy( std::begin(li_in), std::end(li_in), std::begin(*li_out) );
-				li_out++;
-			}
+			stinf._innerEventMask.reset();
+			for( const auto& itr: stinf._innerTransList )
+				stinf._innerEventMask.set( static_cast<size_t>(itr._innerEvent) );
 		}
-
-/// Assigns an external transition event \c ev to switch from state \c st1 to state \c st2
-/**
-\note Transition to same state are allowed.
-*/
-		void assignTransition( ST st1, EV ev, ST st2 )
-		{
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st1), nbStates() );
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st2), nbStates() );
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev),  nbEvents() );
-			auto st1_idx = SPAG_P_CAST2IDX(st1);
-
-#ifdef SPAG_USE_SIGNALS
-			if( _stateInfo[st1_idx]._isPassState )
-			{
-				std::string err_msg{ "error, attempting to assign a transition to state" };
-				err_msg += std::to_string( st1_idx );
-#ifdef SPAG_ENUM_STRINGS
-				err_msg += " (" + _strStates[ st1_idx ] + ")";
 #endif
-				err_msg += ", was previously declared as pass-state";
-				SPAG_P_THROW_ERROR_CFG( err_msg );
-			}
+#ifdef SPAG_PACKED_TABLE
+		_packedTable.build( _transitionMat, _allowedMat );
 #endif
-			_transitionMat[ SPAG_P_CAST2IDX(ev) ][ st1_idx ] = st2;
-			_allowedMat[    SPAG_P_CAST2IDX(ev) ][ st1_idx ] = 1;
-		}
+#ifdef SPAG_ENUM_STRINGS
+		_indexEvents.build( _strEvents );
+		_indexStates.build( _strStates );
+#endif
+		_isBuilt = true;
+	}
 
+#ifdef SPAG_USE_ARRAY
 #ifdef SPAG_USE_SIGNALS
-/// Assigns a transition to a "pass-state" (AAT): once on state \c st1, the FSM will switch right away to \c st2
-/**
-\warning If a time out has previously been assigned to state \c st1, it will be removed
+	std::array<
+		std::array<ST, static_cast<size_t>(ST::NB_STATES)>,
+		static_cast<size_t>(EV::NB_EVENTS)+2                   // + 2 is used to hold the AAT
+	> _transitionMat;  ///< describe what states the fsm switches to, when an event is received. lines: events, columns: states, value: states to switch to. DOES NOT hold timer events
+#else
+	std::array<
+		std::array<ST, static_cast<size_t>(ST::NB_STATES)>,
+		static_cast<size_t>(EV::NB_EVENTS)+1                  // +1 is used to hold the timeout events
+	> _transitionMat;  ///< describe what states the fsm switches to, when an event is received. lines: events, columns: states, value: states to switch to. DOES NOT hold timer events
+#endif
 
-\warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
-*/
-		void assignAAT( ST st1, ST st2 )
-		{
-			auto st1_idx = SPAG_P_CAST2IDX(st1);
-			auto st2_idx = SPAG_P_CAST2IDX(st2);
-			SPAG_CHECK_LESS( st1_idx, nbStates() );
-			SPAG_CHECK_LESS( st2_idx, nbStates() );
-			if( st1 == st2 )
-				SPAG_P_THROW_ERROR_CFG(
-					"unable to assign an AAT to same states: S"
-					 + std::to_string( st1_idx ) + "and S" + std::to_string( st2_idx )
-				);
+/// Matrix holding for each event a byte telling is the event is ignored or not, for a given state (0:ignore event, 1:handle external event, -1: internal event)
+	std::array<
+		std::array<char, static_cast<size_t>(ST::NB_STATES)>,
+		static_cast<size_t>(EV::NB_EVENTS)
+	> _allowedMat;
+#else
+	std::vector<std::vector<ST>>   _transitionMat;
+	std::vector<std::vector<char>> _allowedMat;
+#endif // SPAG_USE_ARRAY
 
-			_transitionMat[ nbEvents()+1 ][st1_idx] = st2;
-			for( auto& line: _allowedMat ) // disable other transitions for that state
-				line[ st1_idx ] = 0;
+#ifdef SPAG_PACKED_TABLE
+	PackedTable<ST,EV> _packedTable;     ///< run-time copy of the two matrices above, built by build()
+#endif
 
-			auto& stinf = _stateInfo[st1_idx];
-			stinf._isPassState = true;
+#ifdef SPAG_USE_TRANSITION_ACTIONS
+/// Transition actions, event-major, same index as the transition: <code>ev * nbStates() + st</code>. Line \c nbEvents() holds the timeouts actions
+#ifdef SPAG_USE_ARRAY
+	std::array<
+		TransitionAction<ST,EV>,
+		( static_cast<size_t>(EV::NB_EVENTS) + 1 ) * static_cast<size_t>(ST::NB_STATES)
+	> _actionMat;
+#else
+	std::vector<TransitionAction<ST,EV>> _actionMat = std::vector<TransitionAction<ST,EV>>( ( nbEvents() + 1 ) * nbStates() );
+#endif
+#endif
 
-			if( stinf._innerTransList.size() )
-				SPAG_P_LOG_ERROR << "warning, assign AAT transition from state "
-#ifdef SPAG_ENUM_STRINGS
-					<< st1_idx << " (" << _strStates[st1_idx] << ") to state "
-					<< st2_idx << " (" << _strStates[st2_idx] << ")"
+#ifdef SPAG_USE_ARRAY
+	std::array<StateInfo<ST,EV,CBA>,static_cast<size_t>(ST::NB_STATES)> _stateInfo;         ///< Holds for each state the details
 #else
-					<< st1_idx << " to state " << st2_idx
+	std::vector<StateInfo<ST,EV,CBA>> _stateInfo;         ///< Holds for each state the details
+#endif
+	EventSet<EV> _innerEvents;    ///< holds, for each event, a flag telling if it has been declared as inner event
+#ifdef SPAG_USE_EVENT_QUEUE
+	std::array<uint8_t,static_cast<size_t>(EV::NB_EVENTS)> _queueFlags{};   ///< for each event, the flags of type QueueFlag used by postEvent()
 #endif
-					<< " removes the "
-					<< stinf._innerTransList.size() << " inner transition(s) previously assigned to this state.\n";
-			stinf._innerTransList.clear();
 
-			auto& tev = stinf._timerEvent;
-			if( tev._enabled )
-			{
-				SPAG_P_LOG_ERROR << "warning, removal of timeout of "
-					<< tev._duration << ' ' << priv::stringFromTimeUnit( tev._durUnit )
-					<< " on state S" << std::setfill('0') << std::setw(2) << SPAG_P_CAST2IDX(st1)
 #ifdef SPAG_ENUM_STRINGS
-					<< " (" << _strStates[st1_idx] << ')'
+	std::vector<std::string> _strEvents;      ///< holds events strings
+	std::vector<std::string> _strStates;      ///< holds states strings
+	StringIndex _indexEvents;                 ///< index on \c _strEvents, built by build()
+	StringIndex _indexStates;                 ///< index on \c _strStates, built by build()
 #endif
-					<< ".\n";
-				tev._enabled = false;
-			}
-		}
+	std::function<void(ST,EV)> _ignEventCallback;     ///< ignored events callback function
 
-/// Assigns a inner transition between \c st1 and \c st2, triggered by internal event \c ev
-/// \warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
-		void assignInnerTransition( ST st1, EV iev, ST st2 )
-		{
-			auto st1_idx = SPAG_P_CAST2IDX(st1);
-			auto ev_idx  = SPAG_P_CAST2IDX(iev);
-			SPAG_CHECK_LESS( st1_idx,              nbStates() );
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st2), nbStates() );
-			SPAG_CHECK_LESS( ev_idx,               nbEvents() );
+	bool _isBuilt = false;                    ///< true if build() has been called since last change
 
-			auto& stinf = _stateInfo[ st1_idx ];
-			if( stinf._isPassState )
-				SPAG_P_THROW_ERROR_CFG( "error, removing pass-state" ); /// \todo maybe a warning instead ?
-			stinf._isPassState = false;
-			stinf._innerTransList.push_back( priv::InnerTransition<ST,EV>(iev, st2) );
-			_innerEventFlag[iev] = false;
-			_transitionMat[ ev_idx ][st1_idx] = st2;
-			_allowedMat[    ev_idx ][st1_idx] = -1;
-		}
+	std::vector<char> _isReferenced;          ///< for each state, true if another state leads to it, see updateReferences()
+	bool _hasReferences = false;              ///< true if updateReferences() has been called since last change
+	bool _isChecked     = false;              ///< true if SpagFSM::doChecking() has been run since last change
+	PrepareGuard _prepared;                   ///< set once checked and built, see SpagFSM::prepareCfg()
+};
 
-/// Whatever state we are on, when internal event \c iev occurs, we will switch to state \c st (except if we are already on that state).
+//-----------------------------------------------------------------------------------
+/// Dummy struct, useful in case there is no need for a timer
+template<typename ST, typename EV,typename CBA=int>
+struct NoTimer;
+
+} // namespace priv
+
+#ifdef SPAG_USE_FSM_ENGINE
+template<typename ST, typename EV, typename CBA>
+class FsmEngine;
+#endif
+
+#ifdef SPAG_USE_FSM_POOL
+template<typename ST, typename EV, typename CBA>
+class FsmPool;
+#endif
+
+#ifdef SPAG_ENABLE_LOGGING
+//-----------------------------------------------------------------------------------
+/// Converts a binary log file (produced when symbol \c SPAG_ASYNC_LOGGING is defined) into the csv format
 /**
-To remove afterwards the inner events on some states, use \c disableInnerTransition()
+Output is exactly the same as what is produced when \c SPAG_ASYNC_LOGGING is not defined,
+so that existing tools processing the csv file can still be used.
+See the program src/log2csv.cpp.
+
+Returns the number of records converted, throws on invalid input.
 */
-		void assignInnerTransition( EV iev, ST st )
+inline
+size_t
+convertLogFile( std::istream& in, std::ostream& out, char sep=';' )
+{
+	priv::LogFileHeader hdr;
+	if( !in.read( reinterpret_cast<char*>( &hdr ), sizeof(hdr) ) || std::string( hdr._magic, 7 ) != "SPAGLOG" )
+		SPAG_P_THROW_ERROR_RT( "input is not a Spaghetti binary log file" );
+	if( hdr._version != SPAG_P_LOGFILE_VERSION )
+		SPAG_P_THROW_ERROR_RT( "unsupported binary log file version: " + std::to_string( hdr._version ) );
+
+	std::vector<std::string> strEvents, strStates;
+	if( hdr._hasStrings )
+	{
+		auto readStrings = [&]( std::vector<std::string>& v_str, uint32_t nb ) // lambda
 		{
-			auto ev_idx = SPAG_P_CAST2IDX(iev);
-			auto st_idx = SPAG_P_CAST2IDX(st);
-			SPAG_CHECK_LESS( st_idx, nbStates() );
-			SPAG_CHECK_LESS( ev_idx, nbEvents() );
+			v_str.resize( nb );
+			for( auto& str: v_str )
+			{
+				uint32_t len = 0;
+				in.read( reinterpret_cast<char*>( &len ), sizeof(len) );
+				str.resize( len );
+				in.read( &str[0], len );
+			}
+			if( !in )
+				SPAG_P_THROW_ERROR_RT( "unable to read strings from binary log file" );
+		};
+		readStrings( strEvents, hdr._nbEvents );
+		readStrings( strStates, hdr._nbStates );
+	}
 
-			_innerEventFlag[iev] = false;
+	priv::printLogHeader( out, sep, hdr._hasStrings );
+	size_t nb = 0;
+	priv::StateChangeEvent sce;
+	while( in.read( reinterpret_cast<char*>( &sce ), sizeof(sce) ) )
+	{
+		if( sce._state >= hdr._nbStates || sce._event >= hdr._nbEvents )
+			SPAG_P_THROW_ERROR_RT( "invalid record in binary log file, index=" + std::to_string( sce._index ) );
+		priv::printLogRecord(
+			out,
+			sce,
+			sep,
+			hdr._hasStrings ? &strEvents : nullptr,
+			hdr._hasStrings ? &strStates : nullptr
+		);
+		nb++;
+	}
+	return nb;
+}
+#endif // SPAG_ENABLE_LOGGING
 
-			assert( _stateInfo.size() == nbStates() );
-			for( size_t i=0; i<_stateInfo.size(); ++i )
-				if( i != st_idx )
-				{
-					if( !_stateInfo[i].holdsInnerTransition( iev, st ) )
-					{
-						_stateInfo[i]._innerTransList.push_back( priv::InnerTransition<ST,EV>( iev, st ) );
-						_transitionMat[ ev_idx ][i] = st;
-						_allowedMat   [ ev_idx ][i] = -1;
-					}
-				}
-		}
+#ifdef SPAG_ENABLE_TRACEPOINTS
+//-----------------------------------------------------------------------------------
+/// The tracepoints of the FSM, see symbol \c SPAG_ENABLE_TRACEPOINTS and setTracepointHook().
+/// The three values given with each of them are listed here (unused ones are 0)
+enum class Tracepoint : uint8_t
+{
+	Transition        ///< previous state, event (NB_EVENTS for a timeout, NB_EVENTS+1 for an AAT), new state
+	,IgnoredEvent     ///< current state, event
+	,TimerStart       ///< current state, duration, unit (a DurUnit value)
+	,TimerCancel      ///< current state
+	,TimeOut          ///< current state, next state
+	,InnerEvent       ///< current state, inner event (activated with activateInnerEvent() )
+	,CallbackBegin    ///< current state
+	,CallbackEnd      ///< current state
+	,TimerAborted     ///< current state (AsioWrapper only: a canceled timer completion has been received)
+};
 
-/// Removes inner transition \c ev that is assigned on state \c st_from
+/// Function called on each tracepoint: context pointer, tracepoint, FSM (as a \c SpagFSM pointer), and the three values (see Tracepoint)
+using TracepointHook_t = void(*)( void*, Tracepoint, const void*, size_t, size_t, size_t );
+
+namespace priv {
+/// A registered hook: function and its context, never modified once published
+struct TracepointHook
+{
+	TracepointHook_t _func;
+	void*            _context;
+};
+
+/// The hook called on the tracepoints, the same for all the FSM
 /**
-This is a companion function of \c assignInnerTransition( EV, ST )
+The function and its context are published together, with a single atomic pointer.
+It is a static member of a class template, so it can be defined in this header (C++11 has no inline variables),
+and it is constant-initialized: reading it needs no initialization guard.
+*/
+template<typename T=void>
+struct TracepointHookPtr
+{
+	static std::atomic<const TracepointHook*> _current;
+};
+template<typename T>
+std::atomic<const TracepointHook*> TracepointHookPtr<T>::_current{ nullptr };
 
-Hence, as this latter ones assigns an inner event to all the states, we need a function
-to remove this event on some states
+/// Holds all the registered hooks, only used by setTracepointHook()
+/**
+The hooks that have been replaced are kept until exit, as a tracepoint running on another thread can still be using one.
 */
-		void disableInnerTransition( EV ev, ST st_from )
-		{
-			auto st_idx = SPAG_P_CAST2IDX(st_from);
-			auto& stinf = _stateInfo[st_idx];
+struct TracepointHookRegistry
+{
+	std::mutex                                         _mutex;   ///< protects \c _hooks
+	std::vector<std::unique_ptr<const TracepointHook>> _hooks;   ///< all the registered hooks
+};
 
-			auto it = stinf.findInnerEvent( ev );
-			if( it == std::end( stinf._innerTransList ) )
-				SPAG_P_THROW_ERROR_CFG( "state "
-					+ std::to_string( st_idx )
-#ifdef SPAG_ENUM_STRINGS
-					+ " (" + _strStates[st_idx] + ") "
-#endif
-					+ " has no inner transition"
-				);
+inline
+TracepointHookRegistry&
+tracepointHookRegistry()
+{
+	static TracepointHookRegistry reg;
+	return reg;
+}
 
-			stinf._innerTransList.erase( it );
-			_allowedMat[ev][st_from] = 0;
-		}
+/// Called on each tracepoint: only a load and a test when no hook is registered
+inline
+void
+callTracepointHook( Tracepoint tp, const void* fsm, size_t a, size_t b, size_t c )
+{
+	auto hook = TracepointHookPtr<>::_current.load( std::memory_order_acquire );
+	if( hook )
+		hook->_func( hook->_context, tp, fsm, a, b, c );
+}
+} // namespace priv
 
-#else // SPAG_USE_SIGNALS not defined
+/// Registers the function called on each tracepoint, for all the FSM (\c nullptr to remove it). Can be called from any thread
+/**
+The hook is called synchronously by the thread running the FSM, so it must be short (for example, writing a record in a ring buffer).
+A tracepoint always sees a function with its own context. Each call allocates a small record, kept until exit,
+so this is meant to be called a few times, not on each event.
+*/
+inline
+void
+setTracepointHook( TracepointHook_t func, void* context=nullptr )
+{
+	auto& reg = priv::tracepointHookRegistry();
+	std::lock_guard<std::mutex> lock( reg._mutex );
+	if( !func )
+	{
+		priv::TracepointHookPtr<>::_current.store( nullptr, std::memory_order_release );
+		return;
+	}
+	reg._hooks.emplace_back( new priv::TracepointHook{ func, context } );
+	priv::TracepointHookPtr<>::_current.store( reg._hooks.back().get(), std::memory_order_release );
+}
+#endif // SPAG_ENABLE_TRACEPOINTS
 
-		void assignInnerTransition( ST st1, EV ev, ST st2 )
-			SPAG_NOT_AVAILABLE(SPAG_USE_SIGNALS);
-		void assignInnerTransition( EV ev, ST st )
-			SPAG_NOT_AVAILABLE(SPAG_USE_SIGNALS);
-		void disableInnerTransition( EV, ST )
-			SPAG_NOT_AVAILABLE(SPAG_USE_SIGNALS);
-		void assignAAT( ST st1, ST st2 )
-			SPAG_NOT_AVAILABLE(SPAG_USE_SIGNALS);
+#ifdef SPAG_ENABLE_TRACE
+namespace priv {
+//-----------------------------------------------------------------------------------
+/// Type of a trace record, see symbol \c SPAG_ENABLE_TRACE
+enum class TraceKind : uint32_t { Event, TimeOut, InnerEvent };
 
-#endif // SPAG_USE_SIGNALS
+/// A record of the trace file: an input of the FSM. Fixed-size POD, written "as is" in the file
+struct TraceRecord
+{
+	int64_t  _time;    ///< time elapsed since the start of the trace, in nanoseconds
+	uint32_t _kind;    ///< a TraceKind value
+	uint32_t _value;   ///< event index (unused for timeouts)
+};
 
-/// Assigns a timeout event leading to state \c st_final, on \b all states except \c st_final,
-/// using default timer unit and default timer duration value
-		void assignGlobalTimeOut( ST st_final )
+/// Header of the trace file, followed by the records
+struct TraceFileHeader
+{
+	char     _magic[8];      ///< holds "SPAGTRC"
+	uint32_t _version;       ///< binary format version
+	uint32_t _nbStates;
+	uint32_t _nbEvents;
+	uint32_t _initialState;  ///< state of the FSM when the trace was started
+};
+
+/// Current trace format version
+#define SPAG_P_TRACEFILE_VERSION 1
+
+//-----------------------------------------------------------------------------------
+/// Writes the inputs of a FSM (events, timeouts, inner events activations) into a binary file, see SpagFSM::startTrace()
+class TraceWriter
+{
+	public:
+		TraceWriter( const std::string& fname, uint32_t nbStates, uint32_t nbEvents, uint32_t initialState )
 		{
-			assignGlobalTimeOut( _defaultTimerValue, _defaultTimerUnit, st_final );
+			_file.open( fname, std::ios::binary );
+			if( !_file.is_open() )
+				SPAG_P_THROW_ERROR_RT( "unable to open trace file " + fname );
+			TraceFileHeader hdr{
+				{ 'S', 'P', 'A', 'G', 'T', 'R', 'C', 0 },
+				SPAG_P_TRACEFILE_VERSION,
+				nbStates,
+				nbEvents,
+				initialState
+			};
+			_file.write( reinterpret_cast<const char*>( &hdr ), sizeof(hdr) );
+			_startTime = std::chrono::steady_clock::now();
 		}
+		TraceWriter( const TraceWriter& ) = delete;
 
-/// Assigns a timeout event on \b all states except \c st_final, using duration \c dur and default timer unit.
-		void assignGlobalTimeOut( Duration dur, ST st_final )
+/// Adds a record. The file stream is not flushed, so this is only a memory copy most of the time
+		void write( TraceKind kind, size_t value )
 		{
-			assignGlobalTimeOut( dur, _defaultTimerUnit, st_final );
+			TraceRecord rec{
+				std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _startTime ).count(),
+				static_cast<uint32_t>( kind ),
+				static_cast<uint32_t>( value )
+			};
+			_file.write( reinterpret_cast<const char*>( &rec ), sizeof(rec) );
+			_nbRecords++;
+		}
+		size_t nbRecords() const
+		{
+			return _nbRecords;
 		}
 
-/// Assigns a timeout event on \b all states except \c st_final, using duration \c dur and unit \c durUnit
-		void assignGlobalTimeOut( Duration dur, std::string durUnit, ST st_final )
+	private:
+		std::ofstream _file;
+		std::chrono::steady_clock::time_point _startTime;
+		size_t        _nbRecords = 0;
+};
+
+/// Counts the nesting of the input processing functions (RAII), so that only the external inputs are recorded, see SpagFSM::startTrace()
+class TraceScope
+{
+	public:
+		explicit TraceScope( uint32_t& depth ) : _depth( depth )
 		{
-			auto tu = priv::timeUnitFromString( durUnit );
-			if( !tu.first )
-				SPAG_P_THROW_ERROR_CFG( "invalid string value: " + durUnit );
-			assignGlobalTimeOut( dur, tu.second, st_final );
+			_depth++;
+		}
+		~TraceScope()
+		{
+			_depth--;
 		}
+		TraceScope( const TraceScope& ) = delete;
 
-/// Assigns a timeout event on \b all states except \c st_final, using unit \c durUnit
+	private:
+		uint32_t& _depth;
+};
+} // namespace priv
+#endif // SPAG_ENABLE_TRACE
+
+#if defined (SPAG_USE_ASIO_WRAPPER)
+// Forward declaration
+	template<typename ST, typename EV, typename CBA>
+	struct AsioWrapper;
+#endif
+
+//-----------------------------------------------------------------------------------
+/// Options for printing the dotfile, see SpagFSM::writeDotFile()
+struct DotFileOptions
+{
+	std::string nodeShape = "circle"; ///< Default shape for nodes. See https://www.graphviz.org/doc/info/shapes.html
+	bool showActiveState = false;
+	bool showTimeOuts    = true;
+	bool showInnerEvents = true;
+	bool showAAT         = true;
+	bool showStateIndex  = true;
+	bool showStateString = true;
+	bool showEventIndex  = true;
+	bool showEventString = true;
+	bool showUnreachableStates = true;
+	bool fixedNodeWidth  = false;
+	std::string nodeWidth = "1.5";  ///< used only if \c fixedNodeWidth is true
+	bool useColorsEventType = true;
+
+};
+
+#ifdef SPAG_USE_MMAP
+//-----------------------------------------------------------------------------------
+/// Read-only memory-mapped file (POSIX), used to load a configuration image without reading the file, see SpagFSM::loadConfig()
 /**
-After this, on all the states except \c st_final, if \c duration expires, the FSM will switch to \c st_final
-(where there may or may not be a timeout assigned)
+The pages are shared with all the processes mapping the same file.
+\code
+spag::MappedFile file( "config.bin" );
+fsm.loadConfig( file.data(), file.size() );
+\endcode
 */
-		void assignGlobalTimeOut( Duration dur, DurUnit durUnit, ST st_final )
+class MappedFile
+{
+	public:
+		explicit MappedFile( const std::string& fname )
 		{
-			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+			_fd = ::open( fname.c_str(), O_RDONLY );
+			if( _fd < 0 )
+				SPAG_P_THROW_ERROR_RT( "unable to open file " + fname );
+			struct stat st;
+			if( ::fstat( _fd, &st ) != 0 || st.st_size == 0 )
+			{
+				::close( _fd );
+				SPAG_P_THROW_ERROR_RT( "unable to get size of file " + fname );
+			}
+			_size = static_cast<size_t>( st.st_size );
+			_data = ::mmap( nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0 );
+			if( _data == MAP_FAILED )
+			{
+				::close( _fd );
+				SPAG_P_THROW_ERROR_RT( "unable to map file " + fname );
+			}
+		}
+		MappedFile( const MappedFile& ) = delete;
+		~MappedFile()
+		{
+			::munmap( _data, _size );
+			::close( _fd );
+		}
+		const void* data() const { return _data; }
+		size_t      size() const { return _size; }
 
-			for( size_t i=0; i<nbStates(); i++ )                                 // iterate on all the states
-				if( i != SPAG_P_CAST2IDX(st_final) )                             // and for all of them, except the designated one,
-				{
-					auto tev = _stateInfo[ SPAG_P_CAST2IDX( i ) ]._timerEvent;   // get its "timer event" data.
+	private:
+		int    _fd   = -1;
+		void*  _data = nullptr;
+		size_t _size = 0;
+};
+#endif // SPAG_USE_MMAP
 
-#ifdef SPAG_USE_SIGNALS
-					if( _stateInfo[ SPAG_P_CAST2IDX( i ) ]._isPassState )        // if it has already been assigned an AAT, then
-					{                                                            //  issue a warning and process next one.
-						SPAG_P_LOG_ERROR << " warning: state " << i
-	#ifdef SPAG_ENUM_STRINGS
-							<< " (" << _strStates[i] << ')'
-	#endif
-							<< " is a pass state (holds an AAT), time out not assigned.\n";
-					}
-					else
-#endif
-					{
-						if( tev._enabled )
-						{
-							SPAG_P_LOG_ERROR << " warning, removal of previously assigned timeout leading from state " << i
-	#ifdef SPAG_ENUM_STRINGS
-								<< " (" << _strStates[i] << ')'
-	#endif
-								<< " to state " << tev._nextState
-	#ifdef SPAG_ENUM_STRINGS
-								<< " (" << _strStates.at( SPAG_P_CAST2IDX(tev._nextState)) << ')'
-	#endif
-								<< " after " << tev._duration << ' ' << priv::stringFromTimeUnit( tev._durUnit ) << ".\n";
-						}
-						assignTimeOut( static_cast<ST>(i), dur, durUnit, st_final );
-					}
-				}
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+//-----------------------------------------------------------------------------------
+/// A fixed pool of threads, running the asynchronous callbacks of the states (see SpagFSM::assignAsyncCallback() ), symbol \c SPAG_USE_ASYNC_CALLBACKS
+/**
+The jobs are stored in a bounded FIFO: when it is full, push() fails, and the FSM then runs the callback itself.
+Each job holds a shared pointer on its data (for the FSM: its configuration), so it stays valid until the job is done.
+Can be shared by several FSM. The destructor waits for all the pushed jobs to be done.
+*/
+class CallbackPool
+{
+	public:
+/// Type of a job: called with the object, the data and the value given to push()
+		using Job_t = void(*)( const void*, const void*, size_t );
+
+/// Constructor. \c capacity is the maximum number of jobs waiting for a thread
+		explicit CallbackPool( size_t nbThreads=1, size_t capacity=256 )
+			: _jobs( capacity ), _active( nbThreads, nullptr )
+		{
+			SPAG_P_ASSERT( nbThreads > 0 && capacity > 0, "invalid pool size" );
+			for( size_t i=0; i<nbThreads; i++ )
+				_threads.emplace_back( [this,i](){ worker( i ); } );
+		}
+		CallbackPool( const CallbackPool& ) = delete;
+		~CallbackPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock( _mutex );
+				_stopReq = true;
+			}
+			_cvJob.notify_all();
+			for( auto& t: _threads )
+				t.join();
 		}
 
-/// Assigns a timeout event on state \c st_curr, will switch to event \c st_next
+/// Adds a job, returns false (and counts it, see nbRejected() ) if the queue is full. Can be called from any thread
 /**
-Duration will be:
- - if a timeout has been \b previously assigned to \c st_curr, then its value will be retained.
- - if not, the default value and units will be used.
-See setTimerDefaultValue() and setTimerDefaultUnit()
+\c data is kept alive until the job is done, and given to \c func as its second argument.
 */
-		void assignTimeOut( ST st_curr, ST st_next )
+		bool push( Job_t func, const void* obj, size_t value, std::shared_ptr<const void> data=nullptr )
 		{
-			auto st_idx = SPAG_P_CAST2IDX( st_curr );
-			SPAG_CHECK_LESS( st_idx, nbStates() );
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st_next), nbStates() );
-			if( _stateInfo[ st_idx ]._timerEvent._enabled )         // if already one assigned,
-				_stateInfo[ st_idx ]._timerEvent._nextState = st_next;  // then just change the destination state
-			else
-				_stateInfo[ st_idx ]._timerEvent = priv::TimerEvent<ST>( st_next, _defaultTimerValue, _defaultTimerUnit );
+			{
+				std::lock_guard<std::mutex> lock( _mutex );
+				if( _nbJobs == _jobs.size() )
+				{
+					_nbRejected++;
+					return false;
+				}
+				auto& job = _jobs[ ( _first + _nbJobs ) % _jobs.size() ];
+				job._func  = func;
+				job._obj   = obj;
+				job._value = value;
+				job._data  = std::move( data );
+				_nbJobs++;
+			}
+			_cvJob.notify_one();
+			return true;
 		}
 
-/// Assigns a timeout event on state \c st_curr, will switch to event \c st_next
-/// Duration will be \c dur, with the default unit
-		void assignTimeOut( ST st_curr, Duration dur, ST st_next )
+/// Waits until all the jobs pushed so far are done
+		void wait()
 		{
-			assignTimeOut( st_curr, dur, _defaultTimerUnit, st_next );
+			std::unique_lock<std::mutex> lock( _mutex );
+			_cvIdle.wait( lock, [this](){ return _nbJobs == 0 && _nbActive == 0; } );
 		}
 
-/// Assigns a timeout event on state \c st_curr, will switch to event \c st_next. With units
-		void assignTimeOut( ST st_curr, Duration dur, DurUnit unit, ST st_next )
+/// Waits until all the jobs pushed so far for object \c obj are done (the other ones can still be pending)
+		void wait( const void* obj )
 		{
-			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st_curr), nbStates() );
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st_next), nbStates() );
-			_stateInfo[ SPAG_P_CAST2IDX( st_curr ) ]._timerEvent = priv::TimerEvent<ST>( st_next, dur, unit );
+			std::unique_lock<std::mutex> lock( _mutex );
+			_cvIdle.wait( lock, [this,obj](){ return !hasJob( obj ); } );
 		}
 
-/// Assigns a timeout event on state \c st_curr, will switch to event \c st_next. With units as strings
-		void assignTimeOut( ST st_curr, Duration dur, std::string unit, ST st_next )
+		size_t nbThreads() const
 		{
-			auto tu = priv::timeUnitFromString( unit );
-			if( !tu.first )
-				SPAG_P_THROW_ERROR_CFG( "invalid string value: " + unit );
-			assignTimeOut( st_curr, dur, tu.second, st_next );
+			return _threads.size();
 		}
-/// Removes all the timeouts
-		void clearTimeOuts()
+/// Returns the number of jobs that could not be queued (and were then run by the FSM thread)
+		size_t nbRejected() const
 		{
-			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
-			for( size_t i=0; i<nbStates(); i++ )
-				_stateInfo[ SPAG_P_CAST2IDX( i ) ]._timerEvent._enabled = false;
-		}
-/// Removes the timeout on state \c st
-		void clearTimeOut( ST st )
-		{
-			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
-			auto st_idx = SPAG_P_CAST2IDX( st );
-			SPAG_CHECK_LESS( st_idx, nbStates() );
-			if( !_stateInfo[ st_idx ]._timerEvent._enabled )
-			{
-				SPAG_P_LOG_ERROR << "warning: asking for removal of timeout on state S" << st_idx
-#ifdef SPAG_ENUM_STRINGS
-					<< " (" << _strStates[st_idx]  << ')'
-#endif
-					<< " but state has no timeout assigned.\n";
-			}
-			_stateInfo[ st_idx ]._timerEvent._enabled = false;
+			std::lock_guard<std::mutex> lock( _mutex );
+			return _nbRejected;
 		}
 
-/// Whatever state we are on, if the (external) event \c ev occurs, we switch to state \c st.
-/// (Except for state \c st, of course)
-		void assignTransition( EV ev, ST st )
+	private:
+		struct Job
 		{
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
-			for( auto& s: _transitionMat[ ev ] ) // for all columns (=states) in the line "ev"
-					s = st;
-			for( size_t i=0; i<_allowedMat[ ev ].size(); i++ )
-				if( i != SPAG_P_CAST2IDX(st) )
-					_allowedMat[ ev ][ i ] = (i == SPAG_P_CAST2IDX(st) ? 0 : 1);
+			Job_t                       _func  = nullptr;
+			const void*                 _obj   = nullptr;
+			size_t                      _value = 0;
+			std::shared_ptr<const void> _data;
+		};
+
+/// Returns true if a job of \c obj is queued or running. Mutex must be locked
+		bool hasJob( const void* obj ) const
+		{
+			for( size_t i=0; i<_nbJobs; i++ )
+				if( _jobs[ ( _first + i ) % _jobs.size() ]._obj == obj )
+					return true;
+			return std::find( _active.begin(), _active.end(), obj ) != _active.end();
 		}
 
-/// Allow all events of the transition matrix
-/// \todo change this: for internal events, the value must not be 1
-		void allowAllEvents()
+		void worker( size_t idx )
 		{
-			for( auto& line: _allowedMat )
-				for( auto& col: line )
-					col = 1;
+			std::unique_lock<std::mutex> lock( _mutex );
+			for(;;)
+			{
+				_cvJob.wait( lock, [this](){ return _nbJobs != 0 || _stopReq; } );
+				if( _nbJobs == 0 )                    // so stop is only done once the queue is empty
+					break;
+				Job job = std::move( _jobs[ _first ] );
+				_first = ( _first + 1 ) % _jobs.size();
+				_nbJobs--;
+				_nbActive++;
+				_active[ idx ] = job._obj;
+				lock.unlock();
+				job._func( job._obj, job._data.get(), job._value );
+				job._data.reset();
+				lock.lock();
+				_nbActive--;
+				_active[ idx ] = nullptr;
+				_cvIdle.notify_all();                 // wait() and wait( obj )
+			}
 		}
 
-/// Allow event \c ev when on state \c st
+		std::vector<Job>         _jobs;           ///< circular buffer
+		size_t                   _first      = 0;
+		size_t                   _nbJobs     = 0;
+		size_t                   _nbActive   = 0; ///< nb of jobs being run
+		std::vector<const void*> _active;         ///< object of the job run by each thread (null if none)
+		size_t                   _nbRejected = 0;
+		bool                     _stopReq    = false;
+		mutable std::mutex       _mutex;
+		std::condition_variable  _cvJob;
+		std::condition_variable  _cvIdle;
+		std::vector<std::thread> _threads;
+};
+#endif // SPAG_USE_ASYNC_CALLBACKS
+
+//-----------------------------------------------------------------------------------
+/// Main class, holding data for a FSM, without the event loop
 /**
-\warning This does not assign a transition, it only changes things in the allowed transitions matrix.
-Thus it is also not usable for inner transitions.
+types:
+ - ST: an enum defining the different states.
+ - EV: an enum defining the different external events.
+ - TIM: a type handling the events, must provide the following methods:
+   - init();
+   - timerStart( const SpagFSM* ); (must accept to be called while the timer is running, if setTimerReuse() is used)
+   - timerCancel();
+   - postDrain( const SpagFSM* ) (only if \c SPAG_USE_EVENT_QUEUE is defined and postEvent() is used):
+   must schedule a call to processPostedEvents() on the thread running the FSM;
+   - timerRemaining() and timerStartFor( const SpagFSM*, uint64_t ns ) (only if snapshot() and restore() are used);
+ - CBA: the callback function type (single) argument
+
+Requirements: the two enums \b MUST have the following requirements:
+ - the last element \b must be NB_STATES and NB_EVENTS, respectively
+ - the first state must have value 0
 */
-		void allowEvent( ST st, EV ev, bool what=true )
-		{
-			auto st_idx = SPAG_P_CAST2IDX(st);
-			SPAG_CHECK_LESS( st_idx, nbStates() );
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
+template<typename ST, typename EV,typename TIM,typename CBA=int>
+class SpagFSM
+{
+	using Callback_t    = std::function<void(CBA)>;
+	using RawCallback_t = priv::RawCallback<CBA>;
+#ifdef SPAG_USE_TRANSITION_ACTIONS
+	using TransitionAction_t = priv::TransitionActionFunc<ST,EV>;
+#endif
 
-#ifdef SPAG_USE_SIGNALS
-			if( _stateInfo[st_idx].holdsInnerTransition( ev, st ) )
-				throw std::runtime_error( "usage of allowEvent() not possible for inner events" );
-#endif // SPAG_USE_SIGNALS
+	public:
+		using State_t = ST;
+		using Event_t = EV;
 
-			_allowedMat[ SPAG_P_CAST2IDX(ev) ][ st_idx ] = (what?1:0);
-		}
+/// Constructor
 
-/// Assigns a callback function to a state, will be called each time we arrive on this state
-		void assignCallback( ST st, Callback_t func, CBA cb_arg=CBA() )
+		SpagFSM() : _cfg( std::make_shared<priv::FsmConfig<ST,EV,CBA>>() )
 		{
-			auto st_idx = SPAG_P_CAST2IDX(st);
-			SPAG_CHECK_LESS( st_idx, nbStates() );
-			_stateInfo[ st_idx ]._callback    = func;
-			_stateInfo[ st_idx ]._callbackArg = cb_arg;
+			static_assert( SPAG_P_CAST2IDX(ST::NB_STATES) > 1, "Error, you need to provide at least two states" );
+#if (defined SPAG_USE_HOT_RECONFIG) && (defined SPAG_USE_EVENT_QUEUE)
+			_postCfg.store( _cfg.get() );
+#endif
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+			_jitterState = priv::jitterSeed();
+#endif
+#if (defined SPAG_ENABLE_LOGGING) && (defined SPAG_ENUM_STRINGS)
+			_rtdata.setStrings( &_cfg->_strEvents, &_cfg->_strStates );
+#endif
+
+#ifdef SPAG_EMBED_ASIO_WRAPPER
+			_eventHandler = &_asioWrapper;
+#endif
 		}
 
-/// Assigns a callback function to all the states, will be called each time the state is activated
-		void assignCallback( Callback_t func )
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+/// Destructor: waits for the asynchronous callbacks of this FSM that are still pending, see assignCallbackPool()
+		~SpagFSM()
 		{
-//			static_assert( std::is_same<Callback_t,CBA>::value, "Callback function is not of same type as the one declared in FSM" );
-			for( size_t i=0; i<nbStates(); i++ )
-				_stateInfo[ SPAG_P_CAST2IDX(i) ]._callback = func;
+			if( _callbackPool )
+				_callbackPool->wait( this );
 		}
+#endif
 
-/// Assigns a callback function to all the states, with argument value being the state value/index, converted to an \c int .
+/** \name Configuration of FSM */
+///@{
+
+/// Assigns allowed event matrix
 /**
-Requires that argument type is an "integer" type (int, long int, char, ...).
-See https://en.cppreference.com/w/cpp/types/numeric_limits/is_integer
+Allowed types for \c T:
+ - \c std::vector<std::vector<A>>
+ - \c std::array<std::array<A,N1>,N2> (with N1 the number of states, N2 the number of events)
+
+Type \c A can be \c bool, \c char, \c uchar, ...
 */
-		void assignCallbackAutoval( Callback_t func )
+		template<typename T>
+		void assignEventMat( const T& mat )
 		{
-			static_assert( std::numeric_limits<CBA>::is_integer, "To use this, Callback function argument MUST be 'int'" );
-			for( size_t i=0; i<nbStates(); i++ )
+			SPAG_CHECK_EQUAL( mat.size(),    nbEvents() );
+			SPAG_CHECK_EQUAL( mat[0].size(), nbStates() );
+
+			auto li_out = std::begin( wcfg()._allowedMat );
+			for( const auto& li_in : mat )
 			{
-				_stateInfo[ i ]._callback = func;
-				_stateInfo[ i ]._callbackArg = static_cast<CBA>(i);
-				if( i > std::numeric_limits<CBA>::max() )
-					SPAG_P_THROW_ERROR_CFG( "type of callback argument too small to hold all the states" );
+				std::copy( std::begin(li_in), std::end(li_in), std::begin(*li_out) );
+				li_out++;
 			}
 		}
 
-/// Assigns a callback function called when an ignored event occurs
-		void assignIgnoredEventsCallback( std::function<void(ST,EV)> func )
-		{
-			_ignEventCallback = func;
-		}
+/// Assigns transition matrix
+/**
+Copying of elements is done because the input matrix can be a \c std::vector, or an \c std::array
 
-/// Assigns the callback function value \c cb_arg, for state \c st
-		void assignCallbackValue( ST st, CBA cb_arg )
+Allowed types for \c T:
+ - \c std::vector<std::vector<ST>>
+ - \c std::array<std::array<ST,N1>,N2> (with N1 the number of states, N2 the number of events)
+*/
+		template<typename T>
+		void assignTransitionMat( const T& mat )
 		{
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
-			_stateInfo[ SPAG_P_CAST2IDX(st) ]._callbackArg = cb_arg;
+			SPAG_CHECK_EQUAL( mat.size(),    nbEvents() );
+			SPAG_CHECK_EQUAL( mat[0].size(), nbStates() );
+			auto li_out = std::begin( wcfg()._transitionMat );
+			for( const auto& li_in : mat )
+			{
+				std::copy( std::begin(li_in), std::end(li_in), std::begin(*li_out) );
+				li_out++;
+			}
 		}
 
-#ifndef SPAG_EMBED_ASIO_WRAPPER
-		void assignEventHandler( TIM* t )
+/// Assigns an external transition event \c ev to switch from state \c st1 to state \c st2
+/**
+\note Transition to same state are allowed.
+*/
+		void assignTransition( ST st1, EV ev, ST st2 )
 		{
-			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
-			_eventHandler = t;
-		}
-#endif
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st1), nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st2), nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev),  nbEvents() );
+			auto st1_idx = SPAG_P_CAST2IDX(st1);
 
-/// Assign configuration from other FSM
-		void assignConfig( const SpagFSM& fsm )
-		{
-			SPAG_CHECK_EQUAL( nbEvents(), fsm.nbEvents() );
-			SPAG_CHECK_EQUAL( nbStates(), fsm.nbStates() );
-			_transitionMat = fsm._transitionMat;
-			_allowedMat    = fsm._allowedMat;
-			_stateInfo     = fsm._stateInfo;
+#ifdef SPAG_USE_SIGNALS
+			if( wcfg()._stateInfo[st1_idx]._isPassState )
+			{
+				std::string err_msg{ "error, attempting to assign a transition to state" };
+				err_msg += std::to_string( st1_idx );
 #ifdef SPAG_ENUM_STRINGS
-			_strEvents     = fsm._strEvents;
-			_strStates     = fsm._strStates;
+				err_msg += " (" + wcfg()._strStates[ st1_idx ] + ")";
+#endif
+				err_msg += ", was previously declared as pass-state";
+				SPAG_P_THROW_ERROR_CFG( err_msg );
+			}
 #endif
+			wcfg()._transitionMat[ SPAG_P_CAST2IDX(ev) ][ st1_idx ] = st2;
+			wcfg()._allowedMat[    SPAG_P_CAST2IDX(ev) ][ st1_idx ] = 1;
 		}
 
-#ifdef SPAG_ENUM_STRINGS
+#ifdef SPAG_USE_SIGNALS
+/// Assigns a transition to a "pass-state" (AAT): once on state \c st1, the FSM will switch right away to \c st2
+/**
+\warning If a time out has previously been assigned to state \c st1, it will be removed
 
-	private:
-/// parses the strings and returns false if one of the strings is present more than once
-#if 1
-		bool checkUnicity( const std::vector<std::string>& v_str ) const
+\warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
+*/
+		void assignAAT( ST st1, ST st2 )
 		{
+			auto st1_idx = SPAG_P_CAST2IDX(st1);
+			auto st2_idx = SPAG_P_CAST2IDX(st2);
+			SPAG_CHECK_LESS( st1_idx, nbStates() );
+			SPAG_CHECK_LESS( st2_idx, nbStates() );
+			if( st1 == st2 )
+				SPAG_P_THROW_ERROR_CFG(
+					"unable to assign an AAT to same states: S"
+					 + std::to_string( st1_idx ) + "and S" + std::to_string( st2_idx )
+				);
 
-			for( size_t i=0; i<v_str.size()-1; i++ )
-				for( size_t j=i+1; j<v_str.size(); j++ )
-					if( v_str[i] == v_str[j] )
-						return false;
-			return true;
-		}
+			wcfg()._transitionMat[ nbEvents()+1 ][st1_idx] = st2;
+			for( auto& line: wcfg()._allowedMat ) // disable other transitions for that state
+				line[ st1_idx ] = 0;
+
+			auto& stinf = wcfg()._stateInfo[st1_idx];
+			stinf._isPassState = true;
+
+			if( stinf._innerTransList.size() )
+				SPAG_P_LOG_ERROR << "warning, assign AAT transition from state "
+#ifdef SPAG_ENUM_STRINGS
+					<< st1_idx << " (" << wcfg()._strStates[st1_idx] << ") to state "
+					<< st2_idx << " (" << wcfg()._strStates[st2_idx] << ")"
 #else
-		template<typename Key>
-		bool checkUnicity( const std::map<Key,std::string>& strMap ) const
-		{
-			std::vector<Key> v_res;                        // this is the version to use if
-			for( const auto& pair1: strMap )               // we replace the container
-				for( const auto& pair2: strMap )           // for a std::map
-					if( pair1.second == pair2.second )     // (untested !)
-						v_res.push_back( pair1.first );
-			if( v_res.size() > 1 )
-				return false;
-			return true;
-		}
+					<< st1_idx << " to state " << st2_idx
 #endif
-	public:
-/// Assign a string to an enum event value (available only if option SPAG_ENUM_STRINGS is enabled)
-/// \todo Replace the assert with something more user-friendly (same with the other functions)
-		void assignString2Event( EV ev, std::string str )
-		{
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
-			_strEvents[ SPAG_P_CAST2IDX(ev) ] = str;
-			assert( checkUnicity( _strEvents ) );
+					<< " removes the "
+					<< stinf._innerTransList.size() << " inner transition(s) previously assigned to this state.\n";
+			stinf._innerTransList.clear();
+
+			auto& tev = stinf._timerEvent;
+			if( tev._enabled )
+			{
+				SPAG_P_LOG_ERROR << "warning, removal of timeout of "
+					<< tev._duration << ' ' << priv::stringFromTimeUnit( tev._durUnit )
+					<< " on state S" << std::setfill('0') << std::setw(2) << SPAG_P_CAST2IDX(st1)
+#ifdef SPAG_ENUM_STRINGS
+					<< " (" << wcfg()._strStates[st1_idx] << ')'
+#endif
+					<< ".\n";
+				tev._enabled = false;
+			}
 		}
-/// Assign a string to an enum state value (available only if option SPAG_ENUM_STRINGS is enabled)
-		void assignString2State( ST st, std::string str )
+
+/// Assigns a inner transition between \c st1 and \c st2, triggered by internal event \c ev
+/// \warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
+		void assignInnerTransition( ST st1, EV iev, ST st2 )
 		{
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
-			_strStates[ SPAG_P_CAST2IDX(st) ] = str;
-			assert( checkUnicity( _strStates ) );
+			auto st1_idx = SPAG_P_CAST2IDX(st1);
+			auto ev_idx  = SPAG_P_CAST2IDX(iev);
+			SPAG_CHECK_LESS( st1_idx,              nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st2), nbStates() );
+			SPAG_CHECK_LESS( ev_idx,               nbEvents() );
+
+			auto& stinf = wcfg()._stateInfo[ st1_idx ];
+			if( stinf._isPassState )
+				SPAG_P_THROW_ERROR_CFG( "error, removing pass-state" ); /// \todo maybe a warning instead ?
+			stinf._isPassState = false;
+			stinf._innerTransList.push_back( priv::InnerTransition<ST,EV>(iev, st2) );
+			wcfg()._innerEvents.set( ev_idx );
+			_innerEventFlag.reset( ev_idx );
+			wcfg()._transitionMat[ ev_idx ][st1_idx] = st2;
+			wcfg()._allowedMat[    ev_idx ][st1_idx] = -1;
 		}
-/// Assign strings to enum event values (available only if option SPAG_ENUM_STRINGS is enabled)
-		void assignStrings2Events( const std::vector<std::pair<EV,std::string>>& v_str )
+
+/// Whatever state we are on, when internal event \c iev occurs, we will switch to state \c st (except if we are already on that state).
+/**
+To remove afterwards the inner events on some states, use \c disableInnerTransition()
+*/
+		void assignInnerTransition( EV iev, ST st )
 		{
-			SPAG_CHECK_LESS( v_str.size(), nbEvents()+1 );
-			for( const auto& p: v_str )
-				assignString2Event( p.first, p.second );
-			assert( checkUnicity( _strEvents ) );
+			auto ev_idx = SPAG_P_CAST2IDX(iev);
+			auto st_idx = SPAG_P_CAST2IDX(st);
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			SPAG_CHECK_LESS( ev_idx, nbEvents() );
+
+			wcfg()._innerEvents.set( ev_idx );
+			_innerEventFlag.reset( ev_idx );
+
+			assert( wcfg()._stateInfo.size() == nbStates() );
+			for( size_t i=0; i<wcfg()._stateInfo.size(); ++i )
+				if( i != st_idx )
+				{
+					if( !wcfg()._stateInfo[i].holdsInnerTransition( iev, st ) )
+					{
+						wcfg()._stateInfo[i]._innerTransList.push_back( priv::InnerTransition<ST,EV>( iev, st ) );
+						wcfg()._transitionMat[ ev_idx ][i] = st;
+						wcfg()._allowedMat   [ ev_idx ][i] = -1;
+					}
+				}
 		}
-/// Assign strings to enum state values (available only if option SPAG_ENUM_STRINGS is enabled)
-		void assignStrings2States( const std::vector<std::pair<ST,std::string>>& v_str )
+
+/// Removes inner transition \c ev that is assigned on state \c st_from
+/**
+This is a companion function of \c assignInnerTransition( EV, ST )
+
+Hence, as this latter ones assigns an inner event to all the states, we need a function
+to remove this event on some states
+*/
+		void disableInnerTransition( EV ev, ST st_from )
 		{
-			SPAG_CHECK_LESS( v_str.size(), nbStates()+1 );
-			for( const auto& p: v_str )
-				assignString2State( p.first, p.second );
-			assert( checkUnicity( _strStates ) );
-		}
+			auto st_idx = SPAG_P_CAST2IDX(st_from);
+			auto& stinf = wcfg()._stateInfo[st_idx];
+
+			auto it = stinf.findInnerEvent( ev );
+			if( it == std::end( stinf._innerTransList ) )
+				SPAG_P_THROW_ERROR_CFG( "state "
+					+ std::to_string( st_idx )
+#ifdef SPAG_ENUM_STRINGS
+					+ " (" + wcfg()._strStates[st_idx] + ") "
+#endif
+					+ " has no inner transition"
+				);
+
+			stinf._innerTransList.erase( it );
+			wcfg()._allowedMat[ev][st_from] = 0;
+		}
+
+#else // SPAG_USE_SIGNALS not defined
+
+		void assignInnerTransition( ST st1, EV ev, ST st2 )
+			SPAG_NOT_AVAILABLE(SPAG_USE_SIGNALS);
+		void assignInnerTransition( EV ev, ST st )
+			SPAG_NOT_AVAILABLE(SPAG_USE_SIGNALS);
+		void disableInnerTransition( EV, ST )
+			SPAG_NOT_AVAILABLE(SPAG_USE_SIGNALS);
+		void assignAAT( ST st1, ST st2 )
+			SPAG_NOT_AVAILABLE(SPAG_USE_SIGNALS);
+
+#endif // SPAG_USE_SIGNALS
+
+/// Assigns a timeout event leading to state \c st_final, on \b all states except \c st_final,
+/// using default timer unit and default timer duration value
+		void assignGlobalTimeOut( ST st_final )
+		{
+			assignGlobalTimeOut( _defaultTimerValue, _defaultTimerUnit, st_final );
+		}
+
+/// Assigns a timeout event on \b all states except \c st_final, using duration \c dur and default timer unit.
+		void assignGlobalTimeOut( Duration dur, ST st_final )
+		{
+			assignGlobalTimeOut( dur, _defaultTimerUnit, st_final );
+		}
+
+/// Assigns a timeout event on \b all states except \c st_final, using duration \c dur and unit \c durUnit
+		void assignGlobalTimeOut( Duration dur, std::string durUnit, ST st_final )
+		{
+			auto tu = priv::timeUnitFromString( durUnit );
+			if( !tu.first )
+				SPAG_P_THROW_ERROR_CFG( "invalid string value: " + durUnit );
+			assignGlobalTimeOut( dur, tu.second, st_final );
+		}
+
+/// Assigns a timeout event on \b all states except \c st_final, using unit \c durUnit
+/**
+After this, on all the states except \c st_final, if \c duration expires, the FSM will switch to \c st_final
+(where there may or may not be a timeout assigned)
+*/
+		void assignGlobalTimeOut( Duration dur, DurUnit durUnit, ST st_final )
+		{
+			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+
+			for( size_t i=0; i<nbStates(); i++ )                                 // iterate on all the states
+				if( i != SPAG_P_CAST2IDX(st_final) )                             // and for all of them, except the designated one,
+				{
+					auto tev = wcfg()._stateInfo[ SPAG_P_CAST2IDX( i ) ]._timerEvent;   // get its "timer event" data.
+
+#ifdef SPAG_USE_SIGNALS
+					if( wcfg()._stateInfo[ SPAG_P_CAST2IDX( i ) ]._isPassState )        // if it has already been assigned an AAT, then
+					{                                                            //  issue a warning and process next one.
+						SPAG_P_LOG_ERROR << " warning: state " << i
+	#ifdef SPAG_ENUM_STRINGS
+							<< " (" << wcfg()._strStates[i] << ')'
+	#endif
+							<< " is a pass state (holds an AAT), time out not assigned.\n";
+					}
+					else
+#endif
+					{
+						if( tev._enabled )
+						{
+							SPAG_P_LOG_ERROR << " warning, removal of previously assigned timeout leading from state " << i
+	#ifdef SPAG_ENUM_STRINGS
+								<< " (" << wcfg()._strStates[i] << ')'
+	#endif
+								<< " to state " << tev._nextState
+	#ifdef SPAG_ENUM_STRINGS
+								<< " (" << wcfg()._strStates.at( SPAG_P_CAST2IDX(tev._nextState)) << ')'
+	#endif
+								<< " after " << tev._duration << ' ' << priv::stringFromTimeUnit( tev._durUnit ) << ".\n";
+						}
+						assignTimeOut( static_cast<ST>(i), dur, durUnit, st_final );
+					}
+				}
+		}
+
+/// Assigns a timeout event on state \c st_curr, will switch to event \c st_next
+/**
+Duration will be:
+ - if a timeout has been \b previously assigned to \c st_curr, then its value will be retained.
+ - if not, the default value and units will be used.
+See setTimerDefaultValue() and setTimerDefaultUnit()
+*/
+		void assignTimeOut( ST st_curr, ST st_next )
+		{
+			auto st_idx = SPAG_P_CAST2IDX( st_curr );
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st_next), nbStates() );
+			if( wcfg()._stateInfo[ st_idx ]._timerEvent._enabled )         // if already one assigned,
+				wcfg()._stateInfo[ st_idx ]._timerEvent._nextState = st_next;  // then just change the destination state
+			else
+				wcfg()._stateInfo[ st_idx ]._timerEvent = priv::TimerEvent<ST>( st_next, _defaultTimerValue, _defaultTimerUnit );
+		}
+
+/// Assigns a timeout event on state \c st_curr, will switch to event \c st_next
+/// Duration will be \c dur, with the default unit
+		void assignTimeOut( ST st_curr, Duration dur, ST st_next )
+		{
+			assignTimeOut( st_curr, dur, _defaultTimerUnit, st_next );
+		}
+
+/// Assigns a timeout event on state \c st_curr, will switch to event \c st_next. With units
+		void assignTimeOut( ST st_curr, Duration dur, DurUnit unit, ST st_next )
+		{
+			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st_curr), nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st_next), nbStates() );
+			wcfg()._stateInfo[ SPAG_P_CAST2IDX( st_curr ) ]._timerEvent = priv::TimerEvent<ST>( st_next, dur, unit );
+		}
+
+/// Assigns a timeout event on state \c st_curr, will switch to event \c st_next. With units as strings
+		void assignTimeOut( ST st_curr, Duration dur, std::string unit, ST st_next )
+		{
+			auto tu = priv::timeUnitFromString( unit );
+			if( !tu.first )
+				SPAG_P_THROW_ERROR_CFG( "invalid string value: " + unit );
+			assignTimeOut( st_curr, dur, tu.second, st_next );
+		}
+/// Removes all the timeouts
+		void clearTimeOuts()
+		{
+			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+			for( size_t i=0; i<nbStates(); i++ )
+				wcfg()._stateInfo[ SPAG_P_CAST2IDX( i ) ]._timerEvent._enabled = false;
+		}
+/// Removes the timeout on state \c st
+		void clearTimeOut( ST st )
+		{
+			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+			auto st_idx = SPAG_P_CAST2IDX( st );
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			if( !wcfg()._stateInfo[ st_idx ]._timerEvent._enabled )
+			{
+				SPAG_P_LOG_ERROR << "warning: asking for removal of timeout on state S" << st_idx
+#ifdef SPAG_ENUM_STRINGS
+					<< " (" << wcfg()._strStates[st_idx]  << ')'
+#endif
+					<< " but state has no timeout assigned.\n";
+			}
+			wcfg()._stateInfo[ st_idx ]._timerEvent._enabled = false;
+		}
+
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+/// Assigns a retry policy to the timeout of state \c st (that must already have a timeout)
+/**
+On the first \c nbRetries timeouts, the FSM re-enters state \c st (as a self transition: exit callback, callback, timer started again),
+and only the next one switches to the next state of the timeout. The number of retries done so far is given by retryCount().
+Each retry multiplies the duration by \c backoff percent (200: doubled each time),
+and each duration is randomly changed by up to +/- \c jitter percent (0 to 100).
+Any other transition, including a self transition on an event, resets the count.
+
+Example: <code>fsm.assignTimeOutPolicy( st_wait, 3, 200, 10 );</code> waits for the initial duration d, then 2d, 4d and 8d (all +/- 10%),
+calling the callback of \c st_wait each time, and then switches to the next state.
+\warning Only available when \ref SPAG_USE_TIMEOUT_POLICIES is defined
+*/
+		void assignTimeOutPolicy( ST st, uint16_t nbRetries, uint16_t backoff=100, uint16_t jitter=0 )
+		{
+			auto st_idx = SPAG_P_CAST2IDX( st );
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			SPAG_CHECK_LESS( jitter, 101 );
+			if( !_cfg->_stateInfo[ st_idx ]._timerEvent._enabled )
+				SPAG_P_THROW_ERROR_CFG( "state " + std::to_string( st_idx ) + " has no timeout" );
+			auto& pol = wcfg()._stateInfo[ st_idx ]._toPolicy;
+			pol._nbRetries = nbRetries;
+			pol._backoff   = backoff;
+			pol._jitter    = jitter;
+		}
+
+/// Returns the number of retries done on the current state, see assignTimeOutPolicy()
+		uint16_t retryCount() const
+		{
+			return _retryCount;
+		}
+
+/// Sets the seed of the random generator used for the jitter of the timeouts, see assignTimeOutPolicy()
+/// (by default, each instance gets a different seed, so that FSM started together don't retry together)
+		void seedJitter( uint32_t seed )
+		{
+			_jitterState = seed ? seed : 1;
+		}
+#endif // SPAG_USE_TIMEOUT_POLICIES
+
+/// Whatever state we are on, if the (external) event \c ev occurs, we switch to state \c st.
+/// (Except for state \c st, of course)
+		void assignTransition( EV ev, ST st )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
+			for( auto& s: wcfg()._transitionMat[ ev ] ) // for all columns (=states) in the line "ev"
+					s = st;
+			for( size_t i=0; i<wcfg()._allowedMat[ ev ].size(); i++ )
+				if( i != SPAG_P_CAST2IDX(st) )
+					wcfg()._allowedMat[ ev ][ i ] = (i == SPAG_P_CAST2IDX(st) ? 0 : 1);
+		}
+
+/// Allow all events of the transition matrix
+/// \todo change this: for internal events, the value must not be 1
+		void allowAllEvents()
+		{
+			for( auto& line: wcfg()._allowedMat )
+				for( auto& col: line )
+					col = 1;
+		}
+
+/// Allow event \c ev when on state \c st
+/**
+\warning This does not assign a transition, it only changes things in the allowed transitions matrix.
+Thus it is also not usable for inner transitions.
+*/
+		void allowEvent( ST st, EV ev, bool what=true )
+		{
+			auto st_idx = SPAG_P_CAST2IDX(st);
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
+
+#ifdef SPAG_USE_SIGNALS
+			if( wcfg()._stateInfo[st_idx].holdsInnerTransition( ev, st ) )
+				throw std::runtime_error( "usage of allowEvent() not possible for inner events" );
+#endif // SPAG_USE_SIGNALS
+
+			wcfg()._allowedMat[ SPAG_P_CAST2IDX(ev) ][ st_idx ] = (what?1:0);
+		}
+
+/// Assigns a callback function to a state, will be called each time we arrive on this state
+		void assignCallback( ST st, Callback_t func, CBA cb_arg=CBA() )
+		{
+			auto st_idx = SPAG_P_CAST2IDX(st);
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			auto& stinf = wcfg()._stateInfo[ st_idx ];
+			stinf._callback    = func;
+			stinf._rawCallback = nullptr;
+			stinf._callbackArg = cb_arg;
+		}
+
+/// Assigns a callback function to all the states, will be called each time the state is activated
+		void assignCallback( Callback_t func )
+		{
+//			static_assert( std::is_same<Callback_t,CBA>::value, "Callback function is not of same type as the one declared in FSM" );
+			for( auto& stinf: wcfg()._stateInfo )
+			{
+				stinf._callback    = func;
+				stinf._rawCallback = nullptr;
+			}
+		}
+
+/// Assigns a raw callback function to a state: \c func will be called with \c ctx as first argument, each time we arrive on this state
+/**
+Avoids the overhead of \c std::function (type erasure, possible heap allocation, indirect call through a wrapper).
+Replaces the callback assigned with the other overloads, if any.
+*/
+		void assignCallback( ST st, RawCallback_t func, void* ctx, CBA cb_arg=CBA() )
+		{
+			auto st_idx = SPAG_P_CAST2IDX(st);
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			auto& stinf = wcfg()._stateInfo[ st_idx ];
+			stinf._callback    = nullptr;
+			stinf._rawCallback = func;
+			stinf._rawContext  = ctx;
+			stinf._callbackArg = cb_arg;
+		}
+
+/// Assigns a raw callback function to all the states, see assignCallback( ST, RawCallback_t, void*, CBA )
+		void assignCallback( RawCallback_t func, void* ctx )
+		{
+			for( auto& stinf: wcfg()._stateInfo )
+			{
+				stinf._callback    = nullptr;
+				stinf._rawCallback = func;
+				stinf._rawContext  = ctx;
+			}
+		}
+
+/// Assigns member function \c M of object \c obj as callback function of state \c st, without \c std::bind (see SPAG_ASSIGN_MEMBER_CALLBACK_DIRECT() )
+		template<typename C, void (C::*M)(CBA)>
+		void assignMemberCallback( ST st, C* obj )
+		{
+			assignCallback( st, &memberCallback<C,M>, obj, _cfg->_stateInfo[ SPAG_P_CAST2IDX(st) ]._callbackArg );
+		}
+
+/// Assigns member function \c M of object \c obj as callback function of all the states (see SPAG_ASSIGN_MEMBER_CALLBACK_DIRECT_ALL() )
+		template<typename C, void (C::*M)(CBA)>
+		void assignMemberCallback( C* obj )
+		{
+			assignCallback( &memberCallback<C,M>, obj );
+		}
+
+/// Assigns a callback handler to all the states: <code>handler.onEnter( st, cb_arg )</code> will be called each time we arrive on state \c st
+/**
+The handler type \c H must provide a member function <code>void onEnter( ST, CBA )</code>.
+No \c std::function is involved: each state gets a raw callback that directly calls that member function, with the state as a constant.
+*/
+		template<typename H>
+		void assignCallbackHandler( H& handler )
+		{
+			assignCallbackHandler( handler, typename priv::MakeIndexSeq<SPAG_P_CAST2IDX(ST::NB_STATES)>::type() );
+		}
+
+/// Assigns a callback function to all the states, with argument value being the state value/index, converted to an \c int .
+/**
+Requires that argument type is an "integer" type (int, long int, char, ...).
+See https://en.cppreference.com/w/cpp/types/numeric_limits/is_integer
+*/
+		void assignCallbackAutoval( Callback_t func )
+		{
+			static_assert( std::numeric_limits<CBA>::is_integer, "To use this, Callback function argument MUST be 'int'" );
+			for( size_t i=0; i<nbStates(); i++ )
+			{
+				wcfg()._stateInfo[ i ]._callback = func;
+				wcfg()._stateInfo[ i ]._rawCallback = nullptr;
+				wcfg()._stateInfo[ i ]._callbackArg = static_cast<CBA>(i);
+				if( i > std::numeric_limits<CBA>::max() )
+					SPAG_P_THROW_ERROR_CFG( "type of callback argument too small to hold all the states" );
+			}
+		}
+
+/// Assigns a callback function called when an ignored event occurs
+		void assignIgnoredEventsCallback( std::function<void(ST,EV)> func )
+		{
+			wcfg()._ignEventCallback = func;
+		}
+
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+/// Assigns the pool of threads running the asynchronous callbacks of this FSM, see assignAsyncCallback()
+/**
+The pool must outlive the FSM: stop() and the destructor of the FSM wait for its pending callbacks to be done.
+\warning Only available when \ref SPAG_USE_ASYNC_CALLBACKS is defined
+*/
+		void assignCallbackPool( CallbackPool& pool )
+		{
+			_callbackPool = &pool;
+		}
+
+/// Makes the callback of state \c st asynchronous: it will be run by the callback pool, and then event \c ev_done will be posted to the FSM
+/**
+The FSM does not wait for the callback: the call to processEvent() (or processTimeOut(), ...) returns right after having pushed it to the pool.
+Once the callback has returned, \c ev_done is posted with postEvent(), so it gets processed on the thread running the FSM,
+on whatever state the FSM is then (use \c QueueDropIfIgnored if needed, see assignQueueFlags() ).
+Give \c NB_EVENTS as \c ev_done to post nothing. \c ev_done must not be an inner event.
+
+The callback is run on another thread, so it must not call the FSM, other than with postEvent().
+If no pool has been assigned, or if its queue is full, the callback is run as usual, by the FSM thread.
+It should not be assigned to a pass state, the AAT would be done without waiting for the callback.
+\warning Only available when \ref SPAG_USE_ASYNC_CALLBACKS is defined
+*/
+		void assignAsyncCallback( ST st, EV ev_done )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev_done), nbEvents()+1 );
+			auto& stinf = wcfg()._stateInfo[ SPAG_P_CAST2IDX(st) ];
+			stinf._isAsync        = true;
+			stinf._asyncDoneEvent = SPAG_P_CAST2IDX(ev_done);
+		}
+
+/// Makes the callback of state \c st synchronous again (default), see assignAsyncCallback()
+		void clearAsyncCallback( ST st )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
+			auto& stinf = wcfg()._stateInfo[ SPAG_P_CAST2IDX(st) ];
+			stinf._isAsync        = false;
+			stinf._asyncDoneEvent = nbEvents();
+		}
+#endif // SPAG_USE_ASYNC_CALLBACKS
+
+#ifdef SPAG_USE_TRANSITION_ACTIONS
+/// Assigns an exit callback function to a state: called each time the FSM leaves this state, with the callback value of that state
+/**
+Called before the transition action (if any) and before the callback of the next state, while currentState() is still \c st.
+Also called on a self transition (the state is left and entered again).
+\warning Only available when \ref SPAG_USE_TRANSITION_ACTIONS is defined
+*/
+		void assignExitCallback( ST st, Callback_t func )
+		{
+			auto st_idx = SPAG_P_CAST2IDX(st);
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			auto& stinf = wcfg()._stateInfo[ st_idx ];
+			stinf._exitCallback    = func;
+			stinf._exitRawCallback = nullptr;
+		}
+
+/// Assigns a raw exit callback function to a state: \c func will be called with \c ctx as first argument, see assignExitCallback( ST, Callback_t )
+		void assignExitCallback( ST st, RawCallback_t func, void* ctx )
+		{
+			auto st_idx = SPAG_P_CAST2IDX(st);
+			SPAG_CHECK_LESS( st_idx, nbStates() );
+			auto& stinf = wcfg()._stateInfo[ st_idx ];
+			stinf._exitCallback    = nullptr;
+			stinf._exitRawCallback = func;
+			stinf._exitContext     = ctx;
+		}
+
+/// Assigns member function \c M of object \c obj as exit callback function of state \c st
+		template<typename C, void (C::*M)(CBA)>
+		void assignMemberExitCallback( ST st, C* obj )
+		{
+			assignExitCallback( st, &memberCallback<C,M>, obj );
+		}
+
+/// Assigns an action to the transition from state \c st on event \c ev: <code>func( ctx, st, ev )</code> will be called each time that transition is done
+/**
+The action is called after the exit callback of \c st and before the callback of the next state.
+It is stored with the same index as the transition, so it is fetched right after it, with no search.
+Can be assigned for an inner event, but not for an AAT. Passing a null \c func removes the action.
+\warning Only available when \ref SPAG_USE_TRANSITION_ACTIONS is defined
+*/
+		void assignTransitionAction( ST st, EV ev, TransitionAction_t func, void* ctx=nullptr )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
+			auto& act = wcfg()._actionMat[ SPAG_P_CAST2IDX(ev) * nbStates() + SPAG_P_CAST2IDX(st) ];
+			act._func    = func;
+			act._context = ctx;
+		}
+
+/// Assigns an action to the timeout of state \c st, see assignTransitionAction(). The event given to \c func is then \c NB_EVENTS
+		void assignTimeOutAction( ST st, TransitionAction_t func, void* ctx=nullptr )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
+			auto& act = wcfg()._actionMat[ nbEvents() * nbStates() + SPAG_P_CAST2IDX(st) ];
+			act._func    = func;
+			act._context = ctx;
+		}
+#endif // SPAG_USE_TRANSITION_ACTIONS
+
+/// Assigns the callback function value \c cb_arg, for state \c st
+		void assignCallbackValue( ST st, CBA cb_arg )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
+			wcfg()._stateInfo[ SPAG_P_CAST2IDX(st) ]._callbackArg = cb_arg;
+		}
+
+#ifndef SPAG_EMBED_ASIO_WRAPPER
+		void assignEventHandler( TIM* t )
+		{
+			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+			_eventHandler = t;
+		}
+#endif
+
+/// Assign configuration from other FSM
+/**
+No copy is done: both FSM will share the same configuration object, each of them only holds its own run-time data
+(current state, event handler, counters, ...).
+If a configuration function is called afterwards on one of them, it will first get its own copy of the configuration,
+so the other ones is not affected.
+
+\warning Sharing configurations is not thread-safe: it must be done before starting the FSMs.
+*/
+		void assignConfig( const SpagFSM& fsm )
+		{
+			fsm.prepareCfg();
+			setCfg( fsm._cfg );
+#if (defined SPAG_ENABLE_LOGGING) && (defined SPAG_ENUM_STRINGS)
+			_rtdata.setStrings( &_cfg->_strEvents, &_cfg->_strStates );
+#endif
+		}
+
+/// Returns true if the configuration is shared with at least another FSM (see assignConfig() )
+		bool hasSharedConfig() const
+		{
+			return _cfg.use_count() > 1;
+		}
+
+#ifdef SPAG_USE_HOT_RECONFIG
+/// Publishes the configuration of FSM \c src, that this FSM will use from the next event on, without stopping. Can be called from any thread
+/**
+The configuration is checked and built here, by the calling thread (an error is thrown if it is invalid, and nothing is published).
+It is then shared with \c src (see assignConfig() ), and handed over with an atomic pointer swap:
+the thread running the FSM switches to it when it processes the next event (or timeout, or call to start() ),
+the check done by the dispatch path being a single atomic load.
+If several configurations are published before that, only the last one is used.
+
+On the switch, the current state and the run-time data are kept. The running timer (if any) is kept too,
+unless the current state has no timeout in the new configuration, in which case it is canceled
+(and if it has one whereas it had none before, it is started). A changed timeout duration applies from the next entry in the state.
+
+The pending asynchronous callbacks (see assignAsyncCallback() ) keep using the configuration they were pushed with.
+
+\warning \c src must not be changed by another thread while this function runs.
+The assign*() functions of this FSM are still not thread-safe: only this function is.
+Only available when \ref SPAG_USE_HOT_RECONFIG is defined
+*/
+		void publishConfig( const SpagFSM& src ) const
+		{
+			src.prepareCfg();
+			std::atomic_store( &_nextCfg, src._cfg );
+			_cfgPending.store( true, std::memory_order_release );
+		}
+
+/// Returns the number of times the FSM has switched to a published configuration, see publishConfig()
+		size_t nbConfigSwaps() const
+		{
+			return _nbConfigSwaps;
+		}
+#endif // SPAG_USE_HOT_RECONFIG
+
+#ifdef SPAG_ENUM_STRINGS
+
+	private:
+/// Returns false if string \c str is already used in \c v_str, at another position than \c pos (linear time)
+		static bool isUnique( const std::vector<std::string>& v_str, size_t pos, const std::string& str )
+		{
+			for( size_t i=0; i<v_str.size(); i++ )
+				if( i != pos && v_str[i] == str )
+					return false;
+			return true;
+		}
+	public:
+/// Assign a string to an enum event value (available only if option SPAG_ENUM_STRINGS is enabled)
+/// \todo Replace the assert with something more user-friendly (same with the other functions)
+		void assignString2Event( EV ev, std::string str )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
+			assert( isUnique( _cfg->_strEvents, SPAG_P_CAST2IDX(ev), str ) );
+			wcfg()._strEvents[ SPAG_P_CAST2IDX(ev) ] = str;
+		}
+/// Assign a string to an enum state value (available only if option SPAG_ENUM_STRINGS is enabled)
+		void assignString2State( ST st, std::string str )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), nbStates() );
+			assert( isUnique( _cfg->_strStates, SPAG_P_CAST2IDX(st), str ) );
+			wcfg()._strStates[ SPAG_P_CAST2IDX(st) ] = str;
+		}
+/// Assign strings to enum event values (available only if option SPAG_ENUM_STRINGS is enabled)
+		void assignStrings2Events( const std::vector<std::pair<EV,std::string>>& v_str )
+		{
+			SPAG_CHECK_LESS( v_str.size(), nbEvents()+1 );
+			auto& cfg = wcfg();
+			for( const auto& p: v_str )
+			{
+				SPAG_CHECK_LESS( SPAG_P_CAST2IDX(p.first), nbEvents() );
+				cfg._strEvents[ SPAG_P_CAST2IDX(p.first) ] = p.second;
+			}
+			assert( priv::checkUnicity( _cfg->_strEvents ) );
+		}
+/// Assign strings to enum state values (available only if option SPAG_ENUM_STRINGS is enabled)
+		void assignStrings2States( const std::vector<std::pair<ST,std::string>>& v_str )
+		{
+			SPAG_CHECK_LESS( v_str.size(), nbStates()+1 );
+			auto& cfg = wcfg();
+			for( const auto& p: v_str )
+			{
+				SPAG_CHECK_LESS( SPAG_P_CAST2IDX(p.first), nbStates() );
+				cfg._strStates[ SPAG_P_CAST2IDX(p.first) ] = p.second;
+			}
+			assert( priv::checkUnicity( _cfg->_strStates ) );
+		}
 /// Assign strings to enum event values (available only if option SPAG_ENUM_STRINGS is enabled) - overload 1
 		void assignStrings2Events( std::map<EV,std::string>& m_str )
 		{
-			for( const auto& p: m_str )
-				assignString2Event( p.first, p.second );
-			assert( checkUnicity( _strEvents ) );
+			auto& cfg = wcfg();
+			for( const auto& p: m_str )
+			{
+				SPAG_CHECK_LESS( SPAG_P_CAST2IDX(p.first), nbEvents() );
+				cfg._strEvents[ SPAG_P_CAST2IDX(p.first) ] = p.second;
+			}
+			assert( priv::checkUnicity( _cfg->_strEvents ) );
+		}
+/// Assign strings to enum state values (available only if option SPAG_ENUM_STRINGS is enabled) - overload 1
+		void assignStrings2States( std::map<ST,std::string>& m_str )
+		{
+			auto& cfg = wcfg();
+			for( const auto& p: m_str )
+			{
+				SPAG_CHECK_LESS( SPAG_P_CAST2IDX(p.first), nbStates() );
+				cfg._strStates[ SPAG_P_CAST2IDX(p.first) ] = p.second;
+			}
+			assert( priv::checkUnicity( _cfg->_strStates ) );
+		}
+/// Assigns to callback functions an argument value that is the state name (requires that callback argument is a string)
+		void assignCBValuesStrings()
+		{
+			static_assert( std::is_same<CBA,std::string>::value, "Error, unable to assign strings to callback values, callback type is not std::string\n" );
+			for( size_t i=0; i<nbStates(); i++ )
+				assignCallbackValue( static_cast<ST>(i), wcfg()._strStates[i] );
+		}
+/// Returns the string label associated with event \c ev
+		std::string getString( EV ev ) const
+		{
+			return _cfg->_strEvents[ev];
+		}
+/// Returns the string label associated with state \c st
+		std::string getString( ST st ) const
+		{
+			return _cfg->_strStates[st];
+		}
+#else
+		void assignString2Event( EV, std::string ) {}
+		void assignString2State( ST, std::string ) {}
+		void assignStrings2Events( const std::vector<std::pair<EV,std::string>>& ) {}
+		void assignStrings2States( const std::vector<std::pair<ST,std::string>>& ) {}
+		void assignStrings2Events( const std::map<EV,std::string>& ) {}
+		void assignStrings2States( const std::map<ST,std::string>& ) {}
+		void assignCBValuesStrings() const {}
+		std::string getString( EV ev ) const { return std::to_string( SPAG_P_CAST2IDX(ev) ); }
+		std::string getString( ST st ) const { return std::to_string( SPAG_P_CAST2IDX(st) ); }
+#endif
+
+///@}
+
+/** \name Run time functions */
+///@{
+/// start FSM : run callback associated to initial state (if any), an run timer (if any)
+/**
+The configuration is checked and built first, only once even if it is shared by FSMs started by several threads (see prepareCfg() )
+*/
+		void start()
+		{
+			SPAG_P_ASSERT( !_isRunning, "attempt to start an already running FSM" );
+			SPAG_LOG << "start FSM\n";
+#ifdef SPAG_USE_HOT_RECONFIG
+			if( _cfgPending.load( std::memory_order_acquire ) )
+				applyPendingConfig();
+#endif
+			prepareCfg();                    // done only once for a given configuration, even if shared
+			_isRunning = true;
+#ifdef SPAG_ENABLE_HISTOGRAMS
+			_latency._hasEntry = false;
+#endif
+			runAction();
+
+#ifndef SPAG_EXTERNAL_EVENT_LOOP
+			if( !std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value )
+			{
+				SPAG_P_ASSERT( _eventHandler, "Event handler has not been allocated" );
+				_eventHandler->init( this );   // blocking function !
+			}
+#endif
+		}
+
+/// stop FSM : needed only if timer is used, this will cancel (and kill) the pending timer (and discard the posted events not processed yet)
+		void stop() const
+		{
+			SPAG_P_ASSERT( _isRunning, "attempt to stop an already stopped FSM" );
+
+			if( _eventHandler )
+			{
+				SPAG_LOG << "call timerCancel()\n";
+				SPAG_P_TRACEPOINT( TimerCancel, this, SPAG_P_CAST2IDX(_current), 0, 0 );
+				_eventHandler->timerCancel();
+				SPAG_LOG << "call event loop kill()\n";
+				_eventHandler->kill();
+			}
+			_isRunning = false;
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+			if( _callbackPool )
+				_callbackPool->wait( this );    // pending callbacks may still post their completion event
+#endif
+#ifdef SPAG_USE_EVENT_QUEUE
+			discardPostedEvents();              // including the completion events of the asynchronous callbacks
+#endif
+#ifdef SPAG_USE_COROUTINES
+			resumeWaiter();
+#endif
+		}
+
+#ifdef SPAG_USE_COROUTINES
+/// Awaitable returned by nextTransition()
+		struct TransitionAwaiter
+		{
+			const SpagFSM* _fsm;
+
+			bool await_ready() const noexcept { return !_fsm->_isRunning; }
+			void await_suspend( std::coroutine_handle<> h ) const
+			{
+				SPAG_P_ASSERT( !_fsm->_waiter, "a coroutine is already waiting on this FSM" );
+				_fsm->_waiter = h;
+			}
+			ST await_resume() const noexcept { return _fsm->_current; }
+		};
+/// For coroutines: <code>auto st = co_await fsm.nextTransition();</code> suspends until the FSM switches to another state,
+/// and returns that state (needs \c SPAG_USE_COROUTINES)
+/**
+The coroutine is resumed once the callback of the new state has returned (and the pass-states and inner events have been processed),
+on the thread that did the transition. It is also resumed when the FSM is stopped, so it can check isRunning().
+Only one coroutine can wait on a given FSM.
+*/
+		TransitionAwaiter nextTransition() const
+		{
+			return TransitionAwaiter{ this };
+		}
+#endif
+
+/// User-code timer end function/callback should call this when the timer expires
+		void processTimeOut() const
+		{
+			SPAG_P_START;
+#ifdef SPAG_USE_HOT_RECONFIG
+			if( _cfgPending.load( std::memory_order_acquire ) && applyPendingConfig() )
+				if( !_cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ]._timerEvent._enabled )
+				{
+					SPAG_P_END;
+					return;                  // timer was started with the previous configuration
+				}
+#endif
+			const auto& tev = _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ]._timerEvent;
+			SPAG_LOG << "processing timeout event, delay was " << tev._duration << "\n";
+			assert( tev._enabled ); // or else, the timer shouldn't have been started, and thus we shouldn't be here...
+#ifdef SPAG_ENABLE_TRACE
+			if( _trace && _traceDepth == 0 )
+				_trace->write( priv::TraceKind::TimeOut, 0 );
+			priv::TraceScope traceScope( _traceDepth );
+#endif
+#ifdef SPAG_ENABLE_HISTOGRAMS
+			_latency._timeOutLateness.record( _latency.toNs( priv::LatencyData<ST>::Clock::now() - _latency._timerExpected ) );
+#endif
+			auto next = tev._nextState;
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+			if( _retryCount < _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ]._toPolicy._nbRetries )
+			{
+				_retryCount++;
+				_isRetry = true;             // so runAction() does not reset the count
+				next = _current;
+				SPAG_LOG << "retry " << _retryCount << '\n';
+			}
+#endif
+			SPAG_P_TRACEPOINT( TimeOut, this, SPAG_P_CAST2IDX(_current), SPAG_P_CAST2IDX(next), 0 );
+			leaveState( nbEvents() );
+			_previous = _current;
+			_current = next;
+#ifdef SPAG_ENABLE_LOGGING
+			_rtdata.logTransition( _current, nbEvents() );
+#endif
+			SPAG_P_TRACEPOINT( Transition, this, SPAG_P_CAST2IDX(_previous), nbEvents(), SPAG_P_CAST2IDX(_current) );
+			runAction();
+			SPAG_P_END;
+		}
+
+/// User-code should call this function when an external event occurs
+		void processEvent( EV ev ) const
+		{
+			SPAG_P_START;
+
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
+			SPAG_P_ASSERT( _isRunning, "attempting to process an event but FSM is not started" );
+#ifdef SPAG_USE_HOT_RECONFIG
+			if( _cfgPending.load( std::memory_order_acquire ) )
+				applyPendingConfig();
+#endif
+
+			auto ev_idx = SPAG_P_CAST2IDX( ev );
+			if( isInnerEvent(ev) )
+				throwEventError( priv::RE_InnerEvent, "processEvent", ev_idx );
+
+#ifdef SPAG_ENUM_STRINGS
+			SPAG_LOG << "processing event " << ev_idx << ": \"" << _cfg->_strEvents[ev_idx] << "\"\n";
+#else
+			SPAG_LOG << "processing event " << ev_idx << '\n';
+#endif
+#ifdef SPAG_ENABLE_TRACE
+			if( _trace && _traceDepth == 0 )
+				_trace->write( priv::TraceKind::Event, ev_idx );
+			priv::TraceScope traceScope( _traceDepth );
+#endif
+			ST next;
+			if( getTransition( ev_idx, SPAG_P_CAST2IDX(_current), next ) )
+			{
+				if( _cfg->_stateInfo[ SPAG_P_CAST2IDX( _current ) ]._timerEvent._enabled )  // 1 - cancel the waiting timer, if any
+					stopTimer( next );
+				leaveState( ev_idx );
+				_previous = _current;
+				_current = next;                                                      // 2 - switch to next state
+#ifdef SPAG_ENABLE_LOGGING
+				_rtdata.logTransition( _current, ev_idx );
+#endif
+				SPAG_P_TRACEPOINT( Transition, this, SPAG_P_CAST2IDX(_previous), ev_idx, SPAG_P_CAST2IDX(_current) );
+				runAction();                                                          // 3 - call the callback function
+			}
+			else
+			{
+				SPAG_LOG << "event is ignored on current state\n";
+				if( _cfg->_ignEventCallback )
+					_cfg->_ignEventCallback( _current, ev );
+
+#ifdef SPAG_ENABLE_LOGGING
+				_rtdata.logIgnoredEvent( ev_idx );
+#endif
+				SPAG_P_TRACEPOINT( IgnoredEvent, this, SPAG_P_CAST2IDX(_current), ev_idx, 0 );
+			}
+			SPAG_P_END;
+		}
+
+/// Processes a range of events, in order. Returns the number of processed events
+/**
+Same behavior as calling processEvent() on each element of the range, but faster:
+the whole range is checked once before anything is processed (if one of the events is invalid or an inner event, none of them is processed),
+and the per-event work is reduced to the transition itself.
+
+Stops if the FSM gets stopped by one of the callbacks, the remaining events are then not processed.
+
+The range is read twice, so \c IT must be (at least) a forward iterator: single-pass iterators (\c std::istream_iterator, ...) are rejected at build time.
+*/
+		template<typename IT>
+		size_t processEvents( IT first, IT last ) const
+		{
+			static_assert(
+				std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<IT>::iterator_category>::value,
+				"processEvents() needs a forward iterator, the range is read twice"
+			);
+			SPAG_P_START;
+			SPAG_P_ASSERT( _isRunning, "attempting to process events but FSM is not started" );
+#ifdef SPAG_USE_HOT_RECONFIG
+			if( _cfgPending.load( std::memory_order_acquire ) )   // checked once for the whole range
+				applyPendingConfig();
+#endif
+
+			for( auto it = first; it != last; ++it )      // step 1: check the whole range
+			{
+				auto ev_idx = SPAG_P_CAST2IDX( *it );
+				SPAG_CHECK_LESS( ev_idx, nbEvents() );
+				if( _cfg->_innerEvents.test( ev_idx ) )
+					throwEventError( priv::RE_InnerEvent, "processEvents", ev_idx );
+			}
+
+			size_t nb = 0;                                // step 2: process
+#ifdef SPAG_ENABLE_TRACE
+			const bool doTrace = _traceDepth == 0;        // not if called from a callback
+			priv::TraceScope traceScope( _traceDepth );
+#endif
+			for( ; first != last && _isRunning; ++first, ++nb )
+			{
+				const EV ev = *first;
+				const auto ev_idx = SPAG_P_CAST2IDX( ev );
+				const auto st_idx = SPAG_P_CAST2IDX( _current );
+#ifdef SPAG_ENABLE_TRACE
+				if( _trace && doTrace )
+					_trace->write( priv::TraceKind::Event, ev_idx );
+#endif
+				ST next;
+				if( getTransition( ev_idx, st_idx, next ) )
+				{
+					if( _cfg->_stateInfo[ st_idx ]._timerEvent._enabled )
+						stopTimer( next );
+					leaveState( ev_idx );
+					_previous = _current;
+					_current = next;
+#ifdef SPAG_ENABLE_LOGGING
+					_rtdata.logTransition( _current, ev_idx );
+#endif
+					SPAG_P_TRACEPOINT( Transition, this, st_idx, ev_idx, SPAG_P_CAST2IDX(_current) );
+					runAction();
+				}
+				else
+				{
+					if( _cfg->_ignEventCallback )
+						_cfg->_ignEventCallback( _current, ev );
+#ifdef SPAG_ENABLE_LOGGING
+					_rtdata.logIgnoredEvent( ev_idx );
+#endif
+					SPAG_P_TRACEPOINT( IgnoredEvent, this, st_idx, ev_idx, 0 );
+				}
+			}
+			SPAG_P_END;
+			return nb;
+		}
+
+/// Processes all the events held in container \c cont, see processEvents( IT, IT )
+		template<typename CONT>
+		size_t processEvents( const CONT& cont ) const
+		{
+			return processEvents( std::begin(cont), std::end(cont) );
+		}
+
+#ifdef SPAG_USE_EVENT_QUEUE
+/// Thread-safe version of processEvent(): the event is queued, and will be processed later, on the thread running the FSM
+/**
+Can be called concurrently from any thread, never blocks.
+Returns false if the queue is full (see symbol \c SPAG_EVENT_QUEUE_SIZE), in which case the event is not queued.
+
+If an event handler has been assigned, it is requested to schedule a call to processPostedEvents() (only once for a burst of events).
+If not (for example with a FSM declared with \c SPAG_DECLARE_FSM_TYPE_NOTIMER), the user code must call that function itself.
+
+The events that are still in the queue when the FSM is stopped are discarded by stop().
+*/
+		bool postEvent( EV ev ) const
+		{
+			auto ev_idx = SPAG_P_CAST2IDX( ev );
+			SPAG_CHECK_LESS( ev_idx, nbEvents() );
+#ifdef SPAG_USE_HOT_RECONFIG
+			_nbPosting.fetch_add( 1 );                 // the configuration read here can't be freed, see setCfg()
+			auto flags = postFlags( *_postCfg.load(), ev_idx );
+			_nbPosting.fetch_sub( 1, std::memory_order_release );
+#else
+			auto flags = postFlags( *_cfg, ev_idx );
+#endif
+			return queueEvent( ev, flags.first, flags.second );
+		}
+
+	private:
+/// Returns the queueing flags of event \c ev_idx in configuration \c cfg, and true if it must be dropped because ignored (see postEvent() )
+		std::pair<uint8_t,bool> postFlags( const priv::FsmConfig<ST,EV,CBA>& cfg, size_t ev_idx ) const
+		{
+			auto flags = cfg._queueFlags[ ev_idx ];
+			bool ignored = ( flags & QueueDropIfIgnored )
+				&& cfg._allowedMat[ ev_idx ][ _postedState.load( std::memory_order_relaxed ) ] != 1;
+			return std::make_pair( flags, ignored );
+		}
+/// Queues event \c ev according to its \c flags, see postEvent()
+		bool queueEvent( EV ev, uint8_t flags, bool ignored ) const
+		{
+			auto ev_idx = SPAG_P_CAST2IDX( ev );
+			if( flags != QueueDefault )
+			{
+				if( ignored )
+				{
+					_nbCoalesced.fetch_add( 1, std::memory_order_relaxed );
+					return true;
+				}
+				if( ( flags & QueueCoalesce ) && _pendingEvent[ ev_idx ].exchange( true ) )
+				{
+					_nbCoalesced.fetch_add( 1, std::memory_order_relaxed );
+					return true;
+				}
+			}
+			if( !( flags & QueueHighPriority ? _eventQueueHigh.push( ev ) : _eventQueue.push( ev ) ) )
+			{
+				if( flags & QueueCoalesce )
+					_pendingEvent[ ev_idx ].store( false );
+				return false;
+			}
+			if( !_drainPending.exchange( true ) )
+				if( _eventHandler )
+					_eventHandler->postDrain( this );
+			return true;
+		}
+
+	public:
+/// Processes all the events that have been posted with postEvent(), in order. Returns the number of processed events
+/**
+Must be called on the thread running the FSM (i.e. not concurrently with processEvent() or another call to this function).
+The high priority lane (see QueueHighPriority) is checked before each event of the normal lane,
+so a high priority event never waits for more than one normal event.
+Stops if the FSM gets stopped by one of the callbacks, the remaining events are then discarded by stop().
+*/
+		size_t processPostedEvents() const
+		{
+			_drainPending.exchange( false );
+#ifdef SPAG_USE_HOT_RECONFIG
+			releaseRetiredCfg();
+#endif
+			size_t nb = 0;
+			EV ev;
+			while( _isRunning && ( _eventQueueHigh.pop( ev ) || _eventQueue.pop( ev ) ) )
+			{
+				auto ev_idx = SPAG_P_CAST2IDX( ev );
+				if( _cfg->_queueFlags[ ev_idx ] & QueueCoalesce )   // from now on, a new one will be queued
+					_pendingEvent[ ev_idx ].store( false );
+				processEvent( ev );
+				nb++;
+			}
+			return nb;
+		}
+
+/// Assigns the queueing flags of event \c ev, used by postEvent() (see QueueFlag). Default is \c QueueDefault
+/**
+Example: <code>fsm.assignQueueFlags( ev_warning, QueueCoalesce | QueueDropIfIgnored );</code>
+
+With \c QueueDropIfIgnored, the test is done on the state the FSM is in when the event is posted
+(the events still in the queue may change it before this one gets processed).
+The events that are not queued because of these flags are counted, see nbCoalescedEvents(), and postEvent() returns true for them.
+*/
+		void assignQueueFlags( EV ev, uint8_t flags )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
+			wcfg()._queueFlags[ SPAG_P_CAST2IDX(ev) ] = flags;
+		}
+
+/// Returns the number of posted events that were not queued, because of their flags (see assignQueueFlags() ). Can be called from any thread
+		size_t nbCoalescedEvents() const
+		{
+			return _nbCoalesced.load( std::memory_order_relaxed );
+		}
+#endif // SPAG_USE_EVENT_QUEUE
+
+#ifdef SPAG_USE_SIGNALS
+/// Activate inner event: set the inner event to true, so that the inner transition will be processed
+/// when we are on a state that has the event enabled as inner transition
+/// (and once callback has been completed).
+/**
+\warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
+\todo implement "early quit" (as soon as found)
+\todo check if one of the states on which we activate the event is the current one. If so,
+then we need to process the transition right away! (instead of waiting)
+*/
+		void activateInnerEvent( EV ev )
+		{
+			SPAG_P_START;
+
+			if( !isInnerEvent( ev ) )
+				throwEventError( priv::RE_NotInnerEvent, "activateInnerEvent", SPAG_P_CAST2IDX(ev) );
+
+			_innerEventFlag.set( SPAG_P_CAST2IDX(ev) );
+#ifdef SPAG_ENABLE_TRACE
+			if( _trace && _traceDepth == 0 )
+				_trace->write( priv::TraceKind::InnerEvent, SPAG_P_CAST2IDX(ev) );
+			priv::TraceScope traceScope( _traceDepth );
+#endif
+			SPAG_P_TRACEPOINT( InnerEvent, this, SPAG_P_CAST2IDX(_current), SPAG_P_CAST2IDX(ev), 0 );
+			SPAG_LOG << "activating event " << SPAG_P_CAST2IDX(ev)
+#ifdef SPAG_ENUM_STRINGS
+				<< " (" << _cfg->_strEvents[ SPAG_P_CAST2IDX(ev) ] << ')'
+#endif
+				<< " current state is " << (int)currentState()
+#ifdef SPAG_ENUM_STRINGS
+				<< " (" << _cfg->_strStates[ currentState() ] << ')'
+#endif
+				<< '\n';
+
+			SPAG_P_END;
+		}
+
+/// Deactivate an inner event. Will issue a warning if the event is presently not active
+		void clearInternalEvent( EV ev )
+		{
+			if( !isInnerEvent( ev ) )
+				throw std::runtime_error(
+					"request to clear inner event "
+					+ std::to_string( SPAG_P_CAST2IDX(ev) )
+#ifdef SPAG_ENUM_STRINGS
+					+ " (" + _cfg->_strEvents[ SPAG_P_CAST2IDX(ev) ] + ")"
+#endif
+					+ ", but not found in list of Internal Events"
+				);
+
+			if( !_innerEventFlag.test( SPAG_P_CAST2IDX(ev) ) )
+				SPAG_P_LOG_ERROR << "warning, request to clear inner event idx=" << SPAG_P_CAST2IDX(ev)
+#ifdef SPAG_ENUM_STRINGS
+					<< " (" + _cfg->_strEvents[ SPAG_P_CAST2IDX(ev) ] + ")"
+#endif
+					<< ", but event was not active.\n";
+
+			_innerEventFlag.reset( SPAG_P_CAST2IDX(ev) );
+			SPAG_LOG << "deactivating event " << SPAG_P_CAST2IDX(ev)
+#ifdef SPAG_ENUM_STRINGS
+				<< " (" << _cfg->_strEvents[ SPAG_P_CAST2IDX(ev) ] << ')'
+#endif
+				<< " current state is " << (int)currentState()
+#ifdef SPAG_ENUM_STRINGS
+				<< " (" << _cfg->_strStates[ currentState() ] << ')'
+#endif
+				<< ".\n";
+		}
+
+/// Processes the inner transition (AAT or activated inner event) of the current state.
+/// <strong>DO NOT CALL in user code</strong>.
+/**
+This function is called ONLY by runAction(), once the callback of the state has returned.
+\warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
+*/
+		void processInnerEvent( const priv::StateInfo<ST,EV,CBA>& stinf ) const
+		{
+			SPAG_P_START;
+
+			SPAG_P_ASSERT( _isRunning, "attempting to process an inner event but FSM is not started" );
+#if defined (SPAG_ENABLE_LOGGING) || defined (SPAG_ENABLE_TRACEPOINTS)
+			size_t ev_idx = nbEvents() + 1;
+#endif
+			if( stinf._isPassState )
+			{
+				auto next = _cfg->_transitionMat[ nbEvents()+1 ][_current];
+				SPAG_LOG << "is pass state, switch from state " << (int)currentState() << " to state " << (int)next << '\n';
+				leaveState( nbEvents()+1 );
+				_previous = _current;
+				_current  = next;
+			}
+			else
+			{
+				for( const auto& innerTrans: stinf._innerTransList )
+				{
+					auto iev_idx = SPAG_P_CAST2IDX( innerTrans._innerEvent );
+					if( _innerEventFlag.test( iev_idx ) )   // check if given event assigned has been activated
+					{
+						leaveState( iev_idx );
+						_previous = _current;
+						_current = innerTrans._destState;
+#if defined (SPAG_ENABLE_LOGGING) || defined (SPAG_ENABLE_TRACEPOINTS)
+						ev_idx   = iev_idx;
+#endif
+						_innerEventFlag.reset( iev_idx );       // deactivate event
+					}
+				}
+			}
+//			SPAG_LOG << "stinf:\n" << stinf << '\n';
+
+#ifdef SPAG_ENABLE_LOGGING
+			_rtdata.logTransition( _current, ev_idx );
+#endif
+			SPAG_P_TRACEPOINT( Transition, this, SPAG_P_CAST2IDX(_previous), ev_idx, SPAG_P_CAST2IDX(_current) );
+			runAction();                                                          // 3 - call the callback function
+			SPAG_P_END;
+		}
+#endif // SPAG_USE_SIGNALS
+///@}
+
+/** \name Misc. helper functions */
+///@{
+/// Does configuration checks (called by start(), only if the configuration has changed since last check)
+		void doChecking() const;
+/// Return nb of states
+		constexpr size_t nbStates() const
+		{
+			return SPAG_P_CAST2IDX(ST::NB_STATES);
+		}
+/// Return nb of events
+		constexpr size_t nbEvents() const
+		{
+			return SPAG_P_CAST2IDX(EV::NB_EVENTS);
+		}
+/// Return current state
+		ST currentState() const
+		{
+			return _current;
+		}
+/// Return previous state (or initial state upon start() )
+		ST previousState() const
+		{
+			return _previous;
+		}
+/// Returns true if FSM has been started (and not stopped)
+		bool isRunning() const
+		{
+			return _isRunning;
+		}
+
+#ifdef SPAG_ENUM_STRINGS
+/// Returns the state having string \c str. The returned argument first value will be false if not found
+/**
+Once the FSM has been started, this uses an index built at start, instead of comparing \c str to all the strings.
+*/
+		std::pair<bool,ST> findState( const std::string& str ) const
+		{
+			auto res = _cfg->_isBuilt ? _cfg->_indexStates.find( str, _cfg->_strStates ) : priv::findString( str, _cfg->_strStates );
+			return std::make_pair( res.first, static_cast<ST>( res.second ) );
+		}
+/// Returns the event having string \c str. The returned argument first value will be false if not found (see findState() )
+		std::pair<bool,EV> findEvent( const std::string& str ) const
+		{
+			auto res = findEventIdx( str );
+			return std::make_pair( res.first && res.second < nbEvents(), static_cast<EV>( res.second ) );
+		}
+/// Returns index of state having string \c str. Throws if not found
+		size_t getStateIndex( const std::string& str ) const
+		{
+			auto res = findState( str );
+			if( !res.first )
+				SPAG_P_THROW_ERROR_RT( "invalid state string" );
+			return SPAG_P_CAST2IDX( res.second );
+		}
+/// Returns index of event having string \c str (can also be the timeout or AAT pseudo-events). Throws if not found
+		size_t getEventIndex( const std::string& str ) const
+		{
+			auto res = findEventIdx( str );
+			if( !res.first )
+				SPAG_P_THROW_ERROR_RT( "invalid event string" );
+			return res.second;
+		}
+	private:
+		std::pair<bool,size_t> findEventIdx( const std::string& str ) const
+		{
+			return _cfg->_isBuilt ? _cfg->_indexEvents.find( str, _cfg->_strEvents ) : priv::findString( str, _cfg->_strEvents );
+		}
+	public:
+#endif
+/// Read-only access to the configuration of state \c idx (it can be shared with other FSM, see assignConfig() )
+		const priv::StateInfo<ST,EV,CBA>& getStateInfo( size_t idx ) const
+		{
+			assert( idx < nbStates() );
+			return _cfg->_stateInfo[idx];
+		}
+
+/// Returns true if a time out has been assigned to state \c st
+		bool hasTimeOut( ST st ) const
+		{
+			assert( SPAG_P_CAST2IDX(st) < nbStates() );
+			return _cfg->_stateInfo[ SPAG_P_CAST2IDX(st) ]._timerEvent._enabled;
+		}
+/// Return duration of time out for state \c st, or 0 if none
+/// (if it has a timeout policy and is the current state, the duration of the current attempt, in ns, see assignTimeOutPolicy() )
+		std::pair<Duration,DurUnit> timeOutDuration( ST st ) const
+		{
+			assert( SPAG_P_CAST2IDX(st) < nbStates() );
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+			if( st == _current && _isRunning && _cfg->_stateInfo[ SPAG_P_CAST2IDX(st) ]._toPolicy.isActive() )
+				return std::make_pair( static_cast<Duration>( _attemptNs ), DurUnit::ns );   // duration of current attempt
+#endif
+			return std::make_pair(
+				_cfg->_stateInfo[ SPAG_P_CAST2IDX(st) ]._timerEvent._duration,
+				_cfg->_stateInfo[ SPAG_P_CAST2IDX(st) ]._timerEvent._durUnit
+			);
+		}
+
+		void printConfig( std::ostream& str, const char* msg=nullptr ) const;
+
+#ifdef SPAG_ENABLE_LOGGING
+/// Assigns a new name for the output log file (default is spaghetti.csv)
+		void setLogFileName( std::string fn ) const
+		{
+			assert( !fn.empty() );
+			_rtdata._logfileName = fn;
+		}
+
+		Counters getCounters() const
+		{
+			return _rtdata.buildCounters();
+		}
+/// Copies the counters of type \c what into \c dest (at most \c size values), returns the number of counters of that type
+/**
+Unlike getCounters(), this does not allocate anything, and can be called from another thread (for example a monitoring thread)
+while the FSM is running.
+*/
+		size_t readCounters( Item what, size_t* dest, size_t size ) const
+		{
+			return _rtdata.readCounters( what, dest, size );
+		}
+/// Same as readCounters( Item, size_t*, size_t ), with an array
+		template<size_t N>
+		size_t readCounters( Item what, std::array<size_t,N>& dest ) const
+		{
+			return _rtdata.readCounters( what, dest.data(), N );
+		}
+		void clearCounters()
+		{
+			_rtdata.clear();
+		}
+/// Returns the rates (events, transitions, ignored events and timeouts per second) over the last \c window complete seconds
+/**
+For example <code>getRates( 10 )._events</code> is the mean number of events per second over the last 10 seconds.
+Like readCounters(), this does not allocate and can be called from another thread while the FSM is running.
+The rates are not reset by clearCounters().
+*/
+		Rates getRates( size_t window=1 ) const
+		{
+			return _rtdata.rates( window );
+		}
+#else
+		void setLogFilename( std::string fn ) const {}
+//		Counters getCounters() const {}
+//		void clearCounters() {}
+#endif // SPAG_ENABLE_LOGGING
+
+#ifdef SPAG_ENABLE_TRACE
+/// Starts recording all the inputs of the FSM (events, timeouts and inner events activations) into the binary file \c fname
+/**
+The trace can then be replayed into another FSM, with a TraceReplayer.
+For a faithful replay, the trace should be started before the FSM is started (or else, the replayed FSM must be on the same state).
+If a trace is already being recorded, it is closed first.
+
+Only the external inputs are recorded: the events processed and the inner events activated from inside a callback
+are consequences of a recorded input, and are produced again by the callbacks during the replay.
+The events posted with postEvent() are recorded when they are processed (by processPostedEvents() ), unless it is called from a callback.
+During a replay, the ReplayTimer does not drain the queue, so the events posted by the callbacks are not applied a second time.
+*/
+		void startTrace( std::string fname ) const
+		{
+			_trace.reset( new priv::TraceWriter( fname, nbStates(), nbEvents(), SPAG_P_CAST2IDX(_current) ) );
+		}
+/// Stops and closes the trace file. Returns the number of records
+		size_t stopTrace() const
+		{
+			size_t nb = _trace ? _trace->nbRecords() : 0;
+			_trace.reset();
+			return nb;
+		}
+#endif // SPAG_ENABLE_TRACE
+
+#ifdef SPAG_ENABLE_HISTOGRAMS
+/// Returns a copy of the latency histograms (callback duration and dwell time per state, timeout lateness)
+		LatencyHistograms getHistograms() const
+		{
+			LatencyHistograms lh;
+			lh._callback.assign( std::begin(_latency._callback), std::end(_latency._callback) );
+			lh._dwell.assign(    std::begin(_latency._dwell),    std::end(_latency._dwell) );
+			lh._timeOutLateness = _latency._timeOutLateness;
+#ifdef SPAG_ENUM_STRINGS
+			lh._strStates = _cfg->_strStates;
+#endif
+			return lh;
+		}
+		void clearHistograms()
+		{
+			_latency.clear();
+		}
+#endif // SPAG_ENABLE_HISTOGRAMS
+
+/// Sets what is done with the running timer on a transition from a state having a timeout (default is \c TimerReuse::Off )
+/**
+With \c TimerReuse::Rearm, the timer is not canceled if the next state also has a timeout: \c timerStart() re-arms it directly
+(all the provided event handlers support this, a user-provided one must too).
+With \c TimerReuse::KeepDeadline, if the next state has the same timeout (same duration and destination) as the one running
+(self transitions, or states configured with assignGlobalTimeOut() ), nothing is done at all:
+the timeout is then "absolute", counted from the arrival on the first of these states.
+*/
+		void setTimerReuse( TimerReuse mode )
+		{
+			_timerReuse = mode;
+		}
+		TimerReuse timerReuse() const
+		{
+			return _timerReuse;
+		}
+
+/// Run-time state of a FSM, see snapshot() and restore()
+/**
+Fixed size and trivially copyable, so it can be stored as a raw block of bytes (copied with \c memcpy(), written to a file, ...).
+It only holds the run-time data, not the configuration: it can only be restored on a FSM of the same type, having the same configuration.
+*/
+		struct Snapshot
+		{
+			uint32_t _current;      ///< current state
+			uint32_t _previous;     ///< previous state
+			uint8_t  _isRunning;
+			uint8_t  _hasTimeOut;   ///< 1 if a timeout was running
+			uint8_t  _pad[6];       ///< always 0
+			uint64_t _remaining;    ///< time before the timeout, in nanoseconds (if \c _hasTimeOut is 1)
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+			uint64_t _attemptNs;    ///< duration of the current attempt of the timeout
+			uint32_t _jitterState;  ///< state of the random generator of the jitter
+			uint16_t _retryCount;   ///< nb of retries done on the current state
+			uint8_t  _pad2[2];      ///< always 0
+#endif
+#ifdef SPAG_USE_SIGNALS
+			std::array<uint64_t,( SPAG_P_CAST2IDX(EV::NB_EVENTS) + 63 ) / 64> _innerEvents;   ///< activated inner events (one bit per event)
+#endif
+#ifdef SPAG_ENABLE_LOGGING
+			std::array<uint64_t,SPAG_P_CAST2IDX(ST::NB_STATES)>   _stateCounter;
+			std::array<uint64_t,SPAG_P_CAST2IDX(EV::NB_EVENTS)+2> _eventCounter;
+			std::array<uint64_t,SPAG_P_CAST2IDX(EV::NB_EVENTS)>   _ignoredEventCounter;
+#endif
+		};
+
+/// Stores the run-time state of the FSM into \c snap: current and previous states, running flag, time before the timeout,
+/// activated inner events and counters (if \c SPAG_ENABLE_LOGGING is defined)
+/**
+Does not allocate. Must be called on the thread running the FSM (for example from a callback, or from the event loop).
+The time before the timeout is given by the event handler, that must provide <code>uint64_t timerRemaining()</code> (all the provided ones do).
+*/
+		void snapshot( Snapshot& snap ) const
+		{
+			static_assert( std::is_trivially_copyable<Snapshot>::value, "Snapshot must be trivially copyable" );
+			snap._current   = static_cast<uint32_t>( SPAG_P_CAST2IDX(_current) );
+			snap._previous  = static_cast<uint32_t>( SPAG_P_CAST2IDX(_previous) );
+			snap._isRunning = _isRunning ? 1 : 0;
+			std::fill( std::begin(snap._pad), std::end(snap._pad), 0 );
+			snap._hasTimeOut = ( _isRunning && _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ]._timerEvent._enabled ) ? 1 : 0;
+			snap._remaining  = snap._hasTimeOut ? _eventHandler->timerRemaining() : 0;
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+			snap._attemptNs   = _attemptNs;
+			snap._jitterState = _jitterState;
+			snap._retryCount  = _retryCount;
+			std::fill( std::begin(snap._pad2), std::end(snap._pad2), 0 );
+#endif
+#ifdef SPAG_USE_SIGNALS
+			snap._innerEvents.fill( 0 );
+			for( size_t i=0; i<nbEvents(); i++ )
+				if( _innerEventFlag.test( i ) )
+					snap._innerEvents[i/64] |= uint64_t(1) << (i%64);
+#endif
+#ifdef SPAG_ENABLE_LOGGING
+			_rtdata.saveCounters( snap._stateCounter.data(), snap._eventCounter.data(), snap._ignoredEventCounter.data() );
+#endif
+		}
+/// Returns the run-time state of the FSM, see snapshot( Snapshot& )
+		Snapshot snapshot() const
+		{
+			Snapshot snap;
+			snapshot( snap );
+			return snap;
+		}
+
+/// Restores the run-time state of the FSM from \c snap (produced by snapshot() on a FSM of same type and configuration)
+/**
+No callback is called. The configuration and the running flag of this FSM are unchanged:
+ - if the FSM is running, its timer is canceled, and then re-armed with the remaining time stored in the snapshot
+ (or with the timeout of the state, if it had none running), through <code>timerStartFor( fsm, ns )</code>, that the event handler must provide;
+ - if it is not running, start() will then start on the restored state (calling its callback, and starting its whole timeout).
+
+Does not allocate. Must be called on the thread running the FSM.
+*/
+		void restore( const Snapshot& snap )
+		{
+			SPAG_CHECK_LESS( snap._current,  nbStates() );
+			SPAG_CHECK_LESS( snap._previous, nbStates() );
+			if( _isRunning && _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ]._timerEvent._enabled )
+			{
+				SPAG_P_TRACEPOINT( TimerCancel, this, SPAG_P_CAST2IDX(_current), 0, 0 );
+				_eventHandler->timerCancel();
+			}
+			_current   = static_cast<ST>( snap._current );
+			_previous  = static_cast<ST>( snap._previous );
+			_keepTimer = false;
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+			_attemptNs   = snap._attemptNs;
+			_jitterState = snap._jitterState;
+			_retryCount  = snap._retryCount;
+#endif
+#ifdef SPAG_USE_SIGNALS
+			for( size_t i=0; i<nbEvents(); i++ )
+				_innerEventFlag.set( i, ( snap._innerEvents[i/64] >> (i%64) ) & 1 );
+#endif
+#ifdef SPAG_ENABLE_LOGGING
+			_rtdata.restoreCounters( snap._stateCounter.data(), snap._eventCounter.data(), snap._ignoredEventCounter.data() );
+#endif
+#ifdef SPAG_USE_EVENT_QUEUE
+			_postedState.store( SPAG_P_CAST2IDX(_current), std::memory_order_relaxed );
+#endif
+			if( _isRunning )
+			{
+				const auto& tev = _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ]._timerEvent;
+				if( tev._enabled )
+				{
+					SPAG_P_ASSERT( _eventHandler, "Event handler has not been allocated" );
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+					if( !snap._hasTimeOut )        // timeout starts from its first attempt
+					{
+						_retryCount = 0;
+						if( _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ]._toPolicy.isActive() )
+							computeAttempt( _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ] );
+					}
+#endif
+					if( snap._hasTimeOut )
+						_eventHandler->timerStartFor( this, snap._remaining );
+					else
+						_eventHandler->timerStart( this );
+				}
+			}
+		}
+
+/// Sets the timer default value. See assignTimeOut()
+		template<typename T>
+		void setTimerDefaultValue( T val ) const
+		{
+			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+            _defaultTimerValue = val;
+		}
+
+/// Sets the timer default unit. See assignTimeOut()
+		void setTimerDefaultUnit( DurUnit unit ) const
+		{
+			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+            _defaultTimerUnit = unit;
+		}
+
+/// Sets the timer default unit, given as a string. See assignTimeOut()
+/**
+Provided so that we can use this in a function templated with the FSM type, without having the type \c DurUnit available
+(see for example in src/traffic_lights_common.hpp)
+*/
+		void setTimerDefaultUnit( std::string str ) const
+		{
+			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
+			auto tu = priv::timeUnitFromString( str );
+			if( !tu.first )
+				SPAG_P_THROW_ERROR_CFG( "invalid string value: " + str );
+			_defaultTimerUnit = tu.second;
+		}
+
+/// Returns the build options
+/**
+Usage (example): <code>std::cout << fsm_t::buildOptions();</code>
+*/
+		static std::string buildOptions()
+		{
+			std::string yes(" = yes\n"), no(" = no\n");
+			std::string out( "Spaghetti version " );
+			out += SPAG_VERSION;
+			out += "\nBuild options:\n";
+
+			out += SPAG_P_STRINGIZE2( SPAG_USE_ASIO_WRAPPER );
+#ifdef SPAG_USE_ASIO_WRAPPER
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_EMBED_ASIO_WRAPPER );
+#ifdef SPAG_EMBED_ASIO_WRAPPER
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_TIMER_WHEEL );
+#ifdef SPAG_USE_TIMER_WHEEL
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_VIRTUAL_CLOCK );
+#ifdef SPAG_USE_VIRTUAL_CLOCK
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_HIRES_TIMER );
+#ifdef SPAG_USE_HIRES_TIMER
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_WIRE_PROTOCOL );
+#ifdef SPAG_USE_WIRE_PROTOCOL
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_MMAP );
+#ifdef SPAG_USE_MMAP
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_FSM_POOL );
+#ifdef SPAG_USE_FSM_POOL
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_COROUTINES );
+#ifdef SPAG_USE_COROUTINES
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_TRANSITION_ACTIONS );
+#ifdef SPAG_USE_TRANSITION_ACTIONS
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_ASYNC_CALLBACKS );
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_HOT_RECONFIG );
+#ifdef SPAG_USE_HOT_RECONFIG
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_TIMEOUT_POLICIES );
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_FSM_ENGINE );
+#ifdef SPAG_USE_FSM_ENGINE
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_SIGNALS );
+#ifdef SPAG_USE_SIGNALS
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_EVENT_QUEUE );
+#ifdef SPAG_USE_EVENT_QUEUE
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_ENABLE_TRACE );
+#ifdef SPAG_ENABLE_TRACE
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_ENABLE_TRACEPOINTS );
+#ifdef SPAG_ENABLE_TRACEPOINTS
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_USE_USDT );
+#ifdef SPAG_USE_USDT
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_ENABLE_HISTOGRAMS );
+#ifdef SPAG_ENABLE_HISTOGRAMS
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_PACKED_TABLE );
+#ifdef SPAG_PACKED_TABLE
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_EXTERNAL_EVENT_LOOP );
+#ifdef SPAG_EXTERNAL_EVENT_LOOP
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_ENABLE_LOGGING );
+#ifdef SPAG_ENABLE_LOGGING
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_ASYNC_LOGGING );
+#ifdef SPAG_ASYNC_LOGGING
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_PRINT_STATES );
+#ifdef SPAG_PRINT_STATES
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_FRIENDLY_CHECKING );
+#ifdef SPAG_FRIENDLY_CHECKING
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_ENUM_STRINGS );
+#ifdef SPAG_ENUM_STRINGS
+			out += yes;
+#else
+			out += no;
+#endif
+			out += SPAG_P_STRINGIZE2( SPAG_NO_VERBOSE );
+#ifdef SPAG_ENUM_STRINGS
+			out += yes;
+#else
+			out += no;
+#endif
+
+#ifdef SPAG_USE_ASIO_WRAPPER
+		out += "Boost asio used, Boost version=";
+		out += std::to_string(BOOST_VERSION);
+#endif
+
+
+
+			return out;
+		}
+
+		void writeDotFile( std::string fn, DotFileOptions opt=DotFileOptions() ) const;
+
+		std::vector<uint8_t> saveConfig() const;
+		void saveConfig( const std::string& fname ) const;
+		void loadConfig( const void* data, size_t size );
+		void loadConfig( const std::string& fname );
+///@}
+
+///////////////////////////////////
+// SpagFSM: private member function section
+///////////////////////////////////
+
+	private:
+
+/// Returns true if event \c ev has been declared as inner event, with
+/**
+<code>assignInnerTransition( ST st1, EV iev, ST st2 );</code>
+or
+<code>assignInnerTransition( EV, ST );</code>
+
+*/
+	bool isInnerEvent( EV ev ) const
+	{
+		return _cfg->_innerEvents.test( SPAG_P_CAST2IDX(ev) );
+	}
+
+/// Returns true if event \c ev_idx is allowed on state \c st_idx, and if so, assigns the destination state to \c next
+	bool getTransition( size_t ev_idx, size_t st_idx, ST& next ) const
+	{
+#ifdef SPAG_PACKED_TABLE
+		if( !_cfg->_isBuilt )                   // configuration has been changed while running: rebuild the table
+			_cfg->build();
+		auto cell = _cfg->_packedTable.get( st_idx, ev_idx );
+		next = _cfg->_packedTable.nextState( cell );
+		return _cfg->_packedTable.isAllowed( cell );
+#else
+		next = _cfg->_transitionMat[ ev_idx ][ st_idx ];
+		return _cfg->_allowedMat[ ev_idx ][ st_idx ] == 1;
+#endif
+	}
+
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+/// Computes the duration of the next attempt of the timeout of the current state (\c stinf), see assignTimeOutPolicy()
+	void computeAttempt( const priv::StateInfo<ST,EV,CBA>& stinf ) const
+	{
+		const auto& pol = stinf._toPolicy;
+		const uint64_t maxNs = std::numeric_limits<uint64_t>::max() / 256;   // so that the products below can't overflow
+		uint64_t ns = priv::toNanoseconds( stinf._timerEvent._duration, stinf._timerEvent._durUnit );
+		for( uint16_t i=0; i<_retryCount && ns < maxNs; i++ )
+			ns = std::min( ns / 100 * pol._backoff + ns % 100 * pol._backoff / 100, maxNs );
+		if( pol._jitter )
+		{
+			_jitterState ^= _jitterState << 13;    // xorshift32
+			_jitterState ^= _jitterState >> 17;
+			_jitterState ^= _jitterState << 5;
+			auto delta = static_cast<int64_t>( _jitterState % ( 2u * pol._jitter + 1 ) ) - pol._jitter;
+			ns = ns / 100 * static_cast<uint64_t>( 100 + delta ) + ns % 100 * static_cast<uint64_t>( 100 + delta ) / 100;
+		}
+		_attemptNs = ns;
+	}
+#endif
+
+/// Cancels the timer of the current state before switching to state \c next, unless it can be reused (see setTimerReuse() )
+	void stopTimer( ST next ) const
+	{
+		if( _timerReuse != TimerReuse::Off )
+		{
+			const auto& tev  = _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ]._timerEvent;
+			const auto& tev2 = _cfg->_stateInfo[ SPAG_P_CAST2IDX(next) ]._timerEvent;
+			if( tev2._enabled )                 // will be re-armed (or kept) by runAction()
+			{
+				_keepTimer = _timerReuse == TimerReuse::KeepDeadline
+					&& tev2._duration == tev._duration && tev2._durUnit == tev._durUnit && tev2._nextState == tev._nextState;
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+				if( _cfg->_stateInfo[ SPAG_P_CAST2IDX(next) ]._toPolicy.isActive() )
+					_keepTimer = false;               // duration depends on the retry count
+#endif
+				return;
+			}
+		}
+		SPAG_P_ASSERT( _eventHandler, "Event handler has not been allocated" );
+		SPAG_P_TRACEPOINT( TimerCancel, this, SPAG_P_CAST2IDX(_current), 0, 0 );
+		_eventHandler->timerCancel();
+	}
+
+#ifdef SPAG_USE_HOT_RECONFIG
+/// Switches to the configuration published with publishConfig(), called by the thread running the FSM.
+/// Returns true if the configuration has been switched
+	SPAG_P_COLD bool applyPendingConfig() const
+	{
+		_cfgPending.store( false, std::memory_order_relaxed );
+		auto cfg = std::atomic_exchange( &_nextCfg, std::shared_ptr<priv::FsmConfig<ST,EV,CBA>>() );
+		if( !cfg )
+			return false;
+		auto curr_idx = SPAG_P_CAST2IDX(_current);
+		bool hadTimer = _cfg->_stateInfo[ curr_idx ]._timerEvent._enabled;
+		setCfg( std::move( cfg ) );          // the previous one is released once no thread uses it
+#if (defined SPAG_ENABLE_LOGGING) && (defined SPAG_ENUM_STRINGS)
+		_rtdata.setStrings( &_cfg->_strEvents, &_cfg->_strStates );
+#endif
+		_nbConfigSwaps++;
+		SPAG_LOG << "switched to published configuration\n";
+		if( _isRunning )
+		{
+			bool hasTimer = _cfg->_stateInfo[ curr_idx ]._timerEvent._enabled;
+			if( hadTimer && !hasTimer )
+			{
+				SPAG_P_TRACEPOINT( TimerCancel, this, curr_idx, 0, 0 );
+				_eventHandler->timerCancel();
+			}
+			if( !hadTimer && hasTimer )
+			{
+				SPAG_P_ASSERT( _eventHandler, "Event handler has not been allocated" );
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+				if( _cfg->_stateInfo[ curr_idx ]._toPolicy.isActive() )
+					computeAttempt( _cfg->_stateInfo[ curr_idx ] );
+#endif
+#ifdef SPAG_ENABLE_HISTOGRAMS
+				_latency._timerExpected = priv::LatencyData<ST>::Clock::now()
+					+ _latency.toDuration( timeOutDuration( _current ).first, timeOutDuration( _current ).second );
+#endif
+				SPAG_P_TRACEPOINT( TimerStart, this, curr_idx, timeOutDuration( _current ).first,
+					static_cast<size_t>( timeOutDuration( _current ).second ) );    // with a timeout policy, duration of the current attempt
+				_eventHandler->timerStart( this );
+			}
+		}
+		return true;
+	}
+#endif
+
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+/// Runs the callback of state \c st_idx of FSM \c p and posts the completion event (called by the CallbackPool, see assignAsyncCallback() )
+/**
+\c cfg is the configuration of the FSM when the callback was pushed: the job holds a reference on it,
+so it stays valid even if the FSM switches to another one meanwhile (copy on write or publishConfig() ).
+*/
+	static void asyncCallback( const void* p, const void* cfg, size_t st_idx )
+	{
+		auto fsm = static_cast<const SpagFSM*>( p );
+		const auto& config    = *static_cast<const priv::FsmConfig<ST,EV,CBA>*>( cfg );
+		const auto& stateInfo = config._stateInfo[ st_idx ];
+		if( stateInfo._rawCallback )
+			stateInfo._rawCallback( stateInfo._rawContext, stateInfo._callbackArg );
+		else if( stateInfo._callback )
+			stateInfo._callback( stateInfo._callbackArg );
+		if( stateInfo._asyncDoneEvent != fsm->nbEvents() )    // posted with the flags of the held configuration, as the FSM one can be replaced meanwhile
+		{
+			auto flags = fsm->postFlags( config, stateInfo._asyncDoneEvent );
+			fsm->queueEvent( static_cast<EV>( stateInfo._asyncDoneEvent ), flags.first, flags.second );
+		}
+	}
+#endif
+
+/// Calls the exit callback of the current state, and the action of the transition triggered by event \c ev_idx (\c nbEvents() for a timeout, \c nbEvents()+1 for an AAT, that has no action)
+	void leaveState( size_t ev_idx ) const
+	{
+#ifdef SPAG_USE_TRANSITION_ACTIONS
+		const auto st_idx = SPAG_P_CAST2IDX(_current);
+		const auto& stinf = _cfg->_stateInfo[ st_idx ];
+		if( stinf._exitRawCallback )
+			stinf._exitRawCallback( stinf._exitContext, stinf._callbackArg );
+		else if( stinf._exitCallback )
+			stinf._exitCallback( stinf._callbackArg );
+		if( ev_idx <= nbEvents() )
+		{
+			const auto& act = _cfg->_actionMat[ ev_idx * nbStates() + st_idx ];
+			if( act._func )
+				act._func( act._context, _current, static_cast<EV>(ev_idx) );
+		}
+#else
+		(void)ev_idx;
+#endif
+	}
+
+/// Replaces the configuration
+/**
+With \c SPAG_USE_HOT_RECONFIG and \c SPAG_USE_EVENT_QUEUE, the configuration can be replaced while other threads are in postEvent(),
+that reads it through the raw pointer \c _postCfg. The previous configuration is then kept in \c _retiredCfg,
+and released by the thread running the FSM once no thread is in postEvent() (see releaseRetiredCfg() ), so that postEvent() stays lock-free.
+*/
+	void setCfg( std::shared_ptr<priv::FsmConfig<ST,EV,CBA>> cfg ) const
+	{
+#if (defined SPAG_USE_HOT_RECONFIG) && (defined SPAG_USE_EVENT_QUEUE)
+		auto old = std::move( _cfg );
+		_cfg = std::move( cfg );
+		_postCfg.store( _cfg.get() );
+		if( old )
+			_retiredCfg.push_back( std::move( old ) );
+		releaseRetiredCfg();
+#else
+		_cfg = std::move( cfg );
+#endif
+	}
+
+#ifdef SPAG_USE_EVENT_QUEUE
+/// Discards the events posted and not processed yet, called by stop() (so that a later start() does not process stale events)
+	void discardPostedEvents() const
+	{
+		EV ev;
+		while( _eventQueueHigh.pop( ev ) || _eventQueue.pop( ev ) )
+			;
+		for( auto& pending: _pendingEvent )
+			pending.store( false );
+		_drainPending.store( false );         // the drain requested to the event handler may have been canceled by kill()
+	}
+#endif
+
+#if (defined SPAG_USE_HOT_RECONFIG) && (defined SPAG_USE_EVENT_QUEUE)
+/// Releases the configurations replaced by setCfg(), if no thread is in postEvent()
+/**
+A thread in postEvent() increments \c _nbPosting before loading \c _postCfg, and decrements it once it doesn't use the configuration anymore.
+So if the counter is seen null after \c _postCfg has been replaced, no thread can be using a previous configuration.
+*/
+	void releaseRetiredCfg() const
+	{
+		if( !_retiredCfg.empty() && _nbPosting.load() == 0 )
+			_retiredCfg.clear();
+	}
+#endif
+
+/// Returns the configuration, for modification. If it is shared with other FSM, a copy is done first (copy on write)
+	priv::FsmConfig<ST,EV,CBA>& wcfg()
+	{
+		if( _cfg.use_count() > 1 )
+		{
+			setCfg( std::make_shared<priv::FsmConfig<ST,EV,CBA>>( *_cfg ) );
+#if (defined SPAG_ENABLE_LOGGING) && (defined SPAG_ENUM_STRINGS)
+			_rtdata.setStrings( &_cfg->_strEvents, &_cfg->_strStates );
+#endif
+		}
+		_cfg->_isBuilt       = false;
+		_cfg->_hasReferences = false;
+		_cfg->_isChecked     = false;
+		_cfg->_prepared._isDone.store( false, std::memory_order_relaxed );
+		return *_cfg;
+	}
+
+/// Checks (if not done yet) and builds the configuration
+/**
+Done only once for a given configuration, even if it is shared by FSMs started at the same time by several threads:
+the flag is read first (single atomic load once done), the check and build are done holding the mutex of the configuration.
+*/
+	void prepareCfg() const
+	{
+		auto& guard = _cfg->_prepared;
+		if( guard._isDone.load( std::memory_order_acquire ) )
+			return;
+		std::lock_guard<std::mutex> lock( guard._mutex );
+		if( guard._isDone.load( std::memory_order_relaxed ) )
+			return;
+		if( !_cfg->_isChecked )
+			doChecking();
+		_cfg->build();
+		guard._isDone.store( true, std::memory_order_release );
+	}
+
+/// Raw callback calling member function \c M of object \c obj
+	template<typename C, void (C::*M)(CBA)>
+	static void memberCallback( void* obj, CBA cb_arg )
+	{
+		(static_cast<C*>(obj)->*M)( cb_arg );
+	}
+
+/// Raw callback calling the \c onEnter() member function of handler \c h, for state \c S
+	template<typename H, size_t S>
+	static void handlerCallback( void* h, CBA cb_arg )
+	{
+		static_cast<H*>(h)->onEnter( static_cast<ST>(S), cb_arg );
+	}
+
+	template<typename H, size_t... I>
+	void assignCallbackHandler( H& handler, priv::IndexSeq<I...> )
+	{
+		RawCallback_t funcs[] = { &handlerCallback<H,I>... };
+		auto& cfg = wcfg();
+		for( size_t i=0; i<nbStates(); i++ )
+		{
+			cfg._stateInfo[i]._callback    = nullptr;
+			cfg._stateInfo[i]._rawCallback = funcs[i];
+			cfg._stateInfo[i]._rawContext  = &handler;
+		}
+	}
+
+/// Run associated action with a state switch (state has already switched)
+/**
+-# first, starts timer, if needed (first, because running callback can take some time).
+-# second, calls callback function, if any.
+-# third, if a deferred action has been requested on this state (only if \ref SPAG_USE_SIGNALS is defined, see manual),
+processes it once the callback has returned, in a loop (so a chain of pass-states does not recurse).
+*/
+		void runAction() const
+		{
+			SPAG_P_START;
+			SPAG_LOG << "switched to state " << SPAG_P_CAST2IDX(_current)
+#ifdef SPAG_ENUM_STRINGS
+				<< " (" << _cfg->_strStates[ SPAG_P_CAST2IDX(_current) ] << ")"
+#endif
+				<< ", starting handler\n";
+			auto curr_idx = SPAG_P_CAST2IDX(_current);
+			auto& stateInfo = _cfg->_stateInfo[ curr_idx ];
+#ifdef SPAG_USE_EVENT_QUEUE
+			_postedState.store( curr_idx, std::memory_order_relaxed );
+#endif
+#ifdef SPAG_ENABLE_HISTOGRAMS
+			auto t_entry = priv::LatencyData<ST>::Clock::now();
+			if( _latency._hasEntry )
+				_latency._dwell[ SPAG_P_CAST2IDX(_previous) ].record( _latency.toNs( t_entry - _latency._stateEntry ) );
+			_latency._stateEntry = t_entry;
+			_latency._hasEntry   = true;
+#endif
+
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+			if( _isRetry )
+				_isRetry = false;
+			else
+				_retryCount = 0;
+#endif
+			if( _keepTimer )                // running timer is kept, see setTimerReuse()
+			{
+				SPAG_LOG << "timeout kept\n";
+				_keepTimer = false;
+			}
+			else if( stateInfo._timerEvent._enabled )
+			{
+				SPAG_P_ASSERT( _eventHandler, "Event handler has not been allocated" );
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+				if( stateInfo._toPolicy.isActive() )
+					computeAttempt( stateInfo );
+#endif
+				auto dur = timeOutDuration( _current );     // with a timeout policy, duration of the current attempt
+				SPAG_LOG << "timeout start, duration=" << dur.first << "\n";
+#ifdef SPAG_ENABLE_HISTOGRAMS
+				_latency._timerExpected = t_entry + _latency.toDuration( dur.first, dur.second );
+#endif
+				SPAG_P_TRACEPOINT( TimerStart, this, curr_idx, dur.first, static_cast<size_t>( dur.second ) );
+				_eventHandler->timerStart( this );
+			}
+			SPAG_P_TRACEPOINT( CallbackBegin, this, curr_idx, 0, 0 );
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+			if( stateInfo._isAsync )
+			{
+				SPAG_LOG << "asynchronous callback\n";
+				if( !_callbackPool || !_callbackPool->push( &asyncCallback, this, curr_idx, _cfg ) )
+					asyncCallback( this, _cfg.get(), curr_idx );     // no pool, or queue is full: run here
+			}
+			else
+#endif
+			if( stateInfo._rawCallback )
+			{
+				SPAG_LOG << "raw callback function start:\n";
+				stateInfo._rawCallback( stateInfo._rawContext, stateInfo._callbackArg );
+			}
+			else if( stateInfo._callback ) // if there is a callback stored, then call it
+			{
+				SPAG_LOG << "callback function start:\n";
+				stateInfo._callback( stateInfo._callbackArg );
+			}
+			else
+				SPAG_LOG << "state has no callback provided\n";
+			SPAG_P_TRACEPOINT( CallbackEnd, this, curr_idx, 0, 0 );
+#ifdef SPAG_ENABLE_HISTOGRAMS
+			_latency._callback[ curr_idx ].record( _latency.toNs( priv::LatencyData<ST>::Clock::now() - t_entry ) );
+#endif
+
+#ifdef SPAG_USE_SIGNALS
+			if( _isRunning )  // we need this, because the callback could have stopped the FSM, thus we must not switch state !
+			{
+				if( stateInfo._isPassState )
+				{
+					SPAG_LOG << "Is pass-state, deferring inner transition.\n";
+					_innerPending = true;
+				}
+				else
+				{
+					if( ( stateInfo._innerEventMask & _innerEventFlag ).any() ) // if one of the inner events of this state is active
+					{
+						SPAG_LOG << "Inner Event is active, deferring inner transition.\n";
+						_innerPending = true;
+					}
+				}
+				if( _innerPending && stateInfo._timerEvent._enabled )
+				{
+					SPAG_P_TRACEPOINT( TimerCancel, this, curr_idx, 0, 0 );
+					_eventHandler->timerCancel();
+				}
+			}
+			if( !_inDispatch )         // outermost call: process the deferred transitions, iteratively (no recursion)
+			{
+				priv::FlagGuard guard( _inDispatch );
+				while( _innerPending && _isRunning )
+				{
+					_innerPending = false;
+					processInnerEvent( _cfg->_stateInfo[ SPAG_P_CAST2IDX(_current) ] );
+				}
+				_innerPending = false;
+			}
+//			SPAG_LOG << "current state info:\n";
+//			std::cout << _cfg->_stateInfo[ curr_idx ] << '\n';
+#endif
+#ifdef SPAG_USE_COROUTINES
+	#ifdef SPAG_USE_SIGNALS
+			if( !_inDispatch )         // only once the deferred transitions are done
+	#endif
+				resumeWaiter();
+#endif
+			SPAG_P_END;
+		}
+
+#ifdef SPAG_USE_COROUTINES
+/// Resumes the coroutine waiting on nextTransition(), if any
+		void resumeWaiter() const
+		{
+			if( _waiter )
+			{
+				auto h = _waiter;
+				_waiter = nullptr;
+				h.resume();
+			}
+		}
+#endif
+
+/// Throws the error \c code, related to event \c ev_idx (kept out of the run-time functions, see priv::throwRuntimeError() )
+		[[noreturn]] SPAG_P_COLD void throwEventError( priv::EN_RuntimeError code, const char* func, size_t ev_idx ) const
+		{
+#ifdef SPAG_ENUM_STRINGS
+			priv::throwRuntimeError( code, func, ev_idx, &_cfg->_strEvents[ev_idx] );
+#else
+			priv::throwRuntimeError( code, func, ev_idx, nullptr );
+#endif
+		}
+
+		void printLineHeader(  std::ostream&, size_t idx, bool firstline_flag, size_t maxlength ) const;
+		void printMatrix(      std::ostream& ) const;
+		void printStateConfig( std::ostream& ) const;
+		bool isReachable( size_t ) const;
+		std::string getConfigErrorMessage( priv::EN_ConfigError ce, size_t st ) const;
+
+/////////////////////////////
+// SpagFSM: private data section
+/////////////////////////////
+
+	private:
+#ifdef SPAG_USE_FSM_POOL
+		friend class FsmPool<ST,EV,CBA>;
+#endif
+#ifdef SPAG_USE_FSM_ENGINE
+		friend class FsmEngine<ST,EV,CBA>;
+#endif
+// hot data first: what is used on each transition is grouped at the beginning of the object (the configuration itself is behind _cfg)
+		mutable std::shared_ptr<priv::FsmConfig<ST,EV,CBA>> _cfg;  ///< configuration, can be shared with other FSM (see assignConfig() )
+#ifdef SPAG_USE_HOT_RECONFIG
+		mutable std::atomic<bool> _cfgPending{false};  ///< set by publishConfig(), read on each event
+#endif
+		mutable TIM*      _eventHandler      = nullptr;              ///< pointer on timer/ event-loop handling object
+		mutable ST        _current           = static_cast<ST>(0);   ///< current state
+		mutable ST        _previous          = static_cast<ST>(0);   ///< previous state
+		mutable bool      _isRunning         = false;
+		mutable bool      _keepTimer         = false;                ///< set by stopTimer() if the running timer must not be restarted by runAction()
+		TimerReuse        _timerReuse        = TimerReuse::Off;      ///< see setTimerReuse()
+#ifdef SPAG_USE_SIGNALS
+		mutable bool      _innerPending      = false;  ///< set by runAction() when an inner transition (AAT or inner event) must be processed
+		mutable bool      _inDispatch        = false;  ///< true while runAction() is processing the pending inner transitions
+#endif
+		mutable priv::EventSet<EV> _innerEventFlag; ///< holds the activation flag for each inner event
+
+// cold data
+		mutable DurUnit   _defaultTimerUnit  = DurUnit::sec;         ///< default timer units
+		mutable Duration  _defaultTimerValue = 1;                    ///< default timer value
+#ifdef SPAG_USE_COROUTINES
+		mutable std::coroutine_handle<> _waiter;     ///< coroutine waiting for the next transition, see nextTransition()
+#endif
+#ifdef SPAG_ENABLE_LOGGING
+		mutable priv::RunTimeData<ST,EV> _rtdata;
+#endif
+#ifdef SPAG_ENABLE_HISTOGRAMS
+		mutable priv::LatencyData<ST> _latency;     ///< latency histograms
+#endif
+#ifdef SPAG_ENABLE_TRACE
+		mutable std::unique_ptr<priv::TraceWriter> _trace;  ///< trace recorder, allocated by startTrace()
+		mutable uint32_t _traceDepth = 0;                   ///< nesting of the input processing functions, only the outer ones are recorded
+#endif
+
+
+#ifdef SPAG_USE_ASYNC_CALLBACKS
+		CallbackPool*     _callbackPool      = nullptr;  ///< runs the asynchronous callbacks, see assignAsyncCallback()
+#endif
+#ifdef SPAG_USE_TIMEOUT_POLICIES
+		mutable uint64_t  _attemptNs         = 0;           ///< duration of the current attempt, see assignTimeOutPolicy()
+		mutable uint32_t  _jitterState       = 2463534242u; ///< state of the random generator, see seedJitter()
+		mutable uint16_t  _retryCount        = 0;           ///< nb of retries done on the current state
+		mutable bool      _isRetry           = false;       ///< set by processTimeOut() when the state is re-entered for a retry
+#endif
+#ifdef SPAG_USE_HOT_RECONFIG
+		mutable std::shared_ptr<priv::FsmConfig<ST,EV,CBA>> _nextCfg;  ///< configuration published with publishConfig(), only accessed with atomic functions
+		mutable size_t    _nbConfigSwaps     = 0;
+#endif
+
+#ifdef SPAG_EMBED_ASIO_WRAPPER
+		AsioWrapper<ST,EV,CBA> _asioWrapper; ///< optional wrapper around boost::asio::io_service
+#endif
+
+#ifdef SPAG_USE_EVENT_QUEUE
+		mutable priv::MpscQueue<EV,SPAG_EVENT_QUEUE_SIZE> _eventQueue;  ///< events posted with postEvent()
+		mutable priv::MpscQueue<EV,SPAG_EVENT_QUEUE_HIGH_SIZE> _eventQueueHigh;  ///< events posted with postEvent(), having flag QueueHighPriority
+		mutable std::atomic<bool> _drainPending{false};                 ///< true if a call to processPostedEvents() has been requested to event handler
+		mutable std::array<std::atomic<bool>,static_cast<size_t>(EV::NB_EVENTS)> _pendingEvent{};  ///< for events with flag QueueCoalesce: true if one is in the queue
+		mutable std::atomic<size_t> _postedState{0};   ///< copy of current state, readable by the threads calling postEvent()
+		mutable std::atomic<size_t> _nbCoalesced{0};   ///< nb of posted events not queued, see assignQueueFlags()
+#endif
+#if (defined SPAG_USE_HOT_RECONFIG) && (defined SPAG_USE_EVENT_QUEUE)
+		mutable std::atomic<const priv::FsmConfig<ST,EV,CBA>*> _postCfg{nullptr};  ///< configuration read by postEvent(), see setCfg()
+		mutable std::atomic<size_t> _nbPosting{0};     ///< nb of threads in postEvent()
+		mutable std::vector<std::shared_ptr<priv::FsmConfig<ST,EV,CBA>>> _retiredCfg;  ///< replaced configurations, see releaseRetiredCfg()
+#endif
+};
+//-----------------------------------------------------------------------------------
+namespace priv
+{
+//-----------------------------------------------------------------------------------
+inline
+void
+printChars( std::ostream& out, size_t n, char c )
+{
+	for( size_t i=0; i<n; i++ )
+		out << c;
+}
+//-----------------------------------------------------------------------------------
+
+} // namespace priv
+
+//-----------------------------------------------------------------------------------
+/// Configuration error printing function
+template<typename ST, typename EV,typename T,typename CBA>
+std::string
+SpagFSM<ST,EV,T,CBA>::getConfigErrorMessage( priv::EN_ConfigError ce, size_t st ) const
+{
+	std::string msg( priv::getSpagName() + "configuration error: state " );
+	msg += std::to_string( st );
+#ifdef SPAG_ENUM_STRINGS
+	msg += " '";
+	msg += _cfg->_strStates[st];
+	msg += "'";
+#endif
+	msg += ' ';
+
+	switch( ce )
+	{
+		case priv::CE_TimeOutAndPassState:
+			msg += "cannot have both a timeout and a pass-state flag";
+		break;
+		case priv::CE_IllegalPassState:
+			msg += "cannot be followed by another pass-state";
+		break;
+		case priv::CE_SamePassState:
+			msg += "pass-state cannot lead to itself";
+		break;
+		default: assert(0);
+	}
+	return msg;
+}
+//-----------------------------------------------------------------------------------
+/// helper function template for printConfig()
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::printMatrix( std::ostream& out ) const
+{
+	size_t maxlength(0);
+#ifdef SPAG_ENUM_STRINGS
+	maxlength = priv::getMaxLength( _cfg->_strEvents );
+#endif
+
+	char spc_char{ ' ' };
+	out << std::setfill('0');
+
+	priv::printChars( out, maxlength, spc_char );
+	out << "        STATES:\nEVENTS";
+	priv::printChars( out, maxlength, spc_char );
+	out << '|';
+	for( size_t i=0; i<nbStates(); i++ )
+		out << spc_char<< 'S' << std::setw(2) << i;
+	out << '\n';
+	priv::printChars( out, maxlength+6, '-' );
+	out << '|';
+	for( size_t i=0; i<nbStates(); i++ )
+		out << "----";
+	out << '\n';
+
+	auto nbLines = nbEvents()+1; // +1 for timeout events
+#ifdef SPAG_USE_SIGNALS
+	nbLines++;                   // +1 for pass-states
+#endif
+
+#ifndef SPAG_ENUM_STRINGS
+	std::string capt( "EVENTS" );
+	nbLines = std::max( capt.size(), nbLines );
+#endif
+
+	for( size_t i=0; i<nbLines; i++ )
+	{
+#ifdef SPAG_ENUM_STRINGS
+		if( maxlength )
+			priv::PrintEnumString( out, _cfg->_strEvents[i], maxlength );
+#else
+		if( i<capt.size() )
+			out << capt[i];
+		else
+#endif
+			out << spc_char;
+
+		if( i<nbEvents() )
+		{
+			out << spc_char << 'E' << std::setw(2) << i << " | ";
+
+			for( size_t j=0; j<nbStates(); j++ )
+			{
+				if( _cfg->_allowedMat[i][j] )
+					out << 'S' << std::setw(2) << _cfg->_transitionMat[i][j];
+				else
+					out << " . ";
+				out << spc_char;
+			}
+
+		}
+		if( i == nbEvents() ) // TimeOut events
+		{
+			out << "  TO | ";
+			for( size_t j=0; j<nbStates(); j++ )
+			{
+				if( _cfg->_stateInfo[j]._timerEvent._enabled )
+					out << 'S' << std::setw(2) << _cfg->_stateInfo[j]._timerEvent._nextState;
+				else
+					out << " . ";
+				out << spc_char;
+			}
+		}
+#ifdef SPAG_USE_SIGNALS
+		if( i == nbEvents()+1 ) // Pass-state
+		{
+			out << " AAT | ";
+			for( size_t j=0; j<nbStates(); j++ )
+			{
+				if( _cfg->_stateInfo[j]._isPassState )
+					out << 'S' << std::setw(2) << _cfg->_transitionMat[ nbEvents()+1 ][j];
+				else
+					out << " . ";
+				out << spc_char;
+			}
+		}
+#endif
+		out << '\n';
+	}
+}
+//-----------------------------------------------------------------------------------
+/// Helper function, returns true if state \c st is referenced in \c _transitionMat (and that the transition is allowed)
+/// or it has a Timeout or pass-state transition
+/**
+The information is computed for all the states at once, on first call after a configuration change
+*/
+template<typename ST, typename EV,typename T,typename CBA>
+bool
+SpagFSM<ST,EV,T,CBA>::isReachable( size_t st ) const
+{
+	_cfg->updateReferences();
+	return _cfg->_isReferenced[st] != 0;
+}
+//-----------------------------------------------------------------------------------
+/// Checks configuration for any illegal situation. Throws error if one is encountered.
+/**
+Cost is linear with the size of the transition table. The configuration is then flagged as checked, until next change
+(the flag is shared with the FSM using the same configuration, see assignConfig() ).
+*/
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::doChecking() const
+{
+ #if 0
+ 	for( size_t i=0; i<nbStates(); i++ )
+	{
+		auto state = _cfg->_stateInfo[i];
+		if( state._isPassState )
+		{
+			size_t nextState = SPAG_P_CAST2IDX( _cfg->_transitionMat[0][i] );
+			if( nextState == i )
+				SPAG_P_THROW_ERROR_CFG( getConfigErrorMessage( priv::CE_SamePassState, i ) );
+
+//			if( _cfg->_stateInfo[ nextState ]._isPassState )
+//				SPAG_P_THROW_ERROR_CFG( getConfigErrorMessage( priv::CE_IllegalPassState, i ) );
+
+//			if( state._timerEvent._enabled )
+//				SPAG_P_THROW_ERROR_CFG( getConfigErrorMessage( priv::CE_TimeOutAndPassState, i ) );
+		}
+	}
+#endif
+
+// check for unreachable states
+	std::vector<size_t> unreachableStates;
+	for( size_t i=1; i<nbStates(); i++ )         // we start from index 1, because 0 is the initial state, and thus is always reachable!
+		if( !isReachable( i ) )
+			unreachableStates.push_back( i );
+	for( const auto& st: unreachableStates )
+	{
+		std::cout << priv::getSpagName() << "Warning, state S" << std::setw(2) << st
+#ifdef SPAG_ENUM_STRINGS
+			<< " (" << _cfg->_strStates[st] << ')'
+#endif
+			<< " is unreachable\n";
+	}
+
+	for( size_t i=0; i<nbStates(); i++ ) // check for any dead-end situations
+	{
+		bool foundValid(false);
+		if( _cfg->_stateInfo[i]._timerEvent._enabled )
+			foundValid = true;
+#ifdef SPAG_USE_SIGNALS
+		if( _cfg->_stateInfo[i]._isPassState )
+			foundValid = true;
+#endif
+		if( !foundValid )       // else
+		{
+			for( size_t j=0; j<nbEvents(); j++ )
+				if( SPAG_P_CAST2IDX( _cfg->_transitionMat[j][i] ) != i )   // if the transition leads to another state
+					if( _cfg->_allowedMat[j][i] != 0 )                  // AND it is allowed
+						foundValid = true;
+		}
+
+		if( !foundValid )                     // if we didn't find a valid transition
+			if( i == 0 || isReachable( i ) )     // AND it is not in the unreachable states list
+		{
+			std::cout << priv::getSpagName() << "Warning, state S" << std::setw(2) << i
+#ifdef SPAG_ENUM_STRINGS
+				<< " (" << _cfg->_strStates[i] << ')'
+#endif
+				<< " is a dead-end\n";
+		}
+	}
+	_cfg->_isChecked = true;
+}
+//-----------------------------------------------------------------------------------
+/// Helper function for printConfig()
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::printLineHeader( std::ostream& out, size_t idx, bool firstline_flag, size_t maxlength ) const
+{
+	if( firstline_flag )
+		out << 'S' << std::setw(2) << idx;
+	else
+		out << "   ";
+#ifdef SPAG_ENUM_STRINGS
+	out << ':';
+	if( firstline_flag )
+	{
+//		firstline_flag = false;
+		priv::PrintEnumString( out, _cfg->_strStates[idx], maxlength );
+	}
+	else
+		priv::printChars( out, maxlength, ' ' );
+#endif
+		out << "| ";
+}
+//-----------------------------------------------------------------------------------
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::printStateConfig( std::ostream& out ) const
+{
+	size_t maxlength = 0;
+#ifdef SPAG_ENUM_STRINGS
+	maxlength = priv::getMaxLength( _cfg->_strStates );
+#endif
+
+	for( size_t i=0; i<nbStates(); i++ )
+	{
+		printLineHeader( out, i, true, maxlength );
+		bool print_content = false;
+
+		const auto& stinf = _cfg->_stateInfo[i];
+		const auto& tev = stinf._timerEvent;
+		if( tev._enabled )
+		{
+			print_content = true;
+			out << "TO: " <<  tev._duration << ' ' << priv::stringFromTimeUnit( tev._durUnit )
+				<< " => S" << std::setw(2) << SPAG_P_CAST2IDX( tev._nextState );
+#ifdef SPAG_ENUM_STRINGS
+			out << " (";
+			priv::PrintEnumString( out, _cfg->_strStates[tev._nextState] );
+			out << ')';
+#endif // SPAG_ENUM_STRINGS
+			out << '\n';
+		}
+
+#ifdef SPAG_USE_SIGNALS
+		for( size_t j=0; j<stinf._innerTransList.size(); ++j )
+		{
+			if( print_content )
+				printLineHeader( out, i, false, maxlength );
+			else
+				print_content = true;
+
+			const auto &itr = stinf._innerTransList[j];
+			auto dst_st = SPAG_P_CAST2IDX(itr._destState);
+			auto i_ev   = SPAG_P_CAST2IDX(itr._innerEvent);
+			out << "IT ("
+				<< ( _innerEventFlag.test(i_ev)?'A':'I')
+				<< "): E" << std::setw(2) << i_ev;
+#ifdef SPAG_ENUM_STRINGS
+			out << " (";
+			priv::PrintEnumString( out, _cfg->_strEvents[i_ev] );
+			out << ')';
+#endif // SPAG_ENUM_STRINGS
+
+			out << " => S" << std::setw(2) << dst_st;
+
+#ifdef SPAG_ENUM_STRINGS
+			out << " (";
+			priv::PrintEnumString( out, _cfg->_strStates[dst_st] );
+			out << ')';
+#endif // SPAG_ENUM_STRINGS
+
+			out << '\n';
+		}
+
+		if( stinf._isPassState )
+		{
+			if( print_content )
+				printLineHeader( out, i, false, maxlength );
+			else
+				print_content = true;
+
+			out << "AAT: => S" << std::setw(2) << SPAG_P_CAST2IDX( _cfg->_transitionMat[ nbEvents()+1 ][i] );
+#ifdef SPAG_ENUM_STRINGS
+			out << " (";
+			priv::PrintEnumString( out, _cfg->_strStates[_cfg->_transitionMat[ nbEvents()+1 ][i]] );
+			out << ')';
+#endif // SPAG_ENUM_STRINGS
+			out << '\n';
+		}
+#endif // SPAG_USE_SIGNALS
+
+		if( !print_content )
+			out << "-\n";
+	}
+}
+//-----------------------------------------------------------------------------------
+/// Printing function, prints transition table and states info
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::printConfig( std::ostream& out, const char* msg ) const
+{
+	out << "\n* FSM Configuration: ";
+	if( msg )
+		out << msg;
+	out << "\n - Transition table:\n";
+	printMatrix( out );
+	out << "\n - State info:\n";
+	printStateConfig( out );
+	out << "---------------------\n";
+}
+
+//-----------------------------------------------------------------------------------
+/// Saves in current folder a .dot file of the FSM, to be rendered with Graphviz
+/**
+DO NOT give the extension in argument, is is added here.
+*/
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::writeDotFile( std::string fname, DotFileOptions opt ) const
+{
+	std::string full_fn = fname + ".dot";
+	std::ofstream f( full_fn );
+	if( !f.is_open() )
+		SPAG_P_THROW_ERROR_RT( "error, unable to open file: " + full_fn );
+	f << "/*\nGenerated by Spaghetti library\nhttps://github.com/skramm/spaghetti\n"
+		<< "Version " << SPAG_STRINGIZE(SPAG_VERSION) << "\n*/\n";
+	f << "digraph G {\n"
+		<< "rankdir=LR;\n"
+		<< "edge[style=\"bold\"];\n"
+		<< "node[shape=\"" << opt.nodeShape << "\"";
+	if( opt.fixedNodeWidth )
+		f << ",fixedsize=true,width=" << opt.nodeWidth;
+	f << "];\n";
+	f << std::setfill( '0' );
+
+	f << "\n/* States (=nodes) */\n";
+	for( size_t j=0; j<nbStates(); j++ )
+	{
+		if( opt.showUnreachableStates || isReachable( j ) )
+		{
+			f << j << " [label=\"";
+			if( opt.showStateIndex )
+				f << 'S' << std::setw(2) << j;
+	#ifdef SPAG_ENUM_STRINGS
+			if( opt.showStateString )
+			{
+				if( opt.showStateIndex )
+					f << "\\n";
+				f << _cfg->_strStates[j];
+			}
+	#endif
+			f << '"';
+
+			if( j == 0 )                                // initial state
+				f << ",shape=doublecircle";
+			if( opt.showActiveState )
+				if( SPAG_P_CAST2IDX( currentState() ) == j )
+					f << ",style=filled,fillcolor=black,fontcolor=white";
+	#if 0
+			f << ",URL=\"" << fname << ".html#node_" << j << "\"";
+	#endif
+			f << "];\n";
+		}
+	}
+	f << "\n/* External events */\n";
+	for( size_t i=0; i<nbEvents(); i++ )
+		for( size_t j=0; j<nbStates(); j++ )
+			if( _cfg->_allowedMat[i][j] == 1 )
+			{
+#ifdef SPAG_USE_SIGNALS
+				if( !_cfg->_stateInfo[j]._isPassState )
+#endif
+					if( isReachable( j ) || opt.showUnreachableStates )
+					{
+						f << j << " -> " << _cfg->_transitionMat[i][j] << " [label=\"";
+						if( opt.showEventIndex )
+							f << 'E' << std::setw(2) << i;
+#ifdef SPAG_ENUM_STRINGS
+						if( opt.showEventString )
+						{
+							if( opt.showEventIndex )
+								f << ':';
+							f << _cfg->_strEvents[i];
+						}
+#endif
+						f << "\"];\n";
+					}
+			}
+
+	f << "\n/* Inner events and timeout transitions */\n";
+	for( size_t j=0; j<nbStates(); j++ )
+	{
+		const auto& tev = _cfg->_stateInfo[j]._timerEvent;
+		if( tev._enabled && opt.showTimeOuts )
+			if( isReachable( j ) || opt.showUnreachableStates )
+			{
+				f << j << " -> " << tev._nextState
+					<< " [label=\"TO:"
+					<< tev._duration
+					<< priv::stringFromTimeUnit( tev._durUnit )
+					<< "\"";
+				if( opt.useColorsEventType )
+					f << ",color=blue";
+				f << "];\n";
+			}
+#ifdef SPAG_USE_SIGNALS
+		if( _cfg->_stateInfo[j]._isPassState && opt.showAAT )
+			if( isReachable( j ) || opt.showUnreachableStates )
+			{
+				f << j << " -> " << _cfg->_transitionMat[ nbEvents()+1 ][j] << " [label=\"AAT\"";
+				if( opt.useColorsEventType )
+					f << ",color=green";
+				f << "];\n";
+			}
+		if( opt.showInnerEvents )
+		{
+			for( const auto& itr: _cfg->_stateInfo[j]._innerTransList )
+			{
+				if( isReachable( j ) || opt.showUnreachableStates )
+				{
+					f << j << " -> " << SPAG_P_CAST2IDX( itr._destState ) << " [label=\"";
+					if( opt.showEventIndex )
+						f << "IE" << std::setw(2) << SPAG_P_CAST2IDX( itr._innerEvent );
+#ifdef SPAG_ENUM_STRINGS
+					if( opt.showEventString )
+					{
+						if( opt.showEventIndex )
+							f << ':';
+						f << _cfg->_strEvents.at(itr._innerEvent);
+					}
+#endif // SPAG_ENUM_STRINGS
+					f << '"';
+					if( opt.useColorsEventType )
+						f << ",color=red";
+					f << "];\n";
+				}
+			}
+		}
+#endif // SPAG_USE_SIGNALS
+	}
+	f << "}\n";
+
+// experimental
+/** idea: generate an html page embedding both the generated figure from the .dot file
+(using graphviz dot tool) and a list holding the string label of each node.
+The point was to add a link to the svg nodes, as this is supposed to work.
+
+Problem: it doesn't. The link works only if you load the svg file in the browser, but not
+if the svg file is loaded as an image inside the web page.
+*/
+#if 0
+#ifdef SPAG_ENUM_STRINGS
+	std::string full_fn2 = fname + ".html";
+	std::ofstream f2( full_fn2 );
+	if( !f2.is_open() )
+		SPAG_P_THROW_ERROR_RT( "error, unable to open file: " + full_fn2 );
+	f2 << "<html>\n<head>\n<title>";
+	f2 << fname;
+	f2 << "</title>\n</head>\n<body>\n";
+
+	f2 << "<img src=\"" << fname << ".svg\" alt=\"" << fname << "\">\n";
+	f2 << "<hr><ul>\n";
+	for( size_t j=0; j<nbStates(); j++ )
+	{
+		f2 << "<li id=\"node_" << j << "\">node " << j << ": " << _cfg->_strStates[j];
+		f2 << "</li>\n";
+	}
+	f2 << "</ul>\n";
+	f2 << "</body>\n";
+	f2 << "</html>\n";
+#endif
+#endif
+}
+
+//-----------------------------------------------------------------------------------
+/// Returns a binary image of the configuration (transition tables, timeouts, pass states, inner transitions and strings),
+/// that can be loaded with loadConfig()
+/**
+The callback functions and their values, and the ignored events callback are not part of the image.
+See the \c ConfigImageHeader type for the layout.
+*/
+template<typename ST, typename EV,typename T,typename CBA>
+std::vector<uint8_t>
+SpagFSM<ST,EV,T,CBA>::saveConfig() const
+{
+	const auto& cfg = *_cfg;
+	priv::ConfigImageHeader hdr;
+	std::memset( &hdr, 0, sizeof(hdr) );
+	std::memcpy( hdr._magic, "SPAGCFG", 8 );
+	hdr._version   = SPAG_P_CONFIG_IMAGE_VERSION;
+	hdr._byteOrder = 0x01020304;
+	hdr._nbStates  = static_cast<uint32_t>( nbStates() );
+	hdr._nbEvents  = static_cast<uint32_t>( nbEvents() );
+
+	priv::ConfigImageWriter wr;
+	wr.put( hdr );                                 // will be overwritten at the end
+
+	hdr._offTransitions = wr.startSection();
+	for( size_t e=0; e<nbEvents()+2; e++ )
+		for( size_t s=0; s<nbStates(); s++ )
+			wr.put( static_cast<uint32_t>( e < cfg._transitionMat.size() ? SPAG_P_CAST2IDX( cfg._transitionMat[e][s] ) : 0 ) );
+
+	hdr._offAllowed = wr.startSection();
+	for( size_t e=0; e<nbEvents(); e++ )
+		wr.putBytes( cfg._allowedMat[e].data(), nbStates() );
+
+	hdr._offStates = wr.startSection();
+	uint32_t nbInner = 0;
+	for( const auto& si: cfg._stateInfo )
+	{
+		priv::ConfigImageState rec;
+		std::memset( &rec, 0, sizeof(rec) );
+		rec._duration     = si._timerEvent._duration;
+		rec._nextState    = static_cast<uint32_t>( SPAG_P_CAST2IDX( si._timerEvent._nextState ) );
+		rec._timerEnabled = si._timerEvent._enabled;
+		rec._durUnit      = static_cast<uint8_t>( si._timerEvent._durUnit );
+		rec._innerFirst   = nbInner;
+#ifdef SPAG_USE_SIGNALS
+		rec._isPassState  = si._isPassState;
+		rec._innerCount   = static_cast<uint32_t>( si._innerTransList.size() );
+		if( si._isPassState || rec._innerCount )
+			hdr._flags |= priv::CIF_PassStates;
+#endif
+		nbInner += rec._innerCount;
+		wr.put( rec );
+	}
+	hdr._nbInnerTrans = nbInner;
+
+	hdr._offInnerTrans = wr.startSection();
+#ifdef SPAG_USE_SIGNALS
+	for( const auto& si: cfg._stateInfo )
+		for( const auto& it: si._innerTransList )
+		{
+			wr.put( static_cast<uint32_t>( SPAG_P_CAST2IDX( it._innerEvent ) ) );
+			wr.put( static_cast<uint32_t>( SPAG_P_CAST2IDX( it._destState ) ) );
+		}
+#endif
+
+	hdr._offInnerEvents = wr.startSection();
+	for( size_t e=0; e<nbEvents(); e++ )
+		wr.put( static_cast<uint8_t>( cfg._innerEvents.test( e ) ) );
+
+	hdr._offStrings = wr.startSection();
+#ifdef SPAG_ENUM_STRINGS
+	hdr._flags |= priv::CIF_Strings;
+	{
+		uint32_t off = static_cast<uint32_t>( ( nbStates() + nbEvents() + 3 ) * sizeof(uint32_t) );
+		for( const auto& str: cfg._strStates )
+		{
+			wr.put( off );
+			off += static_cast<uint32_t>( str.size() );
+		}
+		for( const auto& str: cfg._strEvents )
+		{
+			wr.put( off );
+			off += static_cast<uint32_t>( str.size() );
+		}
+		wr.put( off );
+		for( const auto& str: cfg._strStates )
+			wr.putBytes( str.data(), str.size() );
+		for( const auto& str: cfg._strEvents )
+			wr.putBytes( str.data(), str.size() );
+	}
+#endif
+	hdr._size = wr.startSection();
+	std::memcpy( wr.data().data(), &hdr, sizeof(hdr) );
+	return std::move( wr.data() );
+}
+
+//-----------------------------------------------------------------------------------
+/// Saves the configuration in binary file \c fname, see saveConfig()
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::saveConfig( const std::string& fname ) const
+{
+	auto image = saveConfig();
+	std::ofstream f( fname, std::ios::binary );
+	if( !f.is_open() )
+		SPAG_P_THROW_ERROR_RT( "unable to open file " + fname );
+	f.write( reinterpret_cast<const char*>( image.data() ), image.size() );
+}
+
+//-----------------------------------------------------------------------------------
+/// Loads a configuration image produced by saveConfig(), held in memory (for example a memory-mapped file, see MappedFile)
+/**
+Replaces the transition tables, timeouts, pass states, inner transitions and strings (if the image holds them and \c SPAG_ENUM_STRINGS is defined).
+The callbacks already assigned are kept.
+The tables are copied as whole blocks: no configuration function is called and no per-transition check is done,
+but the whole image is checked (header, sizes, all the state and event values, and the strings) before the configuration is modified.
+The FSM must not be running.
+Throws if the image is invalid, or has been produced by a FSM with a different number of states or events.
+*/
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::loadConfig( const void* data, size_t size )
+{
+	SPAG_P_ASSERT( !_isRunning, "unable to load a configuration in a running FSM" );
+	priv::ConfigImageReader rd( data, size );
+	auto hdr = rd.read<priv::ConfigImageHeader>( 0 );
+	if( std::memcmp( hdr._magic, "SPAGCFG", 8 ) || hdr._byteOrder != 0x01020304 )
+		SPAG_P_THROW_ERROR_RT( "not a configuration image, or byte order differs" );
+	if( hdr._version != SPAG_P_CONFIG_IMAGE_VERSION )
+		SPAG_P_THROW_ERROR_RT( "configuration image version " + std::to_string( hdr._version ) + " is not supported" );
+	if( hdr._nbStates != nbStates() || hdr._nbEvents != nbEvents() )
+		SPAG_P_THROW_ERROR_RT(
+			"configuration image has " + std::to_string( hdr._nbStates ) + " states and " + std::to_string( hdr._nbEvents )
+			+ " events, FSM has " + std::to_string( nbStates() ) + " states and " + std::to_string( nbEvents() ) + " events"
+		);
+	if( hdr._size > size )
+		SPAG_P_THROW_ERROR_RT( "truncated or invalid configuration image" );
+#ifndef SPAG_USE_SIGNALS
+	if( hdr._flags & priv::CIF_PassStates )
+		SPAG_P_THROW_ERROR_RT( "configuration image holds pass states or inner transitions, this requires SPAG_USE_SIGNALS" );
+#endif
+	const auto nbS = nbStates();
+	const auto nbE = nbEvents();
+
+	rd.bytes( hdr._offTransitions, (nbE+2)*nbS*sizeof(uint32_t) );    // bounds of the sections
+	auto allowed = rd.bytes( hdr._offAllowed, nbE*nbS );
+	rd.bytes( hdr._offStates, nbS*sizeof(priv::ConfigImageState) );
+	rd.bytes( hdr._offInnerTrans, 2*size_t(hdr._nbInnerTrans)*sizeof(uint32_t) );
+	rd.bytes( hdr._offInnerEvents, nbE );
+
+	auto trans = [&]( size_t i ){ return rd.read<uint32_t>( hdr._offTransitions, i ); };
+	auto inner = [&]( size_t i ){ return rd.read<uint32_t>( hdr._offInnerTrans, i ); };
+	std::vector<priv::ConfigImageState> states( nbS );
+	for( size_t i=0; i<nbS; i++ )
+		states[i] = rd.read<priv::ConfigImageState>( hdr._offStates, i );
+
+	for( size_t i=0; i<(nbE+2)*nbS; i++ )          // check everything before modifying the configuration
+		if( trans(i) >= nbS )
+			SPAG_P_THROW_ERROR_RT( "invalid state value in configuration image" );
+	for( size_t i=0; i<nbS; i++ )
+		if(
+			states[i]._nextState >= nbS
+			|| states[i]._durUnit > static_cast<uint8_t>( DurUnit::ns )
+			|| size_t(states[i]._innerFirst) + states[i]._innerCount > hdr._nbInnerTrans
+		)
+			SPAG_P_THROW_ERROR_RT( "invalid state information in configuration image" );
+	for( size_t i=0; i<hdr._nbInnerTrans; i++ )
+		if( inner(2*i) >= nbE || inner(2*i+1) >= nbS )
+			SPAG_P_THROW_ERROR_RT( "invalid inner transition in configuration image" );
+#ifdef SPAG_ENUM_STRINGS
+	const size_t nbStr = nbS + nbE + 2;
+	std::vector<uint32_t> offs;                    // offsets of the strings
+	const char* chars = nullptr;
+	if( hdr._flags & priv::CIF_Strings )
+	{
+		rd.bytes( hdr._offStrings, (nbStr+1)*sizeof(uint32_t) );
+		for( size_t i=0; i<=nbStr; i++ )
+			offs.push_back( rd.read<uint32_t>( hdr._offStrings, i ) );
+		chars = rd.bytes( hdr._offStrings, offs[nbStr] );
+		for( size_t i=0; i<nbStr; i++ )
+			if( offs[i] > offs[i+1] )
+				SPAG_P_THROW_ERROR_RT( "invalid string table in configuration image" );
+	}
+#endif
+
+	auto& cfg = wcfg();
+	for( size_t e=0; e<cfg._transitionMat.size(); e++ )
+		for( size_t s=0; s<nbS; s++ )
+			cfg._transitionMat[e][s] = static_cast<ST>( trans(e*nbS+s) );
+	for( size_t e=0; e<nbE; e++ )
+		std::memcpy( cfg._allowedMat[e].data(), allowed + e*nbS, nbS );
+
+	for( size_t i=0; i<nbS; i++ )
+	{
+		auto& te = cfg._stateInfo[i]._timerEvent;
+		te._duration  = static_cast<Duration>( states[i]._duration );
+		te._nextState = static_cast<ST>( states[i]._nextState );
+		te._enabled   = states[i]._timerEnabled != 0;
+		te._durUnit   = static_cast<DurUnit>( states[i]._durUnit );
+#ifdef SPAG_USE_SIGNALS
+		auto& si = cfg._stateInfo[i];
+		si._isPassState = states[i]._isPassState != 0;
+		si._innerTransList.clear();
+		for( size_t j=states[i]._innerFirst; j<states[i]._innerFirst + states[i]._innerCount; j++ )
+			si._innerTransList.emplace_back( static_cast<EV>( inner(2*j) ), static_cast<ST>( inner(2*j+1) ) );
+#endif
+	}
+	for( size_t e=0; e<nbE; e++ )
+		cfg._innerEvents.set( e, rd.read<uint8_t>( hdr._offInnerEvents, e ) != 0 );
+
+#ifdef SPAG_ENUM_STRINGS
+	if( chars )
+		for( size_t i=0; i<nbStr; i++ )
+		{
+			auto& str = i < nbS ? cfg._strStates[i] : cfg._strEvents[i-nbS];
+			str.assign( chars + offs[i], offs[i+1] - offs[i] );
+		}
+#endif
+}
+
+//-----------------------------------------------------------------------------------
+/// Loads the configuration from binary file \c fname, produced by saveConfig( const std::string& ). The file is memory-mapped if \c SPAG_USE_MMAP is defined
+template<typename ST, typename EV,typename T,typename CBA>
+void
+SpagFSM<ST,EV,T,CBA>::loadConfig( const std::string& fname )
+{
+#ifdef SPAG_USE_MMAP
+	MappedFile file( fname );
+	loadConfig( file.data(), file.size() );
+#else
+	std::ifstream f( fname, std::ios::binary );
+	if( !f.is_open() )
+		SPAG_P_THROW_ERROR_RT( "unable to open file " + fname );
+	std::vector<char> image( ( std::istreambuf_iterator<char>( f ) ), std::istreambuf_iterator<char>() );
+	loadConfig( image.data(), image.size() );
+#endif
+}
+//-----------------------------------------------------------------------------------
+namespace priv {
+
+/// Dummy type, used if no timer requested by user
+template<typename ST, typename EV,typename CBA>
+struct NoTimer
+{
+	void timerStart( const SpagFSM<ST,EV,NoTimer,CBA>* ) {}
+	void timerStartFor( const SpagFSM<ST,EV,NoTimer,CBA>*, uint64_t ) {}
+	uint64_t timerRemaining() const { return 0; }
+	void init(  const SpagFSM<ST,EV,NoTimer,CBA>* ) {}
+	void timerCancel() {}
+	void kill() {}
+	void postDrain( const SpagFSM<ST,EV,NoTimer,CBA>* ) {}
+};
+
+} // namespace priv
+
+#ifdef SPAG_USE_TIMER_WHEEL
+//-----------------------------------------------------------------------------------
+/// Hierarchical timing wheel, can be shared by a large number of FSM (through the WheelTimer event handler)
+/**
+Timers are intrusive nodes (held by the user, here by the WheelTimer objects), so starting and canceling a timer is O(1)
+and does not allocate anything.
+
+The wheel has 4 levels of 256 slots. A timer of \c n ticks is stored on level 0 if n<256,
+on level 1 if n<256^2, and so on. Each time the lower levels have done a full turn, the timers of the next slot of the upper
+level are moved down ("cascade"), until they reach level 0, where they expire.
+
+The wheel does not hold any thread: the user code must call tick() at the given resolution,
+or advance() / update() that process all the elapsed ticks at once. Expired timers run their callback during that call.
+Not thread-safe: all the FSM using a wheel, and the wheel itself, must be used from the same thread.
+*/
+class TimerWheel
+{
+	static constexpr size_t LevelBits = 8;
+	static constexpr size_t NbSlots   = size_t(1) << LevelBits;
+	static constexpr size_t NbLevels  = 4;
+
+	public:
+/// A timer of the wheel
+		struct Node
+		{
+			Node*        _prev   = nullptr;
+			Node*        _next   = nullptr;
+			uint64_t     _expiry = 0;         ///< tick at which the timer expires
+			void       (*_func)( void* ) = nullptr;  ///< called on expiry
+			void*        _arg    = nullptr;   ///< argument of \c _func
+
+			bool isLinked() const
+			{
+				return _next != nullptr;
+			}
+		};
+
+/// Constructor, \c resolution is the duration of a tick, in ms
+		explicit TimerWheel( Duration resolution=1 ) : _resolution( resolution )
+		{
+			SPAG_P_ASSERT( resolution > 0, "tick duration must not be null" );
+			for( auto& level: _slots )
+				for( auto& head: level )
+					head._prev = head._next = &head;
+			_startTime = std::chrono::steady_clock::now();
+		}
+		TimerWheel( const TimerWheel& ) = delete;
+
+/// Returns the duration of a tick, in ms
+		Duration resolution() const
+		{
+			return _resolution;
+		}
+/// Returns the number of ticks elapsed since creation
+		uint64_t now() const
+		{
+			return _current;
+		}
+/// Returns the number of ticks before timer \c node expires (0 if not running)
+		uint64_t remaining( const Node& node ) const
+		{
+			return node.isLinked() ? node._expiry - _current : 0;
+		}
+/// Returns the number of pending timers
+		size_t size() const
+		{
+			return _size;
+		}
+
+/// Converts a duration into a number of ticks (rounded up, at least 1)
+		uint64_t toTicks( Duration dur, DurUnit unit ) const
+		{
+			const uint64_t tickNs = uint64_t(_resolution) * 1000000;
+			auto ticks = ( priv::toNanoseconds( dur, unit ) + tickNs - 1 ) / tickNs;
+			return ticks ? ticks : 1;
+		}
+
+/// Starts timer \c node, that will expire in \c ticks ticks. If it is already running, it is restarted
+		void schedule( Node& node, uint64_t ticks )
+		{
+			cancel( node );
+			node._expiry = _current + ( ticks ? ticks : 1 );
+			insert( node );
+			_size++;
+		}
+
+/// Cancels timer \c node, does nothing if it is not running
+		void cancel( Node& node )
+		{
+			if( node.isLinked() )
+			{
+				unlink( node );
+				_size--;
+			}
+		}
+
+/// Processes one tick. Returns the number of timers that expired
+		size_t tick()
+		{
+			_current++;
+			for( size_t level=1; level<NbLevels; level++ )   // cascade the upper levels, if the lower ones have done a full turn
+			{
+				if( _current & ( ( uint64_t(1) << (LevelBits*level) ) - 1 ) )
+					break;
+				Node& head = _slots[level][ ( _current >> (LevelBits*level) ) & (NbSlots-1) ];
+				while( head._next != &head )
+				{
+					Node& node = *head._next;
+					unlink( node );
+					insert( node );
+				}
+			}
+
+			Node expired;                                  // move the expired timers into a local list, as the callbacks may start or cancel timers
+			expired._prev = expired._next = &expired;
+			Node& head = _slots[0][ _current & (NbSlots-1) ];
+			while( head._next != &head )
+			{
+				Node& node = *head._next;
+				unlink( node );
+				if( node._expiry > _current )              // can happen for timers longer than the wheel range
+					insert( node );
+				else
+					linkBefore( node, expired );
+			}
+
+			size_t nb = 0;
+			while( expired._next != &expired )
+			{
+				Node& node = *expired._next;
+				unlink( node );
+				_size--;
+				nb++;
+				node._func( node._arg );
+			}
+			return nb;
+		}
+
+/// Processes \c nb ticks. Returns the number of timers that expired
+		size_t advance( uint64_t nb )
+		{
+			size_t nbExp = 0;
+			for( uint64_t i=0; i<nb; i++ )
+				nbExp += tick();
+			return nbExp;
 		}
-/// Assign strings to enum state values (available only if option SPAG_ENUM_STRINGS is enabled) - overload 1
-		void assignStrings2States( std::map<ST,std::string>& m_str )
+
+/// Processes all the ticks elapsed (according to \c std::chrono::steady_clock) since last call. Returns the number of timers that expired
+		size_t update()
+		{
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - _startTime ).count();
+			auto target  = static_cast<uint64_t>(elapsed) / _resolution;
+			return target > _current ? advance( target - _current ) : 0;
+		}
+
+	private:
+		static void linkBefore( Node& node, Node& pos )
+		{
+			node._prev = pos._prev;
+			node._next = &pos;
+			pos._prev->_next = &node;
+			pos._prev = &node;
+		}
+		static void unlink( Node& node )
+		{
+			node._prev->_next = node._next;
+			node._next->_prev = node._prev;
+			node._prev = node._next = nullptr;
+		}
+/// Stores \c node in the slot corresponding to its expiry
+		void insert( Node& node )
+		{
+			uint64_t delta = node._expiry > _current ? node._expiry - _current : 0;
+			for( size_t level=0; level<NbLevels; level++ )
+				if( delta < ( uint64_t(1) << (LevelBits*(level+1)) ) )
+				{
+					linkBefore( node, _slots[level][ ( node._expiry >> (LevelBits*level) ) & (NbSlots-1) ] );
+					return;
+				}
+			size_t top = LevelBits*(NbLevels-1);              // beyond range: store it in the furthest slot, it will be re-inserted when moved down
+			linkBefore( node, _slots[NbLevels-1][ ( ( _current >> top ) - 1 ) & (NbSlots-1) ] );
+		}
+
+	private:
+		std::array<std::array<Node,NbSlots>,NbLevels> _slots;  ///< holds the list heads
+		uint64_t _current = 0;
+		size_t   _size    = 0;
+		Duration _resolution;
+		std::chrono::time_point<std::chrono::steady_clock> _startTime;
+};
+
+//-----------------------------------------------------------------------------------
+/// Event handler using a shared TimerWheel. Each FSM needs its own WheelTimer, but they can all use the same wheel
+/**
+Usage:
+\code
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+spag::TimerWheel wheel;
+spag::WheelTimer<States,Events,int> timer( wheel );
+fsm.assignEventHandler( &timer );
+fsm.start();   // non blocking
+for(;;)
+	wheel.update();
+\endcode
+*/
+template<typename ST, typename EV, typename CBA>
+struct WheelTimer
+{
+	using Fsm_t = SpagFSM<ST,EV,WheelTimer,CBA>;
+
+	explicit WheelTimer( TimerWheel& wheel ) : _wheel( wheel )
+	{
+		_node._func = &WheelTimer::onExpiry;
+		_node._arg  = this;
+	}
+	WheelTimer( const WheelTimer& ) = delete;
+	~WheelTimer()
+	{
+		_wheel.cancel( _node );
+	}
+
+/// Mandatory function for SpagFSM. Called when FSM is started, non blocking
+	void init( const Fsm_t* fsm )
+	{
+		_fsm = fsm;
+	}
+/// Mandatory function for SpagFSM. Starts the timer with the duration of the current state
+	void timerStart( const Fsm_t* fsm )
+	{
+		_fsm = fsm;
+		auto duration = fsm->timeOutDuration( fsm->currentState() );
+		_wheel.schedule( _node, _wheel.toTicks( duration.first, duration.second ) );
+	}
+/// Starts the timer with duration \c ns (nanoseconds), used by SpagFSM::restore()
+	void timerStartFor( const Fsm_t* fsm, uint64_t ns )
+	{
+		_fsm = fsm;
+		_wheel.schedule( _node, _wheel.toTicks( ns, DurUnit::ns ) );
+	}
+/// Returns the time before the timer expires, in ns (0 if not running), used by SpagFSM::snapshot()
+	uint64_t timerRemaining() const
+	{
+		return _wheel.remaining( _node ) * _wheel.resolution() * 1000000;
+	}
+/// Mandatory function for SpagFSM. Cancels the pending timer
+	void timerCancel()
+	{
+		_wheel.cancel( _node );
+	}
+	void kill()
+	{
+		_wheel.cancel( _node );
+	}
+/// Posted events (see SpagFSM::postEvent() ) must be processed by user code, with SpagFSM::processPostedEvents()
+	void postDrain( const Fsm_t* ) {}
+
+	private:
+		static void onExpiry( void* p )
+		{
+			static_cast<WheelTimer*>(p)->_fsm->processTimeOut();
+		}
+
+		TimerWheel&       _wheel;
+		TimerWheel::Node  _node;
+		const Fsm_t*      _fsm = nullptr;
+};
+
+#ifdef SPAG_USE_FSM_ENGINE
+namespace priv {
+//-----------------------------------------------------------------------------------
+/// Bump allocator, returning blocks aligned on a cache line, and whose size is a multiple of it (so two blocks never share a cache line)
+/**
+Memory is taken from the system by chunks of \c SPAG_ARENA_CHUNK_SIZE bytes, and is only released by the destructor.
+The chunks are not written when allocated: on systems having a "first touch" policy (Linux), their pages are thus placed
+on the NUMA node of the thread that first writes into them, i.e. that constructs the objects.
+Destructors of the objects are not called, see FsmEngine::Shard.
+*/
+class Arena
+{
+	public:
+		Arena() = default;
+		Arena( const Arena& ) = delete;
+
+		void* allocate( size_t size )
+		{
+			size = ( size + SPAG_P_CACHE_LINE - 1 ) & ~size_t( SPAG_P_CACHE_LINE - 1 );
+			if( size > _left )
+			{
+				auto chunkSize = std::max( size, size_t( SPAG_ARENA_CHUNK_SIZE ) );
+				_chunks.emplace_back( new char[ chunkSize + SPAG_P_CACHE_LINE ] );
+				auto addr = reinterpret_cast<uintptr_t>( _chunks.back().get() );
+				_ptr  = _chunks.back().get() + ( SPAG_P_CACHE_LINE - addr % SPAG_P_CACHE_LINE ) % SPAG_P_CACHE_LINE;
+				_left = chunkSize;
+			}
+			auto p = _ptr;
+			_ptr  += size;
+			_left -= size;
+			return p;
+		}
+		size_t nbChunks() const
+		{
+			return _chunks.size();
+		}
+
+	private:
+		std::vector<std::unique_ptr<char[]>> _chunks;
+		char*  _ptr  = nullptr;
+		size_t _left = 0;
+};
+} // namespace priv
+
+//-----------------------------------------------------------------------------------
+/// Runs a set of FSM over a fixed pool of threads ("shards"), each having its own timer wheel and event queue
+/**
+Each FSM instance is pinned to a shard, according to its identifier (returned by addInstance()): shard = id % nbShards.
+All the processing of a given FSM (callbacks, timeouts, events) is done by the thread of its shard,
+so the FSM itself needs no locking, while the total throughput scales with the number of shards.
+
+Usage:
+\code
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+std::vector<fsm_t> vfsm( 1000 );
+spag::FsmEngine<States,Events,int> engine( 4 );
+for( auto& fsm: vfsm )
+{
+	// configure fsm
+	engine.addInstance( fsm );
+}
+engine.run();                   // non blocking
+engine.postEvent( 123, ev_1 );  // from any thread
+...
+engine.stop();
+\endcode
+
+Instead of adding FSM objects owned by the user code, the engine can create the instances itself, with createInstance():
+each of them is then built by the thread of its shard, in a memory arena of that shard, together with its timer,
+in a block aligned on a cache line. Thus two instances never share a cache line (no false sharing between shards),
+and the instances are allocated on the NUMA node of the shard thread (as long as this one does not move).
+
+\warning The callbacks are run on the shard threads: they must not throw,
+and must not access the FSM of another shard other than through postEvent().
+*/
+template<typename ST, typename EV, typename CBA=int>
+class FsmEngine
+{
+	public:
+		using Fsm_t   = SpagFSM<ST,EV,WheelTimer<ST,EV,CBA>,CBA>;
+		using Timer_t = WheelTimer<ST,EV,CBA>;
+
+/// Constructor. If \c nbShards is 0, then one shard per hardware thread is used. \c resolution is the tick duration of the timer wheels, in ms
+		explicit FsmEngine( size_t nbShards=0, Duration resolution=1 )
+		{
+			if( nbShards == 0 )
+				nbShards = std::max( 1u, std::thread::hardware_concurrency() );
+			for( size_t i=0; i<nbShards; i++ )
+				_shards.emplace_back( new Shard( resolution ) );
+		}
+		FsmEngine( const FsmEngine& ) = delete;
+		~FsmEngine()
+		{
+			if( _isRunning )
+				stop();
+		}
+
+		size_t nbShards()    const { return _shards.size(); }
+		size_t nbInstances() const { return _nbInstances; }
+		bool   isRunning()   const { return _isRunning; }
+/// Returns the index of the shard (thereafter, the thread) handling FSM instance \c id
+		size_t shardOf( size_t id ) const
+		{
+			return id % _shards.size();
+		}
+
+/// Adds the (configured but not started) FSM \c fsm to the engine, and returns its identifier
+/**
+The engine assigns to the FSM an event handler (a WheelTimer, using the wheel of the shard).
+Must be called before run().
+*/
+		size_t addInstance( Fsm_t& fsm )
+		{
+			SPAG_P_ASSERT( !_isRunning, "unable to add an FSM instance to a running engine" );
+			SPAG_P_ASSERT( !fsm.isRunning(), "unable to add a running FSM instance" );
+			auto id = _nbInstances++;
+			auto& shard = *_shards[ shardOf( id ) ];
+			shard._timers.emplace_back( new Timer_t( shard._wheel ) );
+			fsm.assignEventHandler( shard._timers.back().get() );
+			shard._fsm.push_back( &fsm );
+			return id;
+		}
+
+/// Creates a FSM instance owned by the engine, sharing the configuration of \c model (see SpagFSM::assignConfig() ), and returns its identifier
+/**
+The instance is built when run() is called, by the thread of its shard, so its memory is local to that thread (see class description).
+It can be accessed with instance() once run() has returned, and is destroyed with the engine.
+Must be called before run(), and the model must be kept unchanged until run() has returned.
+Only the configuration is shared: the settings of the model that are not part of it (timer reuse, default timer values, ...) are not copied.
+*/
+		size_t createInstance( const Fsm_t& model )
+		{
+			SPAG_P_ASSERT( !_isRunning, "unable to add an FSM instance to a running engine" );
+			model.prepareCfg();                           // done here, so the shard threads only read the configuration
+			auto id = _nbInstances++;
+			auto& shard = *_shards[ shardOf( id ) ];
+			shard._pending.emplace_back( shard._fsm.size(), &model );
+			shard._fsm.push_back( nullptr );
+			return id;
+		}
+
+/// Returns the FSM instance \c id (added with addInstance() or created with createInstance(), in which case run() must have been called)
+		Fsm_t& instance( size_t id )
+		{
+			SPAG_CHECK_LESS( id, _nbInstances );
+			auto fsm = _shards[ shardOf( id ) ]->_fsm[ id / _shards.size() ];
+			SPAG_P_ASSERT( fsm, "instance has not been built yet, run() must be called first" );
+			return *fsm;
+		}
+
+/// Starts the threads, and returns once they have built the instances created with createInstance(). Each thread starts the FSM of its shard
+		void run()
+		{
+			SPAG_P_ASSERT( !_isRunning, "attempt to run an already running engine" );
+			_isRunning = true;
+			for( auto& shard: _shards )
+			{
+				shard->_stopReq.store( false );
+				shard->_built = shard->_pending.empty();
+				Shard* sh = shard.get();
+				shard->_thread = std::thread( [sh](){ FsmEngine::worker( *sh ); } );
+			}
+			for( auto& shard: _shards )
+			{
+				std::unique_lock<std::mutex> lock( shard->_mutex );
+				shard->_cv.wait( lock, [&shard](){ return shard->_built; } );
+			}
+		}
+
+/// Stops the engine: the events already posted are processed, then the FSM are stopped and the threads joined
+		void stop()
+		{
+			SPAG_P_ASSERT( _isRunning, "attempt to stop an engine that is not running" );
+			for( auto& shard: _shards )
+			{
+				std::lock_guard<std::mutex> lock( shard->_mutex );
+				shard->_stopReq.store( true );
+				shard->_cv.notify_one();
+			}
+			for( auto& shard: _shards )
+				shard->_thread.join();
+			_isRunning = false;
+		}
+
+/// Posts event \c ev to FSM instance \c id. Can be called from any thread, never blocks (except for waking up the shard thread)
+/**
+Returns false if the queue of the shard is full (see symbol \c SPAG_EVENT_QUEUE_SIZE), in which case the event is dropped.
+Also returns false if \c id or \c ev is not valid: this is checked whatever the build options, as they can come from the network.
+*/
+		bool postEvent( size_t id, EV ev )
+		{
+			if( id >= _nbInstances || SPAG_P_CAST2IDX(ev) >= SPAG_P_CAST2IDX(EV::NB_EVENTS) )
+				return false;
+			auto& shard = *_shards[ shardOf( id ) ];
+			if( !shard._queue.push( std::make_pair( id / _shards.size(), ev ) ) )
+				return false;
+			std::atomic_thread_fence( std::memory_order_seq_cst );   // so that the shard thread either sees the event, or is seen sleeping
+			if( shard._sleeping.load() )
+			{
+				std::lock_guard<std::mutex> lock( shard._mutex );
+				shard._cv.notify_one();
+			}
+			return true;
+		}
+
+	private:
+/// An instance created by createInstance(): the FSM, followed by its timer, in a single block of the arena
+		struct Instance
+		{
+			explicit Instance( TimerWheel& wheel ) : _timer( wheel )
+			{}
+			Fsm_t   _fsm;
+			Timer_t _timer;
+		};
+
+/// A shard: a thread, with its own timer wheel, event queue and set of FSM
+		struct Shard
+		{
+			explicit Shard( Duration resolution ) : _wheel( resolution )
+			{}
+			~Shard()
+			{
+				for( auto inst: _instances )
+					inst->~Instance();
+			}
+/// Builds the instances requested with createInstance(), called by the shard thread
+			void build()
+			{
+				for( const auto& req: _pending )
+				{
+					auto inst = new( _arena.allocate( sizeof(Instance) ) ) Instance( _wheel );
+					_instances.push_back( inst );
+					inst->_fsm.assignConfig( *req.second );
+					inst->_fsm.assignEventHandler( &inst->_timer );
+					_fsm[ req.first ] = &inst->_fsm;
+				}
+				_pending.clear();
+				std::lock_guard<std::mutex> lock( _mutex );
+				_built = true;
+				_cv.notify_all();
+			}
+			TimerWheel                            _wheel;
+			std::vector<std::unique_ptr<Timer_t>> _timers;
+			std::vector<Fsm_t*>                   _fsm;     ///< FSM of the shard, indexed by id / nbShards
+			priv::Arena                           _arena;   ///< holds the instances created with createInstance()
+			std::vector<Instance*>                _instances;
+			std::vector<std::pair<size_t,const Fsm_t*>> _pending;   ///< instances to build: index in \c _fsm, and model
+			bool                                  _built = false;   ///< set once the pending instances are built (protected by \c _mutex)
+			priv::MpscQueue<std::pair<size_t,EV>,SPAG_EVENT_QUEUE_SIZE> _queue;
+			std::thread                           _thread;
+			std::mutex                            _mutex;
+			std::condition_variable               _cv;
+			std::atomic<bool>                     _sleeping{false};
+			std::atomic<bool>                     _stopReq{false};
+		};
+
+/// Thread function of a shard
+		static void worker( Shard& shard )
+		{
+			if( !shard._pending.empty() )
+				shard.build();
+			shard._wheel.update();             // so the time elapsed since construction does not expire the timers started below
+			for( auto fsm: shard._fsm )
+				fsm->start();                  // non blocking with the WheelTimer
+			for(;;)
+			{
+				bool stopReq = shard._stopReq.load();    // read before draining, so the events posted before stop() are processed
+				std::pair<size_t,EV> elem;
+				for( size_t i=0; i<SPAG_EVENT_QUEUE_SIZE && shard._queue.pop( elem ); i++ )
+				{
+					auto fsm = shard._fsm[ elem.first ];
+					if( fsm->isRunning() )
+						fsm->processEvent( elem.second );
+				}
+				shard._wheel.update();
+				if( stopReq && shard._queue.empty() )
+					break;
+
+				std::unique_lock<std::mutex> lock( shard._mutex );
+				shard._sleeping.store( true );
+				std::atomic_thread_fence( std::memory_order_seq_cst );
+				if( shard._queue.empty() && !shard._stopReq.load() )
+					shard._cv.wait_for( lock, std::chrono::milliseconds( shard._wheel.resolution() ) );
+				shard._sleeping.store( false );
+			}
+			for( auto fsm: shard._fsm )
+				if( fsm->isRunning() )
+					fsm->stop();
+		}
+
+		std::vector<std::unique_ptr<Shard>> _shards;
+		size_t                              _nbInstances = 0;
+		bool                                _isRunning   = false;
+};
+#endif // SPAG_USE_FSM_ENGINE
+#endif // SPAG_USE_TIMER_WHEEL
+
+#ifdef SPAG_USE_FSM_POOL
+//-----------------------------------------------------------------------------------
+/// A set of instances of a same FSM, that only stores their current states, contiguously ("struct of arrays"), to process an event on all of them at once
+/**
+All the instances share the configuration of a given FSM (the "model", see constructor), and the callbacks are those of the model.
+The main function is apply(), that processes a given event on all the instances (or a subset of them, with a mask),
+in two steps:
+-# compute the next state of every instance, from the row of the transition table associated to the event
+(with AVX2 gathers if available, i.e. if the build targets a CPU having it, a plain loop otherwise, that the compiler may vectorize)
+-# run the callback only for the instances that did a transition (and follow the pass-states, if any)
+
+Compared to a call of SpagFSM::processEvent() on each FSM object, this avoids loading a whole FSM object per instance,
+and the ignored events cost nearly nothing.
+
+Limitations: there is no timer handling (timeouts must be processed by the user code with processTimeOut() ),
+inner events are not handled, and no logging is done.
+Only the callbacks of the states are called: exit callbacks and transition actions (see \c SPAG_USE_TRANSITION_ACTIONS) are not.
+Later configuration changes on the model are not seen by the pool (the model then does a copy on write).
+*/
+template<typename ST, typename EV, typename CBA=int>
+class FsmPool
+{
+	static constexpr size_t NbStates = SPAG_P_CAST2IDX(ST::NB_STATES);
+	static constexpr size_t NbEvents = SPAG_P_CAST2IDX(EV::NB_EVENTS);
+/// Flag set in the rows of \c _next when the event is ignored
+	static constexpr uint32_t Ignored = 0x80000000u;
+
+	public:
+/// Constructor: \c nbInstances instances, all on the initial state, with the configuration of \c model (no callback is called here, see start() )
+		template<typename TIM>
+		FsmPool( const SpagFSM<ST,EV,TIM,CBA>& model, size_t nbInstances )
+			: _cfg( model._cfg ), _current( nbInstances, 0 )
+		{
+			model._cfg->build();
+			_next.resize( NbEvents * NbStates );
+			for( size_t e=0; e<NbEvents; e++ )
+				for( size_t s=0; s<NbStates; s++ )
+					_next[ e*NbStates + s ] = ( _cfg->_allowedMat[e][s] == 1 )
+						? static_cast<uint32_t>( _cfg->_transitionMat[e][s] )
+						: static_cast<uint32_t>( s ) | Ignored;
+			_changed.reserve( nbInstances );
+		}
+
+		size_t size() const { return _current.size(); }
+
+/// Runs the callback of the current state of all the instances (and follows the pass-states), as SpagFSM::start() does
+		void start()
+		{
+			for( size_t id=0; id<_current.size(); id++ )
+				runAction( id );
+		}
+
+		ST currentState( size_t id ) const
+		{
+			SPAG_CHECK_LESS( id, _current.size() );
+			return static_cast<ST>( _current[id] );
+		}
+/// Sets the state of instance \c id, without calling its callback
+		void setState( size_t id, ST st )
+		{
+			SPAG_CHECK_LESS( id, _current.size() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), NbStates );
+			_current[id] = static_cast<uint32_t>( st );
+		}
+
+/// Processes event \c ev on all the instances. Returns the number of instances that did a transition
+		size_t apply( EV ev )
+		{
+			return applyImpl( ev, nullptr );
+		}
+/// Processes event \c ev on the instances \c i having <code>mask[i] != 0</code>. Returns the number of instances that did a transition
+		size_t apply( EV ev, const std::vector<uint8_t>& mask )
+		{
+			if( mask.size() != _current.size() )
+				SPAG_P_THROW_ERROR_RT( "mask size (" + std::to_string( mask.size() ) + ") differs from pool size (" + std::to_string( _current.size() ) + ')' );
+			return applyImpl( ev, mask.data() );
+		}
+
+/// Processes event \c ev on instance \c id only. Returns true if it did a transition
+		bool processEvent( size_t id, EV ev )
+		{
+			SPAG_CHECK_LESS( id, _current.size() );
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), NbEvents );
+			auto v = _next[ SPAG_P_CAST2IDX(ev)*NbStates + _current[id] ];
+			if( v & Ignored )
+				return false;
+			_current[id] = v;
+			runAction( id );
+			return true;
+		}
+/// Processes the timeout of the current state of instance \c id (must have one)
+		void processTimeOut( size_t id )
+		{
+			SPAG_CHECK_LESS( id, _current.size() );
+			const auto& tev = _cfg->_stateInfo[ _current[id] ]._timerEvent;
+			SPAG_P_ASSERT( tev._enabled, "current state has no timeout" );
+			_current[id] = static_cast<uint32_t>( tev._nextState );
+			runAction( id );
+		}
+
+/// Returns the instances that did a transition during the last call of apply(), in increasing order
+/// (empty while its callbacks are running; if one of them called apply() again, the instances of that nested call)
+		const std::vector<size_t>& lastChanged() const
+		{
+			return _changed;
+		}
+/// Returns the instance whose callback is running (to be called from a callback, as they are shared by all the instances)
+		size_t currentInstance() const
+		{
+			return _currentId;
+		}
+
+	private:
+		size_t applyImpl( EV ev, const uint8_t* mask )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), NbEvents );
+			const uint32_t* row = _next.data() + SPAG_P_CAST2IDX(ev) * NbStates;
+			uint32_t* cur = _current.data();
+			size_t nb = _current.size();
+			size_t i = 0;
+			_changed.clear();
+
+// step 1: compute next states
+#ifdef __AVX2__
+			const __m256i flag = _mm256_set1_epi32( static_cast<int>(Ignored) );
+			const __m256i zero = _mm256_setzero_si256();
+			for( ; i+8 <= nb; i += 8 )
+			{
+				__m256i vcur = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( cur+i ) );
+				__m256i vnext = _mm256_i32gather_epi32( reinterpret_cast<const int*>(row), vcur, 4 );
+				__m256i trans = _mm256_cmpeq_epi32( _mm256_and_si256( vnext, flag ), zero );      // all ones if transition
+				if( mask )
+				{
+					__m128i m8 = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( mask+i ) );
+					__m256i sel = _mm256_cmpeq_epi32( _mm256_cvtepu8_epi32( m8 ), zero );            // all ones if NOT selected
+					trans = _mm256_andnot_si256( sel, trans );
+				}
+				int bits = _mm256_movemask_ps( _mm256_castsi256_ps( trans ) );
+				if( bits )
+				{
+					_mm256_storeu_si256( reinterpret_cast<__m256i*>( cur+i ), _mm256_blendv_epi8( vcur, vnext, trans ) );
+					for( size_t k=0; k<8; k++ )
+						if( bits & (1<<k) )
+							_changed.push_back( i+k );
+				}
+			}
+#endif
+			for( ; i<nb; i++ )
+			{
+				auto v = row[ cur[i] ];
+				if( !( v & Ignored ) && ( !mask || mask[i] ) )
+				{
+					cur[i] = v;
+					_changed.push_back( i );
+				}
+			}
+
+// step 2: run the callbacks. The list is moved out meanwhile, so that a callback can call apply() again (that one then fills \c _changed)
+			std::vector<size_t> changed;
+			changed.swap( _changed );
+			for( auto id: changed )
+				runAction( id );
+			auto nbChanged = changed.size();
+			if( _changed.empty() )              // no nested call: the list is kept, with its capacity
+				_changed.swap( changed );
+			return nbChanged;
+		}
+
+/// Calls the callback of the current state of instance \c id, then follows the pass-states
+		void runAction( size_t id )
+		{
+			_currentId = id;
+			for(;;)
+			{
+				const auto& stinf = _cfg->_stateInfo[ _current[id] ];
+				if( stinf._rawCallback )
+					stinf._rawCallback( stinf._rawContext, stinf._callbackArg );
+				else if( stinf._callback )
+					stinf._callback( stinf._callbackArg );
+#ifdef SPAG_USE_SIGNALS
+				if( !stinf._isPassState )
+					break;
+				_current[id] = static_cast<uint32_t>( _cfg->_transitionMat[ NbEvents+1 ][ _current[id] ] );
+#else
+				break;
+#endif
+			}
+		}
+
+	private:
+		std::shared_ptr<const priv::FsmConfig<ST,EV,CBA>> _cfg;  ///< shared with the model FSM (copy on write)
+		std::vector<uint32_t> _next;      ///< for each event, a row giving for each state its next state, or itself with flag \c Ignored
+		std::vector<uint32_t> _current;   ///< current state of each instance
+		std::vector<size_t>   _changed;   ///< instances that did a transition during last apply()
+		size_t                _currentId = 0;
+};
+#endif // SPAG_USE_FSM_POOL
+
+#ifdef SPAG_ENABLE_TRACE
+//-----------------------------------------------------------------------------------
+/// Event handler that never triggers any timeout by itself: to be used by a FSM fed by a TraceReplayer, where the timeouts come from the trace
+template<typename ST, typename EV, typename CBA>
+struct ReplayTimer
+{
+	void init( const SpagFSM<ST,EV,ReplayTimer,CBA>* ) {}
+	void timerStart( const SpagFSM<ST,EV,ReplayTimer,CBA>* ) {}
+	void timerStartFor( const SpagFSM<ST,EV,ReplayTimer,CBA>*, uint64_t ) {}
+	uint64_t timerRemaining() const { return 0; }
+	void timerCancel() {}
+	void kill() {}
+	void postDrain( const SpagFSM<ST,EV,ReplayTimer,CBA>* ) {}
+};
+
+/// Replay mode, see TraceReplayer::run()
+enum class ReplayMode : uint8_t
+{
+	FullSpeed,  ///< records are processed as fast as possible, only the virtual clock follows the trace
+	RealTime    ///< records are processed at the time they were recorded (relative to start of replay)
+};
+
+//-----------------------------------------------------------------------------------
+/// Feeds a trace produced by SpagFSM::startTrace() into FSM \c fsm
+/**
+The FSM must have the same number of states and events as the one that was recorded,
+and should use a ReplayTimer as event handler, so that the timeouts occur only when they are read in the trace.
+It must be started, on the state that was the current one when the trace was started.
+
+During the replay, the callbacks can use now() (instead of a real clock) to get the time at which the input was recorded.
+*/
+template<typename FSM>
+class TraceReplayer
+{
+	using ST = typename FSM::State_t;
+	using EV = typename FSM::Event_t;
+
+	public:
+/// Constructor, reads the header of the trace from \c in. Throws on invalid input
+		TraceReplayer( FSM& fsm, std::istream& in ) : _fsm( fsm ), _in( in )
+		{
+			priv::TraceFileHeader hdr;
+			if( !_in.read( reinterpret_cast<char*>( &hdr ), sizeof(hdr) ) || std::string( hdr._magic, 7 ) != "SPAGTRC" )
+				SPAG_P_THROW_ERROR_RT( "input is not a Spaghetti trace file" );
+			if( hdr._version != SPAG_P_TRACEFILE_VERSION )
+				SPAG_P_THROW_ERROR_RT( "unsupported trace file version: " + std::to_string( hdr._version ) );
+			if( hdr._nbStates != _fsm.nbStates() || hdr._nbEvents != _fsm.nbEvents() )
+				SPAG_P_THROW_ERROR_RT(
+					"trace file has " + std::to_string( hdr._nbStates ) + " states and " + std::to_string( hdr._nbEvents )
+					+ " events, FSM has " + std::to_string( _fsm.nbStates() ) + " states and " + std::to_string( _fsm.nbEvents() ) + " events"
+				);
+			_initialState = static_cast<ST>( hdr._initialState );
+		}
+		TraceReplayer( const TraceReplayer& ) = delete;
+
+/// Time of the record being processed (or of the last one), in nanoseconds since start of the trace
+		int64_t now() const
+		{
+			return _now;
+		}
+/// State of the recorded FSM when the trace was started
+		ST initialState() const
+		{
+			return _initialState;
+		}
+
+/// Processes all the records (or only the next \c nbMax ones), returns the number of processed records. Throws on invalid record
+		size_t run( ReplayMode mode=ReplayMode::FullSpeed, size_t nbMax=std::numeric_limits<size_t>::max() )
+		{
+			SPAG_P_ASSERT( _fsm.isRunning(), "FSM must be started before replaying a trace" );
+			if( _nbDone == 0 && _fsm.currentState() != _initialState )
+				SPAG_P_THROW_ERROR_RT( "FSM is not on the initial state of the trace: " + std::to_string( SPAG_P_CAST2IDX(_initialState) ) );
+
+			auto t0 = std::chrono::steady_clock::now() - std::chrono::nanoseconds( _now );
+			size_t nb = 0;
+			priv::TraceRecord rec;
+			while( nb < nbMax && _fsm.isRunning() && _in.read( reinterpret_cast<char*>( &rec ), sizeof(rec) ) )
+			{
+				_now = rec._time;
+				if( mode == ReplayMode::RealTime )
+					std::this_thread::sleep_until( t0 + std::chrono::nanoseconds( rec._time ) );
+				switch( static_cast<priv::TraceKind>( rec._kind ) )
+				{
+					case priv::TraceKind::Event:
+						SPAG_CHECK_LESS( rec._value, _fsm.nbEvents() );
+						_fsm.processEvent( static_cast<EV>( rec._value ) );
+					break;
+					case priv::TraceKind::TimeOut:
+						if( !_fsm.hasTimeOut( _fsm.currentState() ) )
+							SPAG_P_THROW_ERROR_RT( "trace record " + std::to_string( _nbDone ) + ": timeout on a state without timeout" );
+						_fsm.processTimeOut();
+					break;
+					case priv::TraceKind::InnerEvent:
+#ifdef SPAG_USE_SIGNALS
+						SPAG_CHECK_LESS( rec._value, _fsm.nbEvents() );
+						_fsm.activateInnerEvent( static_cast<EV>( rec._value ) );
+#else
+						SPAG_P_THROW_ERROR_RT( "trace holds inner events, symbol SPAG_USE_SIGNALS is needed" );
+#endif
+					break;
+					default:
+						SPAG_P_THROW_ERROR_RT( "invalid trace record, index=" + std::to_string( _nbDone ) );
+				}
+				nb++;
+				_nbDone++;
+			}
+			return nb;
+		}
+
+	private:
+		FSM&          _fsm;
+		std::istream& _in;
+		ST            _initialState;
+		int64_t       _now    = 0;
+		size_t        _nbDone = 0;
+};
+#endif // SPAG_ENABLE_TRACE
+
+#ifdef SPAG_USE_VIRTUAL_CLOCK
+//-----------------------------------------------------------------------------------
+/// Simulated clock, for discrete-event simulation: the pending timeouts of all the FSM (through VirtualTimer objects) are held in a priority queue,
+/// and time jumps directly to the next expiry
+/**
+Time is expressed in nanoseconds since the creation of the clock, and only moves forward when the user code calls step(), run(), runUntil() or runFor().
+Timers expiring at the same time are processed in the order they were started, so a simulation is fully deterministic.
+
+Canceling a timer does not remove it from the queue (this would be O(n)): it is only invalidated, and discarded when it reaches the top.
+The queue is compacted if invalid entries get too numerous.
+
+Not thread-safe: all the FSM using a clock, and the clock itself, must be used from the same thread.
+*/
+class VirtualClock
+{
+	public:
+		using Callback = void(*)( void* );
+
+		VirtualClock() = default;
+		VirtualClock( const VirtualClock& ) = delete;
+
+/// Current simulated time, in ns
+		uint64_t now() const
 		{
-			for( const auto& p: m_str )
-				assignString2State( p.first, p.second );
-			assert( checkUnicity( _strStates ) );
+			return _now;
 		}
-/// Assigns to callback functions an argument value that is the state name (requires that callback argument is a string)
-		void assignCBValuesStrings()
+/// Number of pending timers
+		size_t size() const
 		{
-			static_assert( std::is_same<CBA,std::string>::value, "Error, unable to assign strings to callback values, callback type is not std::string\n" );
-			for( size_t i=0; i<nbStates(); i++ )
-				assignCallbackValue( static_cast<ST>(i), _strStates[i] );
+			return _nbPending;
 		}
-/// Returns the string label associated with event \c ev
-		std::string getString( EV ev ) const
+
+/// Registers a timer, returns its identifier. Function \c func will be called with argument \c arg when the timer expires
+		size_t addTimer( Callback func, void* arg )
 		{
-			return _strEvents[ev];
+			size_t id;
+			if( _freeSlots.empty() )
+			{
+				id = _slots.size();
+				_slots.emplace_back();
+			}
+			else
+			{
+				id = _freeSlots.back();
+				_freeSlots.pop_back();
+			}
+			_slots[id]._func = func;
+			_slots[id]._arg  = arg;
+			return id;
 		}
-/// Returns the string label associated with state \c st
-		std::string getString( ST st ) const
+/// Unregisters timer \c id (cancels it if it is pending)
+		void removeTimer( size_t id )
 		{
-			return _strStates[st];
+			cancel( id );
+			_slots[id]._func = nullptr;
+			_freeSlots.push_back( id );
 		}
-#else
-		void assignString2Event( EV, std::string ) {}
-		void assignString2State( ST, std::string ) {}
-		void assignStrings2Events( const std::vector<std::pair<EV,std::string>>& ) {}
-		void assignStrings2States( const std::vector<std::pair<ST,std::string>>& ) {}
-		void assignStrings2Events( const std::map<EV,std::string>& ) {}
-		void assignStrings2States( const std::map<ST,std::string>& ) {}
-		void assignCBValuesStrings() const {}
-		std::string getString( EV ev ) const { return std::to_string( SPAG_P_CAST2IDX(ev) ); }
-		std::string getString( ST st ) const { return std::to_string( SPAG_P_CAST2IDX(st) ); }
-#endif
-
-///@}
 
-/** \name Run time functions */
-///@{
-/// start FSM : run callback associated to initial state (if any), an run timer (if any)
-		void start()
+/// Starts timer \c id, that will expire in \c delay ns. If it was pending, it is restarted
+		void schedule( size_t id, uint64_t delay )
 		{
-			SPAG_P_ASSERT( !_isRunning, "attempt to start an already running FSM" );
-			SPAG_LOG << "start FSM\n";
-			doChecking();
-
-			_isRunning = true;
-			runAction();
-
-#ifndef SPAG_EXTERNAL_EVENT_LOOP
-			if( !std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value )
+			SPAG_CHECK_LESS( id, _slots.size() );
+			auto& slot = _slots[id];
+			if( slot._pending )
+				_nbPending--;
+			slot._gen++;                     // invalidates previous entry (if any)
+			slot._pending = true;
+			slot._expiry  = _now + delay;
+			_nbPending++;
+			_heap.push_back( Entry{ _now + delay, _seq++, id, slot._gen } );
+			std::push_heap( _heap.begin(), _heap.end(), Later() );
+			if( _heap.size() > 2 * _nbPending + 64 )
+				compact();
+		}
+/// Cancels timer \c id (does nothing if not pending)
+		void cancel( size_t id )
+		{
+			SPAG_CHECK_LESS( id, _slots.size() );
+			auto& slot = _slots[id];
+			if( slot._pending )
 			{
-				SPAG_P_ASSERT( _eventHandler, "Event handler has not been allocated" );
-				_eventHandler->init( this );   // blocking function !
+				slot._pending = false;
+				slot._gen++;
+				_nbPending--;
 			}
-#endif
+		}
+		bool isPending( size_t id ) const
+		{
+			return _slots.at(id)._pending;
+		}
+/// Returns the time before timer \c id expires, in ns (0 if not pending)
+		uint64_t remaining( size_t id ) const
+		{
+			const auto& slot = _slots.at(id);
+			return slot._pending ? slot._expiry - _now : 0;
 		}
 
-/// stop FSM : needed only if timer is used, this will cancel (and kill) the pending timer
-		void stop() const
+/// Jumps to the next expiry and runs the corresponding timer. Returns false if there is no pending timer
+		bool step()
 		{
-			SPAG_P_ASSERT( _isRunning, "attempt to stop an already stopped FSM" );
+			return step( std::numeric_limits<uint64_t>::max() );
+		}
+/// Runs all the timers, until there is no more pending timer (beware: might never end!). Returns the number of expired timers
+		size_t run()
+		{
+			size_t nb = 0;
+			while( step() )
+				nb++;
+			return nb;
+		}
+/// Runs all the timers expiring up to time \c t (in ns), then sets the clock to \c t. Returns the number of expired timers
+		size_t runUntil( uint64_t t )
+		{
+			size_t nb = 0;
+			while( step( t ) )
+				nb++;
+			if( t > _now )
+				_now = t;
+			return nb;
+		}
+/// Runs all the timers expiring in the next \c dur \c unit, then moves the clock forward by that duration. Returns the number of expired timers
+		size_t runFor( Duration dur, DurUnit unit=DurUnit::ms )
+		{
+			return runUntil( _now + priv::toNanoseconds( dur, unit ) );
+		}
 
-			if( _eventHandler )
+	private:
+		struct Slot
+		{
+			Callback _func    = nullptr;
+			void*    _arg     = nullptr;
+			uint64_t _gen     = 0;        ///< incremented at each start/cancel, so that previous entries of the queue become invalid
+			uint64_t _expiry  = 0;        ///< expiry time, if pending
+			bool     _pending = false;
+		};
+		struct Entry
+		{
+			uint64_t _expiry;
+			uint64_t _seq;             ///< insertion order, used for timers having the same expiry
+			size_t   _id;
+			uint64_t _gen;
+		};
+/// Comparison of entries, so the heap has the earliest timer at top
+		struct Later
+		{
+			bool operator()( const Entry& e1, const Entry& e2 ) const
 			{
-				SPAG_LOG << "call timerCancel()\n";
-				_eventHandler->timerCancel();
-				SPAG_LOG << "call event loop kill()\n";
-				_eventHandler->kill();
+				return e1._expiry != e2._expiry ? e1._expiry > e2._expiry : e1._seq > e2._seq;
 			}
-			_isRunning = false;
-		}
+		};
 
-/// User-code timer end function/callback should call this when the timer expires
-		void processTimeOut() const
+		bool isValid( const Entry& e ) const
 		{
-			SPAG_P_START;
-			SPAG_LOG << "processing timeout event, delay was " << _stateInfo[ _current ]._timerEvent._duration << "\n";
-			assert( _stateInfo[ SPAG_P_CAST2IDX(_current) ]._timerEvent._enabled ); // or else, the timer shouldn't have been started, and thus we shouldn't be here...
-			_previous = _current;
-			_current = _stateInfo[ SPAG_P_CAST2IDX( _current ) ]._timerEvent._nextState;
-#ifdef SPAG_ENABLE_LOGGING
-			_rtdata.logTransition( _current, nbEvents() );
-#endif
-			runAction();
-			SPAG_P_END;
+			return _slots[e._id]._pending && _slots[e._id]._gen == e._gen;
 		}
-
-/// User-code should call this function when an external event occurs
-		void processEvent( EV ev ) const
+/// Runs the next valid timer if it expires at or before \c tmax
+		bool step( uint64_t tmax )
 		{
-			SPAG_P_START;
-
-			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), nbEvents() );
-			SPAG_P_ASSERT( _isRunning, "attempting to process an event but FSM is not started" );
-
-			auto ev_idx = SPAG_P_CAST2IDX( ev );
-			if( isInnerEvent(ev) )
-				SPAG_P_THROW_ERROR_RT(
-					std::string( "request to process event idx=" )
-					+ std::to_string( ev_idx )
-				#ifdef SPAG_ENUM_STRINGS
-					+ std::string( " (" ) + _strEvents[ev_idx] + std::string( ")" )
-				#endif
-					+ std::string( " but event has been declared as inner event." )
-				);
-
-#ifdef SPAG_ENUM_STRINGS
-			SPAG_LOG << "processing event " << ev_idx << ": \"" << _strEvents[ev_idx] << "\"\n";
-#else
-			SPAG_LOG << "processing event " << ev_idx << '\n';
-#endif
-			if( _allowedMat[ ev_idx ][ SPAG_P_CAST2IDX(_current) ] == 1 )
+			while( !_heap.empty() )
 			{
-				if( _stateInfo[ SPAG_P_CAST2IDX( _current ) ]._timerEvent._enabled )  // 1 - cancel the waiting timer, if any
+				const Entry top = _heap.front();
+				if( isValid( top ) && top._expiry > tmax )
+					return false;
+				std::pop_heap( _heap.begin(), _heap.end(), Later() );
+				_heap.pop_back();
+				if( isValid( top ) )
 				{
-					SPAG_P_ASSERT( _eventHandler, "Event handler has not been allocated" );
-					_eventHandler->timerCancel();
+					auto& slot = _slots[top._id];
+					slot._pending = false;
+					_nbPending--;
+					_now = top._expiry;
+					slot._func( slot._arg );
+					return true;
 				}
-				_previous = _current;
-				_current = _transitionMat[ ev_idx ][ SPAG_P_CAST2IDX(_current) ];     // 2 - switch to next state
-#ifdef SPAG_ENABLE_LOGGING
-				_rtdata.logTransition( _current, ev_idx );
-#endif
-				runAction();                                                          // 3 - call the callback function
-			}
-			else
-			{
-				SPAG_LOG << "event is ignored on current state\n";
-				if( _ignEventCallback )
-					_ignEventCallback( _current, ev );
-
-#ifdef SPAG_ENABLE_LOGGING
-				_rtdata.logIgnoredEvent( ev_idx );
-#endif
 			}
-			SPAG_P_END;
+			return false;
+		}
+/// Removes the invalid entries from the queue
+		void compact()
+		{
+			_heap.erase(
+				std::remove_if( _heap.begin(), _heap.end(), [this]( const Entry& e ){ return !isValid( e ); } ),
+				_heap.end()
+			);
+			std::make_heap( _heap.begin(), _heap.end(), Later() );
 		}
 
-#ifdef SPAG_USE_SIGNALS
-/// Activate inner event: set the inner event to true, so that a signal will be raised
-/// when we are on a state that has the event enabled as inner transition
-/// (and once callback has been completed).
+		uint64_t            _now       = 0;
+		uint64_t            _seq       = 0;
+		size_t              _nbPending = 0;
+		std::vector<Entry>  _heap;
+		std::vector<Slot>   _slots;
+		std::vector<size_t> _freeSlots;
+};
+
+//-----------------------------------------------------------------------------------
+/// Event handler for SpagFSM using simulated time, see VirtualClock
 /**
-\warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
-\todo implement "early quit" (as soon as found)
-\todo check if one of the states on which we activate the event is the current one. If so,
-then we need to raise the signal right away! (instead of waiting)
+Usage:
+\code
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::VirtualTimer, int );
+spag::VirtualClock clock;
+spag::VirtualTimer<States,Events,int> timer( clock );
+fsm.assignEventHandler( &timer );
+fsm.start();           // non blocking
+clock.runFor( 24, spag::DurUnit::min );  // simulates 24 minutes
+\endcode
 */
-		void activateInnerEvent( EV ev )
+template<typename ST, typename EV, typename CBA>
+struct VirtualTimer
+{
+	using Fsm_t = SpagFSM<ST,EV,VirtualTimer,CBA>;
+
+	explicit VirtualTimer( VirtualClock& clock ) : _clock( clock )
+	{
+		_id = _clock.addTimer( &VirtualTimer::onExpiry, this );
+	}
+	VirtualTimer( const VirtualTimer& ) = delete;
+	~VirtualTimer()
+	{
+		_clock.removeTimer( _id );
+	}
+/// Mandatory function for SpagFSM. Called when FSM is started, non blocking
+	void init( const Fsm_t* fsm )
+	{
+		_fsm = fsm;
+	}
+/// Mandatory function for SpagFSM. Starts the timer with the duration of the current state
+	void timerStart( const Fsm_t* fsm )
+	{
+		_fsm = fsm;
+		auto duration = fsm->timeOutDuration( fsm->currentState() );
+		_clock.schedule( _id, priv::toNanoseconds( duration.first, duration.second ) );
+	}
+/// Starts the timer with duration \c ns (nanoseconds), used by SpagFSM::restore()
+	void timerStartFor( const Fsm_t* fsm, uint64_t ns )
+	{
+		_fsm = fsm;
+		_clock.schedule( _id, ns );
+	}
+/// Returns the time before the timer expires, in ns (0 if not running), used by SpagFSM::snapshot()
+	uint64_t timerRemaining() const
+	{
+		return _clock.remaining( _id );
+	}
+/// Mandatory function for SpagFSM. Cancels the pending timer
+	void timerCancel()
+	{
+		_clock.cancel( _id );
+	}
+	void kill()
+	{
+		_clock.cancel( _id );
+	}
+/// Posted events (see SpagFSM::postEvent() ) must be processed by user code, with SpagFSM::processPostedEvents()
+	void postDrain( const Fsm_t* ) {}
+
+	private:
+		static void onExpiry( void* p )
 		{
-			SPAG_P_START;
+			static_cast<VirtualTimer*>(p)->_fsm->processTimeOut();
+		}
 
-			if( !isInnerEvent( ev ) )
-				throw std::runtime_error(
-					"request to activate inner event "
-					+ std::to_string( SPAG_P_CAST2IDX(ev) )
-#ifdef SPAG_ENUM_STRINGS
-					+ " (" + _strEvents[ SPAG_P_CAST2IDX(ev) ] + ")"
-#endif
-					+ ", but not found in list of Internal Events"
-				);
+		VirtualClock& _clock;
+		size_t        _id;
+		const Fsm_t*  _fsm = nullptr;
+};
+#endif // SPAG_USE_VIRTUAL_CLOCK
 
-			_innerEventFlag[ ev ] = true;
-			SPAG_LOG << "activating event " << SPAG_P_CAST2IDX(ev)
-#ifdef SPAG_ENUM_STRINGS
-				<< " (" << _strEvents[ SPAG_P_CAST2IDX(ev) ] << ')'
-#endif
-				<< " current state is " << (int)currentState()
-#ifdef SPAG_ENUM_STRINGS
-				<< " (" << _strStates[ currentState() ] << ')'
-#endif
-				<< '\n';
+#ifdef SPAG_USE_HIRES_TIMER
+//-----------------------------------------------------------------------------------
+/// Event handler for SpagFSM, for short timeouts (down to a few microseconds)
+/**
+As with the AsioWrapper class, \c init() holds the event loop and is blocking: it returns when the FSM is stopped
+(from a callback, or from another thread).
+Events coming from other threads must be posted with SpagFSM::postEvent() (needs \c SPAG_USE_EVENT_QUEUE),
+they are processed by the event loop thread.
+
+The loop sleeps on a condition variable until shortly before the deadline,
+then busy-waits for the remaining duration (given to the constructor, default is \c SPAG_HIRES_SPIN_US),
+so that the timeout is processed on time, regardless of the OS scheduler latency.
+This means one core is used during the last part of each timeout: for durations above a few milliseconds, the other event handlers are a better choice.
+*/
+template<typename ST, typename EV, typename CBA>
+struct HiResTimer
+{
+	using Fsm_t = SpagFSM<ST,EV,HiResTimer,CBA>;
+	using Clock = std::chrono::steady_clock;
 
-			SPAG_P_END;
+	explicit HiResTimer( Duration spin=SPAG_HIRES_SPIN_US, DurUnit unit=DurUnit::us )
+		: _spin( std::chrono::nanoseconds( priv::toNanoseconds( spin, unit ) ) )
+	{}
+	HiResTimer( const HiResTimer& ) = delete;
+
+/// Mandatory function for SpagFSM. Called when FSM is started. Blocking, until kill() is called
+	void init( const Fsm_t* fsm )
+	{
+		std::unique_lock<std::mutex> lock( _mtx );
+		_quit = false;
+		while( !_quit )
+		{
+			if( _drain )
+			{
+				_drain = false;
+				lock.unlock();
+				processPosted( fsm );
+				lock.lock();
+				continue;
+			}
+			if( !_armed )
+			{
+				_cv.wait( lock );
+				continue;
+			}
+			if( _deadline - Clock::now() > _spin )
+			{
+				_cv.wait_until( lock, _deadline - _spin );
+				continue;
+			}
+			const auto deadline = _deadline;   // last part: busy wait, without holding the lock
+			const auto gen      = _gen;
+			lock.unlock();
+			while( Clock::now() < deadline )
+				;
+			lock.lock();
+			if( _armed && _gen == gen )      // if not canceled or restarted meanwhile
+			{
+				_armed = false;
+				lock.unlock();
+				fsm->processTimeOut();
+				lock.lock();
+			}
 		}
+	}
+/// Mandatory function for SpagFSM. Starts the timer with the duration of the current state
+	void timerStart( const Fsm_t* fsm )
+	{
+		auto duration = fsm->timeOutDuration( fsm->currentState() );
+		timerStartFor( fsm, priv::toNanoseconds( duration.first, duration.second ) );
+	}
+/// Starts the timer with duration \c ns (nanoseconds), used by SpagFSM::restore()
+	void timerStartFor( const Fsm_t*, uint64_t ns )
+	{
+		std::lock_guard<std::mutex> lock( _mtx );
+		_deadline = Clock::now() + std::chrono::nanoseconds( ns );
+		_armed = true;
+		_gen++;
+		_cv.notify_one();
+	}
+/// Returns the time before the timer expires, in ns (0 if not running), used by SpagFSM::snapshot()
+	uint64_t timerRemaining()
+	{
+		std::lock_guard<std::mutex> lock( _mtx );
+		if( !_armed )
+			return 0;
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( _deadline - Clock::now() ).count();
+		return ns > 0 ? static_cast<uint64_t>( ns ) : 0;
+	}
+/// Mandatory function for SpagFSM. Cancels the pending timer
+	void timerCancel()
+	{
+		std::lock_guard<std::mutex> lock( _mtx );
+		_armed = false;
+		_gen++;
+	}
+/// Terminates the event loop, see init()
+	void kill()
+	{
+		std::lock_guard<std::mutex> lock( _mtx );
+		_quit = true;
+		_cv.notify_one();
+	}
+/// Mandatory function for SpagFSM if SpagFSM::postEvent() is used. Wakes up the event loop, that processes the posted events
+	void postDrain( const Fsm_t* )
+	{
+		std::lock_guard<std::mutex> lock( _mtx );
+		_drain = true;
+		_cv.notify_one();
+	}
 
-/// Deactivate an inner event. Will issue a warning if the event is presently not active
-		void clearInternalEvent( EV ev )
+	private:
+		void processPosted( const Fsm_t* fsm )
 		{
-			if( !isInnerEvent( ev ) )
-				throw std::runtime_error(
-					"request to clear inner event "
-					+ std::to_string( SPAG_P_CAST2IDX(ev) )
-#ifdef SPAG_ENUM_STRINGS
-					+ " (" + _strEvents[ SPAG_P_CAST2IDX(ev) ] + ")"
+#ifdef SPAG_USE_EVENT_QUEUE
+			fsm->processPostedEvents();
+#else
+			(void)fsm;
 #endif
-					+ ", but not found in list of Internal Events"
-				);
+		}
 
-			if( _innerEventFlag[ ev ] == false )
-				SPAG_P_LOG_ERROR << "warning, request to clear inner event idx=" << SPAG_P_CAST2IDX(ev)
-#ifdef SPAG_ENUM_STRINGS
-					<< " (" + _strEvents[ SPAG_P_CAST2IDX(ev) ] + ")"
-#endif
-					<< ", but event was not active.\n";
+		std::mutex              _mtx;
+		std::condition_variable _cv;
+		Clock::duration         _spin;
+		Clock::time_point       _deadline;
+		uint64_t                _gen   = 0;     ///< incremented at each start/cancel
+		bool                    _armed = false;
+		bool                    _drain = false;
+		bool                    _quit  = false;
+};
+#endif // SPAG_USE_HIRES_TIMER
 
-			_innerEventFlag[ ev ] = false;
-			SPAG_LOG << "deactivating event " << SPAG_P_CAST2IDX(ev)
-#ifdef SPAG_ENUM_STRINGS
-				<< " (" << _strEvents[ SPAG_P_CAST2IDX(ev) ] << ')'
-#endif
-				<< " current state is " << (int)currentState()
-#ifdef SPAG_ENUM_STRINGS
-				<< " (" << _strStates[ currentState() ] << ')'
-#endif
-				<< ".\n";
-		}
+#ifdef SPAG_USE_COROUTINES
+//-----------------------------------------------------------------------------------
+/// Return type of a coroutine that starts right away and does not need to be awaited (its frame is destroyed when it ends)
+/**
+\code
+spag::CoroTask watch( const fsm_t& fsm )
+{
+	while( fsm.isRunning() )
+		std::cout << "new state: " << co_await fsm.nextTransition() << '\n';
+}
+\endcode
+An exception escaping the coroutine calls \c std::terminate().
+*/
+struct CoroTask
+{
+	struct promise_type
+	{
+		CoroTask get_return_object() noexcept { return CoroTask(); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
 
-/// This is to be called by event loop wrapper, by the signal handler.
-/// <strong>DO NOT CALL in user code</strong>.
+//-----------------------------------------------------------------------------------
+/// A scheduler for coroutines and timeouts, run by a single thread: there is no thread per FSM, and no thread is created
 /**
-This function will be called by the signal handler of the event handler class ONLY (see AsioWrapper::signalHandler() )
-\warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
+It holds a priority queue of deadlines, associated either to a suspended coroutine (see sleepFor() ), to a function (see callAt() ),
+or to a registered timer (see addTimer(), used by the CoroTimer event handler to process the timeouts).
+A registered timer has a single slot: restarting or canceling it invalidates its previous entry, that is not counted by size()
+and is skipped (the invalid entries are removed from the queue when they outnumber the valid ones).
+
+It can be run in two ways:
+- run(): blocking, runs until nothing is scheduled (so it returns when all the FSM are stopped, as that cancels their timeouts)
+
+- runOnce(): non blocking, runs what is due, so it can be called from an existing event loop
+(for example from a timer of an \c io_context, set with nextDeadline() )
+
+Entries can be added from any thread; they are always processed by the thread running the scheduler.
 */
-		void processInnerEvent( const priv::StateInfo<ST,EV,CBA>& stinf ) const
+class CoroScheduler
+{
+	public:
+		using Clock    = std::chrono::steady_clock;
+		using Callback      = void(*)( void*, uint64_t );
+		using TimerCallback = void(*)( void* );
+
+/// Awaitable returned by sleepFor() and sleepUntil()
+		struct SleepAwaiter
 		{
-			SPAG_P_START;
+			CoroScheduler&    _sched;
+			Clock::time_point _time;
 
-			SPAG_P_ASSERT( _isRunning, "attempting to process an inner event but FSM is not started" );
-#ifdef SPAG_ENABLE_LOGGING
-			size_t ev_idx = nbEvents() + 1;
-#endif
-			if( stinf._isPassState )
+			bool await_ready() const noexcept { return _time <= Clock::now(); }
+			void await_suspend( std::coroutine_handle<> h ) const { _sched.resumeAt( _time, h ); }
+			void await_resume() const noexcept {}
+		};
+
+		CoroScheduler() = default;
+		CoroScheduler( const CoroScheduler& ) = delete;
+
+/// Registers a timer, returns its identifier. Function \c func will be called with argument \c ctx when the timer expires
+		size_t addTimer( TimerCallback func, void* ctx )
+		{
+			std::lock_guard<std::mutex> lock( _mtx );
+			size_t id;
+			if( _freeSlots.empty() )
 			{
-				auto next = _transitionMat[ nbEvents()+1 ][_current];
-				SPAG_LOG << "is pass state, switch from state " << (int)currentState() << " to state " << (int)next << '\n';
-				_previous = _current;
-				_current  = next;
+				id = _slots.size();
+				_slots.emplace_back();
 			}
 			else
 			{
-				for( const auto& innerTrans: stinf._innerTransList )
-				{
-					if( !isInnerEvent( innerTrans._innerEvent ) )       // step 1: check that the event is correctly registered in map
-						SPAG_P_THROW_ERROR_RT( "Unable to find inner event" );     /// \todo expand user message
-
-
-					if( _innerEventFlag[ innerTrans._innerEvent ] )   // step 2 : check if given event assigned has been activated
-					{
-						_previous = _current;
-						_current = innerTrans._destState;
-#ifdef SPAG_ENABLE_LOGGING
-						ev_idx   = innerTrans._innerEvent;
-#endif
-						_innerEventFlag[ innerTrans._innerEvent ] = false;       // deactivate event
-					}
-				}
+				id = _freeSlots.back();
+				_freeSlots.pop_back();
 			}
-//			SPAG_LOG << "stinf:\n" << stinf << '\n';
-
-#ifdef SPAG_ENABLE_LOGGING
-			_rtdata.logTransition( _current, ev_idx );
-#endif
-			runAction();                                                          // 3 - call the callback function
-			SPAG_P_END;
+			_slots[id]._func = func;
+			_slots[id]._ctx  = ctx;
+			return id;
 		}
-#endif // SPAG_USE_SIGNALS
-///@}
-
-/** \name Misc. helper functions */
-///@{
-/// Does configuration checks
-		void doChecking() const;
-/// Return nb of states
-		constexpr size_t nbStates() const
+/// Unregisters timer \c id (cancels it if it is pending). Must not be called while its callback is running
+		void removeTimer( size_t id )
 		{
-			return SPAG_P_CAST2IDX(ST::NB_STATES);
+			std::lock_guard<std::mutex> lock( _mtx );
+			cancelSlot( id );
+			_slots[id]._func = nullptr;
+			_freeSlots.push_back( id );
+			_cv.notify_one();
 		}
-/// Return nb of events
-		constexpr size_t nbEvents() const
+/// Starts timer \c id, that will expire at time \c t. If it was pending, it is restarted
+		void schedule( size_t id, Clock::time_point t )
 		{
-			return SPAG_P_CAST2IDX(EV::NB_EVENTS);
+			std::lock_guard<std::mutex> lock( _mtx );
+			cancelSlot( id );
+			auto& slot = _slots[id];
+			slot._pending = true;
+			_nbLive++;
+			pushEntry( Entry{ t, 0, nullptr, nullptr, nullptr, 0, id, slot._gen } );
 		}
-/// Return current state
-		ST currentState() const
+/// Cancels timer \c id (does nothing if not pending)
+		void cancel( size_t id )
 		{
-			return _current;
+			std::lock_guard<std::mutex> lock( _mtx );
+			cancelSlot( id );
+			_cv.notify_one();               // so that run() returns if nothing else is scheduled
 		}
-/// Return previous state (or initial state upon start() )
-		ST previousState() const
+		bool isPending( size_t id ) const
 		{
-			return _previous;
+			std::lock_guard<std::mutex> lock( _mtx );
+			return _slots.at(id)._pending;
 		}
 
-#ifdef SPAG_ENUM_STRINGS
-		size_t getStateIndex( std::string str ) const
+/// <code>co_await sched.sleepFor( 10, spag::DurUnit::ms );</code> suspends the coroutine for the given duration
+		SleepAwaiter sleepFor( Duration dur, DurUnit unit )
 		{
-			auto it = std::find(
-				std::begin(_strStates),
-				std::end(_strStates),
-				str
-			);
-			if( it == std::end(_strStates) )
-				SPAG_P_THROW_ERROR_RT( "invalid state string" );
-			return it - std::begin(_strStates);
+			return SleepAwaiter{ *this, Clock::now() + std::chrono::nanoseconds( priv::toNanoseconds( dur, unit ) ) };
 		}
-
-		size_t getEventIndex( std::string str ) const
+		SleepAwaiter sleepUntil( Clock::time_point t )
 		{
-			auto it = std::find(
-				std::begin(_strEvents),
-				std::end(_strEvents),
-				str
-			);
-			if( it == std::end(_strEvents) )
-				SPAG_P_THROW_ERROR_RT("invalid event string" );
-			return it - std::begin(_strEvents);
+			return SleepAwaiter{ *this, t };
 		}
-#endif
-		priv::StateInfo<ST,EV,CBA>& getStateInfo( size_t idx )
+/// Schedules the resuming of coroutine \c h at time \c t
+		void resumeAt( Clock::time_point t, std::coroutine_handle<> h )
 		{
-			assert( idx < nbStates() );
-			return _stateInfo[idx];
+			std::lock_guard<std::mutex> lock( _mtx );
+			_nbLive++;
+			pushEntry( Entry{ t, 0, h, nullptr, nullptr, 0, NoSlot, 0 } );
 		}
-
-/// Return duration of time out for state \c st, or 0 if none
-		std::pair<Duration,DurUnit> timeOutDuration( ST st ) const
+/// Schedules a call of <code>func( ctx, tag )</code> at time \c t (can not be canceled, see addTimer() for that)
+		void callAt( Clock::time_point t, Callback func, void* ctx, uint64_t tag )
 		{
-			assert( SPAG_P_CAST2IDX(st) < nbStates() );
-			return std::make_pair(
-				_stateInfo[ SPAG_P_CAST2IDX(st) ]._timerEvent._duration,
-				_stateInfo[ SPAG_P_CAST2IDX(st) ]._timerEvent._durUnit
-			);
+			std::lock_guard<std::mutex> lock( _mtx );
+			_nbLive++;
+			pushEntry( Entry{ t, 0, nullptr, func, ctx, tag, NoSlot, 0 } );
 		}
 
-		void printConfig( std::ostream& str, const char* msg=nullptr ) const;
-
-#ifdef SPAG_ENABLE_LOGGING
-/// Assigns a new name for the output log file (default is spaghetti.csv)
-		void setLogFileName( std::string fn ) const
+/// Number of scheduled entries (canceled and restarted timers are not counted)
+		size_t size() const
 		{
-			assert( !fn.empty() );
-			_rtdata._logfileName = fn;
+			std::lock_guard<std::mutex> lock( _mtx );
+			return _nbLive;
+		}
+/// Returns the time of the next entry, if any (first is false if there is none)
+		std::pair<bool,Clock::time_point> nextDeadline()
+		{
+			std::lock_guard<std::mutex> lock( _mtx );
+			dropInvalid();
+			if( _heap.empty() )
+				return std::make_pair( false, Clock::time_point() );
+			return std::make_pair( true, _heap.front()._time );
 		}
 
-		Counters getCounters() const
+/// Runs all the entries that are due, in time order (in scheduling order for a same time), then returns the number of processed entries
+		size_t runOnce()
 		{
-			return _rtdata.buildCounters();
+			const auto now = Clock::now();
+			size_t nb = 0;
+			std::unique_lock<std::mutex> lock( _mtx );
+			while( dropInvalid() && _heap.front()._time <= now )
+			{
+				std::pop_heap( _heap.begin(), _heap.end(), Later() );
+				auto e = _heap.back();
+				_heap.pop_back();
+				_nbLive--;
+				TimerCallback tfunc = nullptr;
+				if( e._slot != NoSlot )
+				{
+					auto& slot = _slots[e._slot];
+					slot._pending = false;
+					tfunc  = slot._func;
+					e._ctx = slot._ctx;
+				}
+				lock.unlock();
+				if( e._coro )
+					e._coro.resume();
+				else if( tfunc )
+					tfunc( e._ctx );
+				else
+					e._func( e._ctx, e._tag );
+				nb++;
+				lock.lock();
+			}
+			return nb;
 		}
-		void clearCounters()
+/// Blocking: sleeps until the next deadline and runs it, until nothing is scheduled. Returns the number of processed entries
+		size_t run()
 		{
-			_rtdata.clear();
+			size_t nb = 0;
+			std::unique_lock<std::mutex> lock( _mtx );
+			while( dropInvalid() )
+			{
+				auto t = _heap.front()._time;
+				if( t > Clock::now() )
+				{
+					_cv.wait_until( lock, t );      // also woken up when an entry is added or a timer is canceled
+					continue;
+				}
+				lock.unlock();
+				nb += runOnce();
+				lock.lock();
+			}
+			return nb;
 		}
-#else
-		void setLogFilename( std::string fn ) const {}
-//		Counters getCounters() const {}
-//		void clearCounters() {}
-#endif // SPAG_ENABLE_LOGGING
 
-/// Sets the timer default value. See assignTimeOut()
-		template<typename T>
-		void setTimerDefaultValue( T val ) const
+	private:
+		struct Entry
 		{
-			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
-            _defaultTimerValue = val;
-		}
+			Clock::time_point       _time;
+			uint64_t                _seq;
+			std::coroutine_handle<> _coro;
+			Callback                _func;
+			void*                   _ctx;
+			uint64_t                _tag;
+			size_t                  _slot;     ///< registered timer, or NoSlot
+			uint64_t                _gen;      ///< generation of the slot when the entry was pushed
+		};
+		struct Slot
+		{
+			TimerCallback _func    = nullptr;
+			void*         _ctx     = nullptr;
+			uint64_t      _gen     = 0;        ///< incremented at each start/cancel, so that previous entries of the queue become invalid
+			bool          _pending = false;
+		};
+		static constexpr size_t NoSlot = static_cast<size_t>(-1);
+		struct Later
+		{
+			bool operator()( const Entry& a, const Entry& b ) const
+			{
+				return a._time != b._time ? a._time > b._time : a._seq > b._seq;
+			}
+		};
 
-/// Sets the timer default unit. See assignTimeOut()
-		void setTimerDefaultUnit( DurUnit unit ) const
+		bool isValid( const Entry& e ) const
 		{
-			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
-            _defaultTimerUnit = unit;
+			return e._slot == NoSlot || ( _slots[e._slot]._pending && _slots[e._slot]._gen == e._gen );
+		}
+/// Invalidates the entry of timer \c id, if pending (mutex must be locked)
+		void cancelSlot( size_t id )
+		{
+			SPAG_CHECK_LESS( id, _slots.size() );
+			auto& slot = _slots[id];
+			if( slot._pending )
+			{
+				slot._pending = false;
+				_nbLive--;
+			}
+			slot._gen++;
+		}
+/// Removes the invalid entries at the top of the queue, returns true if a valid one remains (mutex must be locked)
+		bool dropInvalid()
+		{
+			while( !_heap.empty() && !isValid( _heap.front() ) )
+			{
+				std::pop_heap( _heap.begin(), _heap.end(), Later() );
+				_heap.pop_back();
+			}
+			return !_heap.empty();
+		}
+/// Adds an entry to the queue (mutex must be locked)
+		void pushEntry( Entry e )
+		{
+			e._seq = _seq++;
+			_heap.push_back( e );
+			std::push_heap( _heap.begin(), _heap.end(), Later() );
+			if( _heap.size() > 2 * _nbLive + 64 )      // removes the invalid entries
+			{
+				_heap.erase(
+					std::remove_if( _heap.begin(), _heap.end(), [this]( const Entry& en ){ return !isValid( en ); } ),
+					_heap.end()
+				);
+				std::make_heap( _heap.begin(), _heap.end(), Later() );
+			}
+			_cv.notify_one();
 		}
 
-/// Sets the timer default unit, given as a string. See assignTimeOut()
+		mutable std::mutex      _mtx;
+		std::condition_variable _cv;
+		std::vector<Entry>      _heap;
+		std::vector<Slot>       _slots;
+		std::vector<size_t>     _freeSlots;
+		uint64_t                _seq    = 0;
+		size_t                  _nbLive = 0;      ///< valid entries of the queue
+};
+
+//-----------------------------------------------------------------------------------
+/// Event handler for SpagFSM, whose timeouts are run by a CoroScheduler (that can be shared by any number of FSM)
 /**
-Provided so that we can use this in a function templated with the FSM type, without having the type \c DurUnit available
-(see for example in src/traffic_lights_common.hpp)
+Unlike the AsioWrapper class, \c init() is not blocking: the FSM is run by the thread running the scheduler.
+
+It registers two timers in the scheduler (one for the timeouts, one to process the posted events), removed by the destructor:
+restarting or canceling a timeout replaces its entry, so the scheduler does not grow with the number of restarts, and run() returns
+once the FSM is stopped. The object must not be destroyed while the scheduler is running one of its callbacks.
+
+It is bound to the FSM that starts it first, and can not be shared by several FSM.
+Events posted from other threads with SpagFSM::postEvent() are processed by the scheduler thread.
 */
-		void setTimerDefaultUnit( std::string str ) const
+template<typename ST, typename EV, typename CBA>
+class CoroTimer
+{
+	public:
+		using Fsm_t = SpagFSM<ST,EV,CoroTimer,CBA>;
+
+		explicit CoroTimer( CoroScheduler& sched )
+			: _sched( sched )
+			, _timeOutId( sched.addTimer( &onTimeOut, this ) )
+			, _drainId( sched.addTimer( &onDrain, this ) )
+		{}
+		CoroTimer( const CoroTimer& ) = delete;
+		~CoroTimer()
 		{
-			static_assert( std::is_same<TIM,priv::NoTimer<ST,EV,CBA>>::value == false, "Error, FSM type has no timer" );
-			auto tu = priv::timeUnitFromString( str );
-			if( !tu.first )
-				SPAG_P_THROW_ERROR_CFG( "invalid string value: " + str );
-			_defaultTimerUnit = tu.second;
+			_sched.removeTimer( _timeOutId );
+			_sched.removeTimer( _drainId );
 		}
 
-/// Returns the build options
-/**
-Usage (example): <code>std::cout << fsm_t::buildOptions();</code>
-*/
-		static std::string buildOptions()
+/// Mandatory function for SpagFSM. Called when FSM is started, returns immediately
+		void init( const Fsm_t* fsm )
 		{
-			std::string yes(" = yes\n"), no(" = no\n");
-			std::string out( "Spaghetti version " );
-			out += SPAG_VERSION;
-			out += "\nBuild options:\n";
+			bind( fsm );
+		}
+/// Mandatory function for SpagFSM. Schedules the timeout of the current state
+		void timerStart( const Fsm_t* fsm )
+		{
+			auto duration = fsm->timeOutDuration( fsm->currentState() );
+			timerStartFor( fsm, priv::toNanoseconds( duration.first, duration.second ) );
+		}
+/// Schedules a timeout of duration \c ns (nanoseconds), used by SpagFSM::restore()
+		void timerStartFor( const Fsm_t* fsm, uint64_t ns )
+		{
+			bind( fsm );
+			_deadline = CoroScheduler::Clock::now() + std::chrono::nanoseconds( ns );
+			_sched.schedule( _timeOutId, _deadline );
+		}
+/// Returns the time before the timeout, in ns (0 if past), used by SpagFSM::snapshot()
+		uint64_t timerRemaining() const
+		{
+			auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( _deadline - CoroScheduler::Clock::now() ).count();
+			return ns > 0 ? static_cast<uint64_t>( ns ) : 0;
+		}
+/// Mandatory function for SpagFSM. Cancels the pending timeout
+		void timerCancel()
+		{
+			_sched.cancel( _timeOutId );
+		}
+/// Mandatory function for SpagFSM. Called when FSM is stopped
+		void kill()
+		{
+			_sched.cancel( _timeOutId );
+			_sched.cancel( _drainId );
+		}
+/// Mandatory function for SpagFSM if SpagFSM::postEvent() is used. Requests the scheduler to process the posted events (callable from any thread)
+		void postDrain( const Fsm_t* )
+		{
+			_sched.schedule( _drainId, CoroScheduler::Clock::now() );
+		}
 
-			out += SPAG_P_STRINGIZE2( SPAG_USE_ASIO_WRAPPER );
-#ifdef SPAG_USE_ASIO_WRAPPER
-			out += yes;
-#else
-			out += no;
-#endif
-			out += SPAG_P_STRINGIZE2( SPAG_EMBED_ASIO_WRAPPER );
-#ifdef SPAG_EMBED_ASIO_WRAPPER
-			out += yes;
-#else
-			out += no;
-#endif
-			out += SPAG_P_STRINGIZE2( SPAG_USE_SIGNALS );
-#ifdef SPAG_USE_SIGNALS
-			out += yes;
-#else
-			out += no;
-#endif
-			out += SPAG_P_STRINGIZE2( SPAG_EXTERNAL_EVENT_LOOP );
-#ifdef SPAG_EXTERNAL_EVENT_LOOP
-			out += yes;
-#else
-			out += no;
-#endif
-			out += SPAG_P_STRINGIZE2( SPAG_ENABLE_LOGGING );
-#ifdef SPAG_ENABLE_LOGGING
-			out += yes;
-#else
-			out += no;
-#endif
-			out += SPAG_P_STRINGIZE2( SPAG_PRINT_STATES );
-#ifdef SPAG_PRINT_STATES
-			out += yes;
-#else
-			out += no;
-#endif
-			out += SPAG_P_STRINGIZE2( SPAG_FRIENDLY_CHECKING );
-#ifdef SPAG_FRIENDLY_CHECKING
-			out += yes;
-#else
-			out += no;
-#endif
-			out += SPAG_P_STRINGIZE2( SPAG_ENUM_STRINGS );
-#ifdef SPAG_ENUM_STRINGS
-			out += yes;
-#else
-			out += no;
-#endif
-			out += SPAG_P_STRINGIZE2( SPAG_NO_VERBOSE );
-#ifdef SPAG_ENUM_STRINGS
-			out += yes;
+	private:
+/// Binds the FSM, done by the FSM thread before any scheduling (so the scheduler thread sees it, through the scheduler mutex)
+		void bind( const Fsm_t* fsm )
+		{
+			if( !_fsm )
+				_fsm = fsm;
+			SPAG_P_ASSERT( _fsm == fsm, "CoroTimer object can not be shared by several FSM" );
+		}
+		static void onTimeOut( void* ctx )
+		{
+			auto timer = static_cast<CoroTimer*>( ctx );
+			if( timer->_fsm->isRunning() )
+				timer->_fsm->processTimeOut();
+		}
+		static void onDrain( void* ctx )
+		{
+#ifdef SPAG_USE_EVENT_QUEUE
+			auto timer = static_cast<CoroTimer*>( ctx );
+			if( timer->_fsm->isRunning() )
+				timer->_fsm->processPostedEvents();
 #else
-			out += no;
-#endif
-
-#ifdef SPAG_USE_ASIO_WRAPPER
-		out += "Boost asio used, Boost version=";
-		out += std::to_string(BOOST_VERSION);
+			(void)ctx;
 #endif
+		}
 
+		CoroScheduler& _sched;
+		const size_t   _timeOutId;     ///< scheduler timer of the timeouts
+		const size_t   _drainId;       ///< scheduler timer processing the posted events
+		const Fsm_t*   _fsm = nullptr;
+		CoroScheduler::Clock::time_point _deadline;   ///< of the last scheduled timeout
+};
+#endif // SPAG_USE_COROUTINES
 
+#ifdef SPAG_USE_WIRE_PROTOCOL
+//-----------------------------------------------------------------------------------
+// Binary wire protocol, to send events to one or several FSM over a network
+//-----------------------------------------------------------------------------------
+/**
+A frame (for example a UDP datagram) holds a fixed-size header followed by an array of fixed-size records, all values being little-endian:
+
+| offset | size | content |
+|--------|------|---------|
+| 0      | 2    | magic value, "SP" |
+| 2      | 1    | version (SPAG_P_WIRE_VERSION) |
+| 3      | 1    | reserved, 0 |
+| 4      | 4    | sequence number of the first record |
+| 8      | 2    | number of records |
+| 10     | 2    | reserved, 0 |
+| 12     | 8*n  | records: instance identifier (4 bytes), event index (2 bytes), reserved (2 bytes) |
+
+The sequence number of record \c i is the one of the frame plus \c i, so that the receiver can detect lost or duplicated frames.
+*/
+#define SPAG_P_WIRE_MAGIC   0x5053
+#define SPAG_P_WIRE_VERSION 1
 
-			return out;
-		}
+namespace priv {
 
-		void writeDotFile( std::string fn, DotFileOptions opt=DotFileOptions() ) const;
-///@}
+inline void wireWrite16( uint8_t* p, uint16_t v )
+{
+	p[0] = static_cast<uint8_t>( v );
+	p[1] = static_cast<uint8_t>( v >> 8 );
+}
+inline void wireWrite32( uint8_t* p, uint32_t v )
+{
+	wireWrite16( p,   static_cast<uint16_t>( v ) );
+	wireWrite16( p+2, static_cast<uint16_t>( v >> 16 ) );
+}
+inline uint16_t wireRead16( const uint8_t* p )
+{
+	return static_cast<uint16_t>( p[0] | ( p[1] << 8 ) );
+}
+inline uint32_t wireRead32( const uint8_t* p )
+{
+	return wireRead16( p ) | ( static_cast<uint32_t>( wireRead16( p+2 ) ) << 16 );
+}
 
-///////////////////////////////////
-// SpagFSM: private member function section
-///////////////////////////////////
+} // namespace priv
 
-	private:
+/// Sizes of the wire protocol elements, see WireEncoder and WireDecoder
+struct WireFormat
+{
+	static constexpr size_t HeaderSize = 12;
+	static constexpr size_t RecordSize = 8;
+/// Max number of records that a frame of \c nbBytes bytes can hold
+	static constexpr size_t capacity( size_t nbBytes )
+	{
+		return nbBytes < HeaderSize ? 0 : ( nbBytes - HeaderSize ) / RecordSize;
+	}
+};
 
-/// Returns true if event \c ev has been declared as inner event, with
-/**
-<code>assignInnerTransition( ST st1, EV iev, ST st2 );</code>
-or
-<code>assignInnerTransition( EV, ST );</code>
+//-----------------------------------------------------------------------------------
+/// Writes events into a user-provided buffer, using the binary wire protocol (see WireDecoder). Does not allocate
+template<typename EV>
+class WireEncoder
+{
+	public:
+		WireEncoder( void* buffer, size_t size, uint32_t seq=0 )
+			: _buffer( static_cast<uint8_t*>( buffer ) ), _capacity( WireFormat::capacity( size ) )
+		{
+			SPAG_P_ASSERT( _capacity > 0, "buffer too small to hold a single event" );
+			SPAG_P_ASSERT( _capacity <= 0xffff, "buffer too large" );
+			clear( seq );
+		}
+/// Removes all the records, the next frame will start at sequence number \c seq
+		void clear( uint32_t seq )
+		{
+			_seq = seq;
+			_nbRecords = 0;
+			priv::wireWrite16( _buffer,   SPAG_P_WIRE_MAGIC );
+			_buffer[2] = SPAG_P_WIRE_VERSION;
+			_buffer[3] = 0;
+			priv::wireWrite32( _buffer+4, seq );
+			priv::wireWrite32( _buffer+8, 0 );
+		}
+/// Removes all the records, the next frame will start at the sequence number following the last record
+		void clear()
+		{
+			clear( _seq + static_cast<uint32_t>( _nbRecords ) );
+		}
+/// Adds event \c ev for FSM \c instance. Returns false if the buffer is full
+		bool add( uint32_t instance, EV ev )
+		{
+			if( _nbRecords == _capacity )
+				return false;
+			auto p = _buffer + WireFormat::HeaderSize + _nbRecords * WireFormat::RecordSize;
+			priv::wireWrite32( p,   instance );
+			priv::wireWrite16( p+4, static_cast<uint16_t>( ev ) );
+			priv::wireWrite16( p+6, 0 );
+			_nbRecords++;
+			priv::wireWrite16( _buffer+8, static_cast<uint16_t>( _nbRecords ) );
+			return true;
+		}
+/// Adds event \c ev for FSM 0
+		bool add( EV ev )
+		{
+			return add( 0, ev );
+		}
+		bool full() const          { return _nbRecords == _capacity; }
+		size_t nbRecords() const   { return _nbRecords; }
+/// Size of the frame, in bytes
+		size_t size() const        { return WireFormat::HeaderSize + _nbRecords * WireFormat::RecordSize; }
+		const void* data() const   { return _buffer; }
 
-\note To be replaced with https://en.cppreference.com/w/cpp/container/map/contains
-when C++20 available.
-*/
-	bool isInnerEvent( EV ev ) const
-	{
-		return static_cast<bool>(_innerEventFlag.count( ev ));
-	}
+	private:
+		uint8_t* _buffer;
+		size_t   _capacity;
+		size_t   _nbRecords = 0;
+		uint32_t _seq = 0;
+};
 
-/// Run associated action with a state switch (state has already switched)
+//-----------------------------------------------------------------------------------
+/// Reads a frame encoded with the binary wire protocol (see WireEncoder), and hands the events to one or several FSM. Does not allocate
 /**
--# first, starts timer, if needed (first, because running callback can take some time).
--# second, calls callback function, if any.
--# third, raises a signal if a deferred action has been requested on this state (only if signals have been enabled, see manual).
+The frame is not copied: it must stay valid as long as the decoder is used.
+First check the frame with valid().
+As the frames come from the network, the records are checked whatever the build options (they do not rely on \c assert() ):
+the ones holding an event index that is not smaller than \c NB_EVENTS, or an instance identifier that does not exist,
+are skipped and counted, see nbSkipped().
 */
-		void runAction() const
+template<typename EV>
+class WireDecoder
+{
+	public:
+/// Forward iterator on the events of a frame, so that they can be given directly to SpagFSM::processEvents()
+		class EventIterator
 		{
-			SPAG_P_START;
-			SPAG_LOG << "switched to state " << SPAG_P_CAST2IDX(_current)
-#ifdef SPAG_ENUM_STRINGS
-				<< " (" << _strStates[ SPAG_P_CAST2IDX(_current) ] << ")"
-#endif
-				<< ", starting handler\n";
-			auto curr_idx = SPAG_P_CAST2IDX(_current);
-			auto& stateInfo = _stateInfo[ curr_idx ];
-
-			if( stateInfo._timerEvent._enabled )
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type        = EV;
+				using difference_type   = std::ptrdiff_t;
+				using pointer           = const EV*;
+				using reference         = EV;
+
+				explicit EventIterator( const uint8_t* p ) : _p( p ) {}
+				EV operator*() const { return static_cast<EV>( priv::wireRead16( _p+4 ) ); }
+				EventIterator& operator++() { _p += WireFormat::RecordSize; return *this; }
+				EventIterator  operator++(int) { auto tmp = *this; ++*this; return tmp; }
+				bool operator==( const EventIterator& it ) const { return _p == it._p; }
+				bool operator!=( const EventIterator& it ) const { return _p != it._p; }
+/// Identifier of the FSM the event is sent to
+				uint32_t instance() const { return priv::wireRead32( _p ); }
+
+			private:
+				const uint8_t* _p;
+		};
+
+		WireDecoder( const void* data, size_t size ) : _data( static_cast<const uint8_t*>( data ) )
+		{
+			if( size < WireFormat::HeaderSize )
+				return;
+			if( priv::wireRead16( _data ) != SPAG_P_WIRE_MAGIC || _data[2] != SPAG_P_WIRE_VERSION )
+				return;
+			_nbRecords = priv::wireRead16( _data+8 );
+			if( size != WireFormat::HeaderSize + _nbRecords * WireFormat::RecordSize )
 			{
-				SPAG_P_ASSERT( _eventHandler, "Event handler has not been allocated" );
-				SPAG_LOG << "timeout start, duration=" <<  stateInfo._timerEvent._duration << "\n";
-				_eventHandler->timerStart( this );
+				_nbRecords = 0;
+				return;
 			}
-			if( stateInfo._callback ) // if there is a callback stored, then call it
+			_seq   = priv::wireRead32( _data+4 );
+			_valid = true;
+		}
+/// Returns false if the frame is not valid (wrong size, wrong magic value or version)
+		bool valid() const       { return _valid; }
+		size_t nbRecords() const { return _nbRecords; }
+/// Sequence number of the first record (0 if the frame is not valid)
+		uint32_t seq() const     { return _seq; }
+
+		EventIterator begin() const { return EventIterator( _data + WireFormat::HeaderSize ); }
+		EventIterator end() const   { return EventIterator( _data + WireFormat::HeaderSize + _nbRecords * WireFormat::RecordSize ); }
+
+/// Processes all the events of the frame on \c fsm, whatever their instance identifier. Returns the number of processed events
+		template<typename FSM>
+		size_t processOn( const FSM& fsm ) const
+		{
+			_nbSkipped = 0;
+			size_t nb = 0;
+			auto last = end();
+			for( auto it = begin(); it != last; )
 			{
-				SPAG_LOG << "callback function start:\n";
-				stateInfo._callback( _stateInfo[ SPAG_P_CAST2IDX(_current) ]._callbackArg );
+				auto first = it;
+				while( it != last && isValidEvent( it ) )
+					++it;
+				if( first != it )
+					nb += fsm.processEvents( first, it );
+				for( ; it != last && !isValidEvent( it ); ++it )
+					_nbSkipped++;
 			}
-			else
-				SPAG_LOG << "state has no callback provided\n";
+			return nb;
+		}
 
-#ifdef SPAG_USE_SIGNALS
-			if( _isRunning )  // we need this, because the callback could have stopped the FSM, thus we must not generate a signal !
+/// Processes the events on the FSM of container \c fsms (\c std::vector, \c std::array, ...), indexed by their instance identifier.
+/// Returns the number of processed events
+/**
+Consecutive events sent to the same FSM are handed at once to SpagFSM::processEvents().
+The records whose instance identifier is not smaller than the size of \c fsms are skipped, see nbSkipped().
+*/
+		template<typename CONT>
+		size_t dispatch( const CONT& fsms ) const
+		{
+			_nbSkipped = 0;
+			size_t nb = 0;
+			auto last = end();
+			for( auto it = begin(); it != last; )
 			{
-				bool do_raise_sig = false;
-				if( stateInfo._isPassState )
-				{
-					SPAG_LOG << "Is pass-state, raise signal.\n";
-					do_raise_sig = true;
-				}
-				else
-				{
-					for( auto& itr: stateInfo._innerTransList )
-						if( isInnerEvent( itr._innerEvent ) ) // if event is registered
-							if( _innerEventFlag.at( itr._innerEvent ) ) // and active
-							{
-								SPAG_LOG << "Inner Event idx=" << SPAG_P_CAST2IDX(itr._innerEvent)
-								#ifdef SPAG_ENUM_STRINGS
-									<< " (" << _strEvents[ SPAG_P_CAST2IDX(itr._innerEvent) ] << ")"
-								#endif
-									<< " is active, raise signal.\n";
-								do_raise_sig = true;
-								break;                    // no need to check the others
-							}
-				}
-				if( do_raise_sig )
+				auto id = it.instance();
+				if( id >= fsms.size() || !isValidEvent( it ) )
 				{
-					SPAG_LOG << "raising signal\n";
-					SPAG_LOG_FLUSH;
-					_eventHandler->raiseSignal();
-					_eventHandler->timerCancel();
+					_nbSkipped++;
+					++it;
+					continue;
 				}
+				auto first = it;
+				while( it != last && it.instance() == id && isValidEvent( it ) )
+					++it;
+				nb += fsms[id].processEvents( first, it );
 			}
-//			SPAG_LOG << "current state info:\n";
-//			std::cout << _stateInfo[ curr_idx ] << '\n';
-#endif
-			SPAG_P_END;
+			return nb;
 		}
 
-		void printLineHeader(  std::ostream&, size_t idx, bool firstline_flag, size_t maxlength ) const;
-		void printMatrix(      std::ostream& ) const;
-		void printStateConfig( std::ostream& ) const;
-		bool isReachable( size_t ) const;
-		std::string getConfigErrorMessage( priv::EN_ConfigError ce, size_t st ) const;
+/// Posts all the events to \c engine (FsmEngine, or any class providing \c postEvent(id,ev) and \c nbInstances() member functions).
+/// Returns the number of accepted events. The invalid records are skipped, see nbSkipped()
+		template<typename ENGINE>
+		size_t post( ENGINE& engine ) const
+		{
+			_nbSkipped = 0;
+			size_t nb = 0;
+			auto nbInst = engine.nbInstances();
+			for( auto it = begin(); it != end(); ++it )
+			{
+				if( it.instance() >= nbInst || !isValidEvent( it ) )
+					_nbSkipped++;
+				else
+					nb += engine.postEvent( it.instance(), *it ) ? 1 : 0;
+			}
+			return nb;
+		}
 
-/////////////////////////////
-// SpagFSM: private data section
-/////////////////////////////
+/// Returns the number of records that have been skipped by the last call to processOn(), dispatch() or post(),
+/// because of an invalid event index or instance identifier
+		size_t nbSkipped() const { return _nbSkipped; }
 
 	private:
-#ifdef SPAG_ENABLE_LOGGING
-		mutable priv::RunTimeData<ST,EV> _rtdata;
-#endif
-		mutable ST        _current           = static_cast<ST>(0);   ///< current state
-		mutable ST        _previous          = static_cast<ST>(0);   ///< previous state
-		mutable bool      _isRunning         = false;
-		mutable DurUnit   _defaultTimerUnit  = DurUnit::sec;         ///< default timer units
-		mutable Duration  _defaultTimerValue = 1;                    ///< default timer value
-		mutable TIM*      _eventHandler      = nullptr;              ///< pointer on timer/ event-loop handling object
-
-#ifdef SPAG_USE_ARRAY
-	#ifdef SPAG_USE_SIGNALS
-		std::array<
-			std::array<ST, static_cast<size_t>(ST::NB_STATES)>,
-			static_cast<size_t>(EV::NB_EVENTS)+2                   // + 2 is used to hold the AAT
-		> _transitionMat;  ///< describe what states the fsm switches to, when an event is received. lines: events, columns: states, value: states to switch to. DOES NOT hold timer events
-	#else
-		std::array<
-			std::array<ST, static_cast<size_t>(ST::NB_STATES)>,
-			static_cast<size_t>(EV::NB_EVENTS)+1                  // +1 is used to hold the timeout events
-		> _transitionMat;  ///< describe what states the fsm switches to, when an event is received. lines: events, columns: states, value: states to switch to. DOES NOT hold timer events
-	#endif
+		static bool isValidEvent( const EventIterator& it )
+		{
+			return SPAG_P_CAST2IDX( *it ) < SPAG_P_CAST2IDX( EV::NB_EVENTS );
+		}
 
-/// Matrix holding for each event a byte telling is the event is ignored or not, for a given state (0:ignore event, 1:handle external event, -1: internal event)
-		std::array<
-			std::array<char, static_cast<size_t>(ST::NB_STATES)>,
-			static_cast<size_t>(EV::NB_EVENTS)
-		> _allowedMat;
-#else
-		std::vector<std::vector<ST>>   _transitionMat;
-		std::vector<std::vector<char>> _allowedMat;
-#endif // SPAG_USE_ARRAY
+		const uint8_t* _data;
+		size_t         _nbRecords = 0;
+		mutable size_t _nbSkipped = 0;
+		uint32_t       _seq = 0;
+		bool           _valid = false;
+};
+#endif // SPAG_USE_WIRE_PROTOCOL
 
-#ifdef SPAG_USE_ARRAY
-		std::array<priv::StateInfo<ST,EV,CBA>,static_cast<size_t>(ST::NB_STATES)> _stateInfo;         ///< Holds for each state the details
-#else
-		std::vector<priv::StateInfo<ST,EV,CBA>> _stateInfo;         ///< Holds for each state the details
-#endif
-		mutable std::map<EV,bool> _innerEventFlag; ///< holds the activation flag for each inner event
+//-----------------------------------------------------------------------------------
+// Compile-time FSM
+//-----------------------------------------------------------------------------------
 
-#ifdef SPAG_ENUM_STRINGS
-		std::vector<std::string> _strEvents;      ///< holds events strings
-		std::vector<std::string> _strStates;      ///< holds states strings
-#endif
+/// A transition rule of a StaticFSM: event \c EVT switches from state \c FROM to state \c TO. See macro SPAG_STATIC_TRANSITION()
+template<typename ST, typename EV, ST FROM, EV EVT, ST TO>
+struct StaticTransition;
 
-#ifdef SPAG_EMBED_ASIO_WRAPPER
-		AsioWrapper<ST,EV,CBA> _asioWrapper; ///< optional wrapper around boost::asio::io_service
-#endif
+/// A timeout rule of a StaticFSM: after duration \c DUR on state \c FROM, switch to state \c TO. See macro SPAG_STATIC_TIMEOUT()
+template<typename ST, ST FROM, Duration DUR, DurUnit UNIT, ST TO>
+struct StaticTimeOut;
 
-		std::function<void(ST,EV)> _ignEventCallback;     ///< ignored events callback function
+/// An "Always Active Transition" rule of a StaticFSM: once arrived on state \c FROM (and callback done), switch to state \c TO. See macro SPAG_STATIC_AAT()
+template<typename ST, ST FROM, ST TO>
+struct StaticAat;
 
+/// Default callback handler for StaticFSM: does nothing. Can be used as base class, to provide only one of the two functions
+template<typename ST, typename EV>
+struct StaticNoCallback
+{
+	void onEnter( ST ) {}
+	void onIgnored( ST, EV ) {}
 };
+
+namespace priv {
+
 //-----------------------------------------------------------------------------------
-namespace priv
+/// Base class of the StaticFSM rules: default values, i.e. the rule brings nothing
+struct StaticRuleBase
 {
-//-----------------------------------------------------------------------------------
-inline
-void
-printChars( std::ostream& out, size_t n, char c )
+	static constexpr int      transition( size_t, size_t )    { return -1; }
+	static constexpr int      nbTransitions( size_t, size_t ) { return 0; }
+	static constexpr bool     hasTransition( size_t )         { return false; }
+	static constexpr int      timeOut( size_t )               { return -1; }
+	static constexpr int      nbTimeOuts( size_t )            { return 0; }
+	static constexpr Duration duration( size_t )              { return 0; }
+	static constexpr DurUnit  durUnit( size_t )               { return DurUnit::sec; }
+	static constexpr int      aat( size_t )                   { return -1; }
+	static constexpr int      nbAats( size_t )                { return 0; }
+	static constexpr uint64_t successors( uint64_t )          { return 0; }   ///< states reached from the set of states \c mask
+};
+
+/// Returns the bit associated to state \c st in a set of states
+constexpr uint64_t stateBit( size_t st )
 {
-	for( size_t i=0; i<n; i++ )
-		out << c;
+	return static_cast<uint64_t>(1) << st;
 }
+constexpr bool inSet( uint64_t mask, size_t st )
+{
+	return ( mask >> st ) & 1;
+}
+
 //-----------------------------------------------------------------------------------
+/// Combines all the rules of a StaticFSM
+template<typename... RULES>
+struct StaticRuleSet;
 
-} // namespace priv
+template<>
+struct StaticRuleSet<> : StaticRuleBase
+{};
+
+template<typename R, typename... REST>
+struct StaticRuleSet<R,REST...>
+{
+	using Next = StaticRuleSet<REST...>;
+
+	static constexpr int transition( size_t st, size_t ev )
+	{
+		return R::transition( st, ev ) != -1 ? R::transition( st, ev ) : Next::transition( st, ev );
+	}
+	static constexpr int nbTransitions( size_t st, size_t ev )
+	{
+		return R::nbTransitions( st, ev ) + Next::nbTransitions( st, ev );
+	}
+	static constexpr bool hasTransition( size_t st )
+	{
+		return R::hasTransition( st ) || Next::hasTransition( st );
+	}
+	static constexpr int timeOut( size_t st )
+	{
+		return R::timeOut( st ) != -1 ? R::timeOut( st ) : Next::timeOut( st );
+	}
+	static constexpr int nbTimeOuts( size_t st )
+	{
+		return R::nbTimeOuts( st ) + Next::nbTimeOuts( st );
+	}
+	static constexpr Duration duration( size_t st )
+	{
+		return R::nbTimeOuts( st ) ? R::duration( st ) : Next::duration( st );
+	}
+	static constexpr DurUnit durUnit( size_t st )
+	{
+		return R::nbTimeOuts( st ) ? R::durUnit( st ) : Next::durUnit( st );
+	}
+	static constexpr int aat( size_t st )
+	{
+		return R::aat( st ) != -1 ? R::aat( st ) : Next::aat( st );
+	}
+	static constexpr int nbAats( size_t st )
+	{
+		return R::nbAats( st ) + Next::nbAats( st );
+	}
+	static constexpr uint64_t successors( uint64_t mask )
+	{
+		return R::successors( mask ) | Next::successors( mask );
+	}
+};
 
 //-----------------------------------------------------------------------------------
-/// Configuration error printing function
-template<typename ST, typename EV,typename T,typename CBA>
-std::string
-SpagFSM<ST,EV,T,CBA>::getConfigErrorMessage( priv::EN_ConfigError ce, size_t st ) const
+/// A table computed at build time: element \c i is \c F::value(i)
+template<typename T, typename F, typename SEQ>
+struct StaticTable;
+
+template<typename T, typename F, size_t... I>
+struct StaticTable<T,F,IndexSeq<I...>>
 {
-	std::string msg( priv::getSpagName() + "configuration error: state " );
-	msg += std::to_string( st );
-#ifdef SPAG_ENUM_STRINGS
-	msg += " '";
-	msg += _strStates[st];
-	msg += "'";
-#endif
-	msg += ' ';
+	static constexpr T data[sizeof...(I)] = { F::value(I)... };
+};
 
-	switch( ce )
+template<typename T, typename F, size_t... I>
+constexpr T StaticTable<T,F,IndexSeq<I...>>::data[sizeof...(I)];
+
+//-----------------------------------------------------------------------------------
+/// Compile-time checking of the configuration of a StaticFSM, similar to what SpagFSM::doChecking() does at run-time
+template<size_t NS, size_t NE, typename RS>
+struct StaticChecker
+{
+/// Returns true if \c P::ok(i) is true for all \c i in [lo,hi[ (split in halves, to keep recursion depth low)
+	template<typename P>
+	static constexpr bool forAll( size_t lo, size_t hi )
 	{
-		case priv::CE_TimeOutAndPassState:
-			msg += "cannot have both a timeout and a pass-state flag";
-		break;
-		case priv::CE_IllegalPassState:
-			msg += "cannot be followed by another pass-state";
-		break;
-		case priv::CE_SamePassState:
-			msg += "pass-state cannot lead to itself";
-		break;
-		default: assert(0);
+		return hi-lo <= 1
+			? ( hi == lo || P::ok( lo ) )
+			: forAll<P>( lo, (lo+hi)/2 ) && forAll<P>( (lo+hi)/2, hi );
 	}
-	return msg;
-}
+
+	struct UniqueTransition
+	{
+		static constexpr bool ok( size_t i ) { return RS::nbTransitions( i/NE, i%NE ) <= 1; }
+	};
+	struct UniqueTimeOutAat
+	{
+		static constexpr bool ok( size_t st ) { return RS::nbTimeOuts( st ) <= 1 && RS::nbAats( st ) <= 1; }
+	};
+	struct TimeOutAndPassState       ///< see priv::CE_TimeOutAndPassState
+	{
+		static constexpr bool ok( size_t st ) { return !( RS::nbTimeOuts( st ) && RS::nbAats( st ) ); }
+	};
+	struct SamePassState             ///< see priv::CE_SamePassState
+	{
+		static constexpr bool ok( size_t st ) { return RS::aat( st ) != static_cast<int>(st); }
+	};
+	struct PassStateTransition       ///< a pass-state can't have other transitions
+	{
+		static constexpr bool ok( size_t st ) { return !( RS::nbAats( st ) && RS::hasTransition( st ) ); }
+	};
+
+/// Returns true if following the AAT from state \c st leads to a state that is not a pass-state, in less than \c n steps
+	static constexpr bool aatChainEnds( int st, size_t n )
+	{
+		return st == -1
+			? true
+			: ( n == 0 ? false : aatChainEnds( RS::aat( static_cast<size_t>(st) ), n-1 ) );
+	}
+	struct PassStateLoop
+	{
+		static constexpr bool ok( size_t st ) { return aatChainEnds( static_cast<int>(st), NS ); }
+	};
+
+/// Returns the set of states reachable from set \c mask, in \c n steps at most
+	static constexpr uint64_t reachable( uint64_t mask, size_t n )
+	{
+		return n == 0 ? mask : reachable( mask | RS::successors( mask ), n-1 );
+	}
+	static constexpr bool allReachable()
+	{
+		return reachable( stateBit(0), NS ) == ( NS == 64 ? ~static_cast<uint64_t>(0) : stateBit(NS)-1 );
+	}
+};
+
+} // namespace priv
+
 //-----------------------------------------------------------------------------------
-/// helper function template for printConfig()
-template<typename ST, typename EV,typename T,typename CBA>
-void
-SpagFSM<ST,EV,T,CBA>::printMatrix( std::ostream& out ) const
+template<typename ST, typename EV, ST FROM, EV EVT, ST TO>
+struct StaticTransition : priv::StaticRuleBase
 {
-	size_t maxlength(0);
-#ifdef SPAG_ENUM_STRINGS
-	maxlength = priv::getMaxLength( _strEvents );
-#endif
+	static_assert( FROM < ST::NB_STATES && TO < ST::NB_STATES, "invalid state in transition" );
+	static_assert( EVT < EV::NB_EVENTS, "invalid event in transition" );
 
-	char spc_char{ ' ' };
-	out << std::setfill('0');
+	static constexpr int transition( size_t st, size_t ev )
+	{
+		return ( st == static_cast<size_t>(FROM) && ev == static_cast<size_t>(EVT) ) ? static_cast<int>(TO) : -1;
+	}
+	static constexpr int nbTransitions( size_t st, size_t ev )
+	{
+		return transition( st, ev ) == -1 ? 0 : 1;
+	}
+	static constexpr bool hasTransition( size_t st )
+	{
+		return st == static_cast<size_t>(FROM);
+	}
+	static constexpr uint64_t successors( uint64_t mask )
+	{
+		return priv::inSet( mask, static_cast<size_t>(FROM) ) ? priv::stateBit( static_cast<size_t>(TO) ) : 0;
+	}
+};
 
-	priv::printChars( out, maxlength, spc_char );
-	out << "        STATES:\nEVENTS";
-	priv::printChars( out, maxlength, spc_char );
-	out << '|';
-	for( size_t i=0; i<nbStates(); i++ )
-		out << spc_char<< 'S' << std::setw(2) << i;
-	out << '\n';
-	priv::printChars( out, maxlength+6, '-' );
-	out << '|';
-	for( size_t i=0; i<nbStates(); i++ )
-		out << "----";
-	out << '\n';
+template<typename ST, ST FROM, Duration DUR, DurUnit UNIT, ST TO>
+struct StaticTimeOut : priv::StaticRuleBase
+{
+	static_assert( FROM < ST::NB_STATES && TO < ST::NB_STATES, "invalid state in timeout" );
 
-	auto nbLines = nbEvents()+1; // +1 for timeout events
-#ifdef SPAG_USE_SIGNALS
-	nbLines++;                   // +1 for pass-states
-#endif
+	static constexpr int timeOut( size_t st )
+	{
+		return st == static_cast<size_t>(FROM) ? static_cast<int>(TO) : -1;
+	}
+	static constexpr int nbTimeOuts( size_t st )
+	{
+		return st == static_cast<size_t>(FROM) ? 1 : 0;
+	}
+	static constexpr Duration duration( size_t st )
+	{
+		return st == static_cast<size_t>(FROM) ? DUR : 0;
+	}
+	static constexpr DurUnit durUnit( size_t )
+	{
+		return UNIT;
+	}
+	static constexpr uint64_t successors( uint64_t mask )
+	{
+		return priv::inSet( mask, static_cast<size_t>(FROM) ) ? priv::stateBit( static_cast<size_t>(TO) ) : 0;
+	}
+};
 
-#ifndef SPAG_ENUM_STRINGS
-	std::string capt( "EVENTS" );
-	nbLines = std::max( capt.size(), nbLines );
-#endif
+template<typename ST, ST FROM, ST TO>
+struct StaticAat : priv::StaticRuleBase
+{
+	static_assert( FROM < ST::NB_STATES && TO < ST::NB_STATES, "invalid state in AAT" );
 
-	for( size_t i=0; i<nbLines; i++ )
+	static constexpr int aat( size_t st )
 	{
-#ifdef SPAG_ENUM_STRINGS
-		if( maxlength )
-			priv::PrintEnumString( out, _strEvents[i], maxlength );
-#else
-		if( i<capt.size() )
-			out << capt[i];
-		else
-#endif
-			out << spc_char;
+		return st == static_cast<size_t>(FROM) ? static_cast<int>(TO) : -1;
+	}
+	static constexpr int nbAats( size_t st )
+	{
+		return st == static_cast<size_t>(FROM) ? 1 : 0;
+	}
+	static constexpr uint64_t successors( uint64_t mask )
+	{
+		return priv::inSet( mask, static_cast<size_t>(FROM) ) ? priv::stateBit( static_cast<size_t>(TO) ) : 0;
+	}
+};
+
+//-----------------------------------------------------------------------------------
+/// A FSM whose configuration is fully defined at build time
+/**
+Template arguments:
+ - \c ST: states enum, \c EV: events enum (same requirements as for SpagFSM)
+ - \c CB: callback handler type, must provide the two member functions <code>void onEnter( ST )</code> and <code>void onIgnored( ST, EV )</code>
+ (see StaticNoCallback)
+ - \c RULES: the transitions, timeouts and AAT (see SPAG_STATIC_TRANSITION(), SPAG_STATIC_TIMEOUT() and SPAG_STATIC_AAT() )
+
+The configuration is checked at build time (duplicate transitions, unreachable states, pass-state errors),
+and the transition table is a \c constexpr array, so processEvent() does a single table lookup,
+and callbacks are direct (inlinable) calls.
+
+There is no timer handling: the user code must call processTimeOut() when the timeout of the current state
+(see hasTimeOut() and timeOutDuration() ) expires.
+
+\warning Limited to 64 states.
+*/
+template<typename ST, typename EV, typename CB, typename... RULES>
+class StaticFSM
+{
+	using Rules   = priv::StaticRuleSet<RULES...>;
+	static constexpr size_t NbStates = static_cast<size_t>(ST::NB_STATES);
+	static constexpr size_t NbEvents = static_cast<size_t>(EV::NB_EVENTS);
+	using Checker = priv::StaticChecker<NbStates,NbEvents,Rules>;
+
+	static_assert( NbStates > 1,   "Error, you need to provide at least two states" );
+	static_assert( NbStates <= 64, "Error, StaticFSM is limited to 64 states" );
+	static_assert( Checker::template forAll<typename Checker::UniqueTransition>( 0, NbStates*NbEvents ), "Error, a transition is defined twice" );
+	static_assert( Checker::template forAll<typename Checker::UniqueTimeOutAat>( 0, NbStates ),           "Error, a timeout or an AAT is defined twice on a state" );
+	static_assert( Checker::template forAll<typename Checker::TimeOutAndPassState>( 0, NbStates ),        "Error, a state has both a timeout and an AAT" );
+	static_assert( Checker::template forAll<typename Checker::SamePassState>( 0, NbStates ),              "Error, pass-state leads to same state" );
+	static_assert( Checker::template forAll<typename Checker::PassStateTransition>( 0, NbStates ),        "Error, a pass-state can't have other transitions" );
+	static_assert( Checker::template forAll<typename Checker::PassStateLoop>( 0, NbStates ),              "Error, pass-states loop" );
+	static_assert( Checker::allReachable(), "Error, some states are unreachable" );
+
+	struct TransitionF { static constexpr int8_t   value( size_t i )  { return static_cast<int8_t>( Rules::transition( i/NbEvents, i%NbEvents ) ); } };
+	struct TimeOutF    { static constexpr int8_t   value( size_t st ) { return static_cast<int8_t>( Rules::timeOut( st ) ); } };
+	struct AatF        { static constexpr int8_t   value( size_t st ) { return static_cast<int8_t>( Rules::aat( st ) ); } };
+	struct DurationF   { static constexpr Duration value( size_t st ) { return Rules::duration( st ); } };
+	struct DurUnitF    { static constexpr DurUnit  value( size_t st ) { return Rules::durUnit( st ); } };
+
+	using Transitions = priv::StaticTable<int8_t,  TransitionF,typename priv::MakeIndexSeq<NbStates*NbEvents>::type>; ///< state-major, -1 means ignored
+	using TimeOuts    = priv::StaticTable<int8_t,  TimeOutF,   typename priv::MakeIndexSeq<NbStates>::type>;
+	using Aats        = priv::StaticTable<int8_t,  AatF,       typename priv::MakeIndexSeq<NbStates>::type>;
+	using Durations   = priv::StaticTable<Duration,DurationF,  typename priv::MakeIndexSeq<NbStates>::type>;
+	using DurUnits    = priv::StaticTable<DurUnit, DurUnitF,   typename priv::MakeIndexSeq<NbStates>::type>;
 
-		if( i<nbEvents() )
+	public:
+		explicit StaticFSM( CB cb = CB() ) : _cb( cb )
+		{}
+
+		static constexpr size_t nbStates() { return NbStates; }
+		static constexpr size_t nbEvents() { return NbEvents; }
+
+/// Returns a reference on the callback handler
+		CB& handler() { return _cb; }
+
+/// start FSM : run callback associated to initial state (and the AAT, if any)
+		void start()
 		{
-			out << spc_char << 'E' << std::setw(2) << i << " | ";
+			SPAG_P_ASSERT( !_isRunning, "attempt to start an already running FSM" );
+			_isRunning = true;
+			_current   = static_cast<ST>(0);
+			_previous  = _current;
+			runAction();
+		}
+		void stop()
+		{
+			SPAG_P_ASSERT( _isRunning, "attempt to stop an already stopped FSM" );
+			_isRunning = false;
+		}
+		bool isRunning()     const { return _isRunning; }
+		ST   currentState()  const { return _current; }
+		ST   previousState() const { return _previous; }
 
-			for( size_t j=0; j<nbStates(); j++ )
+/// User-code should call this function when an external event occurs
+		void processEvent( EV ev )
+		{
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(ev), NbEvents );
+			SPAG_P_ASSERT( _isRunning, "attempting to process an event but FSM is not started" );
+			auto next = Transitions::data[ SPAG_P_CAST2IDX(_current)*NbEvents + SPAG_P_CAST2IDX(ev) ];
+			if( next < 0 )
 			{
-				if( _allowedMat[i][j] )
-					out << 'S' << std::setw(2) << _transitionMat[i][j];
-				else
-					out << " . ";
-				out << spc_char;
+				_cb.onIgnored( _current, ev );
+				return;
 			}
+			_previous = _current;
+			_current  = static_cast<ST>(next);
+			runAction();
+		}
 
+/// User-code should call this function when the timeout of the current state expires
+		void processTimeOut()
+		{
+			SPAG_P_ASSERT( _isRunning, "attempting to process a timeout but FSM is not started" );
+			SPAG_P_ASSERT( hasTimeOut(), "current state has no timeout" );
+			_previous = _current;
+			_current  = static_cast<ST>( TimeOuts::data[ SPAG_P_CAST2IDX(_current) ] );
+			runAction();
 		}
-		if( i == nbEvents() ) // TimeOut events
+
+/// Returns true if the current state has a timeout
+		bool hasTimeOut() const
 		{
-			out << "  TO | ";
-			for( size_t j=0; j<nbStates(); j++ )
-			{
-				if( _stateInfo[j]._timerEvent._enabled )
-					out << 'S' << std::setw(2) << _stateInfo[j]._timerEvent._nextState;
-				else
-					out << " . ";
-				out << spc_char;
-			}
+			return TimeOuts::data[ SPAG_P_CAST2IDX(_current) ] >= 0;
 		}
-#ifdef SPAG_USE_SIGNALS
-		if( i == nbEvents()+1 ) // Pass-state
+
+/// Returns the timeout duration and unit of state \c st (duration is 0 if the state has no timeout)
+		std::pair<Duration,DurUnit> timeOutDuration( ST st ) const
 		{
-			out << " AAT | ";
-			for( size_t j=0; j<nbStates(); j++ )
+			SPAG_CHECK_LESS( SPAG_P_CAST2IDX(st), NbStates );
+			return std::make_pair( Durations::data[ SPAG_P_CAST2IDX(st) ], DurUnits::data[ SPAG_P_CAST2IDX(st) ] );
+		}
+
+	private:
+/// Calls the callback of the current state, and then follows the AAT, if any
+		void runAction()
+		{
+			for(;;)
 			{
-				if( _stateInfo[j]._isPassState )
-					out << 'S' << std::setw(2) << _transitionMat[ nbEvents()+1 ][j];
-				else
-					out << " . ";
-				out << spc_char;
+				_cb.onEnter( _current );
+				auto next = Aats::data[ SPAG_P_CAST2IDX(_current) ];
+				if( next < 0 || !_isRunning )      // the callback could have stopped the FSM
+					break;
+				_previous = _current;
+				_current  = static_cast<ST>(next);
 			}
 		}
-#endif
-		out << '\n';
-	}
-}
+
+	private:
+		CB   _cb;
+		ST   _current   = static_cast<ST>(0);
+		ST   _previous  = static_cast<ST>(0);
+		bool _isRunning = false;
+};
+
 //-----------------------------------------------------------------------------------
-/// Helper function, returns true if state \c st is referenced in \c _transitionMat (and that the transition is allowed)
-/// or it has a Timeout or pass-state transition
-template<typename ST, typename EV,typename T,typename CBA>
-bool
-SpagFSM<ST,EV,T,CBA>::isReachable( size_t st ) const
+/// Dense transition table for DynamicFSM: one cell for each (state,event) pair, state-major (this is the default)
+/**
+Memory footprint is <code>nbStates * nbEvents * sizeof(IDX)</code>, and a lookup is a single memory access.
+*/
+template<typename IDX>
+class DenseTable
 {
-	for( size_t i=0; i<nbStates(); i++ )
-		if( i != st )
+	public:
+		static constexpr IDX None = std::numeric_limits<IDX>::max();
+
+		void init( size_t nbStates, size_t nbEvents )
 		{
-			for( size_t k=0; k<nbEvents(); k++ )
-				if( SPAG_P_CAST2IDX( _transitionMat[k][i] ) == st )
-					if( _allowedMat[k][i] != 0 )
-						return true;
+			_nbEvents = nbEvents;
+			_data.assign( nbStates * nbEvents, None );
+		}
+		void set( size_t st, size_t ev, IDX next )
+		{
+			_data[ st * _nbEvents + ev ] = next;
+		}
+/// Removes all the transitions of state \c st
+		void clearState( size_t st )
+		{
+			std::fill_n( _data.begin() + st * _nbEvents, _nbEvents, None );
+		}
+/// Nothing to do here, the table is always up to date
+		void build() {}
+/// Always true, see SparseTable::isBuilt()
+		bool isBuilt() const { return true; }
 
-			if( _stateInfo[i]._timerEvent._enabled )
-				if( SPAG_P_CAST2IDX( _stateInfo[i]._timerEvent._nextState ) == st )
-					return true;
+/// Returns the destination state, or \c None if event \c ev is ignored on state \c st
+		IDX get( size_t st, size_t ev ) const
+		{
+			return _data[ st * _nbEvents + ev ];
+		}
+/// Returns the memory used by the table, in bytes
+		size_t memSize() const
+		{
+			return _data.size() * sizeof(IDX);
+		}
 
-#ifdef SPAG_USE_SIGNALS
-			if( _stateInfo[i]._isPassState )
-				if( _transitionMat[ nbEvents()+1 ][i] == st )
-					return true;
+	private:
+		size_t           _nbEvents = 0;
+		std::vector<IDX> _data;
+};
 
-			for( const auto& itr: _stateInfo[i]._innerTransList )
-				if( SPAG_P_CAST2IDX( itr._destState ) == st )
-					return true;
-#endif
-		}
+template<typename IDX>
+constexpr IDX DenseTable<IDX>::None;
 
-	return false;
-}
 //-----------------------------------------------------------------------------------
-/// Checks configuration for any illegal situation. Throws error if one is encountered.
-template<typename ST, typename EV,typename T,typename CBA>
-void
-SpagFSM<ST,EV,T,CBA>::doChecking() const
+/// Sparse transition table for DynamicFSM, for large FSM with few transitions on each state
+/**
+The table is stored in CSR form ("Compressed Sparse Row"): for each state, the sorted list of its allowed events,
+with the associated destination states, all the rows being contiguous.
+Memory footprint is <code>(nbStates+1) * 4 + nbTransitions * 2 * sizeof(IDX)</code>.
+
+A lookup searches the event in the row of the current state: linear scan for short rows, binary search for the others,
+so an ignored event costs a few compares instead of a single access.
+
+Assignments are first stored in a pending list, that is merged into the table by build()
+(called by DynamicFSM::start(), and on the next event after some configuration changes done while the FSM is running,
+so that a sequence of changes costs a single build).
+*/
+template<typename IDX>
+class SparseTable
 {
- #if 0
- 	for( size_t i=0; i<nbStates(); i++ )
-	{
-		auto state = _stateInfo[i];
-		if( state._isPassState )
+	private:
+		struct Entry
 		{
-			size_t nextState = SPAG_P_CAST2IDX( _transitionMat[0][i] );
-			if( nextState == i )
-				SPAG_P_THROW_ERROR_CFG( getConfigErrorMessage( priv::CE_SamePassState, i ) );
+			uint64_t _key;      ///< state * nbEvents + event
+			IDX      _next;
+			bool operator < ( const Entry& e ) const { return _key < e._key; }
+		};
+/// Rows shorter than this are searched linearly
+		static constexpr size_t LinearMax = 8;
 
-//			if( _stateInfo[ nextState ]._isPassState )
-//				SPAG_P_THROW_ERROR_CFG( getConfigErrorMessage( priv::CE_IllegalPassState, i ) );
+	public:
+		static constexpr IDX None = std::numeric_limits<IDX>::max();
 
-//			if( state._timerEvent._enabled )
-//				SPAG_P_THROW_ERROR_CFG( getConfigErrorMessage( priv::CE_TimeOutAndPassState, i ) );
+		void init( size_t nbStates, size_t nbEvents )
+		{
+			_nbEvents = nbEvents;
+			_rowStart.assign( nbStates+1, 0 );
+			_events.clear();
+			_next.clear();
+			_pending.clear();
+			_hasRemoved = false;
 		}
-	}
-#endif
-
-// check for unreachable states
-	std::vector<size_t> unreachableStates;
-	for( size_t i=1; i<nbStates(); i++ )         // we start from index 1, because 0 is the initial state, and thus is always reachable!
-		if( !isReachable( i ) )
-			unreachableStates.push_back( i );
-	for( const auto& st: unreachableStates )
-	{
-		std::cout << priv::getSpagName() << "Warning, state S" << std::setw(2) << st
-#ifdef SPAG_ENUM_STRINGS
-			<< " (" << _strStates[st] << ')'
-#endif
-			<< " is unreachable\n";
-	}
-
-	for( size_t i=0; i<nbStates(); i++ ) // check for any dead-end situations
-	{
-		bool foundValid(false);
-		if( _stateInfo[i]._timerEvent._enabled )
-			foundValid = true;
-#ifdef SPAG_USE_SIGNALS
-		if( _stateInfo[i]._isPassState )
-			foundValid = true;
-#endif
-		if( !foundValid )       // else
+/// Throws if the table could get more transitions than the row indexes can hold (checked before the table is modified)
+		void set( size_t st, size_t ev, IDX next )
 		{
-			for( size_t j=0; j<nbEvents(); j++ )
-				if( SPAG_P_CAST2IDX( _transitionMat[j][i] ) != i )   // if the transition leads to another state
-					if( _allowedMat[j][i] != 0 )                  // AND it is allowed
-						foundValid = true;
+			if( _events.size() + _pending.size() >= std::numeric_limits<uint32_t>::max() )
+				SPAG_P_THROW_ERROR_CFG( "too many transitions" );
+			_pending.push_back( Entry{ static_cast<uint64_t>(st) * _nbEvents + ev, next } );
 		}
-
-		if( !foundValid )                     // if we didn't find a valid transition
-			if( std::find(
-				unreachableStates.begin(),
-				unreachableStates.end(),
-				i
-			) == unreachableStates.end() )     // AND it is not in the unreachable states list
+/// Removes all the transitions of state \c st
+		void clearState( size_t st )
 		{
-			std::cout << priv::getSpagName() << "Warning, state S" << std::setw(2) << i
-#ifdef SPAG_ENUM_STRINGS
-				<< " (" << _strStates[i] << ')'
-#endif
-				<< " is a dead-end\n";
+			std::fill( _next.begin() + _rowStart[st], _next.begin() + _rowStart[st+1], None );   // removed by next build()
+			_hasRemoved |= _rowStart[st+1] != _rowStart[st];
+			auto first = static_cast<uint64_t>(st) * _nbEvents;
+			auto nbEv  = _nbEvents;
+			_pending.erase(
+				std::remove_if(
+					_pending.begin(),
+					_pending.end(),
+					[first,nbEv]( const Entry& e ){ return e._key >= first && e._key < first + nbEv; }
+				),
+				_pending.end()
+			);
 		}
-	}
-}
-//-----------------------------------------------------------------------------------
-/// Helper function for printConfig()
-template<typename ST, typename EV,typename T,typename CBA>
-void
-SpagFSM<ST,EV,T,CBA>::printLineHeader( std::ostream& out, size_t idx, bool firstline_flag, size_t maxlength ) const
-{
-	if( firstline_flag )
-		out << 'S' << std::setw(2) << idx;
-	else
-		out << "   ";
-#ifdef SPAG_ENUM_STRINGS
-	out << ':';
-	if( firstline_flag )
-	{
-//		firstline_flag = false;
-		priv::PrintEnumString( out, _strStates[idx], maxlength );
-	}
-	else
-		priv::printChars( out, maxlength, ' ' );
-#endif
-		out << "| ";
-}
-//-----------------------------------------------------------------------------------
-template<typename ST, typename EV,typename T,typename CBA>
-void
-SpagFSM<ST,EV,T,CBA>::printStateConfig( std::ostream& out ) const
-{
-	size_t maxlength = 0;
-#ifdef SPAG_ENUM_STRINGS
-	maxlength = priv::getMaxLength( _strStates );
-#endif
-
-	for( size_t i=0; i<nbStates(); i++ )
-	{
-		printLineHeader( out, i, true, maxlength );
-		bool print_content = false;
 
-		const auto& stinf = _stateInfo[i];
-		const auto& tev = stinf._timerEvent;
-		if( tev._enabled )
+/// Merges the pending assignments into the table (the last assignment of a given pair wins), and removes the empty cells
+		void build()
 		{
-			print_content = true;
-			out << "TO: " <<  tev._duration << ' ' << priv::stringFromTimeUnit( tev._durUnit )
-				<< " => S" << std::setw(2) << SPAG_P_CAST2IDX( tev._nextState );
-#ifdef SPAG_ENUM_STRINGS
-			out << " (";
-			priv::PrintEnumString( out, _strStates[tev._nextState] );
-			out << ')';
-#endif // SPAG_ENUM_STRINGS
-			out << '\n';
+			if( _pending.empty() && !_hasRemoved )
+				return;
+
+			auto nbStates = _rowStart.size() - 1;
+			std::vector<Entry> all;
+			all.reserve( _next.size() + _pending.size() );
+			for( size_t st=0; st<nbStates; st++ )
+				for( auto i=_rowStart[st]; i<_rowStart[st+1]; i++ )
+					all.push_back( Entry{ static_cast<uint64_t>(st) * _nbEvents + _events[i], _next[i] } );
+			all.insert( all.end(), _pending.begin(), _pending.end() );
+			_pending.clear();
+			std::stable_sort( all.begin(), all.end() );
+
+			_events.clear();
+			_next.clear();
+			std::fill( _rowStart.begin(), _rowStart.end(), 0 );
+			for( size_t i=0; i<all.size(); i++ )
+			{
+				if( i+1 < all.size() && all[i+1]._key == all[i]._key )   // overwritten by a later assignment
+					continue;
+				if( all[i]._next == None )
+					continue;
+				_events.push_back( static_cast<IDX>( all[i]._key % _nbEvents ) );
+				_next.push_back( all[i]._next );
+				_rowStart[ all[i]._key / _nbEvents + 1 ]++;
+			}
+			_hasRemoved = false;
+			for( size_t st=0; st<nbStates; st++ )
+				_rowStart[st+1] += _rowStart[st];
 		}
 
-#ifdef SPAG_USE_SIGNALS
-		for( size_t j=0; j<stinf._innerTransList.size(); ++j )
+/// Returns the destination state, or \c None if event \c ev is ignored on state \c st
+		IDX get( size_t st, size_t ev ) const
 		{
-			if( print_content )
-				printLineHeader( out, i, false, maxlength );
-			else
-				print_content = true;
-
-			const auto &itr = stinf._innerTransList[j];
-			auto dst_st = SPAG_P_CAST2IDX(itr._destState);
-			auto i_ev   = SPAG_P_CAST2IDX(itr._innerEvent);
-			out << "IT ("
-				<< ( _innerEventFlag.at(itr._innerEvent)?'A':'I')
-				<< "): E" << std::setw(2) << i_ev;
-#ifdef SPAG_ENUM_STRINGS
-			out << " (";
-			priv::PrintEnumString( out, _strEvents[i_ev] );
-			out << ')';
-#endif // SPAG_ENUM_STRINGS
-
-			out << " => S" << std::setw(2) << dst_st;
-
-#ifdef SPAG_ENUM_STRINGS
-			out << " (";
-			priv::PrintEnumString( out, _strStates[dst_st] );
-			out << ')';
-#endif // SPAG_ENUM_STRINGS
-
-			out << '\n';
+			auto first = _rowStart[st];
+			auto last  = _rowStart[st+1];
+			if( last - first <= LinearMax )
+			{
+				for( auto i=first; i<last; i++ )
+					if( _events[i] == ev )
+						return _next[i];
+				return None;
+			}
+			auto it = std::lower_bound( _events.begin() + first, _events.begin() + last, static_cast<IDX>(ev) );
+			if( it == _events.begin() + last || *it != ev )
+				return None;
+			return _next[ it - _events.begin() ];
 		}
-
-		if( stinf._isPassState )
+/// Returns the memory used by the table, in bytes (pending assignments excepted)
+		size_t memSize() const
 		{
-			if( print_content )
-				printLineHeader( out, i, false, maxlength );
-			else
-				print_content = true;
-
-			out << "AAT: => S" << std::setw(2) << SPAG_P_CAST2IDX( _transitionMat[ nbEvents()+1 ][i] );
-#ifdef SPAG_ENUM_STRINGS
-			out << " (";
-			priv::PrintEnumString( out, _strStates[_transitionMat[ nbEvents()+1 ][i]] );
-			out << ')';
-#endif // SPAG_ENUM_STRINGS
-			out << '\n';
+			return _rowStart.size() * sizeof(uint32_t) + ( _events.size() + _next.size() ) * sizeof(IDX);
+		}
+/// Returns the number of stored transitions (pending assignments excepted)
+		size_t nbTransitions() const
+		{
+			return _events.size();
+		}
+/// Returns true if there is no pending assignment, i.e. if build() has nothing to do
+		bool isBuilt() const
+		{
+			return _pending.empty() && !_hasRemoved;
 		}
-#endif // SPAG_USE_SIGNALS
 
-		if( !print_content )
-			out << "-\n";
-	}
-}
-//-----------------------------------------------------------------------------------
-/// Printing function, prints transition table and states info
-template<typename ST, typename EV,typename T,typename CBA>
-void
-SpagFSM<ST,EV,T,CBA>::printConfig( std::ostream& out, const char* msg ) const
-{
-	out << "\n* FSM Configuration: ";
-	if( msg )
-		out << msg;
-	out << "\n - Transition table:\n";
-	printMatrix( out );
-	out << "\n - State info:\n";
-	printStateConfig( out );
-	out << "---------------------\n";
-}
+	private:
+		size_t                _nbEvents = 0;
+		std::vector<uint32_t> _rowStart;   ///< for each state, index of its first transition in the two vectors below (plus one last value)
+		std::vector<IDX>      _events;     ///< allowed events, sorted in each row
+		std::vector<IDX>      _next;       ///< destination states
+		std::vector<Entry>    _pending;    ///< assignments not yet merged into the table
+		bool                  _hasRemoved = false;   ///< true if clearState() left empty cells in the table
+};
+
+template<typename IDX>
+constexpr IDX SparseTable<IDX>::None;
 
 //-----------------------------------------------------------------------------------
-/// Saves in current folder a .dot file of the FSM, to be rendered with Graphviz
+/// A FSM whose number of states and events is given at run-time (no enums needed), for large generated FSM
 /**
-DO NOT give the extension in argument, is is added here.
+Template arguments:
+ - \c IDX: the type used for states and events indexes, and to store the transitions: an unsigned integer type
+ (\c uint8_t, \c uint16_t or \c uint32_t), its max value being reserved (so \c uint8_t allows up to 255 states)
+ - \c CB: callback handler type, must provide the two member functions <code>void onEnter( IDX )</code> and <code>void onIgnored( IDX, IDX )</code>
+ (see StaticNoCallback)
+ - \c TABLE: the transition table type: DenseTable (default) or SparseTable
+
+With the default DenseTable, the transition table is a single contiguous array, state-major (one row of \c nbEvents() values per state),
+ignored events being stored as the max value of \c IDX. So processEvent() does a single table lookup, for any size.
+With SparseTable, only the allowed transitions are stored, which is smaller when states have few allowed events.
+
+As with StaticFSM, there is no timer handling: the user code must call processTimeOut() when the timeout of the current state
+(see hasTimeOut() and timeOutDuration() ) expires.
 */
-template<typename ST, typename EV,typename T,typename CBA>
-void
-SpagFSM<ST,EV,T,CBA>::writeDotFile( std::string fname, DotFileOptions opt ) const
+template<typename IDX=uint16_t, typename CB=StaticNoCallback<IDX,IDX>, typename TABLE=DenseTable<IDX>>
+class DynamicFSM
 {
-	std::string full_fn = fname + ".dot";
-	std::ofstream f( full_fn );
-	if( !f.is_open() )
-		SPAG_P_THROW_ERROR_RT( "error, unable to open file: " + full_fn );
-	f << "/*\nGenerated by Spaghetti library\nhttps://github.com/skramm/spaghetti\n"
-		<< "Version " << SPAG_STRINGIZE(SPAG_VERSION) << "\n*/\n";
-	f << "digraph G {\n"
-		<< "rankdir=LR;\n"
-		<< "edge[style=\"bold\"];\n"
-		<< "node[shape=\"" << opt.nodeShape << "\"";
-	if( opt.fixedNodeWidth )
-		f << ",fixedsize=true,width=" << opt.nodeWidth;
-	f << "];\n";
-	f << std::setfill( '0' );
+	static_assert( std::is_integral<IDX>::value && std::is_unsigned<IDX>::value, "Error, index type must be an unsigned integer type" );
 
-	f << "\n/* States (=nodes) */\n";
-	for( size_t j=0; j<nbStates(); j++ )
-	{
-		if( opt.showUnreachableStates || isReachable( j ) )
+	public:
+/// Value stored in the tables for "no transition"
+		static constexpr IDX None = std::numeric_limits<IDX>::max();
+
+		DynamicFSM( size_t nbStates, size_t nbEvents, CB cb = CB() )
+			: _nbStates( nbStates ), _nbEvents( nbEvents ), _cb( cb )
 		{
-			f << j << " [label=\"";
-			if( opt.showStateIndex )
-				f << 'S' << std::setw(2) << j;
-	#ifdef SPAG_ENUM_STRINGS
-			if( opt.showStateString )
-			{
-				if( opt.showStateIndex )
-					f << "\\n";
-				f << _strStates[j];
-			}
-	#endif
-			f << '"';
+			if( nbStates < 2 )
+				SPAG_P_THROW_ERROR_CFG( "you need to provide at least two states" );
+			if( nbEvents < 1 )
+				SPAG_P_THROW_ERROR_CFG( "you need to provide at least one event" );
+			if( nbStates > None || nbEvents > None )
+				SPAG_P_THROW_ERROR_CFG( "index type is too small for " + std::to_string( std::max( nbStates, nbEvents ) ) + " values" );
+			_transitions.init( nbStates, nbEvents );
+			_timeOut.assign( nbStates, None );
+			_aat.assign( nbStates, None );
+			_duration.assign( nbStates, 0 );
+			_durUnit.assign( nbStates, DurUnit::sec );
+		}
 
-			if( j == 0 )                                // initial state
-				f << ",shape=doublecircle";
-			if( opt.showActiveState )
-				if( SPAG_P_CAST2IDX( currentState() ) == j )
-					f << ",style=filled,fillcolor=black,fontcolor=white";
-	#if 0
-			f << ",URL=\"" << fname << ".html#node_" << j << "\"";
-	#endif
-			f << "];\n";
+		size_t nbStates() const { return _nbStates; }
+		size_t nbEvents() const { return _nbEvents; }
+/// Returns the transition table (with SparseTable, the changes done while running are only merged into it on the next event)
+		const TABLE& table() const { return _transitions; }
+
+/// Returns a reference on the callback handler
+		CB& handler() { return _cb; }
+
+/// \name Configuration
+///@{
+/// Assigns an external transition event \c ev to switch from state \c st1 to state \c st2
+		void assignTransition( IDX st1, IDX ev, IDX st2 )
+		{
+			SPAG_CHECK_LESS( st1, _nbStates );
+			SPAG_CHECK_LESS( st2, _nbStates );
+			SPAG_CHECK_LESS( ev,  _nbEvents );
+			if( _aat[st1] != None )
+				SPAG_P_THROW_ERROR_CFG( "state " + std::to_string( st1 ) + " is a pass-state, it can't have other transitions" );
+			_transitions.set( st1, ev, st2 );
 		}
-	}
-	f << "\n/* External events */\n";
-	for( size_t i=0; i<nbEvents(); i++ )
-		for( size_t j=0; j<nbStates(); j++ )
-			if( _allowedMat[i][j] == 1 )
-			{
-#ifdef SPAG_USE_SIGNALS
-				if( !_stateInfo[j]._isPassState )
-#endif
-					if( isReachable( j ) || opt.showUnreachableStates )
-					{
-						f << j << " -> " << _transitionMat[i][j] << " [label=\"";
-						if( opt.showEventIndex )
-							f << 'E' << std::setw(2) << i;
-#ifdef SPAG_ENUM_STRINGS
-						if( opt.showEventString )
-						{
-							if( opt.showEventIndex )
-								f << ':';
-							f << _strEvents[i];
-						}
-#endif
-						f << "\"];\n";
-					}
-			}
+/// Assigns an external transition event \c ev to switch to state \c st, from all the states (except the pass-states)
+		void assignTransition( IDX ev, IDX st )
+		{
+			for( size_t i=0; i<_nbStates; i++ )
+				if( _aat[i] == None )
+					assignTransition( static_cast<IDX>(i), ev, st );
+		}
+/// Removes the transition on event \c ev from state \c st (the event will then be ignored on that state)
+		void clearTransition( IDX st, IDX ev )
+		{
+			SPAG_CHECK_LESS( st, _nbStates );
+			SPAG_CHECK_LESS( ev, _nbEvents );
+			_transitions.set( st, ev, None );
+		}
+/// Assigns a timeout of duration \c dur (units \c unit) on state \c st1, leading to state \c st2
+		void assignTimeOut( IDX st1, Duration dur, DurUnit unit, IDX st2 )
+		{
+			SPAG_CHECK_LESS( st1, _nbStates );
+			SPAG_CHECK_LESS( st2, _nbStates );
+			if( _aat[st1] != None )
+				SPAG_P_THROW_ERROR_CFG( "state " + std::to_string( st1 ) + " is a pass-state, it can't have a timeout" );
+			_timeOut[st1]  = st2;
+			_duration[st1] = dur;
+			_durUnit[st1]  = unit;
+		}
+/// Assigns a timeout, with units given as a string ("ms", "sec", ...)
+		void assignTimeOut( IDX st1, Duration dur, std::string unit, IDX st2 )
+		{
+			auto tu = priv::timeUnitFromString( unit );
+			if( !tu.first )
+				SPAG_P_THROW_ERROR_CFG( "invalid string value: " + unit );
+			assignTimeOut( st1, dur, tu.second, st2 );
+		}
+/// Assigns an "Always Active Transition": once arrived on state \c st1 (and its callback done), the FSM switches to state \c st2
+		void assignAAT( IDX st1, IDX st2 )
+		{
+			SPAG_CHECK_LESS( st1, _nbStates );
+			SPAG_CHECK_LESS( st2, _nbStates );
+			if( st1 == st2 )
+				SPAG_P_THROW_ERROR_CFG( "pass-state cannot lead to itself" );
+			if( _timeOut[st1] != None )
+				SPAG_P_THROW_ERROR_CFG( "state " + std::to_string( st1 ) + " has a timeout, it can't be a pass-state" );
+			if( _aat[st2] != None )
+				SPAG_P_THROW_ERROR_CFG( "pass-state " + std::to_string( st1 ) + " is followed by another pass-state" );
+			_transitions.clearState( st1 );
+			_aat[st1] = st2;
+		}
+///@}
 
-	f << "\n/* Inner events and timeout transitions */\n";
-	for( size_t j=0; j<nbStates(); j++ )
-	{
-		const auto& tev = _stateInfo[j]._timerEvent;
-		if( tev._enabled && opt.showTimeOuts )
-			if( isReachable( j ) || opt.showUnreachableStates )
-			{
-				f << j << " -> " << tev._nextState
-					<< " [label=\"TO:"
-					<< tev._duration
-					<< priv::stringFromTimeUnit( tev._durUnit )
-					<< "\"";
-				if( opt.useColorsEventType )
-					f << ",color=blue";
-				f << "];\n";
-			}
-#ifdef SPAG_USE_SIGNALS
-		if( _stateInfo[j]._isPassState && opt.showAAT )
-			if( isReachable( j ) || opt.showUnreachableStates )
-			{
-				f << j << " -> " << _transitionMat[ nbEvents()+1 ][j] << " [label=\"AAT\"";
-				if( opt.useColorsEventType )
-					f << ",color=green";
-				f << "];\n";
-			}
-		if( opt.showInnerEvents )
+/// start FSM : run callback associated to initial state (and the AAT, if any)
+		void start()
+		{
+			SPAG_P_ASSERT( !_isRunning, "attempt to start an already running FSM" );
+			_transitions.build();
+			_isRunning = true;
+			_current   = 0;
+			_previous  = 0;
+			runAction();
+		}
+		void stop()
+		{
+			SPAG_P_ASSERT( _isRunning, "attempt to stop an already stopped FSM" );
+			_isRunning = false;
+		}
+		bool isRunning()     const { return _isRunning; }
+		IDX  currentState()  const { return _current; }
+		IDX  previousState() const { return _previous; }
+
+/// User-code should call this function when an external event occurs
+		void processEvent( IDX ev )
 		{
-			for( const auto& itr: _stateInfo[j]._innerTransList )
+			SPAG_CHECK_LESS( ev, _nbEvents );
+			SPAG_P_ASSERT( _isRunning, "attempting to process an event but FSM is not started" );
+			if( !_transitions.isBuilt() )          // configuration has been changed while running (never with DenseTable)
+				_transitions.build();
+			auto next = _transitions.get( _current, ev );
+			if( next == None )
 			{
-				if( isReachable( j ) || opt.showUnreachableStates )
-				{
-					f << j << " -> " << SPAG_P_CAST2IDX( itr._destState ) << " [label=\"";
-					if( opt.showEventIndex )
-						f << "IE" << std::setw(2) << SPAG_P_CAST2IDX( itr._innerEvent );
-#ifdef SPAG_ENUM_STRINGS
-					if( opt.showEventString )
-					{
-						if( opt.showEventIndex )
-							f << ':';
-						f << _strEvents.at(itr._innerEvent);
-					}
-#endif // SPAG_ENUM_STRINGS
-					f << '"';
-					if( opt.useColorsEventType )
-						f << ",color=red";
-					f << "];\n";
-				}
+				_cb.onIgnored( _current, ev );
+				return;
 			}
+			_previous = _current;
+			_current  = next;
+			runAction();
+		}
+/// Processes a range of events, in order. Stops if the FSM gets stopped by a callback. Returns the number of processed events
+		template<typename IT>
+		size_t processEvents( IT first, IT last )
+		{
+			size_t nb = 0;
+			for( ; first != last && _isRunning; ++first, ++nb )
+				processEvent( static_cast<IDX>( *first ) );
+			return nb;
 		}
-#endif // SPAG_USE_SIGNALS
-	}
-	f << "}\n";
-
-// experimental
-/** idea: generate an html page embedding both the generated figure from the .dot file
-(using graphviz dot tool) and a list holding the string label of each node.
-The point was to add a link to the svg nodes, as this is supposed to work.
 
-Problem: it doesn't. The link works only if you load the svg file in the browser, but not
-if the svg file is loaded as an image inside the web page.
-*/
-#if 0
-#ifdef SPAG_ENUM_STRINGS
-	std::string full_fn2 = fname + ".html";
-	std::ofstream f2( full_fn2 );
-	if( !f2.is_open() )
-		SPAG_P_THROW_ERROR_RT( "error, unable to open file: " + full_fn2 );
-	f2 << "<html>\n<head>\n<title>";
-	f2 << fname;
-	f2 << "</title>\n</head>\n<body>\n";
+/// User-code should call this function when the timeout of the current state expires
+		void processTimeOut()
+		{
+			SPAG_P_ASSERT( _isRunning, "attempting to process a timeout but FSM is not started" );
+			SPAG_P_ASSERT( hasTimeOut(), "current state has no timeout" );
+			_previous = _current;
+			_current  = _timeOut[_current];
+			runAction();
+		}
+/// Returns true if the current state has a timeout
+		bool hasTimeOut() const
+		{
+			return _timeOut[_current] != None;
+		}
+/// Returns the timeout duration and unit of state \c st (duration is 0 if the state has no timeout)
+		std::pair<Duration,DurUnit> timeOutDuration( IDX st ) const
+		{
+			SPAG_CHECK_LESS( st, _nbStates );
+			return std::make_pair( _timeOut[st] == None ? Duration(0) : _duration[st], _durUnit[st] );
+		}
 
-	f2 << "<img src=\"" << fname << ".svg\" alt=\"" << fname << "\">\n";
-	f2 << "<hr><ul>\n";
-	for( size_t j=0; j<nbStates(); j++ )
-	{
-		f2 << "<li id=\"node_" << j << "\">node " << j << ": " << _strStates[j];
-		f2 << "</li>\n";
-	}
-	f2 << "</ul>\n";
-	f2 << "</body>\n";
-	f2 << "</html>\n";
-#endif
-#endif
-}
-//-----------------------------------------------------------------------------------
-namespace priv {
+	private:
+/// Calls the callback of the current state, and then follows the AAT, if any
+		void runAction()
+		{
+			for(;;)
+			{
+				_cb.onEnter( _current );
+				auto next = _aat[_current];
+				if( next == None || !_isRunning )      // the callback could have stopped the FSM
+					break;
+				_previous = _current;
+				_current  = next;
+			}
+		}
 
-/// Dummy type, used if no timer requested by user
-template<typename ST, typename EV,typename CBA>
-struct NoTimer
-{
-	void timerStart( const SpagFSM<ST,EV,NoTimer,CBA>* ) {}
-	void init(  const SpagFSM<ST,EV,NoTimer,CBA>* ) {}
-	void timerCancel() {}
-	void raiseSignal() {}
+	private:
+		size_t                _nbStates;
+		size_t                _nbEvents;
+		TABLE                 _transitions;
+		std::vector<IDX>      _timeOut;       ///< for each state, the state to switch to on timeout
+		std::vector<IDX>      _aat;           ///< for each state, the state to switch to after the callback (pass-states)
+		std::vector<Duration> _duration;
+		std::vector<DurUnit>  _durUnit;
+		CB   _cb;
+		IDX  _current   = 0;
+		IDX  _previous  = 0;
+		bool _isRunning = false;
 };
 
-} // namespace priv
+template<typename IDX, typename CB, typename TABLE>
+constexpr IDX DynamicFSM<IDX,CB,TABLE>::None;
 
 //-----------------------------------------------------------------------------------
 
@@ -2488,9 +8532,8 @@ That last point isn't that obvious, as it also must have a lifespan not limited
 For timer duration, see
 http://en.cppreference.com/w/cpp/chrono/duration
 
-\bug we have a problem with signal when both symbols SPAG_USE_SIGNALS and SPAG_EXTERNAL_EVENT_LOOP are defined:
-the signal handler is NOT called!!!
-See src/sample_3c.cpp that demonstrates the problem.
+Inner events and AAT (symbol \c SPAG_USE_SIGNALS) are processed by SpagFSM itself, right after the callback,
+thus they do not involve this class.
 */
 template<typename ST, typename EV, typename CBA>
 struct AsioWrapper
@@ -2520,10 +8563,6 @@ struct AsioWrapper
 
 	std::unique_ptr<SteadyClock> _asioTimer; ///< pointer on timer, will be allocated in constructor
 
-#ifdef SPAG_USE_SIGNALS
-	boost::asio::signal_set _signals;
-#endif
-
 	public:
 /// Constructor
 #ifdef SPAG_EXTERNAL_EVENT_LOOP
@@ -2540,10 +8579,6 @@ struct AsioWrapper
 		AsioWrapper() : _ewg( boost::asio::make_work_guard( _io_service ) )
 	#endif
 #endif
-
-#ifdef SPAG_USE_SIGNALS
-	, _signals( _io_service, SPAG_SIGNAL )
-#endif
 	{
 		_asioTimer = std::unique_ptr<SteadyClock>( new SteadyClock(_io_service) );
 	}
@@ -2559,28 +8594,13 @@ struct AsioWrapper
 	void init( spag::SpagFSM<ST,EV,AsioWrapper,CBA>* fsm )
 	{
 		SPAG_LOG << '\n';
-#ifdef SPAG_USE_SIGNALS
-		_signals.async_wait(            // initialize the signal handler, for deferred events
-			boost::bind(
-				&AsioWrapper<ST,EV,CBA>::signalHandler,
-				this,
-				boost::asio::placeholders::error,
-				boost::asio::placeholders::signal_number,
-				fsm
-			)
-		);
-#endif
 		_io_service.run();          // blocking call !!!
 	}
 
-/// terminates all pending events, timers events or signals
+/// terminates all pending events and timers events
 	void kill()
 	{
 		SPAG_LOG << '\n';
-#ifdef SPAG_USE_SIGNALS
-		_signals.cancel();
-		_signals.clear();
-#endif
 		_io_service.stop();
 	}
 
@@ -2593,6 +8613,7 @@ struct AsioWrapper
 		{
 			case boost::system::errc::operation_canceled:    // do nothing
 				SPAG_LOG << "err_code=operation_canceled\n";
+				SPAG_P_TRACEPOINT( TimerAborted, fsm, SPAG_P_CAST2IDX( fsm->currentState() ), 0, 0 );
 			break;
 			case 0:
 				fsm->processTimeOut();                    // normal operation: timer has expired
@@ -2616,6 +8637,12 @@ struct AsioWrapper
 		SPAG_LOG << "Starting timer with duration=" << duration.first << '\n';
 		switch( duration.second )
 		{
+			case DurUnit::ns:
+				_asioTimer->expires_from_now( std::chrono::nanoseconds(duration.first) );
+			break;
+			case DurUnit::us:
+				_asioTimer->expires_from_now( std::chrono::microseconds(duration.first) );
+			break;
 			case DurUnit::ms:
 				_asioTimer->expires_from_now( std::chrono::milliseconds(duration.first) );
 			break;
@@ -2636,49 +8663,38 @@ struct AsioWrapper
 			)
 		);
 	}
-
-#ifdef SPAG_USE_SIGNALS
-/// This is a handler, automatically called by boost::io_service when an OS signal USR1 is detected (see init() ).
-/// \warning Only available when \ref SPAG_USE_SIGNALS is defined, see manual.
-	void signalHandler( const boost::system::error_code& err_code, int signal_number, spag::SpagFSM<ST,EV,AsioWrapper,CBA>* fsm )
+/// Starts timer with duration \c ns (nanoseconds), used by SpagFSM::restore()
+	void timerStartFor( const spag::SpagFSM<ST,EV,AsioWrapper,CBA>* fsm, uint64_t ns )
 	{
-		SPAG_P_START;
-
-		SPAG_LOG << "handling signal " << signal_number << " errorcode=" << err_code.message() << ", current state=" << fsm->currentState() << std::endl;
-		auto st_idx = SPAG_P_CAST2IDX( fsm->currentState() );
-		auto& stateInfo = fsm->getStateInfo( st_idx );
-//		std::cout << "signal handler, processing " << stateInfo._innerTrans;
-
-		SPAG_LOG << "BEFORE processInnerEvent(): " << stateInfo << '\n';
-		fsm->processInnerEvent( stateInfo );
-		SPAG_LOG << "AFTER processInnerEvent(): " << stateInfo << '\n';
-
-// update on 2020-04-05: new boost releases (from ???)
-// now doesn't have the == operator
-		if( !err_code )
-//		if( err_code == 0 )
-			_signals.async_wait(                                   // re-initialize signal handler, only if the handler is not called whith a "cancel" message
-				boost::bind(
-					&AsioWrapper<ST,EV,CBA>::signalHandler,
-					this,
-					boost::asio::placeholders::error,
-					boost::asio::placeholders::signal_number,
-					fsm
-				)
-			);
-		else
-		{
-			SPAG_P_THROW_ERROR_RT( "Unexpected error boost::system::error_code: " + err_code.message() );
-		}
-		SPAG_P_END;
+		_asioTimer->expires_from_now( std::chrono::nanoseconds( ns ) );
+		_asioTimer->async_wait(
+			boost::bind(
+				&AsioWrapper<ST,EV,CBA>::timerCallback,
+				this,
+				boost::asio::placeholders::error,
+				fsm
+			)
+		);
 	}
-	void raiseSignal()
+/// Returns the time before the timer expires, in ns (0 if past), used by SpagFSM::snapshot()
+	uint64_t timerRemaining() const
 	{
-		SPAG_P_START;
-		std::raise( SPAG_SIGNAL );
-		SPAG_P_END;
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( _asioTimer->expires_from_now() ).count();
+		return ns > 0 ? static_cast<uint64_t>( ns ) : 0;
 	}
-#endif
+
+#ifdef SPAG_USE_EVENT_QUEUE
+/// Mandatory function for SpagFSM if SpagFSM::postEvent() is used. Schedules the processing of the posted events on the io_service thread
+	void postDrain( const spag::SpagFSM<ST,EV,AsioWrapper,CBA>* fsm )
+	{
+		SPAG_LOG << '\n';
+	#if BOOST_VERSION < 106600
+		_io_service.post( [fsm](){ fsm->processPostedEvents(); } );
+	#else
+		boost::asio::post( _io_service, [fsm](){ fsm->processPostedEvents(); } );
+	#endif
+	}
+#endif // SPAG_USE_EVENT_QUEUE
 };
 
 #endif // SPAG_USE_ASIO_WRAPPER
@@ -2697,6 +8713,34 @@ struct AsioWrapper
 #define SPAG_ASSIGN_MEMBER_CALLBACK_ALL( fsm, ClassName, CallbackFunc ) \
 	fsm.assignCallback( std::bind( &ClassName::CallbackFunc, this, std::placeholders::_1 ) )
 
+/// Shorthand for declaring a transition of a StaticFSM: event \c ev switches from state \c st1 to state \c st2
+#define SPAG_STATIC_TRANSITION( st1, ev, st2 ) \
+	spag::StaticTransition<decltype(st1),decltype(ev),st1,ev,st2>
+
+/// Shorthand for declaring a timeout of a StaticFSM: after duration \c dur (in units \c unit, one of \c spag::DurUnit)
+/// on state \c st1, switch to state \c st2
+#define SPAG_STATIC_TIMEOUT( st1, dur, unit, st2 ) \
+	spag::StaticTimeOut<decltype(st1),st1,dur,unit,st2>
+
+/// Shorthand for declaring an "Always Active Transition" of a StaticFSM, from state \c st1 to state \c st2
+#define SPAG_STATIC_AAT( st1, st2 ) \
+	spag::StaticAat<decltype(st1),st1,st2>
+
+/// Shorthand for declaring the type of a StaticFSM, with callback handler \c cb, and the rules as following arguments
+#define SPAG_DECLARE_STATIC_FSM_TYPE( type, st, ev, cb, ... ) \
+	using type = spag::StaticFSM<st,ev,cb,__VA_ARGS__>
+
+/// Shorthand to declare a member function as callback function, without \c std::bind nor \c std::function.
+/// The member function must take the callback argument by value.
+/// \warning needs to be done inside another class member function
+#define SPAG_ASSIGN_MEMBER_CALLBACK_DIRECT( fsm, State, ClassName, CallbackFunc ) \
+	fsm.assignMemberCallback<ClassName,&ClassName::CallbackFunc>( State, this )
+
+/// Shorthand to declare a member function as callback function for all states, without \c std::bind nor \c std::function.
+/// \warning needs to be done inside another class member function
+#define SPAG_ASSIGN_MEMBER_CALLBACK_DIRECT_ALL( fsm, ClassName, CallbackFunc ) \
+	fsm.assignMemberCallback<ClassName,&ClassName::CallbackFunc>( this )
+
 /// Shorthand for declaring a type of FSM without a timer
 #ifdef SPAG_USE_ASIO_WRAPPER
 	#define SPAG_DECLARE_FSM_TYPE_NOTIMER( type, st, ev, cbarg ) \
@@ -0,0 +1,51 @@
+/**
+\file log2csv.cpp
+\brief Converts a binary log file, produced when symbol SPAG_ASYNC_LOGGING is defined, into the regular csv format.
+
+Usage: <code>log2csv [input_file [output_file]]</code><br>
+Default input is "spaghetti.bin", default output is stdout.
+
+This file is part of Spaghetti, a C++ library for implementing Finite State Machines
+
+Homepage: https://github.com/skramm/spaghetti
+*/
+
+#define SPAG_ENABLE_LOGGING
+#include "spaghetti.hpp"
+
+//-----------------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+	std::string fn_in( "spaghetti.bin" );
+	if( argc > 1 )
+		fn_in = argv[1];
+
+	std::ifstream f_in( fn_in, std::ios::binary );
+	if( !f_in.is_open() )
+	{
+		std::cerr << argv[0] << ": unable to open input file " << fn_in << '\n';
+		return 1;
+	}
+	try
+	{
+		size_t nb = 0;
+		if( argc > 2 )
+		{
+			std::ofstream f_out( argv[2] );
+			if( !f_out.is_open() )
+			{
+				std::cerr << argv[0] << ": unable to open output file " << argv[2] << '\n';
+				return 1;
+			}
+			nb = spag::convertLogFile( f_in, f_out );
+		}
+		else
+			nb = spag::convertLogFile( f_in, std::cout );
+		std::cerr << argv[0] << ": converted " << nb << " records\n";
+	}
+	catch( const std::exception& e )
+	{
+		std::cerr << argv[0] << ": error: " << e.what() << '\n';
+		return 1;
+	}
+}
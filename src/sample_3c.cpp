@@ -2,10 +2,6 @@
 \file sample_3c.cpp
 \brief Similar to sample_3b.cpp, but with external event handler
 
-\bug for some reason, we have a problem here:
-when SPAG_EXTERNAL_EVENT_LOOP is defined, the signal is raised but the handler is NOT called.
-Need to investigate this...
-
 This file is part of Spaghetti, a C++ library for implementing Finite State Machines
 
 Homepage: https://github.com/skramm/spaghetti
@@ -0,0 +1,76 @@
+/**
+\file sample_4.cpp
+\brief demo of posting events from several threads with postEvent() (needs symbol SPAG_USE_EVENT_QUEUE).
+
+The events are queued without any locking, and processed on the thread running the event loop
+(here, the one that called <code>fsm.start()</code>).
+
+This file is part of Spaghetti, a C++ library for implementing Finite State Machines
+
+Homepage: https://github.com/skramm/spaghetti
+*/
+
+#define SPAG_EMBED_ASIO_WRAPPER
+#define SPAG_USE_EVENT_QUEUE
+#define SPAG_ENUM_STRINGS
+#include "spaghetti.hpp"
+
+#include <thread>
+
+enum States { st_Idle, st_Active, st_Done, NB_STATES };
+enum Events { ev_Ping, ev_Stop, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_ASIO( fsm_t, States, Events, int );
+
+fsm_t fsm;
+int g_count = 0;  // no need for a mutex: callbacks are always called on the same thread
+
+void cb( int st )
+{
+	if( st == st_Done )
+	{
+		std::cout << "Done, " << g_count << " state changes\n";
+		fsm.stop();
+	}
+	else
+		g_count++;
+}
+
+/// Producer thread: posts ev_Ping events
+void producer( int id )
+{
+	for( int i=0; i<100; i++ )
+	{
+		if( !fsm.postEvent( ev_Ping ) )
+			std::cout << "thread " << id << ": queue full, event lost\n";
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1+id ) );
+	}
+}
+
+//-----------------------------------------------------------------------------------
+int main( int, char* argv[] )
+{
+	std::cout << argv[0] << ": " << fsm_t::buildOptions() << '\n';
+
+	fsm.assignTransition( st_Idle,   ev_Ping, st_Active );
+	fsm.assignTransition( st_Active, ev_Ping, st_Idle );
+	fsm.assignTransition( ev_Stop, st_Done );
+	fsm.assignTimeOut( st_Idle, 3, st_Done );   // just in case...
+	fsm.assignCallbackAutoval( cb );
+
+	std::vector<std::thread> v_threads;
+	for( int i=0; i<3; i++ )
+		v_threads.push_back( std::thread( producer, i ) );
+
+	std::thread controller(                                 // waits for the producers, then stops FSM
+		[&v_threads]()
+		{
+			for( auto& t: v_threads )
+				t.join();
+			fsm.postEvent( ev_Stop );
+		}
+	);
+
+	fsm.start();    // blocking, until fsm.stop() is called
+	controller.join();
+}
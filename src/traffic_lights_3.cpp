@@ -15,6 +15,7 @@ Homepage: https://github.com/skramm/spaghetti
 #include "traffic_lights_common.hpp"
 
 #define SPAG_USE_ASIO_WRAPPER
+#define SPAG_USE_WIRE_PROTOCOL
 #define SPAG_ENABLE_LOGGING
 #define SPAG_ENUM_STRINGS
 #include "spaghetti.hpp"
@@ -26,33 +27,37 @@ SPAG_DECLARE_FSM_TYPE_ASIO( fsm_t, States, Events, std::string );
 std::mutex* g_mutex;
 
 //-----------------------------------------------------------------------------------
-/// Concrete class, implements UdpServer and SpagFSM, and triggers event on the FSM
-struct MyServer : public UdpServer<1024>
+/// Concrete class, implements BatchUdpServer and SpagFSM, and triggers event on the FSM
+struct MyServer : public BatchUdpServer<1024>
 {
 	MyServer( boost::asio::io_service& io_service, int port_no )
-		: UdpServer( io_service, port_no )
+		: BatchUdpServer( io_service, port_no )
 	{}
 
-	std::vector<BYTE> getResponse( const Buffer_t& buffer, std::size_t nb_bytes ) const
+	size_t processDatagram( const BYTE* data, size_t nb_bytes, BYTE* )
 	{
-		std::cout << "received " << nb_bytes << " bytes\n";
-		switch( buffer.at(0) )
+		spag::WireDecoder<Events> frame( data, nb_bytes );          // see traffic_lights_client.cpp
+		if( !frame.valid() )
 		{
-			case 'a':
-				fsm.processEvent( ev_WarningOn );
-			break;
-			case 'b':
-				fsm.processEvent( ev_WarningOff );
-			break;
-			case 'c':
-				fsm.processEvent( ev_Reset );
-			break;
-			default:
-				std::cout << "Error: invalid message received !\n";
+			std::cout << "Error: invalid message received !\n";
+			return 0;
 		}
-		return std::vector<BYTE>(); // return empty vector
+		std::cout << "received " << frame.nbRecords() << " events\n";
+		if( frame.seq() != _seq )
+			std::cout << "Warning: expected sequence number " << _seq << ", got " << frame.seq() << '\n';
+		_seq = frame.seq() + frame.nbRecords();
+		try
+		{
+			frame.processOn( fsm );
+		}
+		catch( const std::exception& e )                            // invalid event index
+		{
+			std::cout << "Error: " << e.what() << '\n';
+		}
+		return 0; // no response
 	}
 	fsm_t fsm;
+	uint32_t _seq = 0;     ///< next expected sequence number
 };
 
 //-----------------------------------------------------------------------------------
@@ -1,7 +1,8 @@
 /**
-\file test_traffic_lights_client.cpp
-\brief client-side for test_traffic_lights_1.cpp .
-sends udp frames to the server, using port 12345
+\file traffic_lights_client.cpp
+\brief client-side for traffic_lights_3.cpp .
+sends udp frames to the server, using port 12345.
+Each line typed is sent as a single frame, using the binary wire protocol, with one event per character
 
 This file is part of Spaghetti, a C++ library for implementing Finite State Machines
 
@@ -12,6 +13,11 @@ Homepage: https://github.com/skramm/spaghetti
 #include <iostream>
 #include <boost/asio.hpp>
 
+#include "traffic_lights_common.hpp"
+
+#define SPAG_USE_WIRE_PROTOCOL
+#include "spaghetti.hpp"
+
 using boost::asio::ip::udp;
 
 //-----------------------------------------------------------------------------------
@@ -34,15 +40,28 @@ int main( int argc, char* argv[] )
 		udp::socket socket( io_service );
 		socket.open( udp::v4() );
 
-		std::cout << "Enter key: (a:warning on, b:warning off, c:reset): ";
+		std::array<uint8_t,512> buffer;
+		spag::WireEncoder<Events> frame( buffer.data(), buffer.size() );
+
+		std::cout << "Enter keys: (a:warning on, b:warning off, c:reset), several can be given at once: ";
 		do
 		{
 			std::string str;
 			std::cin >> str;
-			socket.send_to(                 // blocking data send
-				boost::asio::buffer( str ),
-				endpoint
-			);
+			frame.clear();                  // next sequence number
+			for( auto c: str )
+				switch( c )
+				{
+					case 'a': frame.add( ev_WarningOn );  break;
+					case 'b': frame.add( ev_WarningOff ); break;
+					case 'c': frame.add( ev_Reset );      break;
+					default: std::cout << "invalid key: " << c << '\n';
+				}
+			if( frame.nbRecords() )
+				socket.send_to(                 // blocking data send
+					boost::asio::buffer( frame.data(), frame.size() ),
+					endpoint
+				);
 		}
 		while(1);
 	}
@@ -17,7 +17,7 @@ extern std::mutex* g_mutex;
 
 //-----------------------------------------------------------------------------------
 /// initialization of mutex pointer (classical static initialization pattern)
-static std::mutex* getSingletonMutex()
+inline std::mutex* getSingletonMutex()
 {
     static std::mutex instance;
     return &instance;
@@ -14,6 +14,10 @@ Homepage: https://github.com/skramm/spaghetti
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
 
+#ifdef __linux__
+	#include <sys/socket.h>
+#endif
+
 typedef unsigned char BYTE;
 //-----------------------------------------------------------------------------------
 /// A udp server based on boost::asio, templated by size of buffer.
@@ -72,5 +76,197 @@ class UdpServer
 		}
 };
 //-----------------------------------------------------------------------------------
+/// A high-throughput udp server based on boost::asio, templated by size of buffers and by number of datagrams handled per wake-up.
+/// Does not hold the io_service, it must be provided separately
+/**
+Upon each wake-up of the socket, up to \c BATCH datagrams are read at once (with \c recvmmsg() on Linux,
+repeated non-blocking reads elsewhere) into a pool of buffers allocated once, in the object itself.
+For each of them, the function processDatagram() (to be provided by the inherited class) is called,
+that can write a response into another preallocated buffer.
+The responses are then sent all at once (with \c sendmmsg() on Linux), without blocking:
+if the socket send buffer is full, they are dropped (and counted, see nbDroppedResponses()).
+
+Nothing is allocated on the reception path: the completion handler is a small object (no \c boost::bind),
+so boost::asio recycles the memory of the asynchronous operation.
+
+The boost::io_service is assumed to be started externally
+*/
+template<size_t BUF_SIZE, size_t BATCH=32>
+class BatchUdpServer
+{
+	public:
+		BatchUdpServer( boost::asio::io_service& io_service, int port_no )
+			: _socket( io_service, boost::asio::ip::udp::endpoint( boost::asio::ip::udp::v4(), port_no ) )
+		{
+			_socket.non_blocking( true );
+#ifdef __linux__
+			for( size_t i=0; i<BATCH; i++ )
+			{
+				_rxIov[i].iov_base = _rxBuffers[i].data();
+				_rxIov[i].iov_len  = BUF_SIZE;
+			}
+#endif
+		}
+		virtual ~BatchUdpServer() = default;
+
+		void start_receive()
+		{
+#if BOOST_VERSION < 106600
+			_socket.async_receive( boost::asio::null_buffers(), WaitHandler{ this } );
+#else
+			_socket.async_wait( boost::asio::ip::udp::socket::wait_read, WaitHandler{ this } );
+#endif
+		}
+
+/// Local endpoint, useful if the server was created with port 0
+		boost::asio::ip::udp::endpoint local_endpoint() const
+		{
+			return _socket.local_endpoint();
+		}
+		size_t nbDatagrams() const        { return _nbDatagrams; }
+		size_t nbBatches() const          { return _nbBatches; }
+		size_t nbDroppedResponses() const { return _nbDropped; }
+
+	private:
+/// This virtual function NEEDS to be implemented in inherited class.
+/// Handles datagram \c data of size \c nb_bytes, can write a response in \c resp (of size BUF_SIZE), and returns its size (0 means no response)
+		virtual size_t processDatagram( const BYTE* data, size_t nb_bytes, BYTE* resp ) = 0;
+
+/// Completion handler, avoids allocating a boost::bind object at each call
+		struct WaitHandler
+		{
+			BatchUdpServer* _server;
+			void operator()( const boost::system::error_code& err ) const
+			{
+				_server->_rx_handler( err );
+			}
+			void operator()( const boost::system::error_code& err, size_t ) const
+			{
+				_server->_rx_handler( err );
+			}
+		};
+
+/// Reception callback function: reads and handles all the pending datagrams, BATCH at a time, then waits again
+		void _rx_handler( const boost::system::error_code& err )
+		{
+			if( err )                   // socket closed or io_service stopped
+				return;
+			size_t nb;
+			do
+			{
+				nb = receiveBatch();
+				if( nb )
+				{
+					_nbBatches++;
+					_nbDatagrams += nb;
+					size_t nbResp = 0;
+					for( size_t i=0; i<nb; i++ )
+					{
+						auto size = processDatagram( _rxBuffers[i].data(), _rxSize[i], _txBuffers[nbResp].data() );
+						if( size )
+						{
+							setResponse( nbResp, i, size );
+							nbResp++;
+						}
+					}
+					sendBatch( nbResp );
+				}
+			}
+			while( nb == BATCH );
+			start_receive();
+		}
+
+#ifdef __linux__
+		size_t receiveBatch()
+		{
+			for( size_t i=0; i<BATCH; i++ )  // these get modified by recvmmsg()
+			{
+				auto& hdr = _rxMsgs[i].msg_hdr;
+				hdr = msghdr();
+				hdr.msg_name    = &_rxAddr[i];
+				hdr.msg_namelen = sizeof( _rxAddr[i] );
+				hdr.msg_iov     = &_rxIov[i];
+				hdr.msg_iovlen  = 1;
+			}
+			int nb = ::recvmmsg( _socket.native_handle(), _rxMsgs.data(), BATCH, MSG_DONTWAIT, nullptr );
+			if( nb <= 0 )
+				return 0;
+			for( int i=0; i<nb; i++ )
+				_rxSize[i] = _rxMsgs[i].msg_len;
+			return nb;
+		}
+		void setResponse( size_t idx, size_t rx_idx, size_t size )
+		{
+			_txIov[idx].iov_base = _txBuffers[idx].data();
+			_txIov[idx].iov_len  = size;
+			auto& hdr = _txMsgs[idx].msg_hdr;
+			hdr = msghdr();
+			hdr.msg_name    = &_rxAddr[rx_idx];
+			hdr.msg_namelen = _rxMsgs[rx_idx].msg_hdr.msg_namelen;
+			hdr.msg_iov     = &_txIov[idx];
+			hdr.msg_iovlen  = 1;
+		}
+		void sendBatch( size_t nb )
+		{
+			size_t sent = 0;
+			while( sent < nb )
+			{
+				int n = ::sendmmsg( _socket.native_handle(), _txMsgs.data() + sent, nb - sent, MSG_DONTWAIT );
+				if( n <= 0 )
+					break;
+				sent += n;
+			}
+			_nbDropped += nb - sent;
+		}
+#else
+		size_t receiveBatch()
+		{
+			size_t nb = 0;
+			boost::system::error_code err;
+			for( ; nb<BATCH; nb++ )
+			{
+				_rxSize[nb] = _socket.receive_from( boost::asio::buffer( _rxBuffers[nb] ), _rxEndpoints[nb], 0, err );
+				if( err )
+					break;
+			}
+			return nb;
+		}
+		void setResponse( size_t idx, size_t rx_idx, size_t size )
+		{
+			_txEndpoints[idx] = _rxEndpoints[rx_idx];
+			_txSize[idx] = size;
+		}
+		void sendBatch( size_t nb )
+		{
+			boost::system::error_code err;
+			for( size_t i=0; i<nb; i++ )
+			{
+				_socket.send_to( boost::asio::buffer( _txBuffers[i].data(), _txSize[i] ), _txEndpoints[i], 0, err );
+				if( err )
+					_nbDropped++;
+			}
+		}
+#endif
+
+		boost::asio::ip::udp::socket _socket;
+		std::array<std::array<BYTE,BUF_SIZE>,BATCH> _rxBuffers;
+		std::array<std::array<BYTE,BUF_SIZE>,BATCH> _txBuffers;
+		std::array<size_t,BATCH>                    _rxSize;
+#ifdef __linux__
+		std::array<mmsghdr,BATCH>          _rxMsgs;
+		std::array<iovec,BATCH>            _rxIov;
+		std::array<sockaddr_storage,BATCH> _rxAddr;
+		std::array<mmsghdr,BATCH>          _txMsgs;
+		std::array<iovec,BATCH>            _txIov;
+#else
+		std::array<boost::asio::ip::udp::endpoint,BATCH> _rxEndpoints;
+		std::array<boost::asio::ip::udp::endpoint,BATCH> _txEndpoints;
+		std::array<size_t,BATCH>                         _txSize;
+#endif
+		size_t _nbDatagrams = 0;
+		size_t _nbBatches   = 0;
+		size_t _nbDropped   = 0;
+};
+//-----------------------------------------------------------------------------------
 
 #endif // HG_UDP_SERVER_HPP
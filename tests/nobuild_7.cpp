@@ -0,0 +1,20 @@
+/**
+This cannot build: with a StaticFSM, the configuration is checked at build time,
+and here state st2 is unreachable.
+*/
+
+#include "../spaghetti.hpp"
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev1, ev2, NB_EVENTS };
+
+SPAG_DECLARE_STATIC_FSM_TYPE( fsm_t, States, Events, spag::StaticNoCallback<States,Events>,
+	SPAG_STATIC_TRANSITION( st0, ev1, st1 ),
+	SPAG_STATIC_TRANSITION( st1, ev2, st0 ),
+	SPAG_STATIC_TRANSITION( st2, ev2, st0 )
+);
+
+int main()
+{
+	fsm_t fsm;
+}
@@ -0,0 +1,35 @@
+/**
+This cannot build: processEvents() reads the range twice (check, then process),
+so it needs a forward iterator, and this one is a single-pass (input) iterator.
+*/
+
+#include "../spaghetti.hpp"
+
+enum States { st0, st1, NB_STATES };
+enum Events { ev1, ev2, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, bool );
+
+struct InputIterator
+{
+	using iterator_category = std::input_iterator_tag;
+	using value_type        = Events;
+	using difference_type   = std::ptrdiff_t;
+	using pointer           = const Events*;
+	using reference         = Events;
+
+	const Events* _p;
+	Events operator*() const { return *_p; }
+	InputIterator& operator++() { ++_p; return *this; }
+	bool operator!=( const InputIterator& it ) const { return _p != it._p; }
+};
+
+int main()
+{
+	fsm_t fsm;
+	fsm.assignTransition( st0, ev1, st1 );
+	fsm.assignTransition( st1, ev2, st0 );
+	fsm.start();
+	Events events[] = { ev1, ev2 };
+	fsm.processEvents( InputIterator{ events }, InputIterator{ events+2 } );
+}
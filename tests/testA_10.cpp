@@ -0,0 +1,96 @@
+/**
+\file testA_10.cpp
+\brief test of the raw callbacks (function pointer + context), member callbacks without std::bind, and callback handler
+*/
+
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+void config( fsm_t& fsm )
+{
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTransition( st2, ev0, st0 );
+	fsm.assignCallbackValue( st0, 10 );
+	fsm.assignCallbackValue( st1, 11 );
+	fsm.assignCallbackValue( st2, 12 );
+}
+
+void run( fsm_t& fsm, int n )
+{
+	fsm.start();
+	for( int i=0; i<n; i++ )
+		fsm.processEvent( ev0 );
+	fsm.stop();
+}
+
+struct Counter
+{
+	int _sum = 0;
+};
+
+void rawCallback( void* ctx, int arg )
+{
+	static_cast<Counter*>(ctx)->_sum += arg;
+}
+
+struct MyClass
+{
+	MyClass()
+	{
+		config( _fsm );
+		SPAG_ASSIGN_MEMBER_CALLBACK_DIRECT_ALL( _fsm, MyClass, callback );
+		SPAG_ASSIGN_MEMBER_CALLBACK_DIRECT( _fsm, st2, MyClass, callback2 );
+	}
+	void callback( int arg )
+	{
+		_sum += arg;
+	}
+	void callback2( int arg )
+	{
+		_sum += 100*arg;
+	}
+	fsm_t _fsm;
+	int _sum = 0;
+};
+
+struct Handler
+{
+	void onEnter( States st, int arg )
+	{
+		_nb[st]++;
+		_sum += arg;
+	}
+	int _nb[NB_STATES] = { 0, 0, 0 };
+	int _sum = 0;
+};
+
+int main()
+{
+	{
+		fsm_t fsm;
+		config( fsm );
+		Counter c1, c2;
+		fsm.assignCallback( rawCallback, &c1 );
+		fsm.assignCallback( st1, rawCallback, &c2, 1000 );
+		run( fsm, 5 );            // states: 0 1 2 0 1 2
+		std::cout << "raw: sum1=" << c1._sum << " sum2=" << c2._sum << '\n';
+	}
+	{
+		MyClass mc;
+		run( mc._fsm, 5 );
+		std::cout << "member: sum=" << mc._sum << '\n';
+	}
+	{
+		fsm_t fsm;
+		config( fsm );
+		Handler h;
+		fsm.assignCallbackHandler( h );
+		run( fsm, 7 );            // states: 0 1 2 0 1 2 0 1
+		std::cout << "handler: nb=" << h._nb[0] << '-' << h._nb[1] << '-' << h._nb[2] << " sum=" << h._sum << '\n';
+	}
+}
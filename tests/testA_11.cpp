@@ -0,0 +1,72 @@
+/**
+\file testA_11.cpp
+\brief test of the timer wheel event handler (SPAG_USE_TIMER_WHEEL): a lot of FSM share the same wheel
+*/
+
+#define SPAG_USE_TIMER_WHEEL
+#include "spaghetti.hpp"
+
+#include <deque>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+
+const size_t g_nbFsm = 1000;
+size_t g_nbCallbacks = 0;
+
+void cb( int )
+{
+	g_nbCallbacks++;
+}
+
+void print( const std::vector<fsm_t>& v_fsm, const spag::TimerWheel& wheel )
+{
+	size_t nb[NB_STATES] = { 0, 0, 0 };
+	for( const auto& fsm: v_fsm )
+		nb[ fsm.currentState() ]++;
+	std::cout << "tick " << wheel.now() << ": " << nb[0] << '-' << nb[1] << '-' << nb[2]
+		<< " pending timers=" << wheel.size() << " nb callbacks=" << g_nbCallbacks << '\n';
+}
+
+int main()
+{
+	spag::TimerWheel wheel;  // 1 tick = 1 ms
+	std::deque<spag::WheelTimer<States,Events,int>> v_timers;
+	std::vector<fsm_t> v_fsm( g_nbFsm );
+	for( auto& fsm: v_fsm )
+	{
+		v_timers.emplace_back( wheel );
+		fsm.assignTimeOut( st0, 5, spag::DurUnit::ms, st1 );
+		fsm.assignTimeOut( st1, 300, spag::DurUnit::ms, st2 );
+		fsm.assignTimeOut( st2, 70, spag::DurUnit::sec, st0 );   // needs cascading from level 2
+		fsm.assignTransition( st1, ev0, st0 );
+		fsm.assignCallback( cb );
+		fsm.assignEventHandler( &v_timers.back() );
+		fsm.start();
+	}
+	print( v_fsm, wheel );
+	wheel.advance( 50 );
+	print( v_fsm, wheel );
+	wheel.advance( 50 );
+	for( size_t i=0; i<g_nbFsm; i+=2 )
+		v_fsm[i].processEvent( ev0 );        // cancels the timer of state st1
+	print( v_fsm, wheel );
+	wheel.advance( 250 );
+	print( v_fsm, wheel );
+	wheel.advance( 70000 );
+	print( v_fsm, wheel );
+	wheel.advance( 10000 );
+	print( v_fsm, wheel );
+	for( auto& fsm: v_fsm )
+		fsm.stop();
+	print( v_fsm, wheel );
+
+	spag::TimerWheel::Node node;             // re-scheduling a running timer replaces it
+	for( uint64_t i=1; i<=5; i++ )
+		wheel.schedule( node, 10*i );
+	std::cout << "re-armed: pending timers=" << wheel.size();
+	wheel.cancel( node );
+	std::cout << ", after cancel=" << wheel.size() << '\n';
+}
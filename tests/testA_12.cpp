@@ -0,0 +1,44 @@
+/**
+\file testA_12.cpp
+\brief test of inner events and pass states (AAT) with a FSM without timer: these are processed right after the callback
+*/
+
+#define SPAG_USE_SIGNALS
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, st3, st4, NB_STATES };
+enum Events { ev0, ev_inner, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+fsm_t fsm;
+int g_count = 0;
+
+void cb( int s )
+{
+	std::cout << "callback: state=" << s << " count=" << g_count++ << '\n';
+	if( s == st1 && g_count == 6 )
+	{
+		std::cout << "activating inner event\n";
+		fsm.activateInnerEvent( ev_inner );
+	}
+}
+
+int main()
+{
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignAAT( st1, st2 );                  // chain of pass-states: st1 => st2 => st3
+	fsm.assignAAT( st2, st3 );
+	fsm.assignTransition( st3, ev0, st0 );
+	fsm.assignInnerTransition( st0, ev_inner, st4 );
+	fsm.assignTransition( st4, ev0, st0 );
+
+	fsm.start();
+	for( int i=0; i<5; i++ )
+	{
+		fsm.processEvent( ev0 );
+		std::cout << "after event " << i << ": current state=" << fsm.currentState() << '\n';
+	}
+	fsm.stop();
+}
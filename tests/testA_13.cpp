@@ -0,0 +1,90 @@
+/**
+\file testA_13.cpp
+\brief test of FsmEngine: many FSM instances run over a fixed pool of threads, events being posted from several threads
+*/
+
+#define SPAG_USE_FSM_ENGINE
+#include "spaghetti.hpp"
+
+#include <set>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+
+/// data of an instance, only accessed by the thread of its shard
+struct Instance
+{
+	fsm_t           fsm;
+	int             nbCallbacks = 0;
+	std::thread::id threadId;
+	bool            sameThread = true;
+};
+
+void callback( void* ctx, int )
+{
+	auto& inst = *static_cast<Instance*>(ctx);
+	if( inst.nbCallbacks++ == 0 )
+		inst.threadId = std::this_thread::get_id();
+	else
+		if( inst.threadId != std::this_thread::get_id() )
+			inst.sameThread = false;
+}
+
+int main()
+{
+	const size_t nbInstances = 100;
+	const size_t nbProducers = 4;
+	const size_t nbEvents    = 1000;  // per instance
+
+	std::vector<Instance> vinst( nbInstances );
+	spag::FsmEngine<States,Events,int> engine( 4 );
+
+	for( auto& inst: vinst )
+	{
+		inst.fsm.assignTransition( st0, ev0, st1 );
+		inst.fsm.assignTransition( st1, ev0, st2 );
+		inst.fsm.assignTransition( st2, ev0, st0 );
+		inst.fsm.assignTransition( ev1, st0 );
+		inst.fsm.assignCallback( &callback, &inst );
+		engine.addInstance( inst.fsm );
+	}
+	std::cout << "nb shards=" << engine.nbShards() << " nb instances=" << engine.nbInstances()
+		<< " shard of instance 42=" << engine.shardOf( 42 ) << '\n';
+
+	engine.run();
+
+	std::vector<std::thread> producers;   // each producer posts the events of a subset of the instances
+	for( size_t p=0; p<nbProducers; p++ )
+		producers.emplace_back(
+			[&engine,p,nbProducers,nbInstances,nbEvents]()
+			{
+				for( size_t i=0; i<nbEvents; i++ )
+					for( size_t id=p; id<nbInstances; id += nbProducers )
+						while( !engine.postEvent( id, id%2 ? ev0 : ev1 ) ) // retry if queue is full (ev1 is ignored on st0)
+							std::this_thread::yield();
+			}
+		);
+	for( auto& t: producers )
+		t.join();
+	std::cout << "invalid instance accepted=" << engine.postEvent( nbInstances, ev0 )
+		<< " invalid event accepted=" << engine.postEvent( 0, static_cast<Events>( NB_EVENTS ) ) << '\n';
+	engine.stop();
+
+	size_t total = 0;
+	bool sameThread = true;
+	std::set<std::thread::id> threads;
+	for( size_t id=0; id<nbInstances; id++ )
+	{
+		total += vinst[id].nbCallbacks;
+		sameThread = sameThread && vinst[id].sameThread;
+		threads.insert( vinst[id].threadId );
+		if( id < 4 )
+			std::cout << "instance " << id << ": nb callbacks=" << vinst[id].nbCallbacks
+				<< " final state=" << vinst[id].fsm.currentState() << " running=" << vinst[id].fsm.isRunning() << '\n';
+	}
+	std::cout << "total callbacks=" << total << '\n';
+	std::cout << "each instance processed on a single thread: " << (sameThread ? "yes" : "no") << '\n';
+	std::cout << "nb of threads used=" << threads.size() << '\n';
+}
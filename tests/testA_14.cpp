@@ -0,0 +1,63 @@
+/**
+\file testA_14.cpp
+\brief test of the latency histograms (symbol SPAG_ENABLE_HISTOGRAMS)
+*/
+
+#define SPAG_ENABLE_HISTOGRAMS
+#define SPAG_USE_TIMER_WHEEL
+#include "spaghetti.hpp"
+
+#include <thread>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+
+void cb( int s )
+{
+	if( s == st1 )
+		std::this_thread::sleep_for( std::chrono::milliseconds(2) );
+}
+
+int main()
+{
+	spag::Histogram h;                      // values stored exactly below 16, then with 16 buckets per power of 2
+	for( uint64_t v=1; v<=1000; v++ )
+		h.record( v );
+	std::cout << "count=" << h.count() << " min=" << h.min() << " max=" << h.max() << " mean=" << h.mean()
+		<< " p50=" << h.percentile(.5) << " p90=" << h.percentile(.9) << " p100=" << h.percentile(1.) << '\n';
+	for( uint64_t v: { 0, 15, 16, 17, 31, 32, 1000, 1023, 1024 } )
+		std::cout << "value " << v << ": bucket " << spag::Histogram::bucketIndex( v )
+			<< ", upper value=" << spag::Histogram::bucketUpperValue( spag::Histogram::bucketIndex( v ) ) << '\n';
+	std::cout << "huge value: bucket " << spag::Histogram::bucketIndex( uint64_t(-1) ) << '/' << spag::Histogram::NbBuckets << '\n';
+
+	fsm_t fsm;
+	spag::TimerWheel wheel;
+	spag::WheelTimer<States,Events,int> timer( wheel );
+	fsm.assignEventHandler( &timer );
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTimeOut( st2, 5, "ms", st0 );
+
+	fsm.start();
+	for( int i=0; i<10; i++ )
+	{
+		fsm.processEvent( ev0 );
+		fsm.processEvent( ev0 );
+		wheel.advance( 5 );         // triggers timeout on st2
+	}
+	fsm.stop();
+
+	auto hist = fsm.getHistograms();
+	for( int i=0; i<NB_STATES; i++ )
+		std::cout << "state " << i << ": nb callbacks=" << hist._callback[i].count()
+			<< " nb dwell=" << hist._dwell[i].count() << '\n';
+	std::cout << "nb timeouts=" << hist._timeOutLateness.count() << '\n';
+	std::cout << "callback on st1 takes at least 2ms: " << ( hist._callback[st1].percentile(.5) >= 2000000 ? "yes" : "no" ) << '\n';
+	std::cout << "dwell time on st1 is at least 2ms: " << ( hist._dwell[st1].min() >= 2000000 ? "yes" : "no" ) << '\n';
+
+	fsm.clearHistograms();
+	std::cout << "after clear: " << fsm.getHistograms()._callback[st1].count() << '\n';
+}
@@ -0,0 +1,75 @@
+/**
+\file testA_15.cpp
+\brief test of readCounters(): allocation-free counter reading, from a monitoring thread while FSM is running
+*/
+
+#define SPAG_ENABLE_LOGGING
+#include "spaghetti.hpp"
+
+#include <thread>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+int main()
+{
+	fsm_t fsm;
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTransition( st2, ev0, st0 );
+	fsm.assignTransition( st2, ev1, st0 );
+
+	std::atomic<bool> done{false};
+	bool monotonic = true;
+	std::atomic<size_t> nbReads{0};
+	std::thread monitor(                   // checks that the counters never decrease
+		[&]()
+		{
+			std::array<size_t,NB_STATES> prev{ { 0, 0, 0 } };
+			std::array<size_t,NB_STATES> cnt;
+			do                             // at least one read, whatever the scheduling
+			{
+				fsm.readCounters( spag::ItemStates, cnt );
+				for( size_t i=0; i<NB_STATES; i++ )
+				{
+					if( cnt[i] < prev[i] )
+						monotonic = false;
+					prev[i] = cnt[i];
+				}
+				nbReads++;
+			}
+			while( !done );
+		}
+	);
+
+	while( nbReads == 0 )                  // so the reads overlap the processing, without depending on the timing
+		std::this_thread::yield();
+	fsm.start();
+	for( int i=0; i<30000; i++ )
+	{
+		fsm.processEvent( ev0 );
+		fsm.processEvent( ev1 );
+	}
+	fsm.stop();
+	done = true;
+	monitor.join();
+	std::cout << "counters never decreased: " << ( monotonic ? "yes" : "no" ) << ", at least one read: " << ( nbReads > 0 ? "yes" : "no" ) << '\n';
+
+	std::array<size_t,NB_STATES> states;
+	size_t events[NB_EVENTS+2];
+	size_t ignored[NB_EVENTS];
+	std::cout << "nb state counters=" << fsm.readCounters( spag::ItemStates, states ) << '\n';
+	std::cout << "nb event counters=" << fsm.readCounters( spag::ItemEvents, events, NB_EVENTS+2 ) << '\n';
+	std::cout << "nb ignored event counters=" << fsm.readCounters( spag::ItemIgnoredEvents, ignored, NB_EVENTS ) << '\n';
+	for( size_t i=0; i<NB_STATES; i++ )
+		std::cout << "state " << i << ": " << states[i] << '\n';
+	for( size_t i=0; i<NB_EVENTS; i++ )
+		std::cout << "event " << i << ": " << events[i] << " ignored: " << ignored[i] << '\n';
+
+	size_t small[1];                           // destination smaller than the number of counters
+	auto n = fsm.readCounters( spag::ItemStates, small, 1 );
+	std::cout << "nb=" << n << " first=" << small[0] << '\n';
+	fsm.getCounters().print( std::cout, spag::ItemStates );
+}
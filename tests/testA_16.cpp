@@ -0,0 +1,150 @@
+/**
+\file testA_16.cpp
+\brief test of trace recording (events, timeouts, inner events) and replay (symbol SPAG_ENABLE_TRACE),
+including events processed from a callback (not recorded)
+*/
+
+#define SPAG_ENABLE_TRACE
+#define SPAG_USE_TIMER_WHEEL
+#define SPAG_USE_SIGNALS
+#include "spaghetti.hpp"
+
+#include <sstream>
+
+enum States { st0, st1, st2, st3, NB_STATES };
+enum Events { ev0, ev1, ev_inner, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t,        States, Events, spag::WheelTimer,  int );
+SPAG_DECLARE_FSM_TYPE( fsm_replay_t, States, Events, spag::ReplayTimer, int );
+
+std::ostringstream g_out;   ///< holds the sequence of visited states
+
+void cb( int s )
+{
+	g_out << s;
+}
+
+template<typename FSM>
+void config( FSM& fsm )
+{
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTransition( st1, ev1, st0 );
+	fsm.assignTimeOut( st2, 10, "ms", st0 );
+	fsm.assignInnerTransition( st0, ev_inner, st3 );
+	fsm.assignTransition( st3, ev1, st0 );
+}
+
+/// Callback processing an event itself on st1: that event must not be recorded, the replayed callback will do it again
+template<typename FSM>
+struct Nested
+{
+	static FSM* fsm;
+	static void cb( int s )
+	{
+		g_out << s;
+		if( s == st1 )
+			fsm->processEvent( ev0 );
+	}
+};
+template<typename FSM>
+FSM* Nested<FSM>::fsm = nullptr;
+
+template<typename FSM>
+void configNested( FSM& fsm )
+{
+	Nested<FSM>::fsm = &fsm;
+	fsm.assignCallbackAutoval( Nested<FSM>::cb );
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTransition( st2, ev0, st0 );
+	fsm.assignTransition( ev1, st3 );
+	fsm.assignTransition( st3, ev1, st0 );
+}
+
+int main()
+{
+	std::string seq_rec;
+	{
+		fsm_t fsm;
+		spag::TimerWheel wheel;
+		spag::WheelTimer<States,Events,int> timer( wheel );
+		fsm.assignEventHandler( &timer );
+		config( fsm );
+
+		fsm.startTrace( "testA_16.bin" );
+		fsm.start();
+		for( int i=0; i<20; i++ )
+		{
+			fsm.processEvent( ev0 );
+			fsm.processEvent( i%3 ? ev0 : ev1 );
+			wheel.advance( 10 );                 // timeout on st2
+			if( i%5 == 4 )
+				fsm.activateInnerEvent( ev_inner );
+			fsm.processEvent( ev1 );
+		}
+		std::vector<Events> v_ev{ ev0, ev0, ev1, ev0 };
+		fsm.processEvents( v_ev );
+		fsm.stop();
+		std::cout << "nb records=" << fsm.stopTrace() << '\n';
+		seq_rec = g_out.str();
+	}
+
+	for( auto mode: { spag::ReplayMode::FullSpeed, spag::ReplayMode::RealTime } )
+	{
+		g_out.str( "" );
+		fsm_replay_t fsm;
+		spag::ReplayTimer<States,Events,int> timer;
+		fsm.assignEventHandler( &timer );
+		config( fsm );
+		fsm.start();
+
+		std::ifstream f( "testA_16.bin", std::ios::binary );
+		spag::TraceReplayer<fsm_replay_t> replayer( fsm, f );
+		auto nb = replayer.run( mode, 10 );             // in two steps
+		nb += replayer.run( mode );
+		std::cout << "mode " << (int)mode << ": nb replayed=" << nb << ", identical: " << ( g_out.str() == seq_rec ? "yes" : "no" )
+			<< ", virtual time is non-zero: " << ( replayer.now() > 0 ? "yes" : "no" ) << '\n';
+	}
+	std::cout << "sequence=" << seq_rec << '\n';
+
+	{                                                    // events processed by a callback
+		g_out.str( "" );
+		fsm_t fsm;
+		spag::TimerWheel wheel;
+		spag::WheelTimer<States,Events,int> timer( wheel );
+		fsm.assignEventHandler( &timer );
+		configNested( fsm );
+		fsm.startTrace( "testA_16.bin" );
+		fsm.start();
+		for( int i=0; i<6; i++ )
+			fsm.processEvent( i%3 ? ev0 : ev1 );
+		fsm.stop();
+		std::cout << "nested: nb records=" << fsm.stopTrace();
+		seq_rec = g_out.str();
+
+		g_out.str( "" );
+		fsm_replay_t fsm2;
+		spag::ReplayTimer<States,Events,int> timer2;
+		fsm2.assignEventHandler( &timer2 );
+		configNested( fsm2 );
+		fsm2.start();
+		std::ifstream f( "testA_16.bin", std::ios::binary );
+		spag::TraceReplayer<fsm_replay_t> replayer( fsm2, f );
+		auto nb = replayer.run();
+		std::cout << ", nb replayed=" << nb << ", identical: " << ( g_out.str() == seq_rec ? "yes" : "no" ) << ", sequence=" << seq_rec << '\n';
+	}
+
+	try                                                  // a FSM with a different number of states is rejected
+	{
+		enum St2 { s0, s1, NB_STATES };
+		spag::SpagFSM<St2,Events,spag::ReplayTimer<St2,Events,int>,int> fsm2;
+		std::ifstream f( "testA_16.bin", std::ios::binary );
+		spag::TraceReplayer<decltype(fsm2)> replayer( fsm2, f );
+	}
+	catch( const std::exception& e )
+	{
+		std::cout << "error: " << e.what() << '\n';
+	}
+}
@@ -0,0 +1,77 @@
+/**
+\file testA_17.cpp
+\brief test of VirtualClock: a thousand FSM simulated over a whole day (symbol SPAG_USE_VIRTUAL_CLOCK)
+*/
+
+#define SPAG_USE_VIRTUAL_CLOCK
+#include "spaghetti.hpp"
+
+#include <memory>
+
+enum States { st_red, st_orange, st_green, st_blinking, NB_STATES };
+enum Events { ev_warning, ev_reset, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::VirtualTimer, int );
+
+using vtimer_t = spag::VirtualTimer<States,Events,int>;
+
+std::array<size_t,NB_STATES> g_count;
+
+void cb( int s )
+{
+	g_count[s]++;
+}
+
+int main()
+{
+	const size_t nbFsm = 1000;
+	spag::VirtualClock clock;
+
+	std::vector<fsm_t> vfsm( nbFsm );
+	std::vector<std::unique_ptr<vtimer_t>> vtimer;
+	for( auto& fsm: vfsm )
+	{
+		vtimer.emplace_back( new vtimer_t( clock ) );
+		fsm.assignEventHandler( vtimer.back().get() );
+		fsm.assignCallbackAutoval( cb );
+		fsm.assignTimeOut( st_red,    30, "sec", st_green );
+		fsm.assignTimeOut( st_green,  25, "sec", st_orange );
+		fsm.assignTimeOut( st_orange,  5, "sec", st_red );
+		fsm.assignTransition( ev_warning, st_blinking );
+		fsm.assignTransition( st_blinking, ev_reset, st_red );
+	}
+
+	for( size_t i=0; i<nbFsm; i++ )          // start with some offset, so timeouts are spread over time
+	{
+		clock.runFor( i%60, spag::DurUnit::ms );
+		vfsm[i].start();
+	}
+	std::cout << "nb pending timers=" << clock.size() << '\n';
+
+	auto nb = clock.runFor( 12*60, spag::DurUnit::min );
+	std::cout << "after 12 hours: nb timeouts=" << nb << " time=" << clock.now() << '\n';
+
+	for( size_t i=0; i<nbFsm; i+=10 )        // 1 in 10 switches to blinking, timer gets canceled
+		vfsm[i].processEvent( ev_warning );
+	std::cout << "nb pending timers=" << clock.size() << '\n';
+
+	nb = clock.runFor( 6*60, spag::DurUnit::min );
+	std::cout << "after 18 hours: nb timeouts=" << nb << '\n';
+
+	for( size_t i=0; i<nbFsm; i+=10 )
+		vfsm[i].processEvent( ev_reset );
+	nb = clock.runUntil( clock.now() + 6ULL*3600*1000000000 );
+	std::cout << "after 24 hours: nb timeouts=" << nb << " time=" << clock.now() << '\n';
+
+	for( size_t s=0; s<NB_STATES; s++ )
+		std::cout << "state " << s << ": " << g_count[s] << '\n';
+
+	for( auto& fsm: vfsm )
+		fsm.stop();
+	std::cout << "nb pending timers=" << clock.size() << ", step: " << clock.step() << '\n';
+
+	vfsm.resize( 1 );                       // timers can be removed and added again
+	vtimer.resize( 1 );
+	vtimer_t t2( clock );
+	std::cout << "final time=" << clock.now() << '\n';
+}
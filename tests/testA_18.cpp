@@ -0,0 +1,75 @@
+/**
+\file testA_18.cpp
+\brief test of sub-millisecond timeouts (units "us" and "ns") and of the HiResTimer event handler (symbol SPAG_USE_HIRES_TIMER)
+*/
+
+#define SPAG_USE_HIRES_TIMER
+#define SPAG_USE_EVENT_QUEUE
+#define SPAG_USE_TIMER_WHEEL
+#define SPAG_ENABLE_HISTOGRAMS
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st_wait, st_end, NB_STATES };
+enum Events { ev_wait, ev_go, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::HiResTimer, int );
+
+fsm_t g_fsm;
+size_t g_nbCallbacks = 0;   ///< on st0 and st1
+const size_t g_nbMax = 1000;
+
+void cb( int s )
+{
+	switch( s )
+	{
+		case st0:
+		case st1:
+			if( ++g_nbCallbacks == g_nbMax )
+				g_fsm.processEvent( ev_wait );
+		break;
+		case st_end:
+			g_fsm.stop();
+		break;
+		default: break;
+	}
+}
+
+int main()
+{
+	for( auto str: { "ns", "nsec", "us", "usec", "ms" } )
+		std::cout << str << " => " << spag::priv::stringFromTimeUnit( spag::priv::timeUnitFromString( str ).second ) << '\n';
+
+	spag::TimerWheel wheel;                       // sub-ms durations are rounded up to a tick
+	std::cout << "ticks: " << wheel.toTicks( 500, spag::DurUnit::ns ) << ' ' << wheel.toTicks( 1500, spag::DurUnit::us )
+		<< ' ' << wheel.toTicks( 2, spag::DurUnit::ms ) << '\n';
+
+	spag::HiResTimer<States,Events,int> timer;
+	g_fsm.assignEventHandler( &timer );
+	g_fsm.assignCallbackAutoval( cb );
+	g_fsm.assignTimeOut( st0, 200, "us", st1 );
+	g_fsm.assignTimeOut( st1, 300000, spag::DurUnit::ns, st0 );
+	g_fsm.assignTransition( st0, ev_wait, st_wait );
+	g_fsm.assignTransition( st1, ev_wait, st_wait );
+	g_fsm.assignTransition( st_wait, ev_go, st_end );
+	g_fsm.assignTransition( st_end, ev_go, st0 );
+	g_fsm.printConfig( std::cout );
+
+	std::thread poster(                           // posts an event when the FSM is waiting
+		[]()
+		{
+			while( g_fsm.currentState() != st_wait )
+				std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+			g_fsm.postEvent( ev_go );
+		}
+	);
+	auto t0 = std::chrono::steady_clock::now();
+	g_fsm.start();                               // blocking, until stopped from the callback of st_end
+	auto elapsed = std::chrono::steady_clock::now() - t0;
+	poster.join();
+
+	std::cout << "nb callbacks=" << g_nbCallbacks << " final state=" << g_fsm.currentState() << '\n';
+	std::cout << "elapsed at least 250 ms: " << ( elapsed >= std::chrono::microseconds( 250 * g_nbMax ) ? "yes" : "no" ) << '\n';
+	auto hist = g_fsm.getHistograms();
+	std::cout << "nb measured timeouts=" << hist._timeOutLateness.count()
+		<< ", median lateness below 1 ms: " << ( hist._timeOutLateness.percentile(.5) < 1000000 ? "yes" : "no" ) << '\n';
+}
@@ -0,0 +1,72 @@
+/**
+\file testA_19.cpp
+\brief test of BatchUdpServer (src/udp_server.hpp): batched reception of events over UDP loopback, with responses
+*/
+
+#include "src/udp_server.hpp"
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+/// Each datagram holds one event per byte, the response is the current state after processing them
+struct Server : public BatchUdpServer<64,16>
+{
+	Server( boost::asio::io_service& io_service ) : BatchUdpServer( io_service, 0 )
+	{}
+	size_t processDatagram( const BYTE* data, size_t nb_bytes, BYTE* resp )
+	{
+		for( size_t i=0; i<nb_bytes; i++ )
+			if( data[i] < NB_EVENTS )
+				fsm.processEvent( static_cast<Events>( data[i] ) );
+		if( nb_bytes == 1 )             // no response to single events
+			return 0;
+		resp[0] = static_cast<BYTE>( fsm.currentState() );
+		return 1;
+	}
+	fsm_t fsm;
+};
+
+int main()
+{
+	using boost::asio::ip::udp;
+	boost::asio::io_service io;
+	Server server( io );
+	server.fsm.assignTransition( st0, ev0, st1 );
+	server.fsm.assignTransition( st1, ev0, st2 );
+	server.fsm.assignTransition( st2, ev0, st0 );
+	server.fsm.assignTransition( ev1, st0 );
+	server.fsm.start();
+	server.start_receive();
+
+	udp::socket client( io, udp::endpoint( udp::v4(), 0 ) );
+	udp::endpoint dest( boost::asio::ip::address_v4::loopback(), server.local_endpoint().port() );
+
+	const size_t nbBursts = 20;
+	const size_t burst    = 50;            // more than a batch
+	size_t nbResp = 0;
+	std::array<BYTE,64> rx;
+	for( size_t b=0; b<nbBursts; b++ )
+	{
+		for( size_t i=0; i<burst-1; i++ )
+		{
+			BYTE ev = ev0;
+			client.send_to( boost::asio::buffer( &ev, 1 ), dest );
+		}
+		std::array<BYTE,3> last{ { ev0, ev0, ev1 } };     // this one gets a response: back to st0
+		client.send_to( boost::asio::buffer( last ), dest );
+
+		while( server.nbDatagrams() < (b+1)*burst )
+			io.run_one();
+		udp::endpoint from;
+		client.receive_from( boost::asio::buffer( rx ), from );
+		if( rx[0] == st0 )
+			nbResp++;
+	}
+	std::cout << "nb datagrams=" << server.nbDatagrams() << " nb correct responses=" << nbResp
+		<< " nb dropped=" << server.nbDroppedResponses() << '\n';
+	std::cout << "several datagrams per batch: " << ( server.nbBatches() < server.nbDatagrams() ? "yes" : "no" ) << '\n';
+	std::cout << "final state=" << server.fsm.currentState() << '\n';
+}
@@ -0,0 +1,136 @@
+/**
+\file testA_20.cpp
+\brief test of the binary wire protocol: WireEncoder and WireDecoder (symbol SPAG_USE_WIRE_PROTOCOL)
+*/
+
+#define SPAG_USE_WIRE_PROTOCOL
+#include "spaghetti.hpp"
+
+#include <cstring>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+/// mimics FsmEngine::postEvent()
+struct FakeEngine
+{
+	std::vector<std::pair<size_t,Events>> posted;
+	bool postEvent( size_t id, Events ev )
+	{
+		if( posted.size() == 5 )
+			return false;
+		posted.push_back( std::make_pair( id, ev ) );
+		return true;
+	}
+	size_t nbInstances() const { return 3; }
+};
+
+void configure( fsm_t& fsm )
+{
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTransition( st2, ev0, st0 );
+	fsm.assignTransition( ev1, st0 );
+}
+
+int main()
+{
+	std::array<uint8_t,4096> buf;
+	spag::WireEncoder<Events> enc( buf.data(), buf.size(), 100 );
+	std::cout << "capacity=" << spag::WireFormat::capacity( buf.size() ) << '\n';
+
+// 1 - single FSM, many events in one frame
+	for( int i=0; i<500; i++ )
+		enc.add( i%7 ? ev0 : ev1 );
+	std::cout << "nb records=" << enc.nbRecords() << " size=" << enc.size() << '\n';
+	{
+		spag::WireDecoder<Events> dec( enc.data(), enc.size() );
+		fsm_t fsm;
+		configure( fsm );
+		fsm.start();
+		std::cout << "valid=" << dec.valid() << " seq=" << dec.seq() << " nb=" << dec.nbRecords()
+			<< " processed=" << dec.processOn( fsm ) << " final state=" << fsm.currentState() << '\n';
+	}
+
+// 2 - several FSM
+	enc.clear();
+	std::cout << "next frame: nb records=" << enc.nbRecords() << '\n';
+	for( uint32_t id: { 0, 0, 0, 2, 2, 1, 0 } )
+		enc.add( id, ev0 );
+	{
+		spag::WireDecoder<Events> dec( enc.data(), enc.size() );
+		std::cout << "seq=" << dec.seq() << " events:";
+		for( auto it=dec.begin(); it!=dec.end(); ++it )
+			std::cout << ' ' << it.instance() << ':' << *it;
+		std::cout << '\n';
+
+		std::vector<fsm_t> vfsm( 3 );
+		for( auto& fsm: vfsm )
+		{
+			configure( fsm );
+			fsm.start();
+		}
+		std::cout << "dispatched=" << dec.dispatch( vfsm ) << " states:";
+		for( const auto& fsm: vfsm )
+			std::cout << ' ' << fsm.currentState();
+		std::cout << '\n';
+
+		FakeEngine engine;
+		std::cout << "posted=" << dec.post( engine ) << '\n';
+
+		std::vector<fsm_t> vfsm2( 2 );            // instance 2 does not exist
+		for( auto& fsm: vfsm2 )
+		{
+			configure( fsm );
+			fsm.start();
+		}
+		std::cout << "dispatched on 2 FSM=" << dec.dispatch( vfsm2 ) << " skipped=" << dec.nbSkipped() << '\n';
+	}
+
+// 2b - records out of range (malformed or hostile frame): skipped, whatever the build options
+	enc.clear();
+	enc.add( 0, ev0 );
+	enc.add( 0, static_cast<Events>( NB_EVENTS ) );
+	enc.add( 5, ev0 );                              // no FSM 5
+	enc.add( 1, ev1 );
+	enc.add( 0, static_cast<Events>( 0xffff ) );
+	{
+		spag::WireDecoder<Events> dec( enc.data(), enc.size() );
+		fsm_t fsm;
+		configure( fsm );
+		fsm.start();
+		std::cout << "bad records: processed=" << dec.processOn( fsm ) << " skipped=" << dec.nbSkipped();
+		std::vector<fsm_t> vfsm( 3 );
+		for( auto& f: vfsm )
+		{
+			configure( f );
+			f.start();
+		}
+		std::cout << ", dispatched=" << dec.dispatch( vfsm ) << " skipped=" << dec.nbSkipped();
+		FakeEngine engine;
+		std::cout << ", posted=" << dec.post( engine ) << " skipped=" << dec.nbSkipped() << '\n';
+	}
+
+// 3 - invalid frames
+	std::cout << "truncated: " << spag::WireDecoder<Events>( enc.data(), enc.size()-1 ).valid() << '\n';
+	std::cout << "too short: " << spag::WireDecoder<Events>( enc.data(), 5 ).valid() << '\n';
+	{
+		std::array<uint8_t,4> tiny;                       // shorter than the header: nothing must be read after it
+		std::memcpy( tiny.data(), buf.data(), tiny.size() );
+		spag::WireDecoder<Events> dec( tiny.data(), tiny.size() );
+		std::cout << "tiny: valid=" << dec.valid() << " seq=" << dec.seq() << " nb=" << dec.nbRecords()
+			<< " empty=" << ( dec.begin() == dec.end() ) << '\n';
+	}
+	buf[2] = 99;
+	std::cout << "wrong version: " << spag::WireDecoder<Events>( enc.data(), enc.size() ).valid() << '\n';
+
+// 4 - full buffer
+	std::array<uint8_t,spag::WireFormat::HeaderSize + 3*spag::WireFormat::RecordSize> small;
+	spag::WireEncoder<Events> enc2( small.data(), small.size() );
+	int nb = 0;
+	while( enc2.add( ev0 ) )
+		nb++;
+	std::cout << "small buffer: nb=" << nb << " full=" << enc2.full() << '\n';
+}
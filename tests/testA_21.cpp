@@ -0,0 +1,65 @@
+/**
+\file testA_21.cpp
+\brief test of string lookup: findState(), findEvent(), getStateIndex(), getEventIndex(), before and after start (index)
+*/
+
+#define SPAG_ENUM_STRINGS
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev_go, ev_back, ev_inner, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+void lookup( const fsm_t& fsm )
+{
+	for( auto str: { "Idle", "Running", "St-2", "unknown" } )
+	{
+		auto res = fsm.findState( str );
+		std::cout << "state \"" << str << "\": found=" << res.first;
+		if( res.first )
+			std::cout << " value=" << res.second << " index=" << fsm.getStateIndex( str );
+		std::cout << '\n';
+	}
+	for( auto str: { "go", "back", "Ev-2", "*Timeout*", "" } )
+	{
+		auto res = fsm.findEvent( str );
+		std::cout << "event \"" << str << "\": found=" << res.first;
+		if( res.first )
+			std::cout << " value=" << res.second;
+		std::cout << '\n';
+	}
+	std::cout << "index of timeout pseudo-event=" << fsm.getEventIndex( "*Timeout*" ) << '\n';
+	try
+	{
+		fsm.getEventIndex( "unknown" );
+	}
+	catch( const std::exception& e )
+	{
+		std::cout << "error: " << e.what() << '\n';
+	}
+}
+
+int main()
+{
+	fsm_t fsm;
+	fsm.assignTransition( st0, ev_go, st1 );
+	fsm.assignTransition( st1, ev_go, st2 );
+	fsm.assignTransition( ev_back, st0 );
+	fsm.assignStrings2States( { { st0, "Idle" }, { st1, "Running" } } );
+	fsm.assignStrings2Events( { { ev_go, "go" }, { ev_back, "back" } } );
+
+	std::cout << "* before start:\n";
+	lookup( fsm );
+	fsm.start();
+	std::cout << "* after start:\n";
+	lookup( fsm );
+
+	for( auto cmd: { "go", "go", "back", "go" } )     // text commands mapped to events
+		fsm.processEvent( fsm.findEvent( cmd ).second );
+	std::cout << "current state=" << fsm.currentState() << '\n';
+	fsm.stop();
+
+	fsm.assignString2State( st2, "Done" );            // invalidates the index, until next start
+	std::cout << "after change: found=" << fsm.findState( "Done" ).first << " old string found=" << fsm.findState( "St-2" ).first << '\n';
+}
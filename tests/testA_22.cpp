@@ -0,0 +1,146 @@
+/**
+\file testA_22.cpp
+\brief test of saveConfig() / loadConfig(): binary configuration image, loaded from memory and from a memory-mapped file
+*/
+
+#define SPAG_USE_SIGNALS
+#define SPAG_ENUM_STRINGS
+#define SPAG_USE_MMAP
+#define SPAG_USE_VIRTUAL_CLOCK
+#include "spaghetti.hpp"
+
+#include <sstream>
+
+enum States { st0, st1, st2, st3, st4, NB_STATES };
+enum Events { ev0, ev1, ev_inner, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::VirtualTimer, int );
+
+std::ostringstream g_out;
+
+void cb( int s )
+{
+	g_out << s;
+}
+
+/// Runs a sequence of events and timeouts, returns the sequence of visited states
+std::string run( fsm_t& fsm )
+{
+	g_out.str( "" );
+	spag::VirtualClock clock;
+	spag::VirtualTimer<States,Events,int> timer( clock );
+	fsm.assignEventHandler( &timer );
+	fsm.assignCallbackAutoval( cb );
+	fsm.start();
+	for( int i=0; i<10; i++ )
+	{
+		fsm.processEvent( i%3 ? ev0 : ev1 );
+		if( i%4 == 0 )
+			fsm.activateInnerEvent( ev_inner );
+		clock.runFor( 20, spag::DurUnit::ms );
+	}
+	fsm.stop();
+	return g_out.str();
+}
+
+int main()
+{
+	fsm_t fsm1;
+	fsm1.assignTransition( st0, ev0, st1 );
+	fsm1.assignTransition( st1, ev0, st2 );
+	fsm1.assignTransition( ev1, st0 );
+	fsm1.assignTimeOut( st2, 500, "us", st3 );
+	fsm1.assignAAT( st3, st4 );
+	fsm1.assignTimeOut( st4, 15, "ms", st0 );
+	fsm1.assignInnerTransition( st1, ev_inner, st4 );
+	fsm1.assignInnerTransition( st0, ev_inner, st2 );
+	fsm1.assignStrings2States( { { st0, "Init" }, { st1, "Run" }, { st4, "Cool down" } } );
+	fsm1.assignString2Event( ev0, "next" );
+
+	auto image = fsm1.saveConfig();
+	std::cout << "image size=" << image.size() << '\n';
+	fsm1.saveConfig( "testA_22.bin" );
+
+	std::ostringstream cfg1, cfg2, cfg3;
+	fsm1.printConfig( cfg1 );
+
+	fsm_t fsm2;                                      // from memory
+	fsm2.loadConfig( image.data(), image.size() );
+	fsm2.printConfig( cfg2 );
+
+	fsm_t fsm3;                                      // from the (memory-mapped) file
+	fsm3.loadConfig( "testA_22.bin" );
+	fsm3.printConfig( cfg3 );
+	std::cout << "identical configurations: " << ( cfg1.str() == cfg2.str() && cfg1.str() == cfg3.str() ? "yes" : "no" ) << '\n';
+	std::cout << "strings: " << fsm3.getStateIndex( "Cool down" ) << ' ' << fsm3.getEventIndex( "next" ) << '\n';
+
+	auto seq1 = run( fsm1 );
+	auto seq3 = run( fsm3 );
+	std::cout << "sequence=" << seq1 << ", identical: " << ( seq1 == seq3 ? "yes" : "no" ) << '\n';
+
+	for( int i=0; i<4; i++ )                         // invalid images
+	{
+		auto bad = image;
+		size_t size = bad.size();
+		switch( i )
+		{
+			case 0: bad[0] = 'X';          break;     // magic
+			case 1: size = 100;            break;     // truncated
+			case 2: bad[ sizeof(spag::priv::ConfigImageHeader) ] = 99; break;  // first state value of the transition table
+			case 3:
+			{
+				enum St3 { s0, s1, s2, NB_STATES };
+				spag::SpagFSM<St3,Events,spag::priv::NoTimer<St3,Events,int>,int> other;
+				try
+				{
+					other.loadConfig( image.data(), image.size() );
+				}
+				catch( const std::exception& e )
+				{
+					std::cout << "error: " << e.what() << '\n';
+				}
+				continue;
+			}
+		}
+		try
+		{
+			fsm_t fsm;
+			fsm.loadConfig( bad.data(), size );
+		}
+		catch( const std::exception& e )
+		{
+			std::cout << "error: " << e.what() << '\n';
+		}
+	}
+
+	{                                                // unaligned image
+		std::vector<uint8_t> buf( 1, 0 );
+		buf.insert( buf.end(), image.begin(), image.end() );
+		fsm_t fsm;
+		fsm.loadConfig( buf.data() + 1, image.size() );
+		std::ostringstream cfg;
+		fsm.printConfig( cfg );
+		std::cout << "unaligned image: identical configuration: " << ( cfg.str() == cfg1.str() ? "yes" : "no" ) << '\n';
+	}
+	{                                                // invalid string table: the configuration must be left unchanged
+		spag::priv::ConfigImageHeader hdr;
+		std::memcpy( &hdr, image.data(), sizeof(hdr) );
+		auto bad = image;
+		uint32_t off = 0xFFFF;
+		std::memcpy( bad.data() + hdr._offStrings, &off, sizeof(off) );
+		fsm_t fsm;
+		fsm.assignTransition( st0, ev1, st3 );
+		std::ostringstream before, after;
+		fsm.printConfig( before );
+		try
+		{
+			fsm.loadConfig( bad.data(), bad.size() );
+		}
+		catch( const std::exception& e )
+		{
+			std::cout << "error: " << e.what() << '\n';
+		}
+		fsm.printConfig( after );
+		std::cout << "configuration unchanged: " << ( before.str() == after.str() ? "yes" : "no" ) << '\n';
+	}
+}
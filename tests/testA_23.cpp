@@ -0,0 +1,78 @@
+/**
+\file testA_23.cpp
+\brief test of the run-time sized FSM (DynamicFSM), with a large number of states and different index types
+*/
+
+#include "spaghetti.hpp"
+
+#include <cstdint>
+
+struct Callbacks : public spag::StaticNoCallback<uint16_t,uint16_t>
+{
+	void onEnter( uint16_t )
+	{
+		_nbEnter++;
+	}
+	void onIgnored( uint16_t, uint16_t )
+	{
+		_nbIgnored++;
+	}
+	size_t _nbEnter   = 0;
+	size_t _nbIgnored = 0;
+};
+
+int main()
+{
+	{                                                       // a ring of 5000 states: ev0 goes forward, ev1 goes back to 0, ev2 is ignored
+		const size_t nbStates = 5000;
+		spag::DynamicFSM<uint16_t,Callbacks> fsm( nbStates, 3 );
+		for( size_t s=0; s<nbStates; s++ )
+			fsm.assignTransition( s, 0, (s+1)%nbStates );
+		fsm.assignTransition( 1, 0 );
+		fsm.clearTransition( 0, 1 );
+		fsm.assignTimeOut( 4000, 5, "ms", 4999 );
+
+		fsm.start();
+		for( size_t i=0; i<4000; i++ )
+			fsm.processEvent( 0 );
+		std::cout << "current state=" << fsm.currentState() << ", has timeout=" << fsm.hasTimeOut()
+			<< ", duration=" << fsm.timeOutDuration( fsm.currentState() ).first << '\n';
+		fsm.processTimeOut();
+		std::cout << "current state=" << fsm.currentState() << ", previous=" << fsm.previousState() << '\n';
+		std::vector<uint16_t> v_ev{ 0, 0, 2, 1, 1, 2, 0 };
+		std::cout << "nb processed=" << fsm.processEvents( v_ev.begin(), v_ev.end() ) << '\n';
+		std::cout << "current state=" << fsm.currentState() << ", nb callbacks=" << fsm.handler()._nbEnter
+			<< ", nb ignored=" << fsm.handler()._nbIgnored << '\n';
+		fsm.stop();
+	}
+	{                                                       // small FSM with 8 bits indexes and a pass-state
+		spag::DynamicFSM<uint8_t> fsm( 255, 2 );
+		fsm.assignTransition( 0, 0, 1 );
+		fsm.assignAAT( 1, 254 );
+		fsm.assignTransition( 254, 1, 0 );
+		fsm.start();
+		fsm.processEvent( 0 );
+		std::cout << "nb states=" << fsm.nbStates() << ", current state=" << (int)fsm.currentState()
+			<< ", previous=" << (int)fsm.previousState() << '\n';
+		fsm.processEvent( 1 );
+		std::cout << "current state=" << (int)fsm.currentState() << '\n';
+	}
+	try                                                     // max value of index type is reserved
+	{
+		spag::DynamicFSM<uint8_t> fsm( 256, 2 );
+	}
+	catch( const std::exception& e )
+	{
+		std::cout << "error: " << e.what() << '\n';
+	}
+	try
+	{
+		spag::DynamicFSM<uint16_t> fsm( 10, 2 );
+		fsm.assignTimeOut( 3, 1, spag::DurUnit::sec, 4 );
+		fsm.assignAAT( 3, 5 );
+	}
+	catch( const std::exception& e )
+	{
+		std::cout << "error: " << e.what() << '\n';
+	}
+}
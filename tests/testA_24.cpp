@@ -0,0 +1,79 @@
+/**
+\file testA_24.cpp
+\brief test of the sparse transition table of DynamicFSM (SparseTable): same behavior as the dense table, smaller footprint
+*/
+
+#include "spaghetti.hpp"
+
+#include <random>
+
+struct Callbacks : public spag::StaticNoCallback<uint16_t,uint16_t>
+{
+	void onEnter( uint16_t st )
+	{
+		_sum = _sum * 31 + st;
+	}
+	void onIgnored( uint16_t, uint16_t )
+	{
+		_nbIgnored++;
+	}
+	uint64_t _sum       = 0;
+	size_t   _nbIgnored = 0;
+};
+
+using dense_t  = spag::DynamicFSM<uint16_t,Callbacks>;
+using sparse_t = spag::DynamicFSM<uint16_t,Callbacks,spag::SparseTable<uint16_t>>;
+
+/// 3000 states, 500 events, each state has a few allowed events (more on the first states, so both short and long rows are searched)
+template<typename FSM>
+void config( FSM& fsm )
+{
+	std::mt19937 rng( 1 );
+	for( size_t s=0; s<fsm.nbStates(); s++ )
+	{
+		fsm.assignTransition( s, s%fsm.nbEvents(), (s+1)%fsm.nbStates() );    // so all the states are reachable
+		size_t nb = ( s < 10 ? 50 : 3 );
+		for( size_t i=0; i<nb; i++ )
+			fsm.assignTransition( s, rng()%fsm.nbEvents(), rng()%fsm.nbStates() );
+	}
+	fsm.assignTransition( 5, 7, 9 );                 // assigned twice: last one wins
+	fsm.assignTransition( 5, 7, 10 );
+	fsm.clearTransition( 6, 6 );
+	fsm.assignAAT( 20, 0 );
+}
+
+template<typename FSM>
+void run( FSM& fsm )
+{
+	std::mt19937 rng( 2 );
+	fsm.start();
+	for( size_t i=0; i<200000; i++ )
+		fsm.processEvent( i%3 ? fsm.currentState() % fsm.nbEvents() : rng()%fsm.nbEvents() );
+	fsm.assignTransition( fsm.currentState(), 499, 1234 );     // configuration changes while running, merged on next event
+	fsm.assignTransition( 1234, 498, 5 );
+	fsm.assignTransition( 1234, 497, 6 );
+	fsm.clearTransition( 1234, 497 );
+	fsm.processEvent( 499 );
+	std::cout << "current state=" << fsm.currentState();
+	fsm.processEvent( 497 );                                   // ignored
+	fsm.processEvent( 498 );
+	std::cout << ", then " << fsm.currentState() << '\n';
+	fsm.stop();
+}
+
+int main()
+{
+	dense_t  fsm1( 3000, 500 );
+	sparse_t fsm2( 3000, 500 );
+	config( fsm1 );
+	config( fsm2 );
+	run( fsm1 );
+	run( fsm2 );
+	std::cout << "same states sequence: " << ( fsm1.handler()._sum == fsm2.handler()._sum ? "yes" : "no" )
+		<< ", same nb of ignored events: " << ( fsm1.handler()._nbIgnored == fsm2.handler()._nbIgnored ? "yes" : "no" ) << '\n';
+	std::cout << "dense table size="  << fsm1.table().memSize() << '\n';
+	std::cout << "sparse table size=" << fsm2.table().memSize() << ", nb transitions=" << fsm2.table().nbTransitions() << '\n';
+	std::cout << "transition 5/7: " << fsm1.table().get( 5, 7 ) << '/' << fsm2.table().get( 5, 7 )
+		<< ", 6/6 ignored: " << ( fsm2.table().get( 6, 6 ) == sparse_t::None ? "yes" : "no" )
+		<< ", pass-state empty: " << ( fsm2.table().get( 20, 20 ) == sparse_t::None ? "yes" : "no" ) << '\n';
+}
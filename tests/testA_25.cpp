@@ -0,0 +1,118 @@
+/**
+\file testA_25.cpp
+\brief test of FsmPool: bulk processing of an event on many instances of a FSM (symbol SPAG_USE_FSM_POOL), including apply() called from a callback
+*/
+
+#define SPAG_USE_FSM_POOL
+#define SPAG_USE_SIGNALS
+#include "spaghetti.hpp"
+
+enum States { st_Init, st_Red, st_Green, st_Orange, st_Blink, NB_STATES };
+enum Events { ev_Reset, ev_Next, ev_Warn, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+using pool_t = spag::FsmPool<States,Events,int>;
+
+std::vector<int> g_nbCalls( NB_STATES, 0 );
+std::vector<States> g_lastState;               ///< last state entered, for each instance
+pool_t* g_pool = nullptr;
+
+void cb( int st )
+{
+	g_nbCalls[st]++;
+	g_lastState[ g_pool->currentInstance() ] = static_cast<States>( st );
+}
+
+pool_t* g_pool2 = nullptr;
+bool g_nested = false;
+
+/// Calls apply() again from a callback, once
+void cbNested( int st )
+{
+	if( st == st_Green && !g_nested )
+	{
+		g_nested = true;
+		g_pool2->apply( ev_Warn );
+	}
+}
+
+int main()
+{
+	fsm_t model;
+	model.assignCallbackAutoval( cb );
+	model.assignAAT( st_Init, st_Red );
+	model.assignTransition( st_Red,    ev_Next, st_Green );
+	model.assignTransition( st_Green,  ev_Next, st_Orange );
+	model.assignTransition( st_Orange, ev_Next, st_Red );
+	model.assignTransition( ev_Warn,  st_Blink );
+	model.assignTransition( ev_Reset, st_Init );
+
+	const size_t nb = 1003;                    // not a multiple of 8
+	pool_t pool( model, nb );
+	g_pool = &pool;
+	g_lastState.assign( nb, st_Init );
+	pool.start();
+	std::cout << "after start, state of 10=" << pool.currentState( 10 ) << '\n';
+
+	std::cout << "size=" << pool.size() << ", nb changed on ev_Next=" << pool.apply( ev_Next ) << '\n';
+	std::cout << "nb changed on ev_Reset=" << pool.apply( ev_Reset ) << ", state of 10=" << pool.currentState( 10 ) << '\n';
+
+	std::vector<uint8_t> mask( nb, 0 );
+	for( size_t i=0; i<nb; i+=3 )
+		mask[i] = 1;
+	std::cout << "nb changed on ev_Next with mask=" << pool.apply( ev_Next, mask ) << ", first ones: ";
+	for( size_t i=0; i<4; i++ )
+		std::cout << pool.lastChanged()[i] << ' ';
+	std::cout << '\n';
+	pool.apply( ev_Next );
+	pool.processEvent( 1, ev_Warn );
+
+	size_t nbState[NB_STATES] = { 0, 0, 0, 0, 0 };
+	bool sameAsCallback = true;
+	for( size_t i=0; i<nb; i++ )
+	{
+		nbState[ pool.currentState( i ) ]++;
+		sameAsCallback = sameAsCallback && ( g_lastState[i] == pool.currentState( i ) );
+	}
+	for( size_t s=0; s<NB_STATES; s++ )
+		std::cout << "state " << s << ": nb instances=" << nbState[s] << ", nb callbacks=" << g_nbCalls[s] << '\n';
+	std::cout << "callbacks saw the right instance: " << ( sameAsCallback ? "yes" : "no" ) << '\n';
+
+// compare with a plain FSM, on the same sequence of events
+	fsm_t fsm;
+	fsm.assignConfig( model );
+	fsm.start();
+	pool_t pool1( model, 1 );
+	pool1.start();
+	Events seq[] = { ev_Next, ev_Next, ev_Warn, ev_Next, ev_Reset, ev_Next, ev_Next, ev_Next, ev_Next };
+	bool same = true;
+	for( auto ev: seq )
+	{
+		fsm.processEvent( ev );
+		pool1.apply( ev );
+		same = same && ( fsm.currentState() == pool1.currentState( 0 ) );
+	}
+	std::cout << "same states as SpagFSM: " << ( same ? "yes" : "no" ) << '\n';
+
+	try
+	{
+		pool.apply( ev_Next, std::vector<uint8_t>( 10, 1 ) );
+	}
+	catch( const std::exception& e )
+	{
+		std::cout << "error: " << e.what() << '\n';
+	}
+
+	fsm_t model2;                                  // apply() called again by a callback
+	model2.assignConfig( model );
+	model2.assignCallbackAutoval( cbNested );
+	pool_t pool2( model2, 20 );
+	g_pool2 = &pool2;
+	pool2.start();
+	auto nbOuter = pool2.apply( ev_Next );
+	size_t nbBlink = 0;
+	for( size_t i=0; i<pool2.size(); i++ )
+		nbBlink += ( pool2.currentState( i ) == st_Blink );
+	std::cout << "nested apply: outer changed=" << nbOuter << ", last changed=" << pool2.lastChanged().size() << ", on st_Blink=" << nbBlink << '\n';
+}
@@ -0,0 +1,41 @@
+/**
+\file testA_26.cpp
+\brief test of the configuration checking: done once for a given configuration, even if shared, and again after a change
+*/
+
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, st3, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+int main()
+{
+	fsm_t model;
+	model.assignTransition( st0, ev0, st1 );
+	model.assignTransition( st1, ev0, st0 );
+	model.assignTransition( st1, ev1, st2 );          // st2 is a dead-end, st3 is unreachable
+
+	std::cout << "- start model:\n";
+	model.start();
+	model.stop();
+	std::cout << "- start again:\n";                   // no check done
+	model.start();
+	model.stop();
+
+	std::cout << "- start 1000 FSM sharing the configuration:\n";
+	std::vector<fsm_t> vfsm( 1000 );
+	for( auto& fsm: vfsm )
+	{
+		fsm.assignConfig( model );
+		fsm.start();
+	}
+	std::cout << "- change configuration of one of them:\n";
+	vfsm[5].stop();
+	vfsm[5].assignTransition( st2, ev0, st3 );          // copy on write: st3 is now reachable, and st2 is no longer a dead-end
+	vfsm[5].start();
+	std::cout << "- explicit check:\n";
+	vfsm[6].doChecking();
+	std::cout << "- done\n";
+}
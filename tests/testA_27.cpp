@@ -0,0 +1,94 @@
+/**
+\file testA_27.cpp
+\brief test that the run-time functions do no heap allocation, once the FSM is started (counting allocator)
+*/
+
+#define SPAG_USE_SIGNALS
+#include "spaghetti.hpp"
+
+#include <new>
+#include <cstdlib>
+
+size_t g_nbAlloc = 0;   ///< number of calls to operator new
+
+void* operator new( std::size_t size )
+{
+	g_nbAlloc++;
+	if( void* p = std::malloc( size ? size : 1 ) )
+		return p;
+	throw std::bad_alloc();
+}
+void operator delete( void* p ) noexcept
+{
+	std::free( p );
+}
+void operator delete( void* p, std::size_t ) noexcept
+{
+	std::free( p );
+}
+
+enum States { st0, st1, st2, st3, NB_STATES };
+enum Events { ev0, ev1, ev_inner, NB_EVENTS };
+
+/// Event handler that does nothing, timeouts are processed by calling processTimeOut()
+template<typename ST, typename EV, typename CBA>
+struct NullTimer
+{
+	void init( const spag::SpagFSM<ST,EV,NullTimer,CBA>* ) {}
+	void timerStart( const spag::SpagFSM<ST,EV,NullTimer,CBA>* ) {}
+	void timerCancel() {}
+	void kill() {}
+	void postDrain( const spag::SpagFSM<ST,EV,NullTimer,CBA>* ) {}
+};
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, NullTimer, int );
+
+size_t g_nbCallbacks = 0;
+void cb( int )
+{
+	g_nbCallbacks++;
+}
+
+int main()
+{
+	fsm_t fsm;
+	NullTimer<States,Events,int> timer;
+	fsm.assignEventHandler( &timer );
+	fsm.assignCallback( cb );
+	fsm.assignIgnoredEventsCallback( []( States, Events ){ g_nbCallbacks++; } );
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTimeOut( st2, 10, "ms", st0 );
+	fsm.assignTransition( st0, ev1, st3 );
+	fsm.assignAAT( st3, st0 );
+	fsm.assignInnerTransition( st1, ev_inner, st0 );
+	fsm.start();
+
+	auto nbAlloc = g_nbAlloc;
+	Events batch[] = { ev0, ev1, ev0, ev1, ev1 };
+	for( int i=0; i<1000; i++ )
+	{
+		fsm.processEvent( ev0 );          // st0 => st1
+		fsm.processEvent( ev1 );          // ignored
+		fsm.processEvent( ev0 );          // st1 => st2
+		fsm.processTimeOut();             // st2 => st0
+		fsm.processEvent( ev1 );          // st0 => st3 => st0 (pass-state)
+		fsm.activateInnerEvent( ev_inner );
+		fsm.processEvent( ev0 );          // st0 => st1 => st0 (inner event)
+		fsm.processEvents( batch, batch+5 );
+		fsm.processTimeOut();
+		fsm.processEvent( ev1 );
+	}
+	std::cout << "nb allocations while running=" << g_nbAlloc - nbAlloc << ", nb callbacks=" << g_nbCallbacks << ", state=" << fsm.currentState() << '\n';
+	fsm.stop();
+
+	try                                   // the error path is still available
+	{
+		fsm.start();
+		fsm.processEvent( ev_inner );
+	}
+	catch( const std::exception& e )
+	{
+		std::cout << "error: " << e.what() << '\n';
+	}
+}
@@ -0,0 +1,92 @@
+/**
+\file testA_28.cpp
+\brief test of the coroutine interface (symbol SPAG_USE_COROUTINES, needs C++20): two FSM and their coroutines, run by a single scheduler, and the replacement of restarted timeouts
+*/
+
+#define SPAG_USE_COROUTINES
+#include "spaghetti.hpp"
+
+#include <sstream>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::CoroTimer, int );
+
+std::ostringstream g_out[2];   ///< one output per FSM, as their relative order depends on timing
+spag::CoroScheduler::Clock::time_point g_tStart, g_tEnd;
+
+/// Waits for the transitions of \c fsm, triggers event ev0 when on st2, and stops the FSM after \c nbCycles cycles
+spag::CoroTask driver( fsm_t& fsm, int id, int nbCycles )
+{
+	int nb = 0;
+	while( fsm.isRunning() )
+	{
+		auto st = co_await fsm.nextTransition();
+		g_out[id] << "fsm " << id << ": state " << st << '\n';
+		if( st == st2 )
+		{
+			g_tEnd = spag::CoroScheduler::Clock::now();
+			if( ++nb == nbCycles )
+				fsm.stop();
+			else
+				fsm.processEvent( ev0 );
+		}
+	}
+	g_out[id] << "fsm " << id << ": done\n";
+}
+
+/// Restarts a timeout before it expires: the first one must be ignored
+spag::CoroTask restarter( spag::CoroScheduler& sched, fsm_t& fsm )
+{
+	co_await sched.sleepFor( 20, spag::DurUnit::ms );
+	g_out[1] << "restarter: state " << fsm.currentState() << '\n';
+	fsm.processEvent( ev1 );                     // st1 => st1, restarts the 40 ms timeout
+}
+
+int main()
+{
+	spag::CoroScheduler sched;
+	spag::CoroTimer<States,Events,int> timer1( sched ), timer2( sched );
+
+	fsm_t fsm1, fsm2;
+	for( auto p: { &fsm1, &fsm2 } )
+	{
+		p->assignTimeOut( st0, 10, "ms", st1 );
+		p->assignTransition( st2, ev0, st0 );
+	}
+	fsm1.assignEventHandler( &timer1 );
+	fsm1.assignTimeOut( st1, 10, "ms", st2 );
+	fsm2.assignEventHandler( &timer2 );
+	fsm2.assignTimeOut( st1, 40, "ms", st2 );
+	fsm2.assignTransition( st1, ev1, st1 );
+
+	g_tStart = spag::CoroScheduler::Clock::now();
+	fsm1.start();                                // not blocking
+	fsm2.start();
+	driver( fsm1, 0, 2 );
+	driver( fsm2, 1, 1 );
+	restarter( sched, fsm2 );
+
+	{                                            // restarting or stopping a FSM replaces or removes its scheduled timeout
+		spag::CoroTimer<States,Events,int> timer3( sched );
+		fsm_t fsm3;
+		fsm3.assignTimeOut( st0, 1, "sec", st1 );
+		fsm3.assignTransition( st0, ev0, st0 );
+		fsm3.assignTransition( st1, ev1, st2 );
+		fsm3.assignTransition( st2, ev1, st0 );
+		fsm3.assignEventHandler( &timer3 );
+		fsm3.start();
+		for( int i=0; i<1000; i++ )
+			fsm3.processEvent( ev0 );
+		std::cout << "after restarts: scheduled=" << sched.size();
+		fsm3.stop();
+		std::cout << ", after stop: scheduled=" << sched.size() << '\n';
+	}
+
+	sched.run();                                 // returns even if fsm3 timeout was never due
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>( g_tEnd - g_tStart ).count();   // end of fsm2
+	std::cout << g_out[0].str() << g_out[1].str();
+	std::cout << "running: " << fsm1.isRunning() << fsm2.isRunning() << ", nothing scheduled: " << ( sched.size() == 0 ? "yes" : "no" )
+		<< ", restarted timeout was honored: " << ( ms >= 60 ? "yes" : "no" ) << '\n';
+}
@@ -0,0 +1,99 @@
+/**
+\file testA_29.cpp
+\brief test of exit callbacks and transition actions (symbol SPAG_USE_TRANSITION_ACTIONS)
+*/
+
+#define SPAG_USE_TRANSITION_ACTIONS
+#define SPAG_USE_TIMER_WHEEL
+#define SPAG_USE_SIGNALS
+#include "spaghetti.hpp"
+
+#include <sstream>
+
+enum States { st0, st1, st2, st_pass, st3, NB_STATES };
+enum Events { ev0, ev1, ev_inner, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+
+std::ostringstream g_out;   ///< holds the sequence of calls
+
+void cbEnter( int s )
+{
+	g_out << " E" << s;
+}
+void cbExit( int s )
+{
+	g_out << " X" << s;
+}
+void action( void* ctx, States st, Events ev )
+{
+	g_out << " A(" << static_cast<const char*>(ctx) << ':' << st << ',' << ev << ')';
+}
+
+struct Counter
+{
+	int nb = 0;
+	void onExit( int ) { nb++; }
+};
+
+void print( const char* msg )
+{
+	std::cout << msg << ":" << g_out.str() << '\n';
+	g_out.str( "" );
+}
+
+int main()
+{
+	fsm_t fsm;
+	spag::TimerWheel wheel;
+	spag::WheelTimer<States,Events,int> timer( wheel );
+	fsm.assignEventHandler( &timer );
+
+	fsm.assignCallbackAutoval( cbEnter );
+	for( int s=0; s<NB_STATES; s++ )
+		fsm.assignExitCallback( static_cast<States>(s), cbExit );
+	Counter counter;
+	fsm.assignMemberExitCallback<Counter,&Counter::onExit>( st1, &counter );  // replaces the previous one
+
+	char name_a[] = "a";
+	char name_b[] = "b";
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTransition( st1, ev1, st1 );                 // self transition
+	fsm.assignTransition( st2, ev1, st_pass );
+	fsm.assignAAT( st_pass, st3 );
+	fsm.assignTimeOut( st3, 10, "ms", st0 );
+	fsm.assignInnerTransition( st0, ev_inner, st2 );
+	fsm.assignTransitionAction( st0, ev0, action, name_a );
+	fsm.assignTransitionAction( st1, ev1, action, name_b );
+	fsm.assignTransitionAction( st0, ev_inner, action, name_b );
+	fsm.assignTimeOutAction( st3, action, name_a );
+
+	fsm.start();
+	print( "start" );
+	fsm.processEvent( ev0 );
+	print( "st0-ev0" );
+	fsm.processEvent( ev1 );
+	print( "st1-ev1" );
+	fsm.processEvent( ev0 );
+	print( "st1-ev0" );
+	fsm.processEvent( ev0 );                               // ignored: nothing called
+	print( "st2-ev0" );
+	fsm.processEvent( ev1 );
+	print( "st2-ev1" );
+	fsm.activateInnerEvent( ev_inner );                   // processed once back on st0
+	wheel.advance( 10 );
+	print( "timeout+inner" );
+
+	fsm.stop();
+	fsm.assignTimeOutAction( st3, nullptr );               // removal
+	fsm.start();                                           // restarts on current state
+	fsm.processEvent( ev1 );
+	wheel.advance( 10 );
+	print( "restart" );
+	std::vector<Events> v_ev{ ev0, ev1, ev0 };
+	fsm.processEvents( v_ev );
+	print( "batch" );
+	std::cout << "exits of st1=" << counter.nb << '\n';
+	fsm.stop();
+}
@@ -0,0 +1,59 @@
+/**
+\file testA_30.cpp
+\brief test of the per-second rate counters (RateCounters class and getRates(), symbol SPAG_ENABLE_LOGGING)
+*/
+
+#define SPAG_ENABLE_LOGGING
+#include "spaghetti.hpp"
+
+#include <thread>
+
+enum States { st0, st1, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+void print( const char* msg, const spag::Rates& r )
+{
+	std::cout << msg << ": ";
+	r.print( std::cout );
+	std::cout << '\n';
+}
+
+int main()
+{
+	spag::RateCounters rc;
+	for( uint64_t sec=0; sec<20; sec++ )               // 10 events per second, one of them ignored
+		for( int i=0; i<10; i++ )
+		{
+			rc.record( spag::RateCounters::KindEvent, sec );
+			rc.record( i ? spag::RateCounters::KindTransition : spag::RateCounters::KindIgnored, sec );
+		}
+	rc.record( spag::RateCounters::KindTimeOut, 19 );
+	print( "1s",       rc.rates( 1, 20 ) );
+	print( "10s",      rc.rates( 10, 20 ) );
+	print( "60s",      rc.rates( 60, 20 ) );          // bounded by elapsed time
+	print( "later",    rc.rates( 10, 25 ) );          // 5 seconds without anything
+	print( "current",  rc.rates( 1, 19 ) );           // second 19 is not complete
+	print( "none",     rc.rates( 1, 0 ) );
+
+	for( int i=0; i<10; i++ )                          // bucket reuse, 64 seconds later
+		rc.record( spag::RateCounters::KindEvent, 64+5 );
+	print( "reused",   rc.rates( 1, 64+6 ) );
+
+	fsm_t fsm;
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st0 );
+	fsm.start();
+	for( int i=0; i<100; i++ )
+		fsm.processEvent( i%4 ? ev0 : ev1 );           // 25 ignored
+	fsm.clearCounters();                               // rates are not affected
+
+	std::this_thread::sleep_for( std::chrono::milliseconds( 1100 ) );   // so that the events are in a complete second
+	auto r = fsm.getRates( 60 );
+	std::cout << "fsm: events=" << r._events * r._window
+		<< " transitions=" << r._transitions * r._window
+		<< " ignored=" << r._ignored * r._window
+		<< " timeouts=" << r._timeOuts * r._window << '\n';
+	fsm.stop();
+}
@@ -0,0 +1,68 @@
+/**
+\file testA_31.cpp
+\brief test of the queueing flags of postEvent(): coalescing and priority lane (symbol SPAG_USE_EVENT_QUEUE)
+*/
+
+#define SPAG_USE_EVENT_QUEUE
+#include "spaghetti.hpp"
+
+#include <sstream>
+
+enum States { st_Idle, st_Run, st_Warn, NB_STATES };
+enum Events { ev_Data, ev_WarningOn, ev_Reset, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+std::ostringstream g_out;   ///< holds the sequence of visited states
+
+void cb( int s )
+{
+	g_out << s;
+}
+
+void print( const fsm_t& fsm, size_t nb )
+{
+	std::cout << "processed=" << nb << " sequence=" << g_out.str() << " coalesced=" << fsm.nbCoalescedEvents() << '\n';
+	g_out.str( "" );
+}
+
+int main()
+{
+	fsm_t fsm;
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st_Idle, ev_Data,      st_Run );
+	fsm.assignTransition( st_Run,  ev_Data,      st_Run );
+	fsm.assignTransition( st_Run,  ev_WarningOn, st_Warn );
+	fsm.assignTransition( st_Warn, ev_Data,      st_Run );
+	fsm.assignTransition( ev_Reset, st_Idle );
+	fsm.assignQueueFlags( ev_WarningOn, spag::QueueCoalesce | spag::QueueDropIfIgnored );
+	fsm.assignQueueFlags( ev_Reset,     spag::QueueHighPriority );
+	fsm.start();
+	print( fsm, 0 );
+
+	for( int i=0; i<3; i++ )                 // ignored on st_Idle: not queued
+		fsm.postEvent( ev_WarningOn );
+	for( int i=0; i<5; i++ )
+		fsm.postEvent( ev_Data );
+	fsm.postEvent( ev_WarningOn );            // still on st_Idle: not queued either
+	print( fsm, fsm.processPostedEvents() );
+
+	for( int i=0; i<4; i++ )                 // only the first one is queued
+		fsm.postEvent( ev_WarningOn );
+	for( int i=0; i<3; i++ )
+		fsm.postEvent( ev_Data );
+	fsm.postEvent( ev_Reset );                // processed first
+	print( fsm, fsm.processPostedEvents() );
+
+	fsm.postEvent( ev_Data );
+	fsm.postEvent( ev_WarningOn );            // can be queued again
+	fsm.postEvent( ev_WarningOn );
+	print( fsm, fsm.processPostedEvents() );
+
+	int nb = 0;                               // high priority lane has its own size
+	for( int i=0; i<SPAG_EVENT_QUEUE_HIGH_SIZE+1; i++ )
+		nb += fsm.postEvent( ev_Reset );
+	std::cout << "queued in high priority lane=" << nb << '\n';
+	fsm.processPostedEvents();
+	fsm.stop();
+}
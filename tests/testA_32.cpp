@@ -0,0 +1,108 @@
+/**
+\file testA_32.cpp
+\brief test of the timer reuse modes (setTimerReuse() ): number of timer operations, and resulting timeouts
+*/
+
+#define SPAG_USE_TIMER_WHEEL
+#include "spaghetti.hpp"
+
+#include <sstream>
+
+enum States { st0, st1, st2, st3, NB_STATES };
+enum Events { ev_go, ev_self, ev_next, ev_other, NB_EVENTS };
+
+/// Event handler based on a TimerWheel, that counts the timer operations
+template<typename ST, typename EV, typename CBA>
+struct CountingTimer
+{
+	using Fsm_t = spag::SpagFSM<ST,EV,CountingTimer,CBA>;
+
+	explicit CountingTimer( spag::TimerWheel& wheel ) : _wheel( wheel )
+	{
+		_node._func = &CountingTimer::onExpiry;
+		_node._arg  = this;
+	}
+	void init( const Fsm_t* fsm )
+	{
+		_fsm = fsm;
+	}
+	void timerStart( const Fsm_t* fsm )
+	{
+		_nbStart++;
+		auto duration = fsm->timeOutDuration( fsm->currentState() );
+		_wheel.schedule( _node, _wheel.toTicks( duration.first, duration.second ) );
+	}
+	void timerCancel()
+	{
+		_nbCancel++;
+		_wheel.cancel( _node );
+	}
+	void kill()
+	{
+		_wheel.cancel( _node );
+	}
+	static void onExpiry( void* p )
+	{
+		static_cast<CountingTimer*>(p)->_fsm->processTimeOut();
+	}
+
+	spag::TimerWheel& _wheel;
+	spag::TimerWheel::Node _node;
+	const Fsm_t* _fsm = nullptr;
+	int _nbStart  = 0;
+	int _nbCancel = 0;
+};
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, CountingTimer, int );
+
+std::ostringstream g_out;   ///< holds the sequence of visited states
+
+void cb( int s )
+{
+	g_out << s;
+}
+
+int main()
+{
+	for( auto mode: { spag::TimerReuse::Off, spag::TimerReuse::Rearm, spag::TimerReuse::KeepDeadline } )
+	{
+		g_out.str( "" );
+		spag::TimerWheel wheel;
+		CountingTimer<States,Events,int> timer( wheel );
+		fsm_t fsm;
+		fsm.assignEventHandler( &timer );
+		fsm.assignCallbackAutoval( cb );
+		fsm.assignTransition( st0, ev_go,    st1 );
+		fsm.assignTransition( st1, ev_self,  st1 );
+		fsm.assignTransition( st1, ev_next,  st2 );
+		fsm.assignTransition( st2, ev_next,  st1 );
+		fsm.assignTransition( st1, ev_other, st3 );
+		fsm.assignTransition( st3, ev_go,    st0 );
+		fsm.assignTimeOut( st1, 100, "ms", st0 );
+		fsm.assignTimeOut( st2, 100, "ms", st0 );     // same timeout as st1
+		fsm.assignTimeOut( st3, 50,  "ms", st0 );
+		fsm.setTimerReuse( mode );
+		fsm.start();
+
+		fsm.processEvent( ev_go );                    // t=0
+		wheel.advance( 30 );
+		fsm.processEvent( ev_self );                  // t=30
+		wheel.advance( 30 );
+		fsm.processEvent( ev_next );                  // t=60
+		auto nbPending = wheel.size();                // one timer, whatever the number of re-arms
+		wheel.advance( 50 );                          // t=110: timeout only if deadline was kept
+		g_out << '-';
+		wheel.advance( 60 );                          // t=170
+		g_out << '-';
+		fsm.processEvent( ev_go );
+		fsm.processEvent( ev_other );                 // different timeout: restarted
+		wheel.advance( 40 );
+		fsm.processEvent( ev_go );                    // no timeout on st0: canceled
+		wheel.advance( 100 );
+		std::cout << "mode " << (int)mode << ": sequence=" << g_out.str()
+			<< " nb start=" << timer._nbStart << " nb cancel=" << timer._nbCancel << " pending=" << nbPending << '\n';
+		if( nbPending != 1 )
+			std::cout << "error: " << nbPending << " pending timers\n";
+		fsm.stop();
+	}
+}
@@ -0,0 +1,96 @@
+/**
+\file testA_33.cpp
+\brief test of snapshot() and restore(): run-time state copied on another FSM, remaining timeout re-armed
+*/
+
+#define SPAG_ENABLE_LOGGING
+#define SPAG_USE_TIMER_WHEEL
+#include "spaghetti.hpp"
+
+#include <cstring>
+#include <sstream>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+
+std::ostringstream g_out;   ///< holds the sequence of visited states
+
+void cb( int s )
+{
+	g_out << s;
+}
+
+void configure( fsm_t& fsm )
+{
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st2, ev0, st0 );
+	fsm.assignTimeOut( st1, 100, "ms", st2 );
+}
+
+void print( const char* msg, const fsm_t& fsm )
+{
+	auto c = fsm.getCounters();
+	std::cout << msg << ": current=" << fsm.currentState() << " previous=" << fsm.previousState()
+		<< " sequence=" << g_out.str()
+		<< " count st1=" << c.getValue( spag::ItemStates, st1 )
+		<< " ev0=" << c.getValue( spag::ItemEvents, ev0 )
+		<< " ignored ev1=" << c.getValue( spag::ItemIgnoredEvents, ev1 ) << '\n';
+	g_out.str( "" );
+}
+
+int main()
+{
+	spag::TimerWheel wheel;
+	spag::WheelTimer<States,Events,int> timer1( wheel );
+	spag::WheelTimer<States,Events,int> timer2( wheel );
+	fsm_t fsm1, fsm2;
+	configure( fsm1 );
+	configure( fsm2 );
+	fsm1.assignEventHandler( &timer1 );
+	fsm2.assignEventHandler( &timer2 );
+
+	fsm1.start();
+	auto snap0 = fsm1.snapshot();                      // on st0, no timeout
+	fsm1.processEvent( ev1 );
+	fsm1.processEvent( ev0 );
+	wheel.advance( 40 );
+	auto snap = fsm1.snapshot();
+	std::cout << "timeout running=" << (int)snap._hasTimeOut << " remaining=" << snap._remaining/1000000 << "ms\n";
+	print( "fsm1", fsm1 );
+
+	unsigned char buf[sizeof(fsm_t::Snapshot)];        // can be stored as raw bytes
+	std::memcpy( buf, &snap, sizeof(buf) );
+
+	fsm2.start();
+	g_out.str( "" );
+	fsm_t::Snapshot snap2;
+	std::memcpy( &snap2, buf, sizeof(buf) );
+	fsm2.restore( snap2 );                             // no callback called
+	print( "fsm2 restored", fsm2 );
+
+	fsm1.restore( snap0 );                             // back on st0: timer canceled
+	wheel.advance( 59 );
+	print( "fsm2 after 59ms", fsm2 );
+	wheel.advance( 1 );
+	print( "fsm2 after 60ms", fsm2 );
+	wheel.advance( 100 );
+	print( "fsm1 restored on st0", fsm1 );
+
+	fsm_t fsm3;                                        // not running: start() uses the restored state
+	configure( fsm3 );
+	spag::WheelTimer<States,Events,int> timer3( wheel );
+	fsm3.assignEventHandler( &timer3 );
+	fsm3.restore( snap );
+	fsm3.start();
+	wheel.advance( 99 );
+	print( "fsm3 after 99ms", fsm3 );
+	wheel.advance( 1 );
+	print( "fsm3 after 100ms", fsm3 );
+
+	fsm1.stop();
+	fsm2.stop();
+	fsm3.stop();
+}
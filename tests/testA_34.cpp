@@ -0,0 +1,67 @@
+/**
+\file testA_34.cpp
+\brief test of the tracepoints, with a user hook (symbol SPAG_ENABLE_TRACEPOINTS)
+*/
+
+#define SPAG_ENABLE_TRACEPOINTS
+#define SPAG_USE_SIGNALS
+#define SPAG_USE_TIMER_WHEEL
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, st3, NB_STATES };
+enum Events { ev0, ev1, ev_inner, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+
+const char* g_names[] = {
+	"Transition", "IgnoredEvent", "TimerStart", "TimerCancel", "TimeOut",
+	"InnerEvent", "CallbackBegin", "CallbackEnd", "TimerAborted"
+};
+
+fsm_t fsm;
+
+void hook( void* ctx, spag::Tracepoint tp, const void* p, size_t a, size_t b, size_t c )
+{
+	auto& nb = *static_cast<int*>( ctx );
+	nb++;
+	if( tp == spag::Tracepoint::CallbackBegin || tp == spag::Tracepoint::CallbackEnd )   // too many
+		return;
+	std::cout << g_names[ static_cast<int>(tp) ] << ": " << a << ' ' << b << ' ' << c
+		<< ( p == &fsm ? "" : " (wrong FSM)" ) << '\n';
+}
+
+void cb( int s )
+{
+	if( s == st2 )
+		fsm.activateInnerEvent( ev_inner );
+}
+
+int main()
+{
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev1, st2 );
+	fsm.assignInnerTransition( st2, ev_inner, st3 );
+	fsm.assignTransition( st3, ev0, st0 );
+	fsm.assignTimeOut( st1, 10, "ms", st0 );
+
+	spag::TimerWheel wheel;
+	spag::WheelTimer<States,Events,int> timer( wheel );
+	fsm.assignEventHandler( &timer );
+
+	int nb = 0;
+	fsm.start();                       // no hook yet
+	spag::setTracepointHook( hook, &nb );
+	fsm.processEvent( ev0 );
+	wheel.advance( 10 );               // timeout
+	fsm.processEvent( ev1 );           // ignored
+	fsm.processEvent( ev0 );
+	std::array<Events,2> evs{ { ev1, ev0 } };
+	fsm.processEvents( evs );          // inner event on st2, then back to st0
+	std::cout << "nb tracepoints=" << nb << '\n';
+
+	spag::setTracepointHook( nullptr );
+	fsm.processEvent( ev0 );
+	fsm.stop();
+	std::cout << "nb tracepoints=" << nb << '\n';
+}
@@ -0,0 +1,68 @@
+/**
+\file testA_35.cpp
+\brief test of FsmEngine::createInstance(): instances built by the shard threads, aligned on a cache line (symbol SPAG_USE_FSM_ENGINE)
+*/
+
+#define SPAG_USE_FSM_ENGINE
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+
+std::atomic<size_t> g_nbCallbacks{0};
+
+void callback( int )
+{
+	g_nbCallbacks++;
+}
+
+int main()
+{
+	const size_t nbInstances = 20;
+
+	fsm_t model;
+	model.assignTransition( st0, ev0, st1 );
+	model.assignTransition( st1, ev0, st2 );
+	model.assignTransition( st2, ev0, st0 );
+	model.assignTransition( ev1, st0 );
+	model.assignCallbackAutoval( callback );
+
+	fsm_t userFsm;                                     // instances owned by the user can still be added
+	userFsm.assignConfig( model );
+
+	spag::FsmEngine<States,Events,int> engine( 4 );
+	for( size_t i=0; i<nbInstances; i++ )
+		if( i == 5 )
+			engine.addInstance( userFsm );
+		else
+			engine.createInstance( model );
+	std::cout << "nb instances=" << engine.nbInstances() << '\n';
+
+	engine.run();                                      // returns once the instances are built
+
+	bool aligned = true, shared = true;
+	for( size_t id=0; id<nbInstances; id++ )
+	{
+		auto& fsm = engine.instance( id );
+		if( id != 5 && reinterpret_cast<uintptr_t>( &fsm ) % SPAG_P_CACHE_LINE != 0 )
+			aligned = false;
+		if( !fsm.hasSharedConfig() )
+			shared = false;
+	}
+	std::cout << "created instances aligned on a cache line: " << ( aligned ? "yes" : "no" ) << '\n';
+	std::cout << "configuration shared: " << ( shared ? "yes" : "no" ) << '\n';
+	std::cout << "instance 5 is the user FSM: " << ( &engine.instance( 5 ) == &userFsm ? "yes" : "no" ) << '\n';
+
+	for( int i=0; i<4; i++ )
+		for( size_t id=0; id<nbInstances; id++ )
+			while( !engine.postEvent( id, ev0 ) )
+				std::this_thread::yield();
+	engine.stop();
+
+	std::cout << "total callbacks=" << g_nbCallbacks << '\n';     // start + 4 transitions per instance
+	for( size_t id=0; id<4; id++ )
+		std::cout << "instance " << id << ": state=" << engine.instance( id ).currentState()
+			<< " running=" << engine.instance( id ).isRunning() << '\n';
+}
@@ -0,0 +1,99 @@
+/**
+\file testA_36.cpp
+\brief test of the asynchronous callbacks, run by a CallbackPool (symbol SPAG_USE_ASYNC_CALLBACKS)
+*/
+
+#define SPAG_USE_ASYNC_CALLBACKS
+#include "spaghetti.hpp"
+
+enum States { st_idle, st_work, st_done, NB_STATES };
+enum Events { ev_start, ev_done, ev_reset, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+std::thread::id g_mainThread;
+std::atomic<int> g_nbOtherThread{0};
+std::atomic<int> g_nbCalls{0};
+
+void cb( int s )
+{
+	if( s == st_work )
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );   // some slow I/O
+		g_nbCalls++;
+		if( std::this_thread::get_id() != g_mainThread )
+			g_nbOtherThread++;
+	}
+}
+
+void configure( fsm_t& fsm )
+{
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st_idle, ev_start, st_work );
+	fsm.assignTransition( st_work, ev_done,  st_done );
+	fsm.assignTransition( ev_reset, st_idle );
+	fsm.assignAsyncCallback( st_work, ev_done );
+}
+
+int main()
+{
+	g_mainThread = std::this_thread::get_id();
+	spag::CallbackPool pool( 2 );
+	std::cout << "nb threads=" << pool.nbThreads() << '\n';
+
+	fsm_t fsm;
+	configure( fsm );
+	fsm.assignCallbackPool( pool );
+	fsm.start();
+
+	auto t0 = std::chrono::steady_clock::now();
+	fsm.processEvent( ev_start );
+	auto dt = std::chrono::steady_clock::now() - t0;
+	std::cout << "processEvent() did not wait for the callback: " << ( dt < std::chrono::milliseconds( 25 ) ? "yes" : "no" ) << '\n';
+	std::cout << "state=" << fsm.currentState() << '\n';
+
+	pool.wait();
+	std::cout << "callback done on other thread: " << g_nbOtherThread << '/' << g_nbCalls << '\n';
+	std::cout << "processed=" << fsm.processPostedEvents() << " state=" << fsm.currentState() << '\n';
+
+	fsm_t fsm2;                                    // no pool: callback is run by the FSM thread
+	configure( fsm2 );
+	fsm2.start();
+	fsm2.processEvent( ev_start );
+	std::cout << "without pool: calls=" << g_nbCalls << " on other thread=" << g_nbOtherThread
+		<< " processed=" << fsm2.processPostedEvents() << " state=" << fsm2.currentState() << '\n';
+
+	fsm2.clearAsyncCallback( st_work );             // back to synchronous: no completion event
+	fsm2.processEvent( ev_reset );
+	fsm2.processEvent( ev_start );
+	std::cout << "synchronous: calls=" << g_nbCalls << " processed=" << fsm2.processPostedEvents()
+		<< " state=" << fsm2.currentState() << " rejected=" << pool.nbRejected() << '\n';
+	fsm.stop();
+	fsm2.stop();
+
+	fsm_t fsm3;
+	configure( fsm3 );
+	fsm3.assignCallbackPool( pool );
+	fsm3.start();
+	fsm3.processEvent( ev_start );                  // callback is pushed, and takes some time
+	fsm3.assignCallbackValue( st_work, 100 );       // the pending callback keeps the configuration it was pushed with
+	fsm3.stop();                                    // waits for the pending callback
+	std::cout << "after stop: calls=" << g_nbCalls << '\n';
+
+	fsm3.start();
+	fsm3.processEvent( ev_reset );                  // back to st_idle before the callback is done
+	fsm3.processEvent( ev_start );
+	fsm3.processEvent( ev_reset );
+	fsm3.stop();                                    // the completion event posted meanwhile is discarded
+	fsm3.start();
+	std::cout << "after restart: processed=" << fsm3.processPostedEvents() << " state=" << fsm3.currentState() << '\n';
+	fsm3.stop();
+	{
+		fsm_t fsm4;
+		configure( fsm4 );
+		fsm4.assignCallbackPool( pool );
+		fsm4.start();
+		fsm4.processEvent( ev_start );
+	}                                               // destructor waits for the pending callback
+	std::cout << "after destruction: calls=" << g_nbCalls << '\n';
+}
@@ -0,0 +1,111 @@
+/**
+\file testA_37.cpp
+\brief test of the hot reconfiguration: publishConfig() from another thread, used from the next event on (symbol SPAG_USE_HOT_RECONFIG),
+and postEvent() from another thread while the configuration is replaced
+*/
+
+#define SPAG_USE_HOT_RECONFIG
+#define SPAG_USE_TIMER_WHEEL
+#define SPAG_USE_EVENT_QUEUE
+#include "spaghetti.hpp"
+
+#include <sstream>
+#include <thread>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, spag::WheelTimer, int );
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm2_t, States, Events, int );
+
+std::ostringstream g_out;   ///< holds the sequence of visited states
+
+void cb( int s )
+{
+	g_out << s;
+}
+
+void print( const char* msg, const fsm_t& fsm )
+{
+	std::cout << msg << ": sequence=" << g_out.str() << " current=" << fsm.currentState() << " nb swaps=" << fsm.nbConfigSwaps() << '\n';
+	g_out.str( "" );
+}
+
+int main()
+{
+	spag::TimerWheel wheel;
+	spag::WheelTimer<States,Events,int> timer( wheel );
+	fsm_t fsm;
+	fsm.assignEventHandler( &timer );
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st0 );
+	fsm.assignTransition( st2, ev0, st0 );
+	fsm.assignTimeOut( st1, 100, "ms", st0 );
+	fsm.start();
+	fsm.processEvent( ev0 );                 // on st1, timer running
+	print( "initial", fsm );
+
+	fsm_t next;                              // new configuration, built off to the side
+	next.assignConfig( fsm );                // starts from the current one (copied on first change)
+	next.assignTransition( st1, ev1, st2 );
+	next.clearTimeOuts();
+	next.assignTimeOut( st2, 50, "ms", st0 );
+	std::thread t( [&fsm,&next](){ fsm.publishConfig( next ); } );
+	t.join();
+	print( "published", fsm );               // not used yet
+
+	wheel.advance( 100 );                    // timeout: st1 has none in the new configuration, so it is ignored
+	print( "after old timeout", fsm );
+	fsm.processEvent( ev1 );                 // new transition
+	wheel.advance( 50 );                     // new timeout
+	print( "new config", fsm );
+
+	fsm_t next2;
+	next2.assignConfig( next );
+	next2.assignTransition( st0, ev1, st2 );   // two publications before the next event: only the last one is used
+	fsm_t next3;
+	next3.assignConfig( next2 );
+	next3.assignTransition( st0, ev1, st1 );
+	fsm.publishConfig( next2 );
+	fsm.publishConfig( next3 );
+	fsm.processEvent( ev1 );
+	print( "last published", fsm );
+	fsm.stop();
+
+	fsm2_t fsm2;                              // the events are posted while the configuration is swapped, and the previous one freed
+	fsm2.assignTransition( st0, ev0, st1 );
+	fsm2.assignTransition( st1, ev0, st0 );
+	fsm2.assignTransition( st1, ev1, st2 );
+	fsm2.assignTransition( st2, ev0, st0 );
+	fsm2.assignQueueFlags( ev1, spag::QueueDropIfIgnored );   // postEvent() reads the configuration
+	fsm2.start();
+	const size_t nbPost = 20000;
+	size_t nbRejected = 0;
+	std::atomic<bool> done( false );
+	std::thread poster( [&](){
+		for( size_t i=0; i<nbPost; i++ )
+			if( !fsm2.postEvent( i%2 ? ev0 : ev1 ) )
+				nbRejected++;
+		done = true;
+	} );
+	size_t nbProcessed = 0;
+	while( !done )
+	{
+		{
+			fsm2_t other;                           // its configuration is only owned by fsm2 once published
+			other.assignTransition( st0, ev0, st1 );
+			other.assignTransition( st1, ev0, st0 );
+			other.assignTransition( st1, ev1, st2 );
+			other.assignTransition( st2, ev0, st0 );
+			other.assignQueueFlags( ev1, spag::QueueDropIfIgnored );
+			fsm2.publishConfig( other );
+		}
+		nbProcessed += fsm2.processPostedEvents();
+	}
+	poster.join();
+	nbProcessed += fsm2.processPostedEvents();
+	std::cout << "posting while swapping: all events counted="
+		<< ( nbProcessed + fsm2.nbCoalescedEvents() + nbRejected == nbPost ) << '\n';
+	fsm2.stop();
+}
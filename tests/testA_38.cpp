@@ -0,0 +1,199 @@
+/**
+\file testA_38.cpp
+\brief test of the timeout policies (assignTimeOutPolicy() ): retry count, backoff and jitter of the durations,
+and durations given to the TimerStart tracepoint, default seeds, and retry state kept by snapshot() / restore()
+*/
+
+#define SPAG_USE_TIMER_WHEEL
+#define SPAG_USE_TIMEOUT_POLICIES
+#define SPAG_ENABLE_TRACEPOINTS
+#include "spaghetti.hpp"
+
+#include <sstream>
+
+enum States { st_idle, st_wait, st_fail, NB_STATES };
+enum Events { ev_go, ev_ack, ev_reset, NB_EVENTS };
+
+/// Event handler based on a TimerWheel (1 tick = 1 ms), that records the started durations
+template<typename ST, typename EV, typename CBA>
+struct RecordingTimer
+{
+	using Fsm_t = spag::SpagFSM<ST,EV,RecordingTimer,CBA>;
+
+	explicit RecordingTimer( spag::TimerWheel& wheel ) : _wheel( wheel )
+	{
+		_node._func = &RecordingTimer::onExpiry;
+		_node._arg  = this;
+	}
+	void init( const Fsm_t* fsm )
+	{
+		_fsm = fsm;
+	}
+	void timerStart( const Fsm_t* fsm )
+	{
+		auto duration = fsm->timeOutDuration( fsm->currentState() );
+		auto ticks = _wheel.toTicks( duration.first, duration.second );
+		_durations << ticks << ' ';
+		_wheel.schedule( _node, ticks );
+	}
+	void timerStartFor( const Fsm_t* fsm, uint64_t ns )
+	{
+		_fsm = fsm;
+		_wheel.schedule( _node, _wheel.toTicks( ns, spag::DurUnit::ns ) );
+	}
+	uint64_t timerRemaining() const
+	{
+		return _wheel.remaining( _node ) * 1000000;
+	}
+	void timerCancel()
+	{
+		_wheel.cancel( _node );
+	}
+	void kill()
+	{
+		_wheel.cancel( _node );
+	}
+	static void onExpiry( void* p )
+	{
+		static_cast<RecordingTimer*>(p)->_fsm->processTimeOut();
+	}
+
+	spag::TimerWheel& _wheel;
+	spag::TimerWheel::Node _node;
+	const Fsm_t* _fsm = nullptr;
+	std::ostringstream _durations;
+};
+
+SPAG_DECLARE_FSM_TYPE( fsm_t, States, Events, RecordingTimer, int );
+
+std::ostringstream g_out;   ///< holds the sequence of visited states
+std::ostringstream g_trace; ///< holds the durations (in ms) of the TimerStart tracepoints
+
+void hook( void*, spag::Tracepoint tp, const void*, size_t, size_t dur, size_t unit )
+{
+	if( tp == spag::Tracepoint::TimerStart )
+		g_trace << spag::priv::toNanoseconds( dur, static_cast<spag::DurUnit>( unit ) ) / 1000000 << ' ';
+}
+
+void cb( int s )
+{
+	g_out << s;
+}
+
+void config( fsm_t& fsm, RecordingTimer<States,Events,int>& timer )
+{
+	fsm.assignEventHandler( &timer );
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignTransition( st_idle, ev_go,    st_wait );
+	fsm.assignTransition( st_wait, ev_ack,   st_idle );
+	fsm.assignTransition( st_wait, ev_go,    st_wait );
+	fsm.assignTransition( st_fail, ev_reset, st_idle );
+	fsm.assignTimeOut( st_wait, 100, "ms", st_fail );
+}
+
+void print( const char* msg, const fsm_t& fsm, RecordingTimer<States,Events,int>& timer )
+{
+	std::cout << msg << ": sequence=" << g_out.str() << " durations=" << timer._durations.str()
+		<< "retries=" << fsm.retryCount() << " state=" << fsm.currentState() << " traced=" << g_trace.str() << '\n';
+	g_out.str( "" );
+	g_trace.str( "" );
+	timer._durations.str( "" );
+}
+
+int main()
+{
+	spag::TimerWheel wheel;
+	RecordingTimer<States,Events,int> timer( wheel );
+	fsm_t fsm;
+	config( fsm, timer );
+	try
+	{
+		fsm.assignTimeOutPolicy( st_idle, 2 );                 // no timeout on that state
+	}
+	catch( const std::exception& err )
+	{
+		std::cout << "error: no timeout\n";
+	}
+	fsm.assignTimeOutPolicy( st_wait, 3, 200 );
+	spag::setTracepointHook( hook );
+	fsm.start();
+
+	fsm.processEvent( ev_go );
+	wheel.advance( 100+200+400+800 );                      // exactly 3 retries, then st_fail
+	print( "backoff", fsm, timer );
+
+	fsm.processEvent( ev_reset );
+	fsm.processEvent( ev_go );
+	wheel.advance( 100+200 );                              // 2 retries
+	print( "partial", fsm, timer );
+	fsm.processEvent( ev_go );                             // self transition on event: count is reset
+	print( "event",   fsm, timer );
+	wheel.advance( 50 );
+	fsm.processEvent( ev_ack );
+	wheel.advance( 1000 );                                 // no timeout on st_idle
+	print( "ack",     fsm, timer );
+	fsm.stop();
+	spag::setTracepointHook( nullptr );
+
+	for( int i=0; i<2; i++ )                               // same seed gives same durations
+	{
+		spag::TimerWheel wheel2;
+		RecordingTimer<States,Events,int> timer2( wheel2 );
+		fsm_t fsm2;
+		config( fsm2, timer2 );
+		fsm2.assignTimeOutPolicy( st_wait, 4, 100, 20 );
+		fsm2.seedJitter( 1234 );
+		fsm2.start();
+		fsm2.processEvent( ev_go );
+		wheel2.advance( 1000 );
+		std::istringstream iss( timer2._durations.str() );
+		size_t d, nbOk=0;
+		while( iss >> d )
+			nbOk += ( d >= 80 && d <= 120 );
+		std::cout << "jitter: durations=" << timer2._durations.str() << "in range=" << nbOk << " state=" << fsm2.currentState() << '\n';
+		fsm2.stop();
+	}
+
+	{                                                      // default seeds differ between instances
+		spag::TimerWheel wheel2;
+		RecordingTimer<States,Events,int> timer2( wheel2 ), timer3( wheel2 );
+		fsm_t fsm2, fsm3;
+		config( fsm2, timer2 );
+		config( fsm3, timer3 );
+		fsm2.assignTimeOutPolicy( st_wait, 4, 100, 20 );
+		fsm3.assignConfig( fsm2 );
+		fsm3.assignEventHandler( &timer3 );
+		fsm2.start();
+		fsm3.start();
+		fsm2.processEvent( ev_go );
+		fsm3.processEvent( ev_go );
+		wheel2.advance( 1000 );
+		std::cout << "default seeds: different durations=" << ( timer2._durations.str() != timer3._durations.str() ? "yes" : "no" ) << '\n';
+		fsm2.stop();
+		fsm3.stop();
+	}
+	{                                                      // snapshot() / restore() keep the retry count and the jitter
+		spag::TimerWheel wheel2;
+		RecordingTimer<States,Events,int> timer2( wheel2 ), timer3( wheel2 );
+		fsm_t fsm2, fsm3;
+		config( fsm2, timer2 );
+		config( fsm3, timer3 );
+		fsm2.assignTimeOutPolicy( st_wait, 4, 100, 20 );
+		fsm3.assignConfig( fsm2 );
+		fsm3.assignEventHandler( &timer3 );
+		fsm2.seedJitter( 1234 );
+		fsm2.start();
+		fsm3.start();
+		fsm2.processEvent( ev_go );
+		wheel2.advance( 86+101 );                          // 2 retries (see durations above)
+		fsm3.restore( fsm2.snapshot() );
+		std::cout << "restored: retries=" << fsm3.retryCount();
+		timer2._durations.str( "" );
+		wheel2.advance( 1000 );
+		std::cout << " state=" << fsm3.currentState()
+			<< " same durations=" << ( timer2._durations.str() == timer3._durations.str() ? "yes" : "no" )
+			<< " durations=" << timer3._durations.str() << '\n';
+		fsm2.stop();
+		fsm3.stop();
+	}
+}
@@ -0,0 +1,60 @@
+/**
+\file testA_4.cpp
+\brief test of the binary asynchronous logging (SPAG_ASYNC_LOGGING), and of its conversion to csv.
+As the time stamps are not reproducible, they are replaced by a fixed string before printing.
+*/
+
+#define SPAG_ENUM_STRINGS
+#define SPAG_ASYNC_LOGGING
+#include "spaghetti.hpp"
+
+#include <sstream>
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+int main()
+{
+	{
+		fsm_t fsm;
+		fsm.assignTransition( st0, ev0, st1 );
+		fsm.assignTransition( st1, ev0, st2 );
+		fsm.assignTransition( st2, ev1, st0 );
+		fsm.assignString2State( st1, "state_1" );
+		fsm.assignString2Event( ev1, "event_1" );
+		fsm.setLogFileName( "testA_4.bin" );
+
+		fsm.start();
+		for( int i=0; i<1000; i++ )
+		{
+			fsm.processEvent( ev0 );
+			fsm.processEvent( ev0 );
+			fsm.processEvent( ev1 );
+			fsm.processEvent( ev1 );  // ignored
+		}
+		fsm.getCounters().print();
+	} // fsm destroyed here, so the log file is complete
+
+	std::ifstream f( "testA_4.bin", std::ios::binary );
+	std::ostringstream oss;
+	auto nb = spag::convertLogFile( f, oss );
+	std::cout << "\nNb records=" << nb << '\n';
+
+	std::istringstream iss( oss.str() );
+	std::string line;
+	size_t idx = 0;
+	while( std::getline( iss, line ) )
+	{
+		if( line[0] != '#' )
+		{
+			auto p1 = line.find( ';' );
+			auto p2 = line.find( ';', p1+1 );
+			line.replace( p1+1, p2-p1-1, "TIME" );
+		}
+		if( idx < 10 || idx > nb )
+			std::cout << line << '\n';
+		idx++;
+	}
+}
@@ -0,0 +1,70 @@
+/**
+\file testA_5.cpp
+\brief test of the thread-safe event queue (SPAG_USE_EVENT_QUEUE): several threads post events concurrently,
+and the main thread processes them.
+*/
+
+#define SPAG_USE_EVENT_QUEUE
+#define SPAG_EVENT_QUEUE_SIZE 64
+#include "spaghetti.hpp"
+
+#include <thread>
+
+enum States { st0, st1, NB_STATES };
+enum Events { ev0, ev1, ev2, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+int g_nbCallbacks = 0;
+int g_ignored = 0;
+
+void cb( int )
+{
+	g_nbCallbacks++;
+}
+void cb_ign( States, Events )
+{
+	g_ignored++;
+}
+
+const int g_nbThreads = 4;
+const int g_nbEvents  = 3000;  // per thread
+
+void producer( const fsm_t* fsm )
+{
+	for( int i=0; i<g_nbEvents; i++ )
+		while( !fsm->postEvent( static_cast<Events>( i%3 ) ) )  // queue full, retry
+			std::this_thread::yield();
+}
+
+int main()
+{
+	fsm_t fsm;
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st0 );
+	fsm.assignTransition( st0, ev1, st0 );   // ev1 processed on both states, ev2 always ignored
+	fsm.assignTransition( st1, ev1, st1 );
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignIgnoredEventsCallback( cb_ign );
+	fsm.start();
+
+	std::vector<std::thread> v_threads;
+	for( int i=0; i<g_nbThreads; i++ )
+		v_threads.push_back( std::thread( producer, &fsm ) );
+
+	size_t nb = 0;
+	while( nb < g_nbThreads*g_nbEvents )
+	{
+		auto n = fsm.processPostedEvents();
+		if( !n )
+			std::this_thread::yield();
+		nb += n;
+	}
+
+	for( auto& t: v_threads )
+		t.join();
+
+	std::cout << "processed " << nb << " events, remaining: " << fsm.processPostedEvents() << "\n";
+	std::cout << "nb callbacks (including start)=" << g_nbCallbacks << " nb ignored=" << g_ignored << '\n';
+	std::cout << "final state=" << fsm.currentState() << '\n';
+}
@@ -0,0 +1,79 @@
+/**
+\file testA_6.cpp
+\brief test of batch processing: processEvents() must give the same result as processEvent() called on each event.
+*/
+
+#define SPAG_FRIENDLY_CHECKING
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, ev2, ev3, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+std::vector<int> g_history;
+int g_ignored = 0;
+
+void cb( int st )
+{
+	g_history.push_back( st );
+}
+void cb_ign( States, Events )
+{
+	g_ignored++;
+}
+
+void config( fsm_t& fsm )
+{
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTransition( st2, ev0, st0 );
+	fsm.assignTransition( st1, ev1, st0 );
+	fsm.assignTransition( st2, ev2, st1 );
+	fsm.assignTransition( ev3, st0 );       // ev3 leads to st0 from all states
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignIgnoredEventsCallback( cb_ign );
+}
+
+int main()
+{
+	std::vector<Events> v_events;
+	unsigned int seed = 42;
+	for( int i=0; i<10000; i++ )
+	{
+		seed = seed * 1103515245u + 12345u;
+		v_events.push_back( static_cast<Events>( (seed>>16) % NB_EVENTS ) );
+	}
+
+	fsm_t fsm1;
+	config( fsm1 );
+	fsm1.start();
+	for( auto ev: v_events )
+		fsm1.processEvent( ev );
+	auto h1 = g_history;
+	auto i1 = g_ignored;
+	std::cout << "single: nb callbacks=" << h1.size() << " nb ignored=" << i1 << " final state=" << fsm1.currentState() << '\n';
+
+	g_history.clear();
+	g_ignored = 0;
+	fsm_t fsm2;
+	config( fsm2 );
+	fsm2.start();
+	auto nb = fsm2.processEvents( v_events.begin(), v_events.end() );
+	std::cout << "batch: nb processed=" << nb << " nb callbacks=" << g_history.size() << " nb ignored=" << g_ignored << " final state=" << fsm2.currentState() << '\n';
+	std::cout << "identical history: " << (h1 == g_history && i1 == g_ignored ? "yes" : "no") << '\n';
+
+	Events tab[] = { ev0, ev0, ev2 };         // container overload
+	nb = fsm2.processEvents( tab );
+	std::cout << "array: nb processed=" << nb << " final state=" << fsm2.currentState() << '\n';
+
+	std::vector<Events> v_bad = { ev0, ev0, NB_EVENTS };
+	try
+	{
+		fsm2.processEvents( v_bad );
+	}
+	catch( const std::exception& )
+	{
+		std::cout << "invalid range: error, state unchanged=" << fsm2.currentState() << '\n';
+	}
+}
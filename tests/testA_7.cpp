@@ -0,0 +1,60 @@
+/**
+\file testA_7.cpp
+\brief test of the packed transition table (SPAG_PACKED_TABLE): must behave exactly as the default one, also when changed while running.
+*/
+
+#define SPAG_PACKED_TABLE
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, st3, NB_STATES };
+enum Events { ev0, ev1, ev2, ev3, ev4, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+size_t g_nbCallbacks = 0;
+size_t g_checksum = 0;
+int g_ignored = 0;
+
+void cb( int st )
+{
+	g_nbCallbacks++;
+	g_checksum = g_checksum * 31 + st;
+}
+void cb_ign( States, Events )
+{
+	g_ignored++;
+}
+
+int main()
+{
+	std::cout << "cell size: 4 states=" << sizeof( spag::priv::PackedCellType<4>::type )
+		<< " 300 states=" << sizeof( spag::priv::PackedCellType<300>::type )
+		<< " 20000 states=" << sizeof( spag::priv::PackedCellType<20000>::type ) << '\n';
+
+	fsm_t fsm;
+	fsm.assignTransition( st0, ev0, st1 );
+	fsm.assignTransition( st1, ev0, st2 );
+	fsm.assignTransition( st2, ev0, st3 );
+	fsm.assignTransition( st3, ev0, st0 );
+	fsm.assignTransition( st1, ev1, st3 );
+	fsm.assignTransition( st3, ev2, st3 );
+	fsm.assignTransition( ev3, st0 );       // ev3 leads to st0 from all states
+	fsm.assignTransition( st2, ev4, st1 );
+	fsm.allowEvent( st2, ev4, false );      // transition assigned, but not allowed
+	fsm.assignCallbackAutoval( cb );
+	fsm.assignIgnoredEventsCallback( cb_ign );
+	fsm.start();
+
+	unsigned int seed = 7;
+	for( int i=0; i<20000; i++ )
+	{
+		seed = seed * 1103515245u + 12345u;
+		fsm.processEvent( static_cast<Events>( (seed>>16) % NB_EVENTS ) );
+	}
+	std::cout << "nb callbacks=" << g_nbCallbacks << " nb ignored=" << g_ignored
+		<< " checksum=" << g_checksum << " final state=" << fsm.currentState() << '\n';
+
+	fsm.assignTransition( st3, ev4, st2 );  // changed while running: the table must be built again
+	fsm.processEvent( ev4 );
+	std::cout << "after change while running: state=" << fsm.currentState() << '\n';
+}
@@ -0,0 +1,57 @@
+/**
+\file testA_8.cpp
+\brief test of configuration sharing between several FSM (assignConfig() ), with copy on write
+*/
+
+#define SPAG_ENUM_STRINGS
+#include "spaghetti.hpp"
+
+enum States { st0, st1, st2, NB_STATES };
+enum Events { ev0, ev1, NB_EVENTS };
+
+SPAG_DECLARE_FSM_TYPE_NOTIMER( fsm_t, States, Events, int );
+
+int g_nbCallbacks = 0;
+
+void cb( int )
+{
+	g_nbCallbacks++;
+}
+
+int main()
+{
+	fsm_t model;
+	model.assignTransition( st0, ev0, st1 );
+	model.assignTransition( st1, ev0, st2 );
+	model.assignTransition( st2, ev0, st0 );
+	model.assignTransition( ev1, st0 );
+	model.assignCallback( cb );
+	model.assignString2State( st1, "ST_ONE" );
+
+	std::cout << "before sharing: shared=" << model.hasSharedConfig() << '\n';
+	std::vector<fsm_t> v_fsm( 1000 );
+	for( auto& fsm: v_fsm )
+		fsm.assignConfig( model );
+	std::cout << "after sharing: shared=" << model.hasSharedConfig() << '\n';
+
+	for( size_t i=0; i<v_fsm.size(); i++ )
+	{
+		v_fsm[i].start();
+		for( size_t j=0; j<i%3; j++ )
+			v_fsm[i].processEvent( ev0 );
+	}
+	size_t nb[3] = { 0, 0, 0 };
+	for( const auto& fsm: v_fsm )
+		nb[ fsm.currentState() ]++;
+	std::cout << "nb callbacks=" << g_nbCallbacks
+		<< " nb on each state: " << nb[0] << '-' << nb[1] << '-' << nb[2] << '\n';
+	std::cout << "state string: " << v_fsm[1].getString( v_fsm[1].currentState() ) << '\n';
+
+	v_fsm[0].assignTransition( st0, ev0, st2 );           // copy on write: only v_fsm[0] is modified
+	v_fsm[0].assignString2State( st2, "ST_TWO" );
+	std::cout << "after change: fsm0 shared=" << v_fsm[0].hasSharedConfig() << " fsm3 shared=" << v_fsm[3].hasSharedConfig() << '\n';
+	v_fsm[0].processEvent( ev0 );
+	v_fsm[3].processEvent( ev0 );
+	std::cout << "fsm0: " << v_fsm[0].getString( v_fsm[0].currentState() )
+		<< ", fsm3: " << v_fsm[3].getString( v_fsm[3].currentState() ) << '\n';
+}
@@ -0,0 +1,51 @@
+/**
+\file testA_9.cpp
+\brief test of the compile-time FSM (StaticFSM), with transitions, timeout and AAT
+*/
+
+#include "spaghetti.hpp"
+
+enum States { st_Init, st_Locked, st_Unlocked, st_Alarm, st_Reset, NB_STATES };
+enum Events { ev_Coin, ev_Push, ev_Kick, NB_EVENTS };
+
+struct Callbacks : public spag::StaticNoCallback<States,Events>
+{
+	void onEnter( States st )
+	{
+		std::cout << "enter " << st << '\n';
+		_nbEnter++;
+	}
+	void onIgnored( States st, Events ev )
+	{
+		std::cout << "ignored event " << ev << " on state " << st << '\n';
+	}
+	int _nbEnter = 0;
+};
+
+SPAG_DECLARE_STATIC_FSM_TYPE( fsm_t, States, Events, Callbacks,
+	SPAG_STATIC_AAT(        st_Init,     st_Locked ),
+	SPAG_STATIC_TRANSITION( st_Locked,   ev_Coin, st_Unlocked ),
+	SPAG_STATIC_TRANSITION( st_Unlocked, ev_Push, st_Locked ),
+	SPAG_STATIC_TRANSITION( st_Unlocked, ev_Coin, st_Unlocked ),
+	SPAG_STATIC_TRANSITION( st_Locked,   ev_Kick, st_Alarm ),
+	SPAG_STATIC_TIMEOUT(    st_Alarm,    5, spag::DurUnit::sec, st_Reset ),
+	SPAG_STATIC_AAT(        st_Reset,    st_Locked )
+);
+
+int main()
+{
+	fsm_t fsm;
+	fsm.start();
+	std::cout << "current state=" << fsm.currentState() << '\n';
+
+	Events events[] = { ev_Push, ev_Coin, ev_Coin, ev_Push, ev_Kick, ev_Coin };
+	for( auto ev: events )
+		fsm.processEvent( ev );
+
+	std::cout << "has timeout=" << fsm.hasTimeOut()
+		<< ", duration=" << fsm.timeOutDuration( fsm.currentState() ).first << '\n';
+	fsm.processTimeOut();
+	std::cout << "current state=" << fsm.currentState() << ", previous=" << fsm.previousState()
+		<< ", has timeout=" << fsm.hasTimeOut() << '\n';
+	std::cout << "nb callbacks=" << fsm.handler()._nbEnter << '\n';
+}